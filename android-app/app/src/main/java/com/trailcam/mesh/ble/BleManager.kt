@@ -46,6 +46,10 @@ class BleManager(private val context: Context) {
     private val _capturedImages = MutableStateFlow<List<CapturedImage>>(emptyList())
     val capturedImages: StateFlow<List<CapturedImage>> = _capturedImages.asStateFlow()
     
+    // Live view frames replace each other rather than piling up in the list
+    private val _liveFrame = MutableStateFlow<LiveFrame?>(null)
+    val liveFrame: StateFlow<LiveFrame?> = _liveFrame.asStateFlow()
+    
     private val _nodeStatuses = MutableStateFlow<Map<Int, NodeStatus>>(emptyMap())
     val nodeStatuses: StateFlow<Map<Int, NodeStatus>> = _nodeStatuses.asStateFlow()
     
@@ -173,6 +177,66 @@ class BleManager(private val context: Context) {
         sendCommand(Commands.PING_MESH)
     }
     
+    /**
+     * Ask a node for the full image behind a thumbnail
+     */
+    fun fetchFullImage(nodeId: Int, imageId: Int) {
+        sendCommand(Commands.FETCH_IMAGE, byteArrayOf(
+            (nodeId and 0xFF).toByte(),
+            ((nodeId shr 8) and 0xFF).toByte(),
+            (imageId and 0xFF).toByte(),
+            ((imageId shr 8) and 0xFF).toByte()
+        ))
+    }
+    
+    /**
+     * Start streaming live view from a node; the gateway keeps it going
+     * until stopLiveView() or the connection drops
+     */
+    fun startLiveView(nodeId: Int) {
+        sendCommand(Commands.LIVE_START, byteArrayOf(
+            (nodeId and 0xFF).toByte(),
+            ((nodeId shr 8) and 0xFF).toByte()
+        ))
+    }
+    
+    /**
+     * Stop live view
+     */
+    fun stopLiveView() {
+        sendCommand(Commands.LIVE_STOP)
+        _liveFrame.value = null
+    }
+    
+    /**
+     * Ask a node for the high-res archive frame taken with an image; it
+     * arrives like a fetched full image
+     */
+    fun pullArchivedImage(nodeId: Int, imageId: Int) {
+        sendCommand(Commands.ARCHIVE_PULL, byteArrayOf(
+            (nodeId and 0xFF).toByte(),
+            ((nodeId shr 8) and 0xFF).toByte(),
+            (imageId and 0xFF).toByte(),
+            ((imageId shr 8) and 0xFF).toByte()
+        ))
+    }
+    
+    /**
+     * Ask a node for up to maxImages archive frames taken at or after a
+     * mesh timestamp
+     */
+    fun pullArchive(nodeId: Int, since: Long, maxImages: Int) {
+        sendCommand(Commands.ARCHIVE_PULL_SINCE, byteArrayOf(
+            (nodeId and 0xFF).toByte(),
+            ((nodeId shr 8) and 0xFF).toByte(),
+            (since and 0xFF).toByte(),
+            ((since shr 8) and 0xFF).toByte(),
+            ((since shr 16) and 0xFF).toByte(),
+            ((since shr 24) and 0xFF).toByte(),
+            maxImages.coerceIn(0, 255).toByte()
+        ))
+    }
+    
     /**
      * Clear all alerts and images
      */
@@ -333,6 +397,13 @@ class BleManager(private val context: Context) {
             }
         }
         
+        // Classifier score follows the path on newer firmware (0xFF = not scored)
+        var confidence: Int? = null
+        if (buffer.remaining() >= 1) {
+            val score = buffer.get().toInt() and 0xFF
+            if (score != 0xFF) confidence = score
+        }
+        
         // Global deduplication: ignore ANY alert within cooldown window
         // This prevents false gateway alerts triggered by electrical noise during sensor alert processing
         val now = System.currentTimeMillis()
@@ -346,7 +417,8 @@ class BleManager(private val context: Context) {
             nodeId = nodeId,
             timestamp = timestamp,
             hasImage = hasImage,
-            path = pathIds
+            path = pathIds,
+            confidence = confidence
         )
         
         val currentAlerts = _motionAlerts.value.toMutableList()
@@ -379,7 +451,35 @@ class BleManager(private val context: Context) {
                 val totalSize = buffer.int
                 val totalChunks = buffer.short.toInt() and 0xFFFF
                 
-                currentImageReception = ImageReception(nodeId, imageId, totalSize, totalChunks)
+                // Crop geometry follows the reserved byte on newer gateways
+                var region: ImageRegion? = null
+                if (data.size >= 25) {
+                    buffer.get() // Skip reserved
+                    val flags = buffer.get().toInt() and 0xFF
+                    if (flags != 0) {
+                        region = ImageRegion(
+                            flags = flags,
+                            x = buffer.short.toInt() and 0xFFFF,
+                            y = buffer.short.toInt() and 0xFFFF,
+                            width = buffer.short.toInt() and 0xFFFF,
+                            height = buffer.short.toInt() and 0xFFFF,
+                            frameWidth = buffer.short.toInt() and 0xFFFF,
+                            frameHeight = buffer.short.toInt() and 0xFFFF
+                        )
+                    }
+                }
+                
+                // Latency and frame rate follow on gateways with live view
+                var latencyMs = -1
+                var fps = 0f
+                if (data.size >= 29) {
+                    val latency = buffer.getShort(25).toInt() and 0xFFFF
+                    latencyMs = if (latency == 0xFFFF) -1 else latency
+                    fps = (buffer.getShort(27).toInt() and 0xFFFF) / 10f
+                }
+                
+                currentImageReception = ImageReception(nodeId, imageId, totalSize, totalChunks,
+                    region = region, latencyMs = latencyMs, fps = fps)
                 Log.d(TAG, "Image start: node=$nodeId, id=$imageId, size=$totalSize, chunks=$totalChunks")
             }
             0x00 -> { // Image chunk
@@ -404,11 +504,21 @@ class BleManager(private val context: Context) {
             0x02 -> { // Image end
                 val reception = currentImageReception ?: return
                 
-                if (reception.isComplete || reception.receivedChunks > 0) {
+                if (reception.region?.isLive == true) {
+                    if (reception.isComplete) {
+                        _liveFrame.value = LiveFrame(
+                            nodeId = reception.nodeId,
+                            data = reception.buffer.copyOf(),
+                            fps = reception.fps,
+                            latencyMs = reception.latencyMs
+                        )
+                    }
+                } else if (reception.isComplete || reception.receivedChunks > 0) {
                     val image = CapturedImage(
                         nodeId = reception.nodeId,
                         imageId = reception.imageId,
-                        data = reception.buffer.copyOf()
+                        data = reception.buffer.copyOf(),
+                        region = reception.region
                     )
                     
                     val currentImages = _capturedImages.value.toMutableList()
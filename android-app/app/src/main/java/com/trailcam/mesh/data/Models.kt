@@ -24,9 +24,62 @@ data class MotionAlert(
     val timestamp: Long,
     val hasImage: Boolean,
     val receivedAt: Long = System.currentTimeMillis(),
-    val path: List<Int> = emptyList()
+    val path: List<Int> = emptyList(),
+    /** On-camera classifier score 0-100 that the trigger was an animal; null if not scored */
+    val confidence: Int? = null
 )
 
+/**
+ * Where an image sits in the camera's full frame. A crop carries its
+ * origin and size; a context image is a low-quality view of the whole frame.
+ * A thumbnail is a reduced preview whose full image can be fetched.
+ * Clip frames arrive as consecutive image IDs from one motion event.
+ */
+data class ImageRegion(
+    val flags: Int,
+    val x: Int,
+    val y: Int,
+    val width: Int,
+    val height: Int,
+    val frameWidth: Int,
+    val frameHeight: Int
+) {
+    val isCrop: Boolean
+        get() = flags and FLAG_CROP != 0
+
+    val isContext: Boolean
+        get() = flags and FLAG_CONTEXT != 0
+
+    val isThumbnail: Boolean
+        get() = flags and FLAG_THUMBNAIL != 0
+
+    val isClip: Boolean
+        get() = flags and FLAG_CLIP != 0
+
+    val isLive: Boolean
+        get() = flags and FLAG_LIVE != 0
+
+    val isTimelapse: Boolean
+        get() = flags and FLAG_TIMELAPSE != 0
+
+    val isPriority: Boolean
+        get() = flags and FLAG_PRIORITY != 0
+
+    val isPartial: Boolean
+        get() = flags and FLAG_PARTIAL != 0
+
+    companion object {
+        const val FLAG_CROP = 0x01
+        const val FLAG_CONTEXT = 0x02
+        const val FLAG_THUMBNAIL = 0x04
+        const val FLAG_CLIP = 0x08
+        const val FLAG_LIVE = 0x10
+        const val FLAG_TIMELAPSE = 0x20
+        const val FLAG_PRIORITY = 0x40
+        const val FLAG_PARTIAL = 0x80
+    }
+}
+
 /**
  * Captured image from a trail camera
  */
@@ -34,8 +87,21 @@ data class CapturedImage(
     val nodeId: Int,
     val imageId: Int,
     val data: ByteArray,
-    val timestamp: Long = System.currentTimeMillis()
+    val timestamp: Long = System.currentTimeMillis(),
+    val region: ImageRegion? = null
 ) {
+    /** Full-resolution image sent in answer to a fetch */
+    val isFullImage: Boolean
+        get() = imageId and FULL_IMAGE_BIT != 0
+
+    /** ID of the thumbnail this image belongs to */
+    val baseImageId: Int
+        get() = imageId and FULL_IMAGE_BIT.inv()
+
+    companion object {
+        const val FULL_IMAGE_BIT = 0x8000
+    }
+
     override fun equals(other: Any?): Boolean {
         if (this === other) return true
         if (javaClass != other?.javaClass) return false
@@ -50,6 +116,31 @@ data class CapturedImage(
     }
 }
 
+/**
+ * Latest live view frame from a node, with the gateway's readout of how
+ * stale it is and how fast frames are arriving
+ */
+data class LiveFrame(
+    val nodeId: Int,
+    val data: ByteArray,
+    val fps: Float,
+    val latencyMs: Int,
+    val receivedAt: Long = System.currentTimeMillis()
+) {
+    override fun equals(other: Any?): Boolean {
+        if (this === other) return true
+        if (javaClass != other?.javaClass) return false
+        other as LiveFrame
+        return nodeId == other.nodeId && receivedAt == other.receivedAt
+    }
+
+    override fun hashCode(): Int {
+        var result = nodeId
+        result = 31 * result + receivedAt.hashCode()
+        return result
+    }
+}
+
 /**
  * Trail camera node status
  */
@@ -90,7 +181,10 @@ data class ImageReception(
     val totalSize: Int,
     val totalChunks: Int,
     var receivedChunks: Int = 0,
-    val buffer: ByteArray = ByteArray(totalSize)
+    val buffer: ByteArray = ByteArray(totalSize),
+    val region: ImageRegion? = null,
+    val latencyMs: Int = -1,
+    val fps: Float = 0f
 ) {
     val isComplete: Boolean
         get() = receivedChunks >= totalChunks
@@ -119,6 +213,11 @@ object Commands {
     const val REQUEST_STATUS: Byte = 0x01
     const val FORCE_CAPTURE: Byte = 0x02
     const val PING_MESH: Byte = 0x03
+    const val FETCH_IMAGE: Byte = 0x04
+    const val LIVE_START: Byte = 0x05
+    const val LIVE_STOP: Byte = 0x06
+    const val ARCHIVE_PULL: Byte = 0x07
+    const val ARCHIVE_PULL_SINCE: Byte = 0x08
 }
 
 
@@ -27,8 +27,9 @@
 
 // PIR Sensor
 #define PIR_PIN 13              // GPIO 13 - motion detection input
-#define PIR_DEBOUNCE_MS 500     // Debounce time in milliseconds
+#define PIR_EPISODE_GAP_MS 500  // Output low this long ends a motion episode
 #define PIR_COOLDOWN_MS 5000    // Cooldown between triggers (5 seconds)
+#define PIR_EDGE_RING 32        // Edges buffered from the ISR (power of two)
 
 // Status LED
 #define LED_PIN 2               // GPIO 2 - onboard blue LED
@@ -62,6 +63,129 @@
 #define CAMERA_JPEG_QUALITY 12            // 0-63, lower = higher quality
 #define CAMERA_FB_COUNT 2                 // Frame buffer count (PSRAM allows more)
 
+// Camera power between captures: OFF releases the driver (slowest wake),
+// STANDBY keeps it configured with the sensor in standby, HOT keeps it
+// streaming with exposure settled (fastest, most power). The pre-trigger
+// ring keeps the camera hot regardless.
+#define CAMERA_POWER_OFF 0
+#define CAMERA_POWER_STANDBY 1
+#define CAMERA_POWER_HOT 2
+#define CAMERA_POWER_MODE CAMERA_POWER_STANDBY
+#define CAMERA_IDLE_MS 10000              // Stay hot this long after the last capture
+#define CAMERA_SETTLE_FRAMES 2            // Frames discarded after a wake while exposure settles
+#define CAMERA_MAX_FRAME_AGE_MS 100       // Older buffered frames are discarded
+#define CAMERA_LATENCY_REPORT 16          // Log the trigger-to-frame histogram every N triggers
+
+// Pre-trigger ring: keep capturing into PSRAM so a motion event can send
+// frames from just before the PIR fired (needs PSRAM)
+#define PRETRIGGER_ENABLED true
+#define PRETRIGGER_INTERVAL_MS 250        // Capture rate while armed (4 fps)
+#define PRETRIGGER_SLOTS 6                // JPEG slots in the ring
+#define PRETRIGGER_SLOT_BYTES IMG_SLOT_BYTES
+#define PRETRIGGER_WINDOW_MS 750          // Frames this recent are frozen on motion
+#define PRETRIGGER_MAX_FRAMES 3           // Frames offered per motion event
+
+// Capture/transmit pipeline: motion events are captured while earlier
+// images are still on the mesh (frame queue needs PSRAM)
+#define MOTION_EVENT_QUEUE 8              // Motion events waiting for capture
+#define MESH_COMMAND_QUEUE 8              // Mesh commands waiting for the loop
+#define FRAME_QUEUE_DEPTH 8               // Captured images waiting for the mesh (fits a burst)
+#define FRAME_QUEUE_SLOT_BYTES IMG_SLOT_BYTES  // Larger frames stream from the camera buffer
+
+// Burst clips: a motion event captures several frames at a fixed interval
+// and sends them as one clip while later frames are still being captured
+// (needs the frame queue; a clip costs several images' airtime)
+#define BURST_ENABLED false
+#define BURST_FRAMES 5                    // Frames per clip (3-10, at most FRAME_QUEUE_DEPTH)
+#define BURST_INTERVAL_MS 400             // Time between clip frames
+
+// Live view: the phone picks a node, which streams small JPEGs back to
+// back while the gateway keeps renewing its lease
+#define LIVE_MAX_WIDTH 160                // Frames are decoded down to at most this width
+#define LIVE_QUALITY 35                   // Live frame JPEG quality
+#define LIVE_MIN_INTERVAL_MS 100          // Fastest frame rate (10 fps)
+#define LIVE_MAX_INTERVAL_MS 2000         // Slowest rate after repeated failures
+#define LIVE_LEASE_MS 5000                // Sensor stops unless renewed within this
+#define LIVE_RENEW_MS 2000                // Gateway renews the lease this often
+
+// Time-lapse: snapshots on a schedule are held on the sensor and sent as
+// one clip when the gateway grants an off-peak window (needs PSRAM)
+#define TIMELAPSE_ENABLED false
+#define TIMELAPSE_INTERVAL_MS 600000      // Between snapshots (10 min)
+#define TIMELAPSE_SLOTS 16                // Snapshots held (at most CLIP_MAX_FRAMES per batch)
+#define TIMELAPSE_SLOT_BYTES IMG_SLOT_BYTES
+#define TIMELAPSE_BATCH_MIN 8             // Snapshots held before asking for a window
+#define TIMELAPSE_QUIET_MS 30000          // Gateway: image-free time that opens a window
+#define TIMELAPSE_RETRY_MS 60000          // Ask again this late when no window is given
+
+// High-res archive: after each motion image the sensor takes a large
+// frame and keeps it on microSD or flash for the phone to pull later
+// (needs PSRAM). microSD runs in 1-bit mode on GPIO 2/14/15, so LED_PIN
+// must move off GPIO 2 first; flash only fits a few dozen frames.
+#define ARCHIVE_STORAGE_SD 0
+#define ARCHIVE_STORAGE_FLASH 1
+#define ARCHIVE_ENABLED false
+#define ARCHIVE_STORAGE ARCHIVE_STORAGE_SD
+#define ARCHIVE_FRAME_SIZE FRAMESIZE_UXGA // 1600x1200 (OV2640 maximum)
+#define ARCHIVE_QUALITY 10                // Archive JPEG quality
+#define ARCHIVE_MAX_IMAGES 1000           // Index slots; the oldest image goes first
+#define ARCHIVE_MIN_FREE_BYTES 1048576    // Storage kept free (1 MB)
+#define ARCHIVE_PULL_QUEUE 8              // Single-image pulls waiting
+#define ARCHIVE_PULL_MAX 50               // Most images one bulk pull sends
+
+// Image budget controller: steer JPEG quality and frame size so images
+// fit a per-image byte budget set by hop depth and measured throughput
+#define QC_ENABLED true
+#define QC_TARGET_TRANSFER_MS 8000        // Aim to deliver one image within this
+#define QC_MIN_BUDGET 3000                // Never aim below this many bytes
+#define QC_QUALITY_WORST 40               // Coarsest JPEG quality used (best is CAMERA_JPEG_QUALITY)
+#define QC_QUALITY_STEP 3                 // Quality change per adjustment
+#define QC_FRAME_SIZE_MIN FRAMESIZE_QQVGA // Smallest frame size used
+#define QC_RECAPTURE_MAX 3                // Recaptures of a frame too large to send
+#define QC_LARGE_IMAGES false             // Aim up to IMG_MAX_BYTES rather than one PSRAM slot
+
+// Motion verification: compare a tiny luma thumbnail of the trigger frame
+// with a running background and veto PIR triggers where nothing moved
+#define VERIFY_ENABLED true
+#define VERIFY_THUMB_WIDTH 32             // Thumbnail grid (width * height must be a multiple of 4)
+#define VERIFY_THUMB_HEIGHT 24
+#define VERIFY_PIXEL_THRESHOLD 10         // Luma change (0-127) that counts a pixel as changed
+#define VERIFY_MIN_CHANGED_PCT 2          // Percent of pixels that must change to pass
+#define VERIFY_LEARN_FRAMES 2             // Background frames needed before vetoing
+
+// Animal classifier: a tiny int8 CNN on the verification thumbnail scores
+// each trigger 0-100 (needs VERIFY_ENABLED). Ships with hand-set
+// placeholder weights until trained ones are exported.
+#define CLASSIFY_ENABLED false
+#define CLASSIFY_DROP_PCT 0               // Scores below this are dropped as empty (0 = keep all)
+#define CLASSIFY_PRIORITY_PCT 70          // Scores from this up are sent as high priority
+
+// Region of interest: send only the part of the frame that changed,
+// re-encoded at better quality (needs PSRAM for the decode)
+#define ROI_ENABLED true
+#define ROI_JPEG_QUALITY 8                // Quality of the cropped region
+#define ROI_MARGIN_PCT 20                 // Padding around the changed box
+#define ROI_MAX_AREA_PCT 50               // Bigger changes send the full frame
+#define ROI_DECODE_MAX_BYTES (640 * 480 * 2)  // RGB565 decode limit; larger frames are decoded scaled
+#define ROI_CONTEXT_ENABLED false         // Also send a low-quality full frame
+#define ROI_CONTEXT_QUALITY 50            // Quality of the context frame (1/4 scale)
+
+// Near-duplicate suppression: skip images whose perceptual hash is close
+// to one sent recently (an animal feeding in front of the camera)
+#define DEDUP_ENABLED true
+#define DEDUP_MAX_DISTANCE 6              // dHash bits (of 64) that may differ for a duplicate
+#define DEDUP_HISTORY 8                   // Recently sent hashes remembered
+#define DEDUP_WINDOW_MS 300000            // Sent hashes expire after this (5 minutes)
+#define DEDUP_ALERT_ONLY true             // Still send the alert, without an image
+
+// Thumbnail-first delivery: send a small preview right away and keep the
+// full JPEG in a PSRAM cache until the gateway or phone fetches it
+#define THUMB_FIRST_ENABLED true
+#define THUMB_MAX_WIDTH 96                // Preview is decoded down to at most this width
+#define THUMB_QUALITY 30                  // Preview JPEG quality
+#define IMG_CACHE_SLOTS 12                // Full images held for fetching
+#define IMG_CACHE_SLOT_BYTES IMG_SLOT_BYTES
+
 // ============================================================================
 // MESH NETWORK CONFIGURATION
 // ============================================================================
@@ -72,23 +196,112 @@
 #define MESH_HEARTBEAT_INTERVAL_MS 10000  // Heartbeat every 10 seconds
 #define MESH_ROUTE_TIMEOUT_MS 30000       // Route expires after 30s no heartbeat
 
+// Transmit queue limits per traffic class (frames)
+#define TXQ_CONTROL_LIMIT 16              // ACK/NACK, discovery, commands
+#define TXQ_ALERT_LIMIT 8                 // Motion alerts
+#define TXQ_BULK_LIMIT 32                 // Relayed image chunks (shared by all sources)
+#define TXQ_TELEMETRY_LIMIT 4             // Heartbeats and status
+
+// Relay fair queueing (bulk traffic is scheduled per source node)
+#define FAIRQ_PER_SOURCE_LIMIT 12         // Max queued bulk frames per source
+#define FAIRQ_QUANTUM_BYTES 256           // DRR credit per turn (>= one full frame)
+
+// Sleepy children: radio off between polls of the parent relay
+#define MESH_SLEEPY_NODE false            // Set true on battery sensors that never relay
+#define MESH_POLL_INTERVAL_MS 5000        // Child polls its parent this often
+#define MESH_POLL_LISTEN_MS 60            // Radio stays on this long after last activity
+#define MESH_CHILD_MAX 4                  // Sleepy children a parent buffers for
+#define MESH_CHILD_BUFFER 6               // Downstream messages held per child
+#define MESH_CHILD_TIMEOUT_MS 30000       // Child forgotten after this long without a poll
+
+// Deep sleep: a battery sensor sleeps once idle and the PIR wakes it
+// (needs MESH_SLEEPY_NODE). Routes and the mesh clock survive in RTC
+// memory; the pre-trigger ring and time-lapse are not started.
+#define DEEP_SLEEP_ENABLED false
+#define DEEP_SLEEP_IDLE_MS 15000          // Awake this long after the last activity
+#define DEEP_SLEEP_CHECKIN_S 3600         // Timer wake to heartbeat and poll (0 = PIR only)
+#define DEEP_SLEEP_CHECKIN_MS 2000        // Awake this long after a timer wake
+#define MESH_RTC_NODES 4                  // Routes kept across deep sleep
+
+// Relay wake windows: duty-cycled relays listen only in short periodic
+// windows on the mesh clock, advertised in heartbeats. Neighbours hold
+// non-urgent traffic for the window; motion alerts wake-burst through.
+#define MESH_WAKE_WINDOWS_ENABLED false   // Duty-cycle this node's radio
+#define MESH_WAKE_PERIOD_MS 1000          // Window repeats this often
+#define MESH_WAKE_OFFSET_MS 0             // Window phase (keep equal mesh-wide so broadcasts land)
+#define MESH_WAKE_WINDOW_MS 50            // Listen window length
+#define MESH_WAKE_DEFER_MAX 16            // Frames held for sleeping neighbours
+#define MESH_WAKE_BURST_GAP_MS 10         // Urgent resend spacing while the target sleeps
+
+// Mesh time sync (gateway is the reference, carried in heartbeats)
+#define MESH_CLOCK_STEP_MS 20             // Larger corrections step, smaller ones slew
+#define MESH_CLOCK_SYNC_TIMEOUT_MS 30000  // Sync lost after this long without a reference
+
+// TDMA: bulk traffic only in the node's own slot (DEVICE_ID % slots).
+// Each node then sends images in 1/MESH_TDMA_SLOTS of the airtime (about
+// 1/8, less the guard), and IDs equal mod MESH_TDMA_SLOTS share a slot;
+// worth it only on meshes busy enough for senders to collide.
+#define MESH_TDMA_ENABLED false
+#define MESH_TDMA_SLOTS 8                 // Slots per frame
+#define MESH_TDMA_SLOT_MS 50              // Slot length
+#define MESH_TDMA_GUARD_MS 5              // No new frames this close to the slot end
+#define MESH_CHUNK_WAIT_MS 3000           // A chunk fails if our slot and next hop are not both ready by then
+
 // Message settings
 #define MSG_MAX_PAYLOAD_SIZE 200          // Max payload per ESP-NOW packet
 #define MSG_HEADER_SIZE 10                // Header size in bytes
 #define MSG_MAX_RETRIES 3                 // Retry count for failed sends
 #define MSG_RETRY_DELAY_MS 100            // Delay between retries
+#define MSG_PENDING_MAX 32                // Messages awaiting an end-to-end ACK
 
 // Image transfer
 #define IMG_CHUNK_SIZE 190                // Bytes per image chunk (leaves room for 4-byte header + padding)
-#define IMG_MAX_CHUNKS 150                // Max chunks per image (~28KB max)
+#define IMG_MAX_CHUNKS 2048               // Max chunks per image (~380KB max)
+#define IMG_MAX_BYTES ((size_t)IMG_MAX_CHUNKS * IMG_CHUNK_SIZE)
+#define IMG_SLOT_BYTES (150 * IMG_CHUNK_SIZE)  // Copied PSRAM image slots (~28KB)
 #define IMG_TRANSFER_TIMEOUT_MS 30000     // Timeout for complete image transfer
 
+// Image transfer admission (gateway grants credits, sensors wait for them)
+#define IMG_GRANT_WINDOW_CHUNKS 32        // Chunks granted per credit
+#define IMG_GRANT_WAIT_MS 60000           // Max time a sensor queues for a grant
+#define IMG_GRANT_REQUEST_TIMEOUT_MS 1000 // Re-request if no grant/credit arrives
+#define IMG_GRANT_RETRY_MIN_MS 500        // Deferral backoff bounds
+#define IMG_GRANT_RETRY_MAX_MS 10000
+#define IMG_GRANT_MS_PER_CHUNK 15         // Estimated gateway time per outstanding chunk
+#define IMG_MAX_RECEPTIONS 2              // Concurrent reassembly buffers on the gateway
+#define IMG_REASSEMBLY_RESERVE 32768      // PSRAM kept free beyond admitted images
+#define IMG_REASSEMBLY_BUDGET 786432      // PSRAM all admitted images may use together
+#define IMG_SEGMENT_CHUNKS 64             // Chunks per reassembly segment (~12KB)
+#define IMG_BLE_BACKLOG_LIMIT 65536       // Defer new transfers above this BLE backlog
+
+// Hop-by-hop custody (relays acknowledge chunks upstream and cache them)
+#define CUSTODY_ENABLED true              // Set false for end-to-end reliability only
+#define CUSTODY_CACHE_CHUNKS 96           // Forwarded chunks kept in PSRAM per relay
+#define CUSTODY_ACK_BATCH 8               // Chunks covered before a custody ACK is sent
+#define CUSTODY_ACK_DELAY_MS 40           // Max delay before a partial custody ACK
+#define CUSTODY_RETRY_MS 300              // Resend a chunk if its custody ACK is late
+#define IMG_NACK_MAX_CHUNKS 32            // Missing chunks listed per NACK
+#define IMG_REPAIR_TIMEOUT_MS 1500        // Gateway repeats a NACK if repair stalls
+#define IMG_REPAIR_WAIT_MS 3500           // Sensor resends IMAGE_END if no NACK came (> IMG_REPAIR_TIMEOUT_MS)
+#define IMG_REPAIR_ROUNDS 3               // NACK rounds before an image is dropped
+
+// Restart intervals: sensors recode each JPEG so every few MCUs decode on
+// their own, and the gateway forwards an image that lost chunks with the
+// damaged rows grey instead of dropping it
+#define JPEG_RESTART_ENABLED true
+#define JPEG_RESTART_MCUS 4               // MCUs per restart interval
+#define JPEG_RESTART_MAX_PAD 16           // Fill bytes spent to start an interval on a chunk boundary
+#define IMG_PARTIAL_AFTER_ROUNDS 1        // Stalled NACK rounds before a partial image is forwarded
+#define IMG_PARTIAL_MIN_PCT 50            // Intervals an image must keep to be worth forwarding
+
 // ============================================================================
 // BLE CONFIGURATION (Gateway only)
 // ============================================================================
 
 #define BLE_DEVICE_NAME "TrailCam-GW"     // BLE advertised name
 #define BLE_MTU_SIZE 512                  // Maximum transmission unit
+#define BLE_FORWARD_BURST 4               // Image chunks sent to the phone per loop pass
+#define BLE_CHUNK_GAP_MS 10               // Pacing per image chunk sent to the phone
 
 // BLE UUIDs
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
@@ -104,6 +317,11 @@
 #define SERIAL_BAUD 115200                // Serial monitor baud rate
 #define WATCHDOG_TIMEOUT_S 30             // Watchdog timer (seconds)
 
+// Timer wheel (all firmware timeouts; the loop sleeps until the next one)
+#define TIMER_WHEEL_SLOTS 256             // Buckets, power of two
+#define TIMER_WHEEL_TICK_MS 1             // Bucket width
+#define TIMER_WHEEL_MAX_SLEEP_MS 100      // Loop wakes at least this often
+
 // Debug settings
 #define DEBUG_ENABLED true
 #if DEBUG_ENABLED
@@ -0,0 +1,154 @@
+#include "animal_classifier.h"
+#include <string.h>
+
+// Placeholder weights, set by hand until trained ones are exported: the
+// score rises with compact, edged regions of change and stays low for
+// an unchanged scene or an even shift in light. Replace the tables below
+// (same layout and fixed-point scales) with quantised trained weights.
+
+// Layer 1: 2 -> 8 channels (luma, change)
+static const int8_t CONV1_WEIGHTS[8 * 2 * 9] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0,   1, 1, 1, 1, 1, 1, 1, 1, 1,  // change level
+    0, 0, 0, 0, 0, 0, 0, 0, 0,   1, 1, 1, 1, 1, 1, 1, 1, 1,  // strong change
+    -1, 0, 1, -2, 0, 2, -1, 0, 1,   0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, +x
+    1, 0, -1, 2, 0, -2, 1, 0, -1,   0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, -x
+    -1, -2, -1, 0, 0, 0, 1, 2, 1,   0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, +y
+    1, 2, 1, 0, 0, 0, -1, -2, -1,   0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, -y
+    0, 0, 0, 0, 0, 0, 0, 0, 0,   -1, -2, -1, 0, 0, 0, 1, 2, 1,  // change edges, +y
+    0, 0, 0, 0, 0, 0, 0, 0, 0,   1, 2, 1, 0, 0, 0, -1, -2, -1,  // change edges, -y
+};
+static const int32_t CONV1_BIAS[8] = { -72, -270, 0, 0, 0, 0, 0, 0 };
+static const uint8_t CONV1_SHIFT[8] = { 2, 1, 2, 2, 2, 2, 2, 2 };
+
+// Layer 2: 8 -> 8 channels; compact strong change; luma edges count only where it is
+static const int8_t CONV2_WEIGHTS[8 * 8 * 9] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // change level
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // strong change
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 4, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, +x (gated)
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 4, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, -x (gated)
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 4, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, +y (gated)
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 4, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // luma edges, -y (gated)
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,  0, 0, 0, 0, 0, 0, 0, 0, 0,  // change edges, +y
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0,  1, 1, 1, 1, 1, 1, 1, 1, 1,  // change edges, -y
+};
+static const int32_t CONV2_BIAS[8] = { 0, -288, -360, -360, -360, -360, 0, 0 };
+static const uint8_t CONV2_SHIFT[8] = { 3, 2, 3, 3, 3, 3, 3, 3 };
+
+// Dense: pooled features to a Q4 logit
+static const int8_t DENSE_WEIGHTS[8] = { -1, 2, 1, 1, 1, 1, 1, 1 };
+static const int32_t DENSE_BIAS = -64;
+
+// 100 / (1 + e^-k) for k = -8..8; interpolated in between
+static const uint8_t SIGMOID_PERCENT[17] = {
+    0, 0, 0, 1, 2, 5, 12, 27, 50, 73, 88, 95, 98, 99, 100, 100, 100
+};
+
+#define CONV1_CHANNELS 8
+#define CONV2_CHANNELS 8
+#define CONV1_WIDTH ((CLASSIFIER_WIDTH + 1) / 2)
+#define CONV1_HEIGHT ((CLASSIFIER_HEIGHT + 1) / 2)
+#define CONV2_WIDTH ((CONV1_WIDTH + 1) / 2)
+#define CONV2_HEIGHT ((CONV1_HEIGHT + 1) / 2)
+
+// Activations (~3.4KB) kept off the loop task's stack
+static int8_t inputPlanes[2 * CLASSIFIER_WIDTH * CLASSIFIER_HEIGHT];
+static int8_t conv1Out[CONV1_CHANNELS * CONV1_WIDTH * CONV1_HEIGHT];
+static int8_t conv2Out[CONV2_CHANNELS * CONV2_WIDTH * CONV2_HEIGHT];
+
+uint8_t AnimalClassifier::score(const uint8_t* luma, const uint8_t* change) {
+    // 7-bit planes fit int8 unchanged
+    const size_t pixels = CLASSIFIER_WIDTH * CLASSIFIER_HEIGHT;
+    memcpy(inputPlanes, luma, pixels);
+    memcpy(inputPlanes + pixels, change, pixels);
+    
+    conv3x3s2(inputPlanes, 2, CLASSIFIER_WIDTH, CLASSIFIER_HEIGHT,
+              CONV1_WEIGHTS, CONV1_BIAS, CONV1_SHIFT, CONV1_CHANNELS, conv1Out);
+    conv3x3s2(conv1Out, CONV1_CHANNELS, CONV1_WIDTH, CONV1_HEIGHT,
+              CONV2_WEIGHTS, CONV2_BIAS, CONV2_SHIFT, CONV2_CHANNELS, conv2Out);
+    
+    int8_t pooled[CONV2_CHANNELS];
+    globalMax(conv2Out, CONV2_CHANNELS, CONV2_WIDTH * CONV2_HEIGHT, pooled);
+    
+    int32_t logit = DENSE_BIAS;
+    for (uint8_t c = 0; c < CONV2_CHANNELS; c++) {
+        logit += (int32_t)DENSE_WEIGHTS[c] * pooled[c];
+    }
+    return sigmoidPercent(logit);
+}
+
+void AnimalClassifier::conv3x3s2(const int8_t* in, uint8_t inCh, uint16_t w, uint16_t h,
+                                 const int8_t* weights, const int32_t* bias, const uint8_t* shift,
+                                 uint8_t outCh, int8_t* out) {
+    const uint16_t ow = (w + 1) / 2;
+    const uint16_t oh = (h + 1) / 2;
+    
+    for (uint8_t oc = 0; oc < outCh; oc++) {
+        const int8_t* kernel = weights + (size_t)oc * inCh * 9;
+        for (uint16_t oy = 0; oy < oh; oy++) {
+            for (uint16_t ox = 0; ox < ow; ox++) {
+                int32_t acc = bias[oc];
+                for (uint8_t ic = 0; ic < inCh; ic++) {
+                    const int8_t* plane = in + (size_t)ic * w * h;
+                    const int8_t* k = kernel + ic * 9;
+                    for (int8_t ky = 0; ky < 3; ky++) {
+                        int32_t y = (int32_t)oy * 2 + ky - 1;
+                        if (y < 0 || y >= h) {
+                            continue;
+                        }
+                        const int8_t* row = plane + (size_t)y * w;
+                        for (int8_t kx = 0; kx < 3; kx++) {
+                            int32_t x = (int32_t)ox * 2 + kx - 1;
+                            if (x >= 0 && x < w) {
+                                acc += (int32_t)k[ky * 3 + kx] * row[x];
+                            }
+                        }
+                    }
+                }
+                
+                // Requantise: ReLU and the channel's scale in one step
+                if (acc < 0) {
+                    acc = 0;
+                }
+                acc >>= shift[oc];
+                out[((size_t)oc * oh + oy) * ow + ox] = (int8_t)(acc > 127 ? 127 : acc);
+            }
+        }
+    }
+}
+
+void AnimalClassifier::globalMax(const int8_t* in, uint8_t channels, size_t pixels, int8_t* out) {
+    for (uint8_t c = 0; c < channels; c++) {
+        const int8_t* plane = in + (size_t)c * pixels;
+        int8_t peak = plane[0];
+        for (size_t i = 1; i < pixels; i++) {
+            if (plane[i] > peak) {
+                peak = plane[i];
+            }
+        }
+        out[c] = peak;
+    }
+}
+
+uint8_t AnimalClassifier::sigmoidPercent(int32_t logit) {
+    // Q4 logit covers -8..+8 in the table; beyond that it is saturated
+    if (logit <= -128) {
+        return SIGMOID_PERCENT[0];
+    }
+    if (logit >= 128) {
+        return SIGMOID_PERCENT[16];
+    }
+    uint32_t x = (uint32_t)(logit + 128);
+    uint8_t i = x >> 4;
+    uint8_t frac = x & 15;
+    int32_t lo = SIGMOID_PERCENT[i];
+    int32_t hi = SIGMOID_PERCENT[i + 1];
+    return (uint8_t)(lo + ((hi - lo) * frac + 8) / 16);
+}
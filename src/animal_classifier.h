@@ -0,0 +1,37 @@
+#ifndef ANIMAL_CLASSIFIER_H
+#define ANIMAL_CLASSIFIER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Input planes: the motion verifier's luma thumbnail
+#define CLASSIFIER_WIDTH 32
+#define CLASSIFIER_HEIGHT 24
+
+// Tiny int8 CNN scoring how likely a triggered frame shows an animal.
+// Input is two 7-bit planes, the luma thumbnail and its absolute change
+// from the background; two strided 3x3 convolutions, a global max pool
+// and one dense unit produce a logit that maps to a 0-100 score.
+// Integer arithmetic only (int8 weights and activations, int32
+// accumulators, per-channel right shifts) and no Arduino dependencies,
+// so the kernels build and run on a host as well.
+class AnimalClassifier {
+public:
+    // Score 0-100; uses static scratch buffers, so not reentrant
+    static uint8_t score(const uint8_t* luma, const uint8_t* change);
+    
+    // 3x3 convolution, stride 2, zero padding 1, ReLU. Planar int8 in
+    // (inCh x h x w) and out (outCh x ceil(h/2) x ceil(w/2)); weights are
+    // [outCh][inCh][3][3], out = clamp((acc + bias) >> shift, 0, 127)
+    static void conv3x3s2(const int8_t* in, uint8_t inCh, uint16_t w, uint16_t h,
+                          const int8_t* weights, const int32_t* bias, const uint8_t* shift,
+                          uint8_t outCh, int8_t* out);
+    
+    // Peak of each channel of a planar int8 map
+    static void globalMax(const int8_t* in, uint8_t channels, size_t pixels, int8_t* out);
+    
+    // Logit in Q4 (16 = 1.0) to a 0-100 probability
+    static uint8_t sigmoidPercent(int32_t logit);
+};
+
+#endif // ANIMAL_CLASSIFIER_H
@@ -1,8 +1,28 @@
 #include "ble_gateway.h"
+#include "mesh_clock.h"
 
 // Global instance
 BleGateway bleGateway;
 
+// Guards reception slots shared by the ESP-NOW receive task and the loop
+static portMUX_TYPE receptionLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Smallest credit issued to a transfer that is already admitted
+static const uint16_t MIN_GRANT_WINDOW = 4;
+
+// Images are reassembled into PSRAM segments of whole chunks
+static const size_t SEGMENT_BYTES = (size_t)IMG_SEGMENT_CHUNKS * IMG_CHUNK_SIZE;
+
+// Room a rebuilt image may need beyond the received one (grey intervals
+// are smaller than the data they replace)
+static const size_t SALVAGE_SLACK = 4096;
+
+// BLE MTU is typically 512, but we use smaller chunks for reliability
+static const size_t BLE_CHUNK_SIZE = 240;  // Leave room for header
+
+// Time the phone gets to process an image header before its chunks
+static const uint32_t BLE_HEADER_GAP_MS = 20;
+
 BleGateway::BleGateway()
     : _server(nullptr)
     , _service(nullptr)
@@ -13,19 +33,28 @@ BleGateway::BleGateway()
     , _advertising(nullptr)
     , _state(BleState::DISCONNECTED)
     , _initialized(false)
+    , _forwarding(nullptr)
+    , _lastImageAt(0)
+    , _lastLiveAt(0)
+    , _liveIntervalMs(0)
     , _connectCallback(nullptr)
     , _commandCallback(nullptr)
-    , _disconnectTime(0) {
+    , _grantCallback(nullptr)
+    , _repairCallback(nullptr) {
     
     // Initialize image reception state
-    _imageReception.buffer = nullptr;
-    _imageReception.active = false;
-    _imageReception.complete = false;
+    memset(_receptions, 0, sizeof(_receptions));
+    for (auto& reception : _receptions) {
+        TimerWheel::bind(reception.timer, onReceptionTimer, &reception);
+    }
+    TimerWheel::bind(_reconnectTimer, onReconnectTimer, this);
+    // No callback: forwarding waits while it is armed
+    TimerWheel::bind(_forwardTimer, nullptr, this);
 }
 
 BleGateway::~BleGateway() {
-    if (_imageReception.buffer) {
-        free(_imageReception.buffer);
+    for (auto& reception : _receptions) {
+        releaseReception(reception);
     }
 }
 
@@ -123,24 +152,39 @@ void BleGateway::update() {
         return;
     }
     
-    // Handle reconnection after disconnect
-    if (_state == BleState::DISCONNECTED && _disconnectTime > 0) {
-        if (millis() - _disconnectTime >= RECONNECT_DELAY) {
-            startAdvertising();
-            _disconnectTime = 0;
-        }
+    // Forward finished images from the loop, not the ESP-NOW receive task,
+    // a paced burst of chunks per pass so mesh grants and ACKs still go out
+    forwardCompletedImage();
+}
+
+void BleGateway::onReconnectTimer(void* context) {
+    BleGateway* gateway = static_cast<BleGateway*>(context);
+    if (gateway->_state == BleState::DISCONNECTED) {
+        gateway->startAdvertising();
+    }
+}
+
+void BleGateway::onReceptionTimer(void* context) {
+    ImageReception& reception = *static_cast<ImageReception*>(context);
+    if (!reception.active || reception.complete) {
+        return;
     }
     
-    // Check for image reception timeout
-    if (_imageReception.active) {
-        if (millis() - _imageReception.startTime > IMG_TRANSFER_TIMEOUT_MS) {
-            DEBUG_PRINTLN("[BLE] Image reception timeout");
-            if (_imageReception.buffer) {
-                free(_imageReception.buffer);
-                _imageReception.buffer = nullptr;
-            }
-            _imageReception.active = false;
-        }
+    // Sender gone quiet, or repair stalled: forward what is there if enough arrived
+    if ((!reception.endReceived || reception.repairRounds >= IMG_PARTIAL_AFTER_ROUNDS) &&
+        bleGateway.salvageReception(reception)) {
+        bleGateway.requestRepair(reception);
+    } else if (!reception.endReceived) {
+        DEBUG_PRINTF("[BLE] Image reception timeout: id=%d from node %d\n",
+            reception.imageId, reception.sourceNode);
+        bleGateway.releaseReception(reception);
+    } else if (reception.repairRounds >= IMG_REPAIR_ROUNDS) {
+        // Repairs outstanding for too many rounds: give up
+        DEBUG_PRINTF("[BLE] Image %d from node %d unrepaired, dropping\n",
+            reception.imageId, reception.sourceNode);
+        bleGateway.releaseReception(reception);
+    } else {
+        bleGateway.requestRepair(reception);
     }
 }
 
@@ -175,7 +219,7 @@ void BleGateway::onConnect(BLEServer* server) {
 
 void BleGateway::onDisconnect(BLEServer* server) {
     _state = BleState::DISCONNECTED;
-    _disconnectTime = millis();
+    timerWheel.arm(_reconnectTimer, RECONNECT_DELAY);
     DEBUG_PRINTLN("[BLE] Client disconnected");
     
     if (_connectCallback) {
@@ -201,7 +245,8 @@ void BleGateway::onWrite(BLECharacteristic* characteristic) {
     }
 }
 
-bool BleGateway::notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool hasImage, const uint16_t* path, uint8_t pathLength) {
+bool BleGateway::notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool hasImage, const uint16_t* path, uint8_t pathLength,
+                                   uint8_t confidence) {
     if (!isConnected()) {
         return false;
     }
@@ -229,8 +274,8 @@ bool BleGateway::notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool has
     }
     
     // Pack motion alert data with path
-    // Format: [nodeId(2), timestamp(4), hasImage(1), pathLength(1), path[...](up to (MAX_PATH_LENGTH+1)*2 bytes)]
-    uint8_t data[8 + 1 + ((MAX_PATH_LENGTH + 1) * 2)];  // Base 8 bytes + pathLength + max path
+    // Format: [nodeId(2), timestamp(4), hasImage(1), pathLength(1), path[...](up to (MAX_PATH_LENGTH+1)*2 bytes), confidence(1)]
+    uint8_t data[8 + 1 + ((MAX_PATH_LENGTH + 1) * 2) + 1];  // Base 8 bytes + pathLength + max path + confidence
     size_t offset = 0;
     
     // Node ID (2 bytes)
@@ -255,6 +300,9 @@ bool BleGateway::notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool has
         data[offset++] = (fullPath[i] >> 8) & 0xFF;
     }
     
+    // Classifier score (1 byte, 0xFF = not scored)
+    data[offset++] = confidence;
+    
     _motionChar->setValue(data, offset);
     _motionChar->notify();
     
@@ -293,7 +341,7 @@ bool BleGateway::notifyStatus(uint16_t nodeId, uint8_t battery, int8_t rssi, uin
     return true;
 }
 
-bool BleGateway::sendImageToPhone(const uint8_t* imageData, size_t length, uint16_t nodeId, uint16_t imageId) {
+bool BleGateway::sendImageToPhone(const uint8_t* imageData, size_t length, uint16_t nodeId, uint16_t imageId, const ImageRegion* region) {
     if (!isConnected()) {
         DEBUG_PRINTLN("[BLE] Cannot send image - not connected");
         return false;
@@ -301,12 +349,108 @@ bool BleGateway::sendImageToPhone(const uint8_t* imageData, size_t length, uint1
     
     DEBUG_PRINTF("[BLE] Sending image to phone: %u bytes\n", length);
     
-    // BLE MTU is typically 512, but we use smaller chunks for reliability
-    const size_t CHUNK_SIZE = 240;  // Leave room for header
-    uint16_t totalChunks = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    uint16_t totalChunks = (length + BLE_CHUNK_SIZE - 1) / BLE_CHUNK_SIZE;
+    sendImageHeaderToBle(length, nodeId, imageId, totalChunks, region);
+    delay(BLE_HEADER_GAP_MS);  // Small delay for phone to process
+    
+    // Send chunks
+    for (uint16_t i = 0; i < totalChunks; i++) {
+        size_t offset = i * BLE_CHUNK_SIZE;
+        size_t chunkLen = min(BLE_CHUNK_SIZE, length - offset);
+        
+        sendImageChunkToBle(imageData + offset, chunkLen, i, totalChunks);
+        delay(BLE_CHUNK_GAP_MS);  // Delay between chunks
+    }
     
-    // Send image header first
-    uint8_t header[12];
+    sendImageEndToBle(imageId);
+    
+    DEBUG_PRINTLN("[BLE] Image sent to phone");
+    
+    return true;
+}
+
+// Bytes that go to the phone: a salvaged image goes out from its rebuilt copy
+static uint32_t forwardSize(const ImageReception& reception) {
+    return reception.salvaged ? reception.salvagedSize : reception.totalSize;
+}
+
+void BleGateway::sendReceptionHeader(ImageReception& reception) {
+    uint32_t size = forwardSize(reception);
+    DEBUG_PRINTF("[BLE] Sending image to phone: %u bytes in %d segments\n",
+        size, reception.segmentCount);
+    
+    // Clip frames go out as consecutive images
+    uint16_t imageId = reception.imageId + reception.clipFrame;
+    uint16_t totalChunks = (size + BLE_CHUNK_SIZE - 1) / BLE_CHUNK_SIZE;
+    
+    // Capture-to-phone latency on the mesh clock (unknown if it is implausible)
+    uint32_t latency = meshClock.now() - reception.capturedAt;
+    uint16_t latencyMs = latency < 0xFFFF ? latency : 0xFFFF;
+    uint16_t fpsTenths = (reception.region.flags & IMAGE_FLAG_LIVE) ? noteLiveFrame() : 0;
+    
+    sendImageHeaderToBle(size, reception.sourceNode, imageId,
+                         totalChunks, &reception.region, latencyMs, fpsTenths);
+    reception.forwardedChunks = 0;
+}
+
+bool BleGateway::sendReceptionChunks(ImageReception& reception, uint16_t maxChunks) {
+    uint32_t size = forwardSize(reception);
+    uint16_t totalChunks = (size + BLE_CHUNK_SIZE - 1) / BLE_CHUNK_SIZE;
+    
+    // BLE chunks straddle segment boundaries, so gather each one
+    uint8_t packet[BLE_CHUNK_SIZE];
+    for (uint16_t sent = 0; sent < maxChunks && reception.forwardedChunks < totalChunks; sent++) {
+        uint16_t i = reception.forwardedChunks;
+        size_t offset = i * BLE_CHUNK_SIZE;
+        size_t chunkLen = min(BLE_CHUNK_SIZE, (size_t)size - offset);
+        
+        size_t copied = reception.salvaged ? chunkLen : 0;
+        if (reception.salvaged) {
+            memcpy(packet, reception.salvaged + offset, chunkLen);
+        }
+        while (copied < chunkLen) {
+            size_t position = offset + copied;
+            size_t within = position % SEGMENT_BYTES;
+            size_t run = min(chunkLen - copied, SEGMENT_BYTES - within);
+            memcpy(packet + copied, reception.segments[position / SEGMENT_BYTES] + within, run);
+            copied += run;
+        }
+        
+        sendImageChunkToBle(packet, chunkLen, i, totalChunks);
+        reception.forwardedChunks++;
+    }
+    
+    if (reception.forwardedChunks < totalChunks) {
+        return false;
+    }
+    
+    sendImageEndToBle(reception.imageId + reception.clipFrame);
+    DEBUG_PRINTLN("[BLE] Image sent to phone");
+    return true;
+}
+
+uint16_t BleGateway::noteLiveFrame() {
+    unsigned long now = millis();
+    uint32_t interval = now - _lastLiveAt;
+    _lastLiveAt = now;
+    
+    // A long gap starts a new live session rather than counting as a slow
+    // frame; otherwise EWMA with 1/4 weight on the new interval
+    if (interval > LIVE_MAX_INTERVAL_MS * 2) {
+        _liveIntervalMs = 0;
+    } else if (_liveIntervalMs == 0) {
+        _liveIntervalMs = interval;
+    } else {
+        _liveIntervalMs = (_liveIntervalMs * 3 + interval) / 4;
+    }
+    return _liveIntervalMs ? 10000 / _liveIntervalMs : 0;
+}
+
+void BleGateway::sendImageHeaderToBle(size_t length, uint16_t nodeId, uint16_t imageId, uint16_t totalChunks,
+                                      const ImageRegion* region, uint16_t latencyMs, uint16_t fpsTenths) {
+    // Send image header first; crop geometry, then latency and live frame
+    // rate, are appended after the original 12 bytes so older apps still parse it
+    uint8_t header[29];
     header[0] = 0x01;  // Image start marker
     header[1] = nodeId & 0xFF;
     header[2] = (nodeId >> 8) & 0xFF;
@@ -320,19 +464,34 @@ bool BleGateway::sendImageToPhone(const uint8_t* imageData, size_t length, uint1
     header[10] = (totalChunks >> 8) & 0xFF;
     header[11] = 0;  // Reserved
     
-    _imageChar->setValue(header, sizeof(header));
-    _imageChar->notify();
-    delay(20);  // Small delay for phone to process
-    
-    // Send chunks
-    for (uint16_t i = 0; i < totalChunks; i++) {
-        size_t offset = i * CHUNK_SIZE;
-        size_t chunkLen = min(CHUNK_SIZE, length - offset);
-        
-        sendImageChunkToBle(imageData + offset, chunkLen, i, totalChunks);
-        delay(10);  // Delay between chunks
+    ImageRegion whole;
+    if (!region) {
+        memset(&whole, 0, sizeof(whole));
+        region = &whole;
     }
+    header[12] = region->flags;
+    header[13] = region->x & 0xFF;
+    header[14] = (region->x >> 8) & 0xFF;
+    header[15] = region->y & 0xFF;
+    header[16] = (region->y >> 8) & 0xFF;
+    header[17] = region->width & 0xFF;
+    header[18] = (region->width >> 8) & 0xFF;
+    header[19] = region->height & 0xFF;
+    header[20] = (region->height >> 8) & 0xFF;
+    header[21] = region->frameWidth & 0xFF;
+    header[22] = (region->frameWidth >> 8) & 0xFF;
+    header[23] = region->frameHeight & 0xFF;
+    header[24] = (region->frameHeight >> 8) & 0xFF;
+    header[25] = latencyMs & 0xFF;
+    header[26] = (latencyMs >> 8) & 0xFF;
+    header[27] = fpsTenths & 0xFF;
+    header[28] = (fpsTenths >> 8) & 0xFF;
     
+    _imageChar->setValue(header, sizeof(header));
+    _imageChar->notify();
+}
+
+void BleGateway::sendImageEndToBle(uint16_t imageId) {
     // Send end marker
     uint8_t footer[4];
     footer[0] = 0x02;  // Image end marker
@@ -342,10 +501,6 @@ bool BleGateway::sendImageToPhone(const uint8_t* imageData, size_t length, uint1
     
     _imageChar->setValue(footer, sizeof(footer));
     _imageChar->notify();
-    
-    DEBUG_PRINTLN("[BLE] Image sent to phone");
-    
-    return true;
 }
 
 void BleGateway::sendImageChunkToBle(const uint8_t* data, size_t length, uint16_t chunkIndex, uint16_t totalChunks) {
@@ -363,80 +518,589 @@ void BleGateway::sendImageChunkToBle(const uint8_t* data, size_t length, uint16_
     _imageChar->notify();
 }
 
-void BleGateway::handleImageStart(uint16_t sourceNode, uint16_t imageId, uint32_t size, uint16_t chunks) {
-    DEBUG_PRINTF("[BLE] Image start from node %d: id=%d, size=%u, chunks=%d\n",
-        sourceNode, imageId, size, chunks);
+void BleGateway::handleImageStart(uint16_t sourceNode, uint16_t imageId, uint32_t size, uint16_t chunks,
+                                  const ImageRegion* region, uint8_t frameCount, uint32_t capturedAt) {
+    DEBUG_PRINTF("[BLE] Image start from node %d: id=%d, size=%u, chunks=%d, frames=%d\n",
+        sourceNode, imageId, size, chunks, frameCount);
+    
+    // Repeated request for a transfer we already admitted: resend its credit
+    // (a clip frame waiting for the phone gets the next frame's credit later)
+    ImageReception* reception = findReception(sourceNode, imageId);
+    if (reception) {
+        timerWheel.arm(reception->timer, IMG_TRANSFER_TIMEOUT_MS);
+        if (!reception->complete) {
+            issueGrant(*reception);
+        }
+        return;
+    }
+    
+    if (chunks == 0 || chunks > IMG_MAX_CHUNKS || size > (uint32_t)chunks * IMG_CHUNK_SIZE ||
+        frameCount > CLIP_MAX_FRAMES) {
+        DEBUG_PRINTF("[BLE] Rejecting image %d from node %d: bad geometry\n", imageId, sourceNode);
+        return;
+    }
+    
+    // Time-lapse batches can wait for an off-peak window; anything else
+    // counts as traffic that keeps the window shut
+    bool timelapse = region && (region->flags & IMAGE_FLAG_TIMELAPSE);
+    uint16_t offPeakWait = timelapse ? offPeakDelay() : 0;
+    if (!timelapse) {
+        _lastImageAt = millis();
+    }
     
-    // Free any existing buffer
-    if (_imageReception.buffer) {
-        free(_imageReception.buffer);
+    // Clip frame sizes are only known at each frame's end: reserve for the largest
+    if (frameCount > 0) {
+        size = IMG_MAX_BYTES;
+        chunks = IMG_MAX_CHUNKS;
     }
     
-    // Allocate buffer for image
-    _imageReception.buffer = (uint8_t*)ps_malloc(size);
-    if (!_imageReception.buffer) {
-        DEBUG_PRINTLN("[BLE] Failed to allocate image buffer");
+    // Admission needs a free slot, PSRAM for the image within the
+    // reassembly budget, and BLE headroom. Segments are allocated as
+    // chunks arrive, so the image need not fit one contiguous block.
+    bool memoryOk = admittedBytes() + size <= IMG_REASSEMBLY_BUDGET &&
+                    heap_caps_get_free_size(MALLOC_CAP_SPIRAM) >= admittedBytes() + size + IMG_REASSEMBLY_RESERVE;
+    // Likely animals are admitted past the BLE backlog limit
+    bool priority = region && (region->flags & IMAGE_FLAG_PRIORITY);
+    if (offPeakWait == 0 && memoryOk && (grantWindow() > 0 || priority)) {
+        reception = claimReception();
+    }
+    
+    if (reception) {
+        // Segment table and received-chunk bitmap
+        reception->segmentCount = (chunks + IMG_SEGMENT_CHUNKS - 1) / IMG_SEGMENT_CHUNKS;
+        reception->segments = (uint8_t**)calloc(reception->segmentCount, sizeof(uint8_t*));
+        reception->chunkMap = (uint8_t*)calloc((chunks + 7) / 8, 1);
+        if (!reception->segments || !reception->chunkMap) {
+            DEBUG_PRINTLN("[BLE] Failed to allocate image buffer");
+            releaseReception(*reception);
+            reception = nullptr;
+        }
+    }
+    
+    if (!reception) {
+        uint16_t retryAfter = offPeakWait > 0 ? offPeakWait : estimateRetryAfter();
+        DEBUG_PRINTF("[BLE] Deferring image %d from node %d for %d ms\n",
+            imageId, sourceNode, retryAfter);
+        if (_grantCallback) {
+            _grantCallback(sourceNode, imageId, 0, retryAfter);
+        }
         return;
     }
     
-    _imageReception.imageId = imageId;
-    _imageReception.sourceNode = sourceNode;
-    _imageReception.totalSize = size;
-    _imageReception.totalChunks = chunks;
-    _imageReception.receivedChunks = 0;
-    _imageReception.startTime = millis();
-    _imageReception.complete = false;
-    _imageReception.active = true;
+    reception->imageId = imageId;
+    reception->sourceNode = sourceNode;
+    reception->totalSize = size;
+    reception->totalChunks = chunks;
+    reception->receivedChunks = 0;
+    reception->grantedChunks = 0;
+    reception->startTime = millis();
+    reception->capturedAt = capturedAt;
+    reception->repairRounds = 0;
+    reception->endReceived = false;
+    reception->complete = false;
+    reception->forwardedChunks = 0;
+    reception->clipFrames = frameCount;
+    reception->clipFrame = 0;
+    reception->clipLast = false;
+    if (region) {
+        reception->region = *region;
+    } else {
+        memset(&reception->region, 0, sizeof(reception->region));
+    }
     
-    memset(_imageReception.buffer, 0, size);
+    timerWheel.arm(reception->timer, IMG_TRANSFER_TIMEOUT_MS);
+    issueGrant(*reception);
 }
 
 void BleGateway::handleImageChunk(uint16_t sourceNode, uint16_t imageId, uint16_t chunkIndex, const uint8_t* data, uint8_t size) {
-    if (!_imageReception.active || _imageReception.imageId != imageId) {
+    ImageReception* reception = findReception(sourceNode, imageId);
+    if (!reception || reception->complete) {
         DEBUG_PRINTLN("[BLE] Unexpected image chunk");
         return;
     }
     
-    // Calculate offset and copy data
-    size_t offset = chunkIndex * IMG_CHUNK_SIZE;
-    if (offset + size <= _imageReception.totalSize) {
-        memcpy(_imageReception.buffer + offset, data, size);
-        _imageReception.receivedChunks++;
+    // Clip chunks carry their frame; anything but the current frame is
+    // early or stale and comes back through repair
+    if (reception->clipFrames > 0) {
+        if ((chunkIndex >> CLIP_FRAME_SHIFT) != reception->clipFrame) {
+            return;
+        }
+        chunkIndex &= CLIP_CHUNK_MASK;
+    }
+    
+    if (!(reception->region.flags & IMAGE_FLAG_TIMELAPSE)) {
+        _lastImageAt = millis();
+    }
+    
+    // Calculate offset and make sure its segment exists
+    size_t offset = (size_t)chunkIndex * IMG_CHUNK_SIZE;
+    if (chunkIndex >= reception->totalChunks || offset + size > reception->totalSize) {
+        return;
+    }
+    uint8_t* segment = segmentFor(*reception, chunkIndex);
+    if (!segment) {
+        DEBUG_PRINTF("[BLE] No PSRAM for chunk %d, left for repair\n", chunkIndex);
+        return;
+    }
+    
+    bool stored = false;
+    bool finished = false;
+    
+    portENTER_CRITICAL(&receptionLock);
+    if (reception->active && !reception->complete) {
+        // Custody resends and repairs can deliver a chunk twice
+        uint8_t bit = 1 << (chunkIndex % 8);
+        if (!(reception->chunkMap[chunkIndex / 8] & bit)) {
+            memcpy(segment + offset % SEGMENT_BYTES, data, size);
+            reception->chunkMap[chunkIndex / 8] |= bit;
+            reception->receivedChunks++;
+            stored = true;
+            finished = reception->endReceived && reception->receivedChunks >= reception->totalChunks;
+        }
+    }
+    portEXIT_CRITICAL(&receptionLock);
+    
+    if (!stored) {
+        return;
+    }
+    
+    // Push the stall timeout out again
+    timerWheel.arm(reception->timer, reception->endReceived ? IMG_REPAIR_TIMEOUT_MS : IMG_TRANSFER_TIMEOUT_MS);
+    
+    // Last repaired chunk in: done, tell the sender and relays
+    if (finished) {
+        DEBUG_PRINTF("[BLE] Image %d from node %d repaired\n", imageId, sourceNode);
+        reception->complete = true;
+        requestRepair(*reception);
+        return;
+    }
+    
+    DEBUG_PRINTF("[BLE] Image chunk %d/%d received\n", 
+        chunkIndex + 1, reception->totalChunks);
+    
+    // Top up the sender's credit once half of the current window is used
+    uint16_t outstanding = reception->grantedChunks - min(reception->receivedChunks, reception->grantedChunks);
+    if (reception->grantedChunks < reception->totalChunks &&
+        outstanding <= max(grantWindow(), MIN_GRANT_WINDOW) / 2) {
+        issueGrant(*reception, false);
+    }
+}
+
+void BleGateway::handleImageEnd(uint16_t sourceNode, uint16_t imageId, const ImageEndPayload* clipEnd) {
+    ImageReception* reception = findReception(sourceNode, imageId);
+    if (!reception) {
+        return;
+    }
+    
+    if (reception->clipFrames > 0) {
+        if (!clipEnd || (clipEnd->frame & ~CLIP_FRAME_LAST) != reception->clipFrame || reception->complete) {
+            return;
+        }
         
-        DEBUG_PRINTF("[BLE] Image chunk %d/%d received\n", 
-            chunkIndex + 1, _imageReception.totalChunks);
+        // Clip cut short after the previous frame: nothing more to forward
+        if (clipEnd->totalChunks == 0) {
+            DEBUG_PRINTF("[BLE] Clip %d from node %d ended after %d frames\n",
+                imageId, sourceNode, reception->clipFrame);
+            releaseReception(*reception);
+            return;
+        }
+        
+        // The frame's real size is known now; the image must still fit
+        // what has been written into it
+        if (clipEnd->totalChunks > IMG_MAX_CHUNKS || clipEnd->totalChunks > CLIP_CHUNK_MASK + 1 ||
+            clipEnd->frameSize > (uint32_t)clipEnd->totalChunks * IMG_CHUNK_SIZE) {
+            return;
+        }
+        portENTER_CRITICAL(&receptionLock);
+        uint16_t beyond = 0;
+        for (uint16_t i = clipEnd->totalChunks; i < reception->totalChunks; i++) {
+            if (reception->chunkMap[i / 8] & (1 << (i % 8))) {
+                beyond++;
+            }
+        }
+        reception->totalChunks = clipEnd->totalChunks;
+        reception->totalSize = clipEnd->frameSize;
+        reception->receivedChunks -= beyond;
+        reception->clipLast = clipEnd->frame & CLIP_FRAME_LAST;
+        portEXIT_CRITICAL(&receptionLock);
+    }
+    
+    DEBUG_PRINTF("[BLE] Image transfer end: %d/%d chunks received\n",
+        reception->receivedChunks, reception->totalChunks);
+    
+    // Complete ones are forwarded by the loop; otherwise NACK what's missing.
+    // Either way the sender hears back (an empty NACK means done).
+    reception->endReceived = true;
+    if (reception->receivedChunks >= reception->totalChunks) {
+        reception->complete = true;
+    }
+    requestRepair(*reception);
+}
+
+ImageReception* BleGateway::findReception(uint16_t sourceNode, uint16_t imageId) {
+    for (auto& reception : _receptions) {
+        if (reception.active && reception.sourceNode == sourceNode && reception.imageId == imageId) {
+            return &reception;
+        }
     }
+    return nullptr;
 }
 
-void BleGateway::handleImageEnd(uint16_t sourceNode, uint16_t imageId) {
-    if (!_imageReception.active || _imageReception.imageId != imageId) {
+ImageReception* BleGateway::claimReception() {
+    ImageReception* claimed = nullptr;
+    
+    portENTER_CRITICAL(&receptionLock);
+    for (auto& reception : _receptions) {
+        if (!reception.active) {
+            reception.active = true;
+            reception.complete = false;
+            claimed = &reception;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&receptionLock);
+    
+    return claimed;
+}
+
+void BleGateway::releaseReception(ImageReception& reception) {
+    timerWheel.cancel(reception.timer);
+    
+    portENTER_CRITICAL(&receptionLock);
+    uint8_t** segments = reception.segments;
+    uint16_t segmentCount = reception.segmentCount;
+    uint8_t* chunkMap = reception.chunkMap;
+    uint8_t* salvaged = reception.salvaged;
+    reception.segments = nullptr;
+    reception.segmentCount = 0;
+    reception.chunkMap = nullptr;
+    reception.salvaged = nullptr;
+    reception.active = false;
+    reception.complete = false;
+    portEXIT_CRITICAL(&receptionLock);
+    
+    if (segments) {
+        for (uint16_t i = 0; i < segmentCount; i++) {
+            if (segments[i]) {
+                free(segments[i]);
+            }
+        }
+        free(segments);
+    }
+    if (chunkMap) {
+        free(chunkMap);
+    }
+    if (salvaged) {
+        free(salvaged);
+    }
+}
+
+void BleGateway::nextClipFrame(ImageReception& reception) {
+    // Frames are reassembled one at a time in the same slot
+    portENTER_CRITICAL(&receptionLock);
+    uint8_t** segments = reception.segments;
+    uint8_t* salvaged = reception.salvaged;
+    reception.segments = nullptr;
+    reception.salvaged = nullptr;
+    portEXIT_CRITICAL(&receptionLock);
+    
+    if (salvaged) {
+        free(salvaged);
+        reception.region.flags &= ~IMAGE_FLAG_PARTIAL;
+    }
+    for (uint16_t i = 0; i < reception.segmentCount; i++) {
+        if (segments[i]) {
+            free(segments[i]);
+            segments[i] = nullptr;
+        }
+    }
+    memset(reception.chunkMap, 0, (IMG_MAX_CHUNKS + 7) / 8);
+    
+    portENTER_CRITICAL(&receptionLock);
+    reception.segments = segments;
+    reception.totalSize = IMG_MAX_BYTES;
+    reception.totalChunks = IMG_MAX_CHUNKS;
+    reception.receivedChunks = 0;
+    reception.grantedChunks = 0;
+    reception.repairRounds = 0;
+    reception.endReceived = false;
+    reception.clipFrame++;
+    reception.complete = false;
+    reception.forwardedChunks = 0;
+    portEXIT_CRITICAL(&receptionLock);
+    
+    DEBUG_PRINTF("[BLE] Clip %d from node %d: waiting for frame %d\n",
+        reception.imageId, reception.sourceNode, reception.clipFrame);
+    
+    timerWheel.arm(reception.timer, IMG_TRANSFER_TIMEOUT_MS);
+    issueGrant(reception);
+}
+
+uint8_t* BleGateway::segmentFor(ImageReception& reception, uint16_t chunkIndex) {
+    uint16_t index = chunkIndex / IMG_SEGMENT_CHUNKS;
+    
+    portENTER_CRITICAL(&receptionLock);
+    uint8_t* segment = reception.active ? reception.segments[index] : nullptr;
+    portEXIT_CRITICAL(&receptionLock);
+    if (segment || !reception.active) {
+        return segment;
+    }
+    
+    // First chunk of this segment: allocate it outside the lock; the last
+    // segment only holds what is left of the image
+    size_t start = (size_t)index * SEGMENT_BYTES;
+    size_t bytes = min(SEGMENT_BYTES, (size_t)reception.totalSize - start);
+    uint8_t* allocated = (uint8_t*)ps_malloc(bytes);
+    if (!allocated) {
+        return nullptr;
+    }
+    
+    // Another context may have beaten us to it
+    portENTER_CRITICAL(&receptionLock);
+    if (reception.active && !reception.segments[index]) {
+        reception.segments[index] = allocated;
+        allocated = nullptr;
+    }
+    segment = reception.active ? reception.segments[index] : nullptr;
+    portEXIT_CRITICAL(&receptionLock);
+    
+    if (allocated) {
+        free(allocated);
+    }
+    return segment;
+}
+
+uint32_t BleGateway::admittedBytes() {
+    uint32_t admitted = 0;
+    for (auto& reception : _receptions) {
+        if (reception.active) {
+            admitted += reception.totalSize;
+        }
+    }
+    return admitted;
+}
+
+void BleGateway::forwardCompletedImage() {
+    // Paced: the loop runs the mesh until the next burst is due
+    if (timerWheel.isArmed(_forwardTimer)) {
         return;
     }
     
-    DEBUG_PRINTF("[BLE] Image transfer complete: %d/%d chunks received\n",
-        _imageReception.receivedChunks, _imageReception.totalChunks);
+    if (_forwarding) {
+        ImageReception& reception = *_forwarding;
+        if (!isConnected()) {
+            DEBUG_PRINTF("[BLE] Phone disconnected, image %d not forwarded\n", reception.imageId);
+            finishForward(reception);
+        } else if (sendReceptionChunks(reception, BLE_FORWARD_BURST)) {
+            finishForward(reception);
+        } else {
+            timerWheel.arm(_forwardTimer, BLE_FORWARD_BURST * BLE_CHUNK_GAP_MS);
+        }
+        return;
+    }
     
-    // Check if all chunks received
-    if (_imageReception.receivedChunks >= _imageReception.totalChunks) {
-        _imageReception.complete = true;
+    // Likely animals go to the phone ahead of other finished images
+    ImageReception* next = nullptr;
+    for (auto& reception : _receptions) {
+        if (!reception.active || !reception.complete) {
+            continue;
+        }
+        if (reception.region.flags & IMAGE_FLAG_PRIORITY) {
+            next = &reception;
+            break;
+        }
+        if (!next) {
+            next = &reception;
+        }
+    }
+    if (!next) {
+        return;
+    }
+    
+    // Forward to phone if connected; its chunks follow on later passes
+    if (!isConnected()) {
+        finishForward(*next);
+        return;
+    }
+    sendReceptionHeader(*next);
+    _forwarding = next;
+    timerWheel.arm(_forwardTimer, BLE_HEADER_GAP_MS);
+}
+
+void BleGateway::finishForward(ImageReception& reception) {
+    _forwarding = nullptr;
+    
+    // Cleanup; a clip's slot moves on to its next frame
+    if (reception.clipFrames > 0 && !reception.clipLast &&
+        reception.clipFrame + 1 < reception.clipFrames) {
+        nextClipFrame(reception);
+    } else {
+        releaseReception(reception);
+    }
+}
+
+uint16_t BleGateway::grantWindow() {
+    uint32_t backlog = bleBacklogBytes();
+    if (backlog >= IMG_BLE_BACKLOG_LIMIT) {
+        return 0;
+    }
+    
+    // Shrink the window as images pile up waiting for the phone
+    return (uint32_t)IMG_GRANT_WINDOW_CHUNKS * (IMG_BLE_BACKLOG_LIMIT - backlog) / IMG_BLE_BACKLOG_LIMIT;
+}
+
+uint16_t BleGateway::estimateRetryAfter() {
+    // Time to finish the admitted transfers plus drain the BLE backlog
+    uint32_t outstanding = 0;
+    for (auto& reception : _receptions) {
+        if (reception.active && !reception.complete) {
+            outstanding += reception.totalChunks - min(reception.receivedChunks, reception.totalChunks);
+        }
+    }
+    
+    uint32_t retryAfter = outstanding * IMG_GRANT_MS_PER_CHUNK + bleBacklogBytes() / 24;  // ~240 B per 10 ms over BLE
+    return constrain(retryAfter, (uint32_t)IMG_GRANT_RETRY_MIN_MS, (uint32_t)IMG_GRANT_RETRY_MAX_MS);
+}
+
+uint16_t BleGateway::offPeakDelay() {
+    // Nobody to forward to: the batch is better off kept on the sensor
+    if (!isConnected()) {
+        return TIMELAPSE_RETRY_MS;
+    }
+    
+    // Wait for transfers in flight to finish and the mesh to settle
+    for (auto& reception : _receptions) {
+        if (reception.active) {
+            return min((uint32_t)estimateRetryAfter() + TIMELAPSE_QUIET_MS, (uint32_t)0xFFFF);
+        }
+    }
+    
+    unsigned long quiet = millis() - _lastImageAt;
+    if (quiet < TIMELAPSE_QUIET_MS) {
+        return TIMELAPSE_QUIET_MS - quiet;
+    }
+    return 0;
+}
+
+uint32_t BleGateway::bleBacklogBytes() {
+    uint32_t backlog = 0;
+    for (auto& reception : _receptions) {
+        if (reception.active && reception.complete) {
+            // Less what has already gone out to the phone
+            uint32_t size = forwardSize(reception);
+            uint32_t forwarded = (uint32_t)reception.forwardedChunks * BLE_CHUNK_SIZE;
+            backlog += forwarded < size ? size - forwarded : 0;
+        }
+    }
+    return backlog;
+}
+
+void BleGateway::issueGrant(ImageReception& reception, bool resend) {
+    uint16_t window = max(grantWindow(), MIN_GRANT_WINDOW);
+    uint32_t granted = min((uint32_t)reception.receivedChunks + window, (uint32_t)reception.totalChunks);
+    
+    if (granted > reception.grantedChunks) {
+        reception.grantedChunks = granted;
+    } else if (!resend) {
+        return;
+    }
+    
+    DEBUG_PRINTF("[BLE] Granting image %d from node %d: %d/%d chunks\n",
+        reception.imageId, reception.sourceNode, reception.grantedChunks, reception.totalChunks);
+    
+    if (_grantCallback) {
+        _grantCallback(reception.sourceNode, reception.imageId, reception.grantedChunks, 0);
+    }
+}
+
+void BleGateway::requestRepair(ImageReception& reception) {
+    uint16_t missing[IMG_NACK_MAX_CHUNKS];
+    uint8_t count = 0;
+    
+    if (!reception.complete) {
+        portENTER_CRITICAL(&receptionLock);
+        uint16_t frameBits = reception.clipFrames > 0 ? reception.clipFrame << CLIP_FRAME_SHIFT : 0;
+        for (uint16_t i = 0; i < reception.totalChunks && count < IMG_NACK_MAX_CHUNKS; i++) {
+            if (!(reception.chunkMap[i / 8] & (1 << (i % 8)))) {
+                missing[count++] = frameBits | i;
+            }
+        }
+        portEXIT_CRITICAL(&receptionLock);
         
-        // Forward to phone if connected
-        if (isConnected()) {
-            sendImageToPhone(
-                _imageReception.buffer,
-                _imageReception.totalSize,
-                _imageReception.sourceNode,
-                _imageReception.imageId
-            );
+        reception.repairRounds++;
+        DEBUG_PRINTF("[BLE] Image %d from node %d: requesting %d missing chunks (round %d)\n",
+            reception.imageId, reception.sourceNode, count, reception.repairRounds);
+    }
+    
+    // Complete: the loop forwards it; otherwise ask again if repair stalls
+    if (reception.complete) {
+        timerWheel.cancel(reception.timer);
+        timerWheel.wake();
+    } else {
+        timerWheel.arm(reception.timer, IMG_REPAIR_TIMEOUT_MS);
+    }
+    
+    if (_repairCallback) {
+        _repairCallback(reception.sourceNode, reception.imageId, missing, count);
+    }
+}
+
+bool BleGateway::salvageReception(ImageReception& reception) {
+    #if JPEG_RESTART_ENABLED
+    // A clip frame's size is only known from its IMAGE_END
+    if (reception.clipFrames > 0 && !reception.endReceived) {
+        return false;
+    }
+    
+    // No more chunks are stored once it is complete
+    portENTER_CRITICAL(&receptionLock);
+    reception.complete = true;
+    portEXIT_CRITICAL(&receptionLock);
+    
+    size_t capacity = reception.totalSize + SALVAGE_SLACK;
+    uint8_t* image = (uint8_t*)ps_malloc(reception.totalSize);
+    uint8_t* rebuilt = (uint8_t*)ps_malloc(capacity);
+    size_t length = 0;
+    uint16_t lost = 0;
+    uint16_t intervals = 0;
+    if (image && rebuilt) {
+        // Gather the chunks that arrived; gaps are left as they are
+        for (uint16_t i = 0; i < reception.totalChunks; i++) {
+            if (reception.chunkMap[i / 8] & (1 << (i % 8))) {
+                size_t offset = (size_t)i * IMG_CHUNK_SIZE;
+                size_t bytes = min((size_t)IMG_CHUNK_SIZE, (size_t)reception.totalSize - offset);
+                memcpy(image + offset, reception.segments[offset / SEGMENT_BYTES] + offset % SEGMENT_BYTES, bytes);
+            }
         }
+        length = JpegRestart::salvage(image, reception.totalSize, reception.chunkMap, IMG_CHUNK_SIZE,
+                                      rebuilt, capacity, lost, intervals);
+    }
+    if (image) {
+        free(image);
     }
     
-    // Cleanup
-    if (_imageReception.buffer) {
-        free(_imageReception.buffer);
-        _imageReception.buffer = nullptr;
+    if (length == 0 || (uint32_t)(intervals - lost) * 100 < (uint32_t)intervals * IMG_PARTIAL_MIN_PCT) {
+        DEBUG_PRINTF("[BLE] Image %d from node %d: too little to salvage\n",
+            reception.imageId, reception.sourceNode);
+        if (rebuilt) {
+            free(rebuilt);
+        }
+        portENTER_CRITICAL(&receptionLock);
+        reception.complete = false;
+        portEXIT_CRITICAL(&receptionLock);
+        return false;
     }
-    _imageReception.active = false;
+    
+    DEBUG_PRINTF("[BLE] Image %d from node %d forwarded partial: %d/%d chunks, %d/%d intervals grey\n",
+        reception.imageId, reception.sourceNode, reception.receivedChunks, reception.totalChunks,
+        lost, intervals);
+    reception.salvaged = rebuilt;
+    reception.salvagedSize = length;
+    reception.region.flags |= IMAGE_FLAG_PARTIAL;
+    return true;
+    #else
+    return false;
+    #endif
 }
 
 void BleGateway::setConnectCallback(BleConnectCallback callback) {
@@ -447,4 +1111,12 @@ void BleGateway::setCommandCallback(BleCommandCallback callback) {
     _commandCallback = callback;
 }
 
+void BleGateway::setGrantCallback(ImageGrantCallback callback) {
+    _grantCallback = callback;
+}
+
+void BleGateway::setRepairCallback(ImageRepairCallback callback) {
+    _repairCallback = callback;
+}
+
 
@@ -9,6 +9,8 @@
 #include <vector>
 #include "config.h"
 #include "message_protocol.h"
+#include "jpeg_restart.h"
+#include "timer_wheel.h"
 
 // BLE connection state
 enum class BleState {
@@ -24,15 +26,31 @@ struct ImageReception {
     uint32_t totalSize;
     uint16_t totalChunks;
     uint16_t receivedChunks;
-    uint8_t* buffer;
+    uint16_t grantedChunks;  // Credit issued to the sender so far
+    uint8_t** segments;      // IMG_SEGMENT_CHUNKS chunks each, allocated as chunks land
+    uint16_t segmentCount;
+    uint8_t* chunkMap;       // One bit per chunk received
+    uint8_t* salvaged;       // Rebuilt with lost intervals grey, forwarded instead
+    uint32_t salvagedSize;
     uint32_t startTime;
-    bool complete;
+    uint32_t capturedAt;     // Sender's mesh time at capture, for latency
+    Timer timer;             // Stall timeout, then NACK repeat once IMAGE_END is in
+    uint8_t repairRounds;    // NACKs sent since IMAGE_END
+    ImageRegion region;      // Crop geometry from IMAGE_START
+    uint8_t clipFrames;      // Burst clip: frames announced (0 = single image)
+    uint8_t clipFrame;       // Frame being reassembled; forwarded as imageId + clipFrame
+    bool clipLast;           // The frame being reassembled ends the clip
+    bool endReceived;        // Sender has finished its first pass
+    bool complete;           // All chunks in, waiting to go to the phone
+    uint16_t forwardedChunks; // BLE chunks sent to the phone so far
     bool active;
 };
 
 // Callback types
 typedef void (*BleConnectCallback)(bool connected);
 typedef void (*BleCommandCallback)(uint8_t command, const uint8_t* data, size_t length);
+typedef void (*ImageGrantCallback)(uint16_t nodeId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs);
+typedef void (*ImageRepairCallback)(uint16_t nodeId, uint16_t imageId, const uint16_t* chunks, uint8_t count);
 
 class BleGateway : public BLEServerCallbacks, public BLECharacteristicCallbacks {
 public:
@@ -53,20 +71,24 @@ public:
     bool isConnected();
     
     // Send notifications to phone
-    bool notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool hasImage, const uint16_t* path = nullptr, uint8_t pathLength = 0);
+    bool notifyMotionAlert(uint16_t nodeId, uint32_t timestamp, bool hasImage, const uint16_t* path = nullptr, uint8_t pathLength = 0,
+                           uint8_t confidence = CONFIDENCE_UNKNOWN);
     bool notifyStatus(uint16_t nodeId, uint8_t battery, int8_t rssi, uint8_t meshNodes);
     
     // Send image data to phone (chunked)
-    bool sendImageToPhone(const uint8_t* imageData, size_t length, uint16_t nodeId, uint16_t imageId);
+    bool sendImageToPhone(const uint8_t* imageData, size_t length, uint16_t nodeId, uint16_t imageId, const ImageRegion* region = nullptr);
     
     // Handle incoming image from mesh for forwarding to phone
-    void handleImageStart(uint16_t sourceNode, uint16_t imageId, uint32_t size, uint16_t chunks);
+    void handleImageStart(uint16_t sourceNode, uint16_t imageId, uint32_t size, uint16_t chunks,
+                          const ImageRegion* region = nullptr, uint8_t frameCount = 0, uint32_t capturedAt = 0);
     void handleImageChunk(uint16_t sourceNode, uint16_t imageId, uint16_t chunkIndex, const uint8_t* data, uint8_t size);
-    void handleImageEnd(uint16_t sourceNode, uint16_t imageId);
+    void handleImageEnd(uint16_t sourceNode, uint16_t imageId, const ImageEndPayload* clipEnd = nullptr);
     
     // Set callbacks
     void setConnectCallback(BleConnectCallback callback);
     void setCommandCallback(BleCommandCallback callback);
+    void setGrantCallback(ImageGrantCallback callback);
+    void setRepairCallback(ImageRepairCallback callback);
     
     // BLE Callbacks (inherited)
     void onConnect(BLEServer* server) override;
@@ -75,7 +97,34 @@ public:
 
 private:
     void startAdvertising();
+    void sendImageHeaderToBle(size_t length, uint16_t nodeId, uint16_t imageId, uint16_t totalChunks,
+                              const ImageRegion* region, uint16_t latencyMs = 0xFFFF, uint16_t fpsTenths = 0);
+    uint16_t noteLiveFrame();
     void sendImageChunkToBle(const uint8_t* data, size_t length, uint16_t chunkIndex, uint16_t totalChunks);
+    void sendImageEndToBle(uint16_t imageId);
+    void sendReceptionHeader(ImageReception& reception);
+    bool sendReceptionChunks(ImageReception& reception, uint16_t maxChunks);
+    void finishForward(ImageReception& reception);
+    
+    // Reassembly slots and admission
+    ImageReception* findReception(uint16_t sourceNode, uint16_t imageId);
+    ImageReception* claimReception();
+    void releaseReception(ImageReception& reception);
+    void nextClipFrame(ImageReception& reception);
+    uint8_t* segmentFor(ImageReception& reception, uint16_t chunkIndex);
+    uint32_t admittedBytes();
+    void forwardCompletedImage();
+    uint16_t grantWindow();
+    uint16_t estimateRetryAfter();
+    uint16_t offPeakDelay();
+    uint32_t bleBacklogBytes();
+    void issueGrant(ImageReception& reception, bool resend = true);
+    void requestRepair(ImageReception& reception);
+    bool salvageReception(ImageReception& reception);
+    
+    // Timer callbacks (run from the loop via the timer wheel)
+    static void onReceptionTimer(void* context);
+    static void onReconnectTimer(void* context);
     
     // BLE objects
     BLEServer* _server;
@@ -90,15 +139,29 @@ private:
     BleState _state;
     bool _initialized;
     
-    // Image reception from mesh
-    ImageReception _imageReception;
+    // Image receptions from mesh
+    ImageReception _receptions[IMG_MAX_RECEPTIONS];
+    
+    // Image going out to the phone a burst of chunks at a time; the pace
+    // timer gives the mesh the loop between bursts
+    ImageReception* _forwarding;
+    Timer _forwardTimer;
+    
+    // Last image traffic other than time-lapse batches
+    unsigned long _lastImageAt;
+    
+    // Live view frame rate as delivered to the phone
+    unsigned long _lastLiveAt;
+    uint32_t _liveIntervalMs;  // EWMA between live frames
     
     // Callbacks
     BleConnectCallback _connectCallback;
     BleCommandCallback _commandCallback;
+    ImageGrantCallback _grantCallback;
+    ImageRepairCallback _repairCallback;
     
     // Reconnect handling
-    unsigned long _disconnectTime;
+    Timer _reconnectTimer;
     static const unsigned long RECONNECT_DELAY = 500;
 };
 
@@ -1,15 +1,34 @@
 #include "camera.h"
+#include <assert.h>
 
 // Global instance
 Camera camera;
 
+// OV2640 COM2 (sensor bank) and OV3660/OV5640 SYSTEM_CTRL0 standby bits
+#define OV2640_REG_COM2 0x109
+#define OV2640_COM2_STANDBY 0x10
+#define OV5640_REG_SYSTEM_CTRL0 0x3008
+#define OV5640_SYSTEM_POWER_DOWN 0x40
+
 Camera::Camera() 
     : _initialized(false)
-    , _fb(nullptr) {
+    , _fb(nullptr)
+    , _held(false)
+    , _frameSize(CAMERA_FRAME_SIZE)
+    , _jpegQuality(CAMERA_JPEG_QUALITY)
+    , _power(CameraPower::OFF)
+    , _idlePower((CameraPower)CAMERA_POWER_MODE)
+    , _settleFrames(0)
+    , _triggerMicros(0)
+    , _triggerPending(false)
+    , _latencySamples(0)
+    , _staleDiscards(0) {
     _lastImage.data = nullptr;
     _lastImage.length = 0;
     _lastImage.timestamp = 0;
     _lastImage.valid = false;
+    memset(_latency, 0, sizeof(_latency));
+    TimerWheel::bind(_idleTimer, onIdleTimer, this);
 }
 
 bool Camera::begin() {
@@ -18,6 +37,26 @@ bool Camera::begin() {
         return true;
     }
     
+    // Frame size based on PSRAM availability
+    if (!psramFound()) {
+        _frameSize = FRAMESIZE_QVGA;
+    }
+    
+    if (!startDriver()) {
+        return false;
+    }
+    
+    _initialized = true;
+    DEBUG_PRINTLN("[CAM] Camera initialized successfully");
+    
+    // Take a test capture to warm up
+    capture();
+    releaseFrame();
+    
+    return true;
+}
+
+bool Camera::startDriver() {
     // Camera configuration for Freenove ESP32-WROVER CAM
     camera_config_t config;
     config.ledc_channel = LEDC_CHANNEL_0;
@@ -40,19 +79,25 @@ bool Camera::begin() {
     config.pin_reset = RESET_GPIO_NUM;
     config.xclk_freq_hz = 20000000;  // 20MHz XCLK
     config.pixel_format = PIXFORMAT_JPEG;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    // The pre-trigger ring and a hot camera want the newest frame, not one
+    // queued since the last grab
+    config.grab_mode = (PRETRIGGER_ENABLED || CAMERA_POWER_MODE == CAMERA_POWER_HOT)
+        ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
     config.fb_location = CAMERA_FB_IN_PSRAM;
-    config.jpeg_quality = CAMERA_JPEG_QUALITY;
+    // Restarts keep what the quality controller chose
+    config.frame_size = _frameSize;
+    config.jpeg_quality = _jpegQuality;
     config.fb_count = CAMERA_FB_COUNT;
     
-    // Frame size based on PSRAM availability
     if (psramFound()) {
         DEBUG_PRINTLN("[CAM] PSRAM found, using larger buffer");
-        config.frame_size = CAMERA_FRAME_SIZE;
         config.fb_count = 2;
+        // Frame buffers are sized at init, so they must hold archive frames
+        if (ARCHIVE_ENABLED && ARCHIVE_FRAME_SIZE > _frameSize) {
+            config.frame_size = ARCHIVE_FRAME_SIZE;
+        }
     } else {
         DEBUG_PRINTLN("[CAM] No PSRAM, using smaller buffer");
-        config.frame_size = FRAMESIZE_QVGA;
         config.fb_count = 1;
         config.fb_location = CAMERA_FB_IN_DRAM;
     }
@@ -89,16 +134,189 @@ bool Camera::begin() {
         sensor->set_raw_gma(sensor, 1);        // Gamma correction
         sensor->set_lenc(sensor, 1);           // Lens correction
         sensor->set_dcw(sensor, 1);            // Downsize enable
+        
+        if (config.frame_size != _frameSize) {
+            sensor->set_framesize(sensor, _frameSize);
+        }
     }
     
-    _initialized = true;
-    DEBUG_PRINTLN("[CAM] Camera initialized successfully");
+    _power = CameraPower::HOT;
+    _settleFrames = CAMERA_SETTLE_FRAMES;
+    return true;
+}
+
+bool Camera::setSensorStandby(bool standby) {
+    if (PWDN_GPIO_NUM >= 0) {
+        pinMode(PWDN_GPIO_NUM, OUTPUT);
+        digitalWrite(PWDN_GPIO_NUM, standby ? HIGH : LOW);
+        return true;
+    }
     
-    // Take a test capture to warm up
-    capture();
+    // No power-down pin wired: use the sensor's own standby
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (!sensor) {
+        return false;
+    }
+    switch (sensor->id.PID) {
+        case OV2640_PID:
+            return sensor->set_reg(sensor, OV2640_REG_COM2, OV2640_COM2_STANDBY,
+                                   standby ? OV2640_COM2_STANDBY : 0) == 0;
+        case OV3660_PID:
+        case OV5640_PID:
+            return sensor->set_reg(sensor, OV5640_REG_SYSTEM_CTRL0, OV5640_SYSTEM_POWER_DOWN,
+                                   standby ? OV5640_SYSTEM_POWER_DOWN : 0) == 0;
+        default:
+            return false;
+    }
+}
+
+void Camera::setIdlePower(CameraPower power) {
+    _idlePower = power;
+    if (_initialized && _power != _idlePower) {
+        timerWheel.arm(_idleTimer, CAMERA_IDLE_MS);
+    }
+}
+
+CameraPower Camera::getPower() {
+    return _power;
+}
+
+void Camera::wake() {
+    if (!_initialized || _power == CameraPower::HOT) {
+        return;
+    }
+    
+    unsigned long start = micros();
+    if (_power == CameraPower::OFF) {
+        if (!startDriver()) {
+            return;
+        }
+    } else {
+        setSensorStandby(false);
+        _power = CameraPower::HOT;
+        _settleFrames = CAMERA_SETTLE_FRAMES;
+    }
+    DEBUG_PRINTF("[CAM] Awake in %lu us\n", micros() - start);
+}
+
+void Camera::standby() {
+    timerWheel.cancel(_idleTimer);
     releaseFrame();
+    if (_power == CameraPower::HOT && setSensorStandby(true)) {
+        _power = CameraPower::STANDBY;
+    }
+}
+
+void Camera::onIdleTimer(void* context) {
+    Camera* cam = static_cast<Camera*>(context);
+    if (cam->_power != CameraPower::HOT || cam->_idlePower == CameraPower::HOT) {
+        return;
+    }
     
-    return true;
+    // A frame still held by the pipeline keeps the driver up
+    if (cam->_fb) {
+        timerWheel.arm(cam->_idleTimer, CAMERA_IDLE_MS);
+        return;
+    }
+    
+    if (cam->_idlePower == CameraPower::OFF) {
+        esp_camera_deinit();
+        if (PWDN_GPIO_NUM >= 0) {
+            cam->setSensorStandby(true);
+        }
+        cam->_power = CameraPower::OFF;
+    } else if (cam->setSensorStandby(true)) {
+        cam->_power = CameraPower::STANDBY;
+    } else {
+        // No standby on this sensor: it keeps streaming
+        return;
+    }
+    DEBUG_PRINTF("[CAM] Idle: %s\n", cam->_power == CameraPower::OFF ? "off" : "standby");
+}
+
+void Camera::markTrigger(uint32_t triggerMicros) {
+    _triggerMicros = triggerMicros;
+    _triggerPending = true;
+}
+
+camera_fb_t* Camera::grabFresh() {
+    wake();
+    if (_power != CameraPower::HOT) {
+        return nullptr;
+    }
+    
+    // Frames buffered before the trigger (or simply old) and those taken
+    // while exposure settles are handed straight back; the driver holds
+    // at most fb_count of them
+    uint32_t freshAfter = _triggerPending ? _triggerMicros
+                                          : (uint32_t)micros() - CAMERA_MAX_FRAME_AGE_MS * 1000UL;
+    uint8_t attempts = CAMERA_FB_COUNT + _settleFrames + 1;
+    for (uint8_t attempt = 0; attempt < attempts; attempt++) {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (!fb) {
+            return nullptr;
+        }
+        
+        uint32_t frameMicros = (uint32_t)fb->timestamp.tv_sec * 1000000UL + fb->timestamp.tv_usec;
+        bool settling = _settleFrames > 0;
+        if (settling) {
+            _settleFrames--;
+        }
+        bool stale = settling || (int32_t)(frameMicros - freshAfter) < 0;
+        if (stale && attempt + 1 < attempts) {
+            esp_camera_fb_return(fb);
+            _staleDiscards++;
+            continue;
+        }
+        
+        noteFreshFrame();
+        return fb;
+    }
+    return nullptr;
+}
+
+void Camera::noteFreshFrame() {
+    if (_idlePower != CameraPower::HOT) {
+        timerWheel.arm(_idleTimer, CAMERA_IDLE_MS);
+    }
+    if (!_triggerPending) {
+        return;
+    }
+    _triggerPending = false;
+    
+    uint32_t latencyMs = ((uint32_t)micros() - _triggerMicros) / 1000;
+    uint8_t bucket = 0;
+    for (uint32_t bound = 25; bucket < CAMERA_LATENCY_BUCKETS - 1 && latencyMs >= bound; bound *= 2) {
+        bucket++;
+    }
+    _latency[bucket]++;
+    _latencySamples++;
+    DEBUG_PRINTF("[CAM] Trigger to fresh frame: %lu ms\n", latencyMs);
+    
+    if (_latencySamples % CAMERA_LATENCY_REPORT == 0) {
+        logLatencyHistogram();
+    }
+}
+
+void Camera::logLatencyHistogram() {
+    DEBUG_PRINTF("[CAM] Trigger latency over %lu triggers (%lu stale frames discarded):\n",
+        _latencySamples, _staleDiscards);
+    uint32_t bound = 25;
+    for (uint8_t i = 0; i < CAMERA_LATENCY_BUCKETS; i++, bound *= 2) {
+        if (i < CAMERA_LATENCY_BUCKETS - 1) {
+            DEBUG_PRINTF("[CAM]   < %4lu ms: %lu\n", bound, _latency[i]);
+        } else {
+            DEBUG_PRINTF("[CAM]  >= %4lu ms: %lu\n", bound / 2, _latency[i]);
+        }
+    }
+}
+
+const uint32_t* Camera::getLatencyHistogram() {
+    return _latency;
+}
+
+uint32_t Camera::getStaleDiscards() {
+    return _staleDiscards;
 }
 
 bool Camera::capture() {
@@ -107,11 +325,18 @@ bool Camera::capture() {
         return false;
     }
     
+    // The held frame is still being sent; recycling it would corrupt the transfer
+    if (_held) {
+        DEBUG_PRINTLN("[CAM] Capture refused: frame held");
+        assert(!_held);
+        return false;
+    }
+    
     // Release previous frame if exists
     releaseFrame();
     
     // Capture new frame
-    _fb = esp_camera_fb_get();
+    _fb = grabFresh();
     if (!_fb) {
         DEBUG_PRINTLN("[CAM] Frame capture failed");
         _lastImage.valid = false;
@@ -129,18 +354,56 @@ bool Camera::capture() {
     return true;
 }
 
+bool Camera::captureTo(uint8_t* dest, size_t capacity, size_t& length) {
+    if (!_initialized) {
+        return false;
+    }
+    
+    length = 0;
+    camera_fb_t* fb = grabFresh();
+    if (!fb) {
+        DEBUG_PRINTLN("[CAM] Frame capture failed");
+        return false;
+    }
+    
+    length = fb->len;
+    bool fits = fb->len <= capacity;
+    if (fits) {
+        memcpy(dest, fb->buf, fb->len);
+    } else {
+        DEBUG_PRINTF("[CAM] Frame of %u bytes exceeds %u byte slot\n", fb->len, capacity);
+    }
+    
+    esp_camera_fb_return(fb);
+    return fits;
+}
+
 CapturedImage Camera::getLastImage() {
     return _lastImage;
 }
 
 void Camera::releaseFrame() {
-    if (_fb) {
+    // Only releaseHeldFrame() hands a held frame back
+    if (_fb && !_held) {
         esp_camera_fb_return(_fb);
         _fb = nullptr;
         _lastImage.valid = false;
     }
 }
 
+void Camera::holdFrame() {
+    _held = _fb != nullptr;
+}
+
+void Camera::releaseHeldFrame() {
+    _held = false;
+    releaseFrame();
+}
+
+bool Camera::isFrameHeld() {
+    return _held;
+}
+
 bool Camera::isInitialized() {
     return _initialized;
 }
@@ -159,6 +422,26 @@ size_t Camera::getImageLength() {
     return 0;
 }
 
+bool Camera::captureAt(framesize_t size, int quality) {
+    sensor_t* sensor = _initialized ? esp_camera_sensor_get() : nullptr;
+    if (!sensor) {
+        return false;
+    }
+    
+    sensor->set_framesize(sensor, size);
+    sensor->set_quality(sensor, quality);
+    // Frames already in the pipeline are at the old size
+    wake();
+    _settleFrames = CAMERA_SETTLE_FRAMES;
+    bool captured = capture();
+    
+    // The held frame stays valid while the sensor goes back
+    sensor->set_framesize(sensor, _frameSize);
+    sensor->set_quality(sensor, _jpegQuality);
+    _settleFrames = CAMERA_SETTLE_FRAMES;
+    return captured;
+}
+
 bool Camera::setFrameSize(framesize_t size) {
     if (!_initialized) {
         return false;
@@ -167,6 +450,7 @@ bool Camera::setFrameSize(framesize_t size) {
     sensor_t* sensor = esp_camera_sensor_get();
     if (sensor) {
         sensor->set_framesize(sensor, size);
+        _frameSize = size;
         DEBUG_PRINTF("[CAM] Frame size set to %d\n", size);
         return true;
     }
@@ -181,10 +465,17 @@ bool Camera::setJpegQuality(int quality) {
     sensor_t* sensor = esp_camera_sensor_get();
     if (sensor) {
         sensor->set_quality(sensor, quality);
+        _jpegQuality = quality;
         DEBUG_PRINTF("[CAM] JPEG quality set to %d\n", quality);
         return true;
     }
     return false;
 }
 
+framesize_t Camera::getFrameSize() {
+    return _frameSize;
+}
 
+int Camera::getJpegQuality() {
+    return _jpegQuality;
+}
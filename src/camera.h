@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include "esp_camera.h"
 #include "config.h"
+#include "timer_wheel.h"
 
 // Image data structure
 struct CapturedImage {
@@ -13,6 +14,16 @@ struct CapturedImage {
     bool valid;         // Whether the image is valid
 };
 
+// Camera power state (CAMERA_POWER_* selects the one used between captures)
+enum class CameraPower : uint8_t {
+    OFF     = CAMERA_POWER_OFF,      // Driver released, sensor unpowered
+    STANDBY = CAMERA_POWER_STANDBY,  // Driver and sensor configured, sensor in standby
+    HOT     = CAMERA_POWER_HOT,      // Streaming, exposure settled
+};
+
+// Trigger-to-fresh-frame latency buckets: <25, <50, <100, ... ms, the last open-ended
+#define CAMERA_LATENCY_BUCKETS 8
+
 class Camera {
 public:
     Camera();
@@ -29,6 +40,12 @@ public:
     // Release the frame buffer (must be called after processing)
     void releaseFrame();
     
+    // Keep the captured frame for a caller that streams from it: until
+    // releaseHeldFrame(), capture() and releaseFrame() refuse to recycle it
+    void holdFrame();
+    void releaseHeldFrame();
+    bool isFrameHeld();
+    
     // Check if camera is initialized
     bool isInitialized();
     
@@ -36,21 +53,74 @@ public:
     uint8_t* getImageData();
     size_t getImageLength();
     
+    // Capture straight into a caller buffer and hand the frame buffer back
+    // to the driver at once; fails if the JPEG does not fit (length still
+    // reports its size so the caller can tell oversize from no frame)
+    bool captureTo(uint8_t* dest, size_t capacity, size_t& length);
+    
+    // Capture one frame at another size and quality (the archive's), then
+    // return the sensor to its own; the frame is held until releaseFrame()
+    bool captureAt(framesize_t size, int quality);
+    
     // Set frame size (quality vs speed tradeoff)
     bool setFrameSize(framesize_t size);
     
     // Set JPEG quality (0-63, lower = better quality)
     bool setJpegQuality(int quality);
+    
+    // Current sensor settings
+    framesize_t getFrameSize();
+    int getJpegQuality();
+    
+    // Power state between captures; captures wake the camera as needed
+    // and it drops back CAMERA_IDLE_MS after the last one
+    void setIdlePower(CameraPower power);
+    CameraPower getPower();
+    
+    // Bring the camera to HOT ahead of a capture (a PIR trigger)
+    void wake();
+    
+    // Drop to standby now rather than after CAMERA_IDLE_MS (before deep sleep)
+    void standby();
+    
+    // The next capture skips frames from before this micros() time and
+    // counts its latency from it
+    void markTrigger(uint32_t triggerMicros);
+    
+    // Statistics
+    const uint32_t* getLatencyHistogram();
+    uint32_t getStaleDiscards();
 
 private:
+    bool startDriver();
+    bool setSensorStandby(bool standby);
+    camera_fb_t* grabFresh();
+    void noteFreshFrame();
+    void logLatencyHistogram();
+    static void onIdleTimer(void* context);
+    
     bool _initialized;
     camera_fb_t* _fb;
+    bool _held;                 // _fb belongs to the frame queue until released
     CapturedImage _lastImage;
+    framesize_t _frameSize;
+    int _jpegQuality;
+    
+    // Power state
+    CameraPower _power;
+    CameraPower _idlePower;
+    Timer _idleTimer;           // Drops back to the idle state
+    uint8_t _settleFrames;      // Still to discard after a wake
+    
+    // Freshness and trigger latency
+    uint32_t _triggerMicros;
+    bool _triggerPending;
+    uint32_t _latency[CAMERA_LATENCY_BUCKETS];
+    uint32_t _latencySamples;
+    uint32_t _staleDiscards;
 };
 
 // Global instance
 extern Camera camera;
 
 #endif // CAMERA_H
-
-
@@ -0,0 +1,141 @@
+#include "chunk_cache.h"
+
+ChunkCache::ChunkCache()
+    : _entries(nullptr)
+    , _capacity(0) {
+}
+
+ChunkCache::~ChunkCache() {
+    if (_entries) {
+        free(_entries);
+    }
+}
+
+bool ChunkCache::begin(uint16_t capacity) {
+    if (_entries) {
+        return true;
+    }
+    
+    size_t bytes = capacity * sizeof(CachedChunk);
+    _entries = (CachedChunk*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+    if (!_entries) {
+        DEBUG_PRINTLN("[CACHE] Failed to allocate chunk cache");
+        return false;
+    }
+    
+    memset(_entries, 0, bytes);
+    _capacity = capacity;
+    
+    DEBUG_PRINTF("[CACHE] Chunk cache ready: %d entries (%u bytes)\n", capacity, bytes);
+    return true;
+}
+
+CachedChunk* ChunkCache::store(const MeshMessage& chunk) {
+    if (!_entries) {
+        return nullptr;
+    }
+    
+    uint16_t imageId = imageIdOf(chunk);
+    CachedChunk* slot = find(chunk.header.sourceId, imageId, chunk.header.chunkIndex);
+    
+    if (!slot) {
+        // Free slot first, then the oldest chunk nobody is waiting on,
+        // then the oldest chunk overall
+        CachedChunk* oldestIdle = nullptr;
+        CachedChunk* oldest = nullptr;
+        for (uint16_t i = 0; i < _capacity; i++) {
+            CachedChunk& candidate = _entries[i];
+            if (!candidate.used) {
+                slot = &candidate;
+                break;
+            }
+            if (!candidate.awaitingCustody &&
+                (!oldestIdle || candidate.sentAt < oldestIdle->sentAt)) {
+                oldestIdle = &candidate;
+            }
+            if (!oldest || candidate.sentAt < oldest->sentAt) {
+                oldest = &candidate;
+            }
+        }
+        if (!slot) {
+            slot = oldestIdle ? oldestIdle : oldest;
+        }
+        slot->retriesLeft = MSG_MAX_RETRIES;
+    }
+    
+    slot->message = chunk;
+    slot->sentAt = millis();
+    slot->awaitingCustody = false;
+    slot->used = true;
+    
+    return slot;
+}
+
+void ChunkCache::markSent(CachedChunk* entry) {
+    if (entry) {
+        entry->sentAt = millis();
+        entry->awaitingCustody = true;
+    }
+}
+
+void ChunkCache::evictImage(uint16_t sourceId, uint16_t imageId) {
+    for (uint16_t i = 0; i < _capacity; i++) {
+        CachedChunk& entry = _entries[i];
+        if (entry.used && entry.message.header.sourceId == sourceId &&
+            imageIdOf(entry.message) == imageId) {
+            entry.used = false;
+            entry.awaitingCustody = false;
+        }
+    }
+}
+
+CachedChunk* ChunkCache::find(uint16_t sourceId, uint16_t imageId, uint16_t chunkIndex) {
+    for (uint16_t i = 0; i < _capacity; i++) {
+        CachedChunk& entry = _entries[i];
+        if (entry.used &&
+            entry.message.header.sourceId == sourceId &&
+            entry.message.header.chunkIndex == chunkIndex &&
+            imageIdOf(entry.message) == imageId) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void ChunkCache::acknowledge(uint16_t sourceId, uint16_t imageId, uint16_t baseChunk, uint32_t bitmap) {
+    for (uint16_t i = 0; i < _capacity; i++) {
+        CachedChunk& entry = _entries[i];
+        if (!entry.used || !entry.awaitingCustody ||
+            entry.message.header.sourceId != sourceId ||
+            imageIdOf(entry.message) != imageId) {
+            continue;
+        }
+        
+        uint16_t offset = entry.message.header.chunkIndex - baseChunk;
+        if (entry.message.header.chunkIndex >= baseChunk && offset < 32 &&
+            (bitmap & (1UL << offset))) {
+            entry.awaitingCustody = false;
+        }
+    }
+}
+
+bool ChunkCache::awaitingCustody() {
+    for (uint16_t i = 0; i < _capacity; i++) {
+        if (_entries[i].used && _entries[i].awaitingCustody) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t ChunkCache::capacity() {
+    return _capacity;
+}
+
+CachedChunk* ChunkCache::entry(uint16_t index) {
+    return index < _capacity ? &_entries[index] : nullptr;
+}
+
+uint16_t ChunkCache::imageIdOf(const MeshMessage& chunk) {
+    return chunk.payload[0] | (chunk.payload[1] << 8);
+}
@@ -0,0 +1,58 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "message_protocol.h"
+
+// Image chunk a relay has forwarded and holds custody of
+struct CachedChunk {
+    MeshMessage message;    // IMAGE_CHUNK exactly as forwarded
+    uint32_t sentAt;        // When it last went to the next hop
+    uint8_t retriesLeft;    // Custody resends remaining
+    bool awaitingCustody;   // Next hop has not acknowledged it yet
+    bool used;
+};
+
+// Bounded PSRAM cache of forwarded image chunks, keyed by
+// (source node, image ID, chunk index). Serves custody resends and
+// NACK repairs from the nearest hop that still holds the chunk.
+class ChunkCache {
+public:
+    ChunkCache();
+    ~ChunkCache();
+    
+    // Allocate the cache
+    bool begin(uint16_t capacity);
+    
+    // Record a chunk accepted for forwarding (evicts the oldest entry when full)
+    CachedChunk* store(const MeshMessage& chunk);
+    
+    // Chunk went out to the next hop; custody ACK now expected
+    void markSent(CachedChunk* entry);
+    
+    // Drop every chunk of an image the gateway has completed
+    void evictImage(uint16_t sourceId, uint16_t imageId);
+    
+    // Look up a chunk
+    CachedChunk* find(uint16_t sourceId, uint16_t imageId, uint16_t chunkIndex);
+    
+    // Apply a custody ACK from the next hop
+    void acknowledge(uint16_t sourceId, uint16_t imageId, uint16_t baseChunk, uint32_t bitmap);
+    
+    // Any forwarded chunk still waiting for a custody ACK
+    bool awaitingCustody();
+    
+    // Direct access for retry scans
+    uint16_t capacity();
+    CachedChunk* entry(uint16_t index);
+    
+    // Key helpers
+    static uint16_t imageIdOf(const MeshMessage& chunk);
+
+private:
+    CachedChunk* _entries;
+    uint16_t _capacity;
+};
+
+#endif // CHUNK_CACHE_H
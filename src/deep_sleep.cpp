@@ -0,0 +1,120 @@
+#include "deep_sleep.h"
+#include "mesh_clock.h"
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
+#include <sys/time.h>
+
+// A deep sleeper must never be picked as a relay
+static_assert(!DEEP_SLEEP_ENABLED || MESH_SLEEPY_NODE, "DEEP_SLEEP_ENABLED needs MESH_SLEEPY_NODE");
+
+#define SLEEP_RTC_MAGIC 0x534C5050  // Marks the RTC clock state as written
+
+// Kept in RTC memory across deep sleep
+RTC_DATA_ATTR static uint32_t rtcMagic = 0;
+RTC_DATA_ATTR static uint32_t rtcMeshTime = 0;      // Mesh time when we went to sleep
+RTC_DATA_ATTR static uint64_t rtcSleptAt = 0;       // RTC time (us) when we went to sleep
+RTC_DATA_ATTR static uint32_t rtcWakeCount = 0;     // PIR wakes measured
+RTC_DATA_ATTR static uint32_t rtcAlertLastMs = 0;
+RTC_DATA_ATTR static uint32_t rtcAlertMinMs = 0;
+RTC_DATA_ATTR static uint32_t rtcAlertMaxMs = 0;
+RTC_DATA_ATTR static uint32_t rtcAlertSumMs = 0;
+
+// Global instance
+DeepSleep deepSleep;
+
+// The RTC timer keeps counting through deep sleep, unlike millis()
+static uint64_t rtcMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+DeepSleep::DeepSleep()
+    : _reason(WakeReason::POWER_ON)
+    , _alertMeasured(false) {
+    // No callback: the loop checks whether it is still armed
+    TimerWheel::bind(_idleTimer, nullptr, this);
+}
+
+void DeepSleep::begin() {
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_EXT0:
+            _reason = WakeReason::MOTION;
+            break;
+        case ESP_SLEEP_WAKEUP_TIMER:
+            _reason = WakeReason::CHECKIN;
+            break;
+        default:
+            _reason = WakeReason::POWER_ON;
+            break;
+    }
+    
+    // Mesh time runs on through the sleep; the next heartbeat corrects
+    // the RTC oscillator's drift
+    if (_reason != WakeReason::POWER_ON && rtcMagic == SLEEP_RTC_MAGIC) {
+        meshClock.resume(rtcMeshTime + (uint32_t)((rtcMicros() - rtcSleptAt) / 1000));
+    }
+    
+    timerWheel.arm(_idleTimer, _reason == WakeReason::CHECKIN ? DEEP_SLEEP_CHECKIN_MS : DEEP_SLEEP_IDLE_MS);
+}
+
+WakeReason DeepSleep::getWakeReason() {
+    return _reason;
+}
+
+bool DeepSleep::wokeFromSleep() {
+    return _reason != WakeReason::POWER_ON;
+}
+
+void DeepSleep::noteActivity() {
+    timerWheel.arm(_idleTimer, DEEP_SLEEP_IDLE_MS);
+}
+
+bool DeepSleep::isIdle() {
+    return !timerWheel.isArmed(_idleTimer);
+}
+
+void DeepSleep::enter() {
+    rtcMeshTime = meshClock.now();
+    rtcSleptAt = rtcMicros();
+    rtcMagic = SLEEP_RTC_MAGIC;
+    
+    // The PIR output idles low; hold the pin there while the digital GPIO
+    // pads are off, and wake when it goes high
+    rtc_gpio_pullup_dis((gpio_num_t)PIR_PIN);
+    rtc_gpio_pulldown_en((gpio_num_t)PIR_PIN);
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)PIR_PIN, 1);
+    if (DEEP_SLEEP_CHECKIN_S > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)DEEP_SLEEP_CHECKIN_S * 1000000ULL);
+    }
+    
+    DEBUG_PRINTF("[SLEEP] Deep sleep after %lu ms awake\n", millis());
+    Serial.flush();
+    esp_deep_sleep_start();
+}
+
+void DeepSleep::noteAlertSent() {
+    if (_reason != WakeReason::MOTION || _alertMeasured) {
+        return;
+    }
+    _alertMeasured = true;
+    
+    // From the start of the app: the ROM and bootloader run before it
+    uint32_t ms = millis();
+    rtcAlertLastMs = ms;
+    rtcAlertMinMs = (rtcWakeCount == 0 || ms < rtcAlertMinMs) ? ms : rtcAlertMinMs;
+    rtcAlertMaxMs = max(rtcAlertMaxMs, ms);
+    rtcAlertSumMs += ms;
+    rtcWakeCount++;
+    
+    DEBUG_PRINTF("[SLEEP] Wake to alert: %lu ms (avg %lu, min %lu, max %lu over %lu wakes)\n",
+        ms, rtcAlertSumMs / rtcWakeCount, rtcAlertMinMs, rtcAlertMaxMs, rtcWakeCount);
+}
+
+uint32_t DeepSleep::getWakeCount() {
+    return rtcWakeCount;
+}
+
+uint32_t DeepSleep::getLastWakeToAlertMs() {
+    return rtcAlertLastMs;
+}
@@ -0,0 +1,56 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+// Why the node is running
+enum class WakeReason : uint8_t {
+    POWER_ON,   // Cold boot or reset
+    MOTION,     // PIR wake from deep sleep
+    CHECKIN,    // Timer wake from deep sleep
+};
+
+// Deep sleep for battery sensors. The loop reports work in progress; once
+// the node has been idle long enough it sleeps with the PIR pin as the
+// wake source (and an optional check-in timer). The mesh clock is carried
+// across sleep in RTC memory, and the time from a PIR wake to the first
+// motion alert sent is measured.
+class DeepSleep {
+public:
+    DeepSleep();
+    
+    // Read the wake cause and resume the mesh clock (call early in setup,
+    // after the timer wheel)
+    void begin();
+    
+    WakeReason getWakeReason();
+    bool wokeFromSleep();
+    
+    // Work is going on: stay awake DEEP_SLEEP_IDLE_MS from now
+    void noteActivity();
+    
+    // Awake long enough with nothing to do
+    bool isIdle();
+    
+    // Sleep until the PIR or check-in timer; does not return
+    void enter();
+    
+    // A motion alert went out (the first after a PIR wake is measured)
+    void noteAlertSent();
+    
+    // Statistics, kept across sleep
+    uint32_t getWakeCount();
+    uint32_t getLastWakeToAlertMs();
+
+private:
+    WakeReason _reason;
+    bool _alertMeasured;
+    Timer _idleTimer;           // Armed while the node must stay awake
+};
+
+// Global instance
+extern DeepSleep deepSleep;
+
+#endif // DEEP_SLEEP_H
@@ -0,0 +1,60 @@
+#include "duplicate_filter.h"
+#include "frame_diff.h"
+
+// Global instance
+DuplicateFilter duplicateFilter;
+
+DuplicateFilter::DuplicateFilter()
+    : _next(0)
+    , _checkedCount(0)
+    , _suppressedCount(0)
+    , _lastDistance(64) {
+    memset(_history, 0, sizeof(_history));
+}
+
+bool DuplicateFilter::isDuplicate(uint64_t hash) {
+    uint32_t now = millis();
+    uint8_t closest = 64;
+    
+    for (uint8_t i = 0; i < DEDUP_HISTORY; i++) {
+        const SentHash& sent = _history[i];
+        if (!sent.used || now - sent.sentAt > DEDUP_WINDOW_MS) {
+            continue;
+        }
+        uint8_t distance = FrameDiff::hammingDistance(hash, sent.hash);
+        if (distance < closest) {
+            closest = distance;
+        }
+    }
+    
+    _checkedCount++;
+    _lastDistance = closest;
+    
+    bool duplicate = closest <= DEDUP_MAX_DISTANCE;
+    if (duplicate) {
+        _suppressedCount++;
+        DEBUG_PRINTF("[DEDUP] Near-duplicate (distance %d) - %lu of %lu suppressed\n",
+            closest, _suppressedCount, _checkedCount);
+    }
+    return duplicate;
+}
+
+void DuplicateFilter::remember(uint64_t hash) {
+    // Oldest entry makes way
+    _history[_next].hash = hash;
+    _history[_next].sentAt = millis();
+    _history[_next].used = true;
+    _next = (_next + 1) % DEDUP_HISTORY;
+}
+
+uint32_t DuplicateFilter::getCheckedCount() {
+    return _checkedCount;
+}
+
+uint32_t DuplicateFilter::getSuppressedCount() {
+    return _suppressedCount;
+}
+
+uint8_t DuplicateFilter::getLastDistance() {
+    return _lastDistance;
+}
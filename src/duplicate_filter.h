@@ -0,0 +1,43 @@
+#ifndef DUPLICATE_FILTER_H
+#define DUPLICATE_FILTER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Perceptual hash of an image that went out, and when
+struct SentHash {
+    uint64_t hash;
+    uint32_t sentAt;
+    bool used;
+};
+
+// Remembers the dHashes of recently sent images so a near-identical
+// frame (within DEDUP_MAX_DISTANCE bits) can skip its transfer
+class DuplicateFilter {
+public:
+    DuplicateFilter();
+    
+    // True if the hash is close to one sent within DEDUP_WINDOW_MS
+    bool isDuplicate(uint64_t hash);
+    
+    // Record a hash whose image is being sent
+    void remember(uint64_t hash);
+    
+    // Statistics
+    uint32_t getCheckedCount();
+    uint32_t getSuppressedCount();
+    uint8_t getLastDistance();      // Distance to the closest recent hash
+
+private:
+    SentHash _history[DEDUP_HISTORY];
+    uint8_t _next;
+    
+    uint32_t _checkedCount;
+    uint32_t _suppressedCount;
+    uint8_t _lastDistance;
+};
+
+// Global instance
+extern DuplicateFilter duplicateFilter;
+
+#endif // DUPLICATE_FILTER_H
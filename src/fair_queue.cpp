@@ -0,0 +1,208 @@
+#include "fair_queue.h"
+#include <new>
+
+FairQueue::FairQueue()
+    : _pool(nullptr)
+    , _next(nullptr)
+    , _freeHead(NONE)
+    , _poolSize(0)
+    , _perSourceLimit(0)
+    , _quantum(0)
+    , _count(0)
+    , _cursor(0)
+    , _turnStarted(false) {
+    
+    memset(_flows, 0, sizeof(_flows));
+}
+
+FairQueue::~FairQueue() {
+    delete[] _pool;
+    delete[] _next;
+}
+
+bool FairQueue::begin(uint16_t poolSize, uint16_t perSourceLimit, uint16_t quantumBytes) {
+    if (_pool) {
+        return true;
+    }
+    
+    _pool = new (std::nothrow) QueuedFrame[poolSize];
+    _next = new (std::nothrow) int16_t[poolSize];
+    if (!_pool || !_next) {
+        // Leave nothing half-allocated for the next begin() to mistake as done
+        delete[] _pool;
+        delete[] _next;
+        _pool = nullptr;
+        _next = nullptr;
+        return false;
+    }
+    
+    // Chain every slot into the free list
+    for (uint16_t i = 0; i < poolSize; i++) {
+        _next[i] = (i + 1 < poolSize) ? i + 1 : NONE;
+    }
+    _freeHead = poolSize > 0 ? 0 : NONE;
+    
+    _poolSize = poolSize;
+    _perSourceLimit = perSourceLimit;
+    _quantum = quantumBytes;
+    _count = 0;
+    
+    return true;
+}
+
+bool FairQueue::enqueue(const QueuedFrame& frame) {
+    uint16_t sourceId = frame.message.header.sourceId;
+    
+    Flow* flow = findFlow(sourceId);
+    if (!flow) {
+        flow = claimFlow(sourceId);
+        if (!flow) {
+            return false;
+        }
+    }
+    
+    if (flow->stats.depth >= _perSourceLimit || _freeHead == NONE) {
+        flow->stats.dropped++;
+        return false;
+    }
+    
+    // Take a slot from the free list and link it at the flow's tail
+    int16_t slot = _freeHead;
+    _freeHead = _next[slot];
+    _pool[slot] = frame;
+    _next[slot] = NONE;
+    
+    if (flow->head == NONE) {
+        flow->head = slot;
+    } else {
+        _next[flow->tail] = slot;
+    }
+    flow->tail = slot;
+    flow->stats.depth++;
+    _count++;
+    
+    return true;
+}
+
+bool FairQueue::dequeue(QueuedFrame& frame) {
+    if (_count == 0) {
+        return false;
+    }
+    
+    // Every pass over a backlogged flow adds a quantum, so this terminates
+    for (;;) {
+        Flow& flow = _flows[_cursor];
+        
+        if (!flow.inUse || flow.head == NONE) {
+            flow.deficit = 0;
+            _cursor = (_cursor + 1) % MAX_FLOWS;
+            _turnStarted = false;
+            continue;
+        }
+        
+        if (!_turnStarted) {
+            flow.deficit += _quantum;
+            _turnStarted = true;
+        }
+        
+        int16_t slot = flow.head;
+        uint16_t cost = frameCost(_pool[slot]);
+        
+        if (flow.deficit >= cost) {
+            frame = _pool[slot];
+            
+            // Unlink from the flow and return the slot to the free list
+            flow.head = _next[slot];
+            _next[slot] = _freeHead;
+            _freeHead = slot;
+            
+            flow.deficit -= cost;
+            flow.stats.depth--;
+            flow.stats.framesSent++;
+            flow.stats.bytesSent += cost;
+            _count--;
+            
+            // An emptied flow forfeits leftover credit
+            if (flow.head == NONE) {
+                flow.deficit = 0;
+                _cursor = (_cursor + 1) % MAX_FLOWS;
+                _turnStarted = false;
+            }
+            return true;
+        }
+        
+        // Not enough credit for the head frame: move on, keep the deficit
+        _cursor = (_cursor + 1) % MAX_FLOWS;
+        _turnStarted = false;
+    }
+}
+
+void FairQueue::chargeAirtime(uint16_t sourceId, uint32_t airtimeUs) {
+    Flow* flow = findFlow(sourceId);
+    if (flow) {
+        flow->stats.airtimeUs += airtimeUs;
+    }
+}
+
+uint16_t FairQueue::size() {
+    return _count;
+}
+
+uint8_t FairQueue::activeFlows() {
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < MAX_FLOWS; i++) {
+        if (_flows[i].inUse && _flows[i].head != NONE) {
+            active++;
+        }
+    }
+    return active;
+}
+
+bool FairQueue::getFlowStats(uint16_t sourceId, FairFlowStats& stats) {
+    Flow* flow = findFlow(sourceId);
+    if (!flow) {
+        return false;
+    }
+    stats = flow->stats;
+    return true;
+}
+
+FairQueue::Flow* FairQueue::findFlow(uint16_t sourceId) {
+    for (uint8_t i = 0; i < MAX_FLOWS; i++) {
+        if (_flows[i].inUse && _flows[i].stats.sourceId == sourceId) {
+            return &_flows[i];
+        }
+    }
+    return nullptr;
+}
+
+FairQueue::Flow* FairQueue::claimFlow(uint16_t sourceId) {
+    // Prefer an unused flow, otherwise recycle an idle one
+    Flow* candidate = nullptr;
+    for (uint8_t i = 0; i < MAX_FLOWS; i++) {
+        if (!_flows[i].inUse) {
+            candidate = &_flows[i];
+            break;
+        }
+        if (!candidate && _flows[i].head == NONE) {
+            candidate = &_flows[i];
+        }
+    }
+    
+    if (!candidate) {
+        return nullptr;
+    }
+    
+    memset(candidate, 0, sizeof(Flow));
+    candidate->stats.sourceId = sourceId;
+    candidate->head = NONE;
+    candidate->tail = NONE;
+    candidate->inUse = true;
+    
+    return candidate;
+}
+
+uint16_t FairQueue::frameCost(const QueuedFrame& frame) {
+    // Serialized size, which is what occupies the air
+    return sizeof(MessageHeader) + 1 + frame.message.payloadLength;
+}
@@ -0,0 +1,82 @@
+#ifndef FAIR_QUEUE_H
+#define FAIR_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "message_protocol.h"
+
+// Frame waiting in a transmit queue
+struct QueuedFrame {
+    MeshMessage message;
+    uint32_t enqueueTime;
+    uint8_t nextHopMac[6];  // Explicit link target (hop-local frames)
+    bool hasNextHop;        // False = route by header.destId
+};
+
+// Per-source flow statistics
+struct FairFlowStats {
+    uint16_t sourceId;
+    uint16_t depth;         // Frames currently queued
+    uint32_t framesSent;
+    uint32_t bytesSent;
+    uint32_t airtimeUs;     // Measured radio time spent on this source
+    uint32_t dropped;       // Frames rejected by the per-source cap
+};
+
+// Deficit-round-robin scheduler keyed by source node.
+// Frames share one fixed pool; each source has its own cap so a single
+// busy sender cannot fill the pool and starve the others.
+class FairQueue {
+public:
+    FairQueue();
+    ~FairQueue();
+    
+    // Allocate the frame pool
+    bool begin(uint16_t poolSize, uint16_t perSourceLimit, uint16_t quantumBytes);
+    
+    // Add a frame to its source's flow; false if the source or pool is full
+    bool enqueue(const QueuedFrame& frame);
+    
+    // Remove the next frame in DRR order
+    bool dequeue(QueuedFrame& frame);
+    
+    // Record radio time used by a frame from this source
+    void chargeAirtime(uint16_t sourceId, uint32_t airtimeUs);
+    
+    // Queue state
+    uint16_t size();
+    uint8_t activeFlows();
+    
+    // Statistics for one source (false if the source has no flow)
+    bool getFlowStats(uint16_t sourceId, FairFlowStats& stats);
+
+private:
+    struct Flow {
+        FairFlowStats stats;
+        int16_t head;       // Pool index of first frame (-1 = empty)
+        int16_t tail;       // Pool index of last frame
+        int32_t deficit;    // DRR byte credit
+        bool inUse;
+    };
+    
+    static const int16_t NONE = -1;
+    static const uint8_t MAX_FLOWS = MESH_MAX_NODES;
+    
+    Flow* findFlow(uint16_t sourceId);
+    Flow* claimFlow(uint16_t sourceId);
+    static uint16_t frameCost(const QueuedFrame& frame);
+    
+    QueuedFrame* _pool;
+    int16_t* _next;         // Per-pool-slot link to the next frame
+    int16_t _freeHead;
+    uint16_t _poolSize;
+    uint16_t _perSourceLimit;
+    uint16_t _quantum;
+    uint16_t _count;
+    
+    Flow _flows[MAX_FLOWS];
+    uint8_t _cursor;        // Flow currently being served
+    bool _turnStarted;      // Quantum already granted to the cursor flow
+};
+
+#endif // FAIR_QUEUE_H
@@ -0,0 +1,151 @@
+#include "frame_diff.h"
+
+void FrameDiff::rgb565ToLuma7(const uint8_t* rgb565, uint16_t sw, uint16_t sh,
+                              uint8_t* luma, uint16_t dw, uint16_t dh) {
+    for (uint16_t dy = 0; dy < dh; dy++) {
+        uint16_t y0 = (uint32_t)dy * sh / dh;
+        uint16_t y1 = (uint32_t)(dy + 1) * sh / dh;
+        if (y1 <= y0) {
+            y1 = y0 + 1;
+        }
+        
+        for (uint16_t dx = 0; dx < dw; dx++) {
+            uint16_t x0 = (uint32_t)dx * sw / dw;
+            uint16_t x1 = (uint32_t)(dx + 1) * sw / dw;
+            if (x1 <= x0) {
+                x1 = x0 + 1;
+            }
+            
+            uint32_t sum = 0;
+            uint32_t count = 0;
+            for (uint16_t y = y0; y < y1; y++) {
+                const uint8_t* p = rgb565 + ((uint32_t)y * sw + x0) * 2;
+                for (uint16_t x = x0; x < x1; x++, p += 2) {
+                    uint16_t c = (p[0] << 8) | p[1];
+                    uint32_t r = (c >> 8) & 0xF8;
+                    uint32_t g = (c >> 3) & 0xFC;
+                    uint32_t b = (c << 3) & 0xF8;
+                    // BT.601 weights in 8.8 fixed point
+                    sum += (r * 77 + g * 150 + b * 29) >> 8;
+                    count++;
+                }
+            }
+            
+            luma[(uint32_t)dy * dw + dx] = (uint8_t)((sum / count) >> 1);
+        }
+    }
+}
+
+uint32_t FrameDiff::countChanged(const uint32_t* a, const uint32_t* b, size_t words, uint8_t threshold) {
+    uint32_t changed = 0;
+    for (size_t i = 0; i < words; i++) {
+        changed += countAbove4(absDiff4(a[i], b[i]), threshold);
+    }
+    return changed;
+}
+
+uint32_t FrameDiff::sumAbsDiff(const uint32_t* a, const uint32_t* b, size_t words) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < words; i++) {
+        // Fold the four lanes: pairs first (max 254 per 16-bit half), then halves
+        uint32_t d = absDiff4(a[i], b[i]);
+        d = (d & 0x00FF00FFu) + ((d >> 8) & 0x00FF00FFu);
+        sum += (d & 0xFFFF) + (d >> 16);
+    }
+    return sum;
+}
+
+void FrameDiff::blend(uint32_t* background, const uint32_t* frame, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        uint32_t bg = background[i];
+        background[i] = average4(bg, average4(bg, frame[i]));
+    }
+}
+
+bool FrameDiff::changedBounds(const uint32_t* a, const uint32_t* b, uint16_t width, uint16_t height,
+                              uint8_t threshold, uint16_t& x0, uint16_t& y0, uint16_t& x1, uint16_t& y1) {
+    uint32_t bias = (uint32_t)(127 - threshold) * 0x01010101u;
+    size_t words = ((size_t)width * height) / 4;
+    bool found = false;
+    
+    for (size_t i = 0; i < words; i++) {
+        uint32_t above = (absDiff4(a[i], b[i]) + bias) & 0x80808080u;
+        while (above) {
+            // Lowest set top bit -> lane -> pixel (lane 0 is the first pixel)
+            uint32_t pixel = i * 4 + (__builtin_ctz(above) >> 3);
+            above &= above - 1;
+            
+            uint16_t x = pixel % width;
+            uint16_t y = pixel / width;
+            if (!found) {
+                x0 = x1 = x;
+                y0 = y1 = y;
+                found = true;
+            }
+            if (x < x0) x0 = x;
+            if (x > x1) x1 = x;
+            if (y < y0) y0 = y;
+            if (y > y1) y1 = y;
+        }
+    }
+    
+    if (found) {
+        x1++;
+        y1++;
+    }
+    return found;
+}
+
+uint64_t FrameDiff::dHash(const uint8_t* luma, uint16_t width, uint16_t height) {
+    // Box-average into a 9x8 grid
+    uint16_t grid[8][9];
+    for (uint8_t gy = 0; gy < 8; gy++) {
+        uint16_t y0 = (uint32_t)gy * height / 8;
+        uint16_t y1 = (uint32_t)(gy + 1) * height / 8;
+        if (y1 <= y0) {
+            y1 = y0 + 1;
+        }
+        for (uint8_t gx = 0; gx < 9; gx++) {
+            uint16_t x0 = (uint32_t)gx * width / 9;
+            uint16_t x1 = (uint32_t)(gx + 1) * width / 9;
+            if (x1 <= x0) {
+                x1 = x0 + 1;
+            }
+            
+            uint32_t sum = 0;
+            for (uint16_t y = y0; y < y1; y++) {
+                for (uint16_t x = x0; x < x1; x++) {
+                    sum += luma[(uint32_t)y * width + x];
+                }
+            }
+            grid[gy][gx] = sum / ((uint32_t)(x1 - x0) * (y1 - y0));
+        }
+    }
+    
+    uint64_t hash = 0;
+    for (uint8_t gy = 0; gy < 8; gy++) {
+        for (uint8_t gx = 0; gx < 8; gx++) {
+            hash = (hash << 1) | (grid[gy][gx] > grid[gy][gx + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+bool FrameDiff::jpegDimensions(const uint8_t* jpeg, size_t length, uint16_t& width, uint16_t& height) {
+    // Walk marker segments up to the baseline frame header (SOF0)
+    size_t pos = 2;
+    while (pos + 9 < length) {
+        if (jpeg[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = jpeg[pos + 1];
+        uint16_t segment = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if (marker == 0xC0) {
+            height = (jpeg[pos + 5] << 8) | jpeg[pos + 6];
+            width = (jpeg[pos + 7] << 8) | jpeg[pos + 8];
+            return width > 0 && height > 0;
+        }
+        pos += 2 + segment;
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pixel kernels for motion verification. Thumbnails hold 7-bit luma
+// (0-127), one pixel per byte, processed four at a time in 32-bit words:
+// the spare top bit of each byte absorbs borrows so lanes never interact.
+// No Arduino dependencies, so they build and run on a host as well.
+class FrameDiff {
+public:
+    // Box-filter a big-endian RGB565 image (as jpg2rgb565 writes it) down
+    // to a dw x dh 7-bit luma thumbnail
+    static void rgb565ToLuma7(const uint8_t* rgb565, uint16_t sw, uint16_t sh,
+                              uint8_t* luma, uint16_t dw, uint16_t dh);
+    
+    // Per-lane |a - b| of four 7-bit pixels
+    static inline uint32_t absDiff4(uint32_t a, uint32_t b) {
+        // Each lane of t holds 128 + a - b, in 1..255: no borrow crosses lanes
+        uint32_t t = (a | 0x80808080u) - b;
+        uint32_t ge = (t & 0x80808080u) >> 7;   // 1 where a >= b
+        uint32_t lt = ge ^ 0x01010101u;          // 1 where a < b
+        // a >= b: t - 128; a < b: 128 - t == (t ^ 0x7F) + 1
+        return (t & (ge * 0x7Fu)) | (((t ^ 0x7F7F7F7Fu) & (lt * 0x7Fu)) + lt);
+    }
+    
+    // Lanes of four 7-bit values strictly above threshold (0-126)
+    static inline uint32_t countAbove4(uint32_t v, uint8_t threshold) {
+        // Adding 127 - threshold sets a lane's top bit exactly when v > threshold
+        uint32_t bias = (uint32_t)(127 - threshold) * 0x01010101u;
+        return __builtin_popcount((v + bias) & 0x80808080u);
+    }
+    
+    // Pixels whose luma differs by more than threshold
+    static uint32_t countChanged(const uint32_t* a, const uint32_t* b, size_t words, uint8_t threshold);
+    
+    // Sum of |a - b| over all pixels
+    static uint32_t sumAbsDiff(const uint32_t* a, const uint32_t* b, size_t words);
+    
+    // background = 3/4 background + 1/4 frame, per pixel
+    static void blend(uint32_t* background, const uint32_t* frame, size_t words);
+    
+    // Bounding box (x1/y1 exclusive) of pixels changed by more than
+    // threshold in a width x height thumbnail; false if none changed
+    static bool changedBounds(const uint32_t* a, const uint32_t* b, uint16_t width, uint16_t height,
+                              uint8_t threshold, uint16_t& x0, uint16_t& y0, uint16_t& x1, uint16_t& y1);
+    
+    // 64-bit difference hash: the luma image boxed down to 9x8, one bit
+    // per horizontally adjacent pair (set where the left cell is brighter)
+    static uint64_t dHash(const uint8_t* luma, uint16_t width, uint16_t height);
+    
+    // Bits that differ between two hashes
+    static inline uint8_t hammingDistance(uint64_t a, uint64_t b) {
+        return __builtin_popcountll(a ^ b);
+    }
+    
+    // Image size from a baseline JPEG's frame header
+    static bool jpegDimensions(const uint8_t* jpeg, size_t length, uint16_t& width, uint16_t& height);
+    
+    // Per-lane floor((a + b) / 2)
+    static inline uint32_t average4(uint32_t a, uint32_t b) {
+        return (a & b) + (((a ^ b) & 0xFEFEFEFEu) >> 1);
+    }
+};
+
+#endif // FRAME_DIFF_H
@@ -0,0 +1,215 @@
+#include "frame_queue.h"
+#include "camera.h"
+#include "quality_control.h"
+
+// Global instance
+FrameQueue frameQueue;
+
+FrameQueue::FrameQueue()
+    : _entries(nullptr)
+    , _storage(nullptr)
+    , _depth(0)
+    , _slotBytes(0)
+    , _head(0)
+    , _count(0)
+    , _cameraHeld(false)
+    , _droppedCount(0)
+    , _streamedCount(0) {
+}
+
+FrameQueue::~FrameQueue() {
+    if (_storage) {
+        free(_storage);
+    }
+    if (_entries) {
+        free(_entries);
+    }
+}
+
+bool FrameQueue::begin(uint8_t depth, size_t slotBytes) {
+    if (_entries) {
+        return true;
+    }
+    
+    if (!psramFound()) {
+        DEBUG_PRINTLN("[QUEUE] No PSRAM - frames sent straight from the camera");
+        return false;
+    }
+    
+    _storage = (uint8_t*)ps_malloc(depth * slotBytes);
+    _entries = (QueuedImage*)ps_malloc(depth * sizeof(QueuedImage));
+    if (!_storage || !_entries) {
+        DEBUG_PRINTLN("[QUEUE] Failed to allocate frame queue");
+        if (_storage) free(_storage);
+        if (_entries) free(_entries);
+        _storage = nullptr;
+        _entries = nullptr;
+        return false;
+    }
+    
+    memset(_entries, 0, depth * sizeof(QueuedImage));
+    _depth = depth;
+    _slotBytes = slotBytes;
+    
+    DEBUG_PRINTF("[QUEUE] Frame queue ready: %d images x %u bytes\n", depth, slotBytes);
+    return true;
+}
+
+bool FrameQueue::isReady() {
+    return _entries != nullptr;
+}
+
+QueuedImage* FrameQueue::tail() {
+    if (!_entries || _count >= _depth) {
+        _droppedCount++;
+        return nullptr;
+    }
+    
+    uint8_t index = (_head + _count) % _depth;
+    QueuedImage* entry = &_entries[index];
+    entry->data = _storage + index * _slotBytes;
+    entry->capacity = _slotBytes;
+    entry->ringSlot = nullptr;
+    entry->cameraFrame = false;
+    entry->clipFrame = 0;
+    entry->clipFrames = 0;
+    memset(&entry->region, 0, sizeof(entry->region));
+    return entry;
+}
+
+QueuedImage* FrameQueue::captureFrame(uint16_t imageId, uint32_t timestamp) {
+    QueuedImage* entry = tail();
+    if (!entry) {
+        return nullptr;
+    }
+    
+    size_t length = 0;
+    if (!_cameraHeld && camera.capture()) {
+        length = camera.getImageLength();
+        if (length <= _slotBytes) {
+            memcpy(entry->data, camera.getImageData(), length);
+            camera.releaseFrame();
+        } else if (QC_LARGE_IMAGES && length <= IMG_MAX_BYTES) {
+            // Too big to copy: send it from the driver buffer, which the
+            // driver does without until the transfer is done
+            entry->data = camera.getImageData();
+            entry->capacity = length;
+            entry->cameraFrame = true;
+            camera.holdFrame();
+            _cameraHeld = true;
+            _streamedCount++;
+        } else {
+            camera.releaseFrame();
+            qualityControl.noteOversize();
+            length = 0;
+        }
+        if (length > 0) {
+            qualityControl.noteFrame(length);
+        }
+    }
+    
+    // A frame is already held (or was too large): fall back to a slot copy
+    if (length == 0 && !qualityControl.capture(entry->data, _slotBytes, length)) {
+        return nullptr;
+    }
+    
+    entry->length = length;
+    entry->imageId = imageId;
+    entry->timestamp = timestamp;
+    _count++;
+    return entry;
+}
+
+QueuedImage* FrameQueue::pushRingFrame(FrameSlot* slot, uint16_t imageId, uint32_t timestamp) {
+    QueuedImage* entry = tail();
+    if (!entry) {
+        return nullptr;
+    }
+    
+    entry->data = slot->data;
+    entry->length = slot->length;
+    entry->capacity = PRETRIGGER_SLOT_BYTES;
+    entry->imageId = imageId;
+    entry->timestamp = timestamp;
+    entry->ringSlot = slot;
+    _count++;
+    return entry;
+}
+
+QueuedImage* FrameQueue::push(const uint8_t* data, size_t length, uint16_t imageId, uint32_t timestamp,
+                              const ImageRegion& region) {
+    if (length > _slotBytes) {
+        return nullptr;
+    }
+    
+    QueuedImage* entry = tail();
+    if (!entry) {
+        return nullptr;
+    }
+    
+    memcpy(entry->data, data, length);
+    entry->length = length;
+    entry->imageId = imageId;
+    entry->timestamp = timestamp;
+    entry->region = region;
+    _count++;
+    return entry;
+}
+
+QueuedImage* FrameQueue::peek() {
+    if (_count == 0) {
+        return nullptr;
+    }
+    return &_entries[_head];
+}
+
+void FrameQueue::pop() {
+    if (_count == 0) {
+        return;
+    }
+    
+    release(_entries[_head]);
+    _head = (_head + 1) % _depth;
+    _count--;
+}
+
+void FrameQueue::dropNewest() {
+    if (_count == 0) {
+        return;
+    }
+    
+    release(_entries[(_head + _count - 1) % _depth]);
+    _count--;
+}
+
+void FrameQueue::release(QueuedImage& entry) {
+    if (entry.ringSlot) {
+        frameRing.release(entry.ringSlot);
+        entry.ringSlot = nullptr;
+    }
+    if (entry.cameraFrame) {
+        camera.releaseHeldFrame();
+        entry.cameraFrame = false;
+        _cameraHeld = false;
+    }
+}
+
+uint8_t FrameQueue::count() {
+    return _count;
+}
+
+uint8_t FrameQueue::freeEntries() {
+    return _depth - _count;
+}
+
+bool FrameQueue::isCameraHeld() {
+    return _cameraHeld;
+}
+
+uint32_t FrameQueue::getDroppedCount() {
+    return _droppedCount;
+}
+
+uint32_t FrameQueue::getStreamedCount() {
+    return _streamedCount;
+}
@@ -0,0 +1,88 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "frame_ring.h"
+#include "message_protocol.h"
+
+// Captured image waiting for the mesh
+struct QueuedImage {
+    uint8_t* data;          // Own PSRAM buffer, the frozen ring slot's data or the camera's
+    size_t length;
+    size_t capacity;        // Bytes data may grow to (in-place re-encodes)
+    uint16_t imageId;
+    uint32_t timestamp;     // Mesh time of the motion event
+    FrameSlot* ringSlot;    // Set when the image lives in the pre-trigger ring
+    bool cameraFrame;       // Set when the image is the held driver frame buffer
+    ImageRegion region;     // Crop geometry (flags 0 = whole frame)
+    uint8_t clipFrame;      // Frame within a burst clip
+    uint8_t clipFrames;     // Frames planned for the clip (0 = single image)
+};
+
+// FIFO of captured images between the capture and transmit stages.
+// Each entry owns a fixed PSRAM buffer the camera copies into, so the
+// driver's frame buffer goes back as soon as the JPEG is captured.
+// Frozen pre-trigger frames are queued by reference instead, as is one
+// frame too large for a slot when QC_LARGE_IMAGES allows it, which is
+// sent straight from the driver's frame buffer and handed back once
+// transmitted.
+class FrameQueue {
+public:
+    FrameQueue();
+    ~FrameQueue();
+    
+    // Allocate entries and their buffers (PSRAM only)
+    bool begin(uint8_t depth, size_t slotBytes);
+    bool isReady();
+    
+    // Capture a frame from the camera into the tail entry (or hold it
+    // in the driver buffer when it is larger than a slot)
+    QueuedImage* captureFrame(uint16_t imageId, uint32_t timestamp);
+    
+    // Queue a frozen pre-trigger frame without copying it
+    QueuedImage* pushRingFrame(FrameSlot* slot, uint16_t imageId, uint32_t timestamp);
+    
+    // Queue a copy of an already encoded image
+    QueuedImage* push(const uint8_t* data, size_t length, uint16_t imageId, uint32_t timestamp,
+                      const ImageRegion& region);
+    
+    // Oldest image, or nullptr when empty
+    QueuedImage* peek();
+    
+    // Done with the oldest image (releases its ring slot if any)
+    void pop();
+    
+    // Take back the most recently queued image (vetoed before sending)
+    void dropNewest();
+    
+    uint8_t count();
+    uint8_t freeEntries();
+    
+    // Whether a queued image is the driver frame buffer (the camera must
+    // not capture again until it is sent)
+    bool isCameraHeld();
+    
+    // Statistics
+    uint32_t getDroppedCount();
+    uint32_t getStreamedCount();
+
+private:
+    QueuedImage* tail();
+    void release(QueuedImage& entry);
+    
+    QueuedImage* _entries;
+    uint8_t* _storage;
+    uint8_t _depth;
+    size_t _slotBytes;
+    uint8_t _head;
+    uint8_t _count;
+    bool _cameraHeld;
+    uint32_t _droppedCount;
+    uint32_t _streamedCount;
+};
+
+// Global instance
+extern FrameQueue frameQueue;
+
+#endif // FRAME_QUEUE_H
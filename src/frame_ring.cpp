@@ -0,0 +1,203 @@
+#include "frame_ring.h"
+#include "camera.h"
+#include "quality_control.h"
+
+// Global instance
+FrameRing frameRing;
+
+FrameRing::FrameRing()
+    : _slots(nullptr)
+    , _storage(nullptr)
+    , _slotCount(0)
+    , _slotBytes(0)
+    , _sequence(0)
+    , _intervalMs(0)
+    , _running(false)
+    , _frameCallback(nullptr)
+    , _captureCount(0)
+    , _oversizeCount(0) {
+    TimerWheel::bind(_captureTimer, onCaptureTimer, this);
+}
+
+FrameRing::~FrameRing() {
+    timerWheel.cancel(_captureTimer);
+    if (_storage) {
+        free(_storage);
+    }
+    if (_slots) {
+        free(_slots);
+    }
+}
+
+bool FrameRing::begin(uint8_t slots, size_t slotBytes) {
+    if (_slots) {
+        return true;
+    }
+    
+    // Several full JPEGs do not fit in internal RAM alongside WiFi
+    if (!psramFound()) {
+        DEBUG_PRINTLN("[RING] No PSRAM - pre-trigger ring disabled");
+        return false;
+    }
+    
+    // One block for all frame data, carved into fixed slots
+    _storage = (uint8_t*)ps_malloc(slots * slotBytes);
+    _slots = (FrameSlot*)ps_malloc(slots * sizeof(FrameSlot));
+    if (!_storage || !_slots) {
+        DEBUG_PRINTLN("[RING] Failed to allocate pre-trigger ring");
+        if (_storage) free(_storage);
+        if (_slots) free(_slots);
+        _storage = nullptr;
+        _slots = nullptr;
+        return false;
+    }
+    
+    memset(_slots, 0, slots * sizeof(FrameSlot));
+    for (uint8_t i = 0; i < slots; i++) {
+        _slots[i].data = _storage + i * slotBytes;
+    }
+    _slotCount = slots;
+    _slotBytes = slotBytes;
+    
+    DEBUG_PRINTF("[RING] Pre-trigger ring ready: %d slots x %u bytes\n", slots, slotBytes);
+    return true;
+}
+
+void FrameRing::start(uint32_t intervalMs) {
+    if (!_slots) {
+        return;
+    }
+    _intervalMs = intervalMs;
+    _running = true;
+    timerWheel.arm(_captureTimer, intervalMs);
+}
+
+void FrameRing::stop() {
+    _running = false;
+    timerWheel.cancel(_captureTimer);
+}
+
+bool FrameRing::isRunning() {
+    return _running;
+}
+
+void FrameRing::onCaptureTimer(void* context) {
+    FrameRing* self = static_cast<FrameRing*>(context);
+    if (!self->_running) {
+        return;
+    }
+    
+    FrameSlot* slot = self->captureNow();
+    if (slot && self->_frameCallback) {
+        self->_frameCallback(*slot);
+    }
+    timerWheel.arm(self->_captureTimer, self->_intervalMs);
+}
+
+void FrameRing::setFrameCallback(FrameCallback callback) {
+    _frameCallback = callback;
+}
+
+FrameSlot* FrameRing::claimSlot() {
+    // Empty slot first, otherwise overwrite the oldest unfrozen frame
+    FrameSlot* oldest = nullptr;
+    for (uint8_t i = 0; i < _slotCount; i++) {
+        FrameSlot& slot = _slots[i];
+        if (slot.frozen) {
+            continue;
+        }
+        if (!slot.valid) {
+            return &slot;
+        }
+        if (!oldest || (int16_t)(slot.sequence - oldest->sequence) < 0) {
+            oldest = &slot;
+        }
+    }
+    return oldest;
+}
+
+FrameSlot* FrameRing::captureNow() {
+    if (!_slots || !camera.isInitialized()) {
+        return nullptr;
+    }
+    
+    FrameSlot* slot = claimSlot();
+    if (!slot) {
+        // Every slot is out with the sender
+        return nullptr;
+    }
+    
+    slot->valid = false;
+    size_t length = 0;
+    if (!qualityControl.capture(slot->data, _slotBytes, length)) {
+        if (length > 0) {
+            _oversizeCount++;
+        }
+        return nullptr;
+    }
+    
+    slot->length = length;
+    slot->capturedAt = millis();
+    slot->sequence = ++_sequence;
+    slot->valid = true;
+    _captureCount++;
+    
+    return slot;
+}
+
+uint8_t FrameRing::freeze(uint32_t windowMs, FrameSlot** out, uint8_t maxFrames) {
+    if (!_slots || maxFrames == 0) {
+        return 0;
+    }
+    
+    uint32_t now = millis();
+    uint8_t count = 0;
+    
+    // Pick the newest frames in the window, then hand them out oldest first
+    for (uint8_t i = 0; i < _slotCount; i++) {
+        FrameSlot* slot = &_slots[i];
+        if (!slot->valid || slot->frozen || now - slot->capturedAt > windowMs) {
+            continue;
+        }
+        
+        // Insertion by sequence, dropping the oldest when over maxFrames
+        uint8_t pos = count;
+        while (pos > 0 && (int16_t)(out[pos - 1]->sequence - slot->sequence) > 0) {
+            pos--;
+        }
+        if (count == maxFrames) {
+            if (pos == 0) {
+                continue;
+            }
+            memmove(&out[0], &out[1], (pos - 1) * sizeof(FrameSlot*));
+            pos--;
+        } else {
+            memmove(&out[pos + 1], &out[pos], (count - pos) * sizeof(FrameSlot*));
+            count++;
+        }
+        out[pos] = slot;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        out[i]->frozen = true;
+    }
+    
+    DEBUG_PRINTF("[RING] Froze %d frame(s) from the last %lu ms\n", count, windowMs);
+    return count;
+}
+
+void FrameRing::release(FrameSlot* slot) {
+    if (slot) {
+        // Each frame is offered once (the sender may also have cropped it in place)
+        slot->frozen = false;
+        slot->valid = false;
+    }
+}
+
+uint32_t FrameRing::getCaptureCount() {
+    return _captureCount;
+}
+
+uint32_t FrameRing::getOversizeCount() {
+    return _oversizeCount;
+}
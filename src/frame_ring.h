@@ -0,0 +1,74 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+// One JPEG held in the pre-trigger ring
+struct FrameSlot {
+    uint8_t* data;          // Fixed PSRAM region, PRETRIGGER_SLOT_BYTES long
+    size_t length;          // JPEG bytes currently held
+    uint32_t capturedAt;    // millis() at capture
+    uint16_t sequence;      // Capture order
+    bool valid;             // Holds a frame
+    bool frozen;            // Handed out; not overwritten until released
+};
+
+// Callback for each background capture
+typedef void (*FrameCallback)(const FrameSlot& slot);
+
+// Fixed set of PSRAM JPEG slots filled at a low rate while idle, so a
+// motion event can send frames from just before the PIR fired. Frozen
+// slots are handed to the sender as-is (no copy) and released afterwards.
+class FrameRing {
+public:
+    FrameRing();
+    ~FrameRing();
+    
+    // Allocate the slots (PSRAM only)
+    bool begin(uint8_t slots, size_t slotBytes);
+    
+    // Start/stop background capture
+    void start(uint32_t intervalMs);
+    void stop();
+    bool isRunning();
+    
+    // Called after each timed (idle) capture
+    void setFrameCallback(FrameCallback callback);
+    
+    // Capture a frame now into the oldest unfrozen slot
+    FrameSlot* captureNow();
+    
+    // Freeze frames captured within windowMs, oldest first; returns count
+    uint8_t freeze(uint32_t windowMs, FrameSlot** out, uint8_t maxFrames);
+    
+    // Return a frozen slot to the ring; its frame is not offered again
+    void release(FrameSlot* slot);
+    
+    // Statistics
+    uint32_t getCaptureCount();
+    uint32_t getOversizeCount();
+
+private:
+    static void onCaptureTimer(void* context);
+    FrameSlot* claimSlot();
+    
+    FrameSlot* _slots;
+    uint8_t* _storage;
+    uint8_t _slotCount;
+    size_t _slotBytes;
+    uint16_t _sequence;
+    uint32_t _intervalMs;
+    Timer _captureTimer;
+    bool _running;
+    FrameCallback _frameCallback;
+    
+    uint32_t _captureCount;
+    uint32_t _oversizeCount;
+};
+
+// Global instance
+extern FrameRing frameRing;
+
+#endif // FRAME_RING_H
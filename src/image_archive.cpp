@@ -0,0 +1,338 @@
+#include "image_archive.h"
+#include <SD_MMC.h>
+#include <SPIFFS.h>
+
+// SD_MMC's 1-bit bus uses GPIO 2 for data
+static_assert(!ARCHIVE_ENABLED || DEVICE_ROLE != ROLE_SENSOR || ARCHIVE_STORAGE != ARCHIVE_STORAGE_SD || LED_PIN != 2,
+              "The SD archive needs LED_PIN moved off GPIO 2");
+
+static const char* ARCHIVE_DIR = "/archive";
+static const char* INDEX_PATH = "/archive/index.bin";
+
+// Global instance
+ImageArchive imageArchive;
+
+ImageArchive::ImageArchive()
+    : _fs(nullptr)
+    , _index(nullptr)
+    , _nextSeq(1)
+    , _count(0)
+    , _staged(nullptr)
+    , _stagedLength(0)
+    , _stagedId(0)
+    , _stagedTimestamp(0)
+    , _pullCount(0)
+    , _bulkSince(0)
+    , _bulkAfterSeq(0)
+    , _bulkLeft(0)
+    , _storedCount(0)
+    , _evictedCount(0)
+    , _pulledCount(0) {
+}
+
+ImageArchive::~ImageArchive() {
+    if (_staged) {
+        free(_staged);
+    }
+    if (_index) {
+        free(_index);
+    }
+}
+
+bool ImageArchive::begin() {
+    if (_index) {
+        return true;
+    }
+    
+    if (!psramFound()) {
+        DEBUG_PRINTLN("[ARCHIVE] No PSRAM - archive disabled");
+        return false;
+    }
+    
+    #if ARCHIVE_STORAGE == ARCHIVE_STORAGE_SD
+    // 1-bit mode leaves GPIO 4, 12 and 13 to the camera and PIR
+    if (!SD_MMC.begin("/sdcard", true)) {
+        DEBUG_PRINTLN("[ARCHIVE] No microSD card - archive disabled");
+        return false;
+    }
+    _fs = &SD_MMC;
+    _fs->mkdir(ARCHIVE_DIR);
+    #else
+    if (!SPIFFS.begin(true)) {
+        DEBUG_PRINTLN("[ARCHIVE] SPIFFS mount failed - archive disabled");
+        return false;
+    }
+    _fs = &SPIFFS;
+    #endif
+    
+    size_t indexBytes = ARCHIVE_MAX_IMAGES * sizeof(ArchiveEntry);
+    _index = (ArchiveEntry*)ps_malloc(indexBytes);
+    if (!_index) {
+        DEBUG_PRINTLN("[ARCHIVE] Failed to allocate index");
+        return false;
+    }
+    memset(_index, 0, indexBytes);
+    
+    // Index from an earlier run, if it has this build's size
+    File file = _fs->open(INDEX_PATH, FILE_READ);
+    bool loaded = file && file.size() == indexBytes && file.read((uint8_t*)_index, indexBytes) == indexBytes;
+    if (file) {
+        file.close();
+    }
+    if (!loaded) {
+        memset(_index, 0, indexBytes);
+        file = _fs->open(INDEX_PATH, FILE_WRITE);
+        if (!file || file.write((uint8_t*)_index, indexBytes) != indexBytes) {
+            DEBUG_PRINTLN("[ARCHIVE] Failed to create index");
+            if (file) {
+                file.close();
+            }
+            free(_index);
+            _index = nullptr;
+            return false;
+        }
+        file.close();
+    }
+    
+    for (uint16_t i = 0; i < ARCHIVE_MAX_IMAGES; i++) {
+        if (_index[i].seq != 0) {
+            _count++;
+            _nextSeq = max(_nextSeq, _index[i].seq + 1);
+        }
+    }
+    
+    DEBUG_PRINTF("[ARCHIVE] Ready on %s: %d images, %llu bytes free\n",
+        ARCHIVE_STORAGE == ARCHIVE_STORAGE_SD ? "microSD" : "flash", _count, freeBytes());
+    return true;
+}
+
+bool ImageArchive::isReady() {
+    return _index != nullptr;
+}
+
+bool ImageArchive::stage(uint16_t imageId, uint32_t timestamp, const uint8_t* data, size_t length) {
+    if (!_index || !data || length == 0) {
+        return false;
+    }
+    
+    // One capture is staged at a time; an earlier one goes out first
+    flush();
+    
+    _staged = (uint8_t*)ps_malloc(length);
+    if (!_staged) {
+        DEBUG_PRINTF("[ARCHIVE] No PSRAM to stage %u bytes\n", length);
+        return false;
+    }
+    memcpy(_staged, data, length);
+    _stagedLength = length;
+    _stagedId = imageId;
+    _stagedTimestamp = timestamp;
+    return true;
+}
+
+void ImageArchive::flush() {
+    if (!_staged) {
+        return;
+    }
+    
+    unsigned long start = millis();
+    if (write(_stagedId, _stagedTimestamp, _staged, _stagedLength)) {
+        DEBUG_PRINTF("[ARCHIVE] Image %d archived: %u bytes in %lu ms (%d held)\n",
+            _stagedId, _stagedLength, millis() - start, _count);
+    }
+    free(_staged);
+    _staged = nullptr;
+}
+
+bool ImageArchive::write(uint16_t imageId, uint32_t timestamp, const uint8_t* data, size_t length) {
+    // Oldest images go until the new one fits
+    while (_count > 0 && (_count >= ARCHIVE_MAX_IMAGES || freeBytes() < length + ARCHIVE_MIN_FREE_BYTES)) {
+        evict(oldestSlot());
+    }
+    if (freeBytes() < length + ARCHIVE_MIN_FREE_BYTES) {
+        DEBUG_PRINTLN("[ARCHIVE] Storage full");
+        return false;
+    }
+    
+    uint16_t slot = 0;
+    while (_index[slot].seq != 0) {
+        slot++;
+    }
+    
+    char path[32];
+    pathFor(_nextSeq, path, sizeof(path));
+    File file = _fs->open(path, FILE_WRITE);
+    if (!file) {
+        DEBUG_PRINTF("[ARCHIVE] Cannot create %s\n", path);
+        return false;
+    }
+    size_t written = file.write(data, length);
+    file.close();
+    if (written != length) {
+        DEBUG_PRINTF("[ARCHIVE] Short write to %s\n", path);
+        _fs->remove(path);
+        return false;
+    }
+    
+    ArchiveEntry& entry = _index[slot];
+    entry.seq = _nextSeq++;
+    entry.timestamp = timestamp;
+    entry.length = length;
+    entry.imageId = imageId;
+    entry.reserved = 0;
+    _count++;
+    _storedCount++;
+    return writeIndex(slot);
+}
+
+bool ImageArchive::writeIndex(uint16_t slot) {
+    File file = _fs->open(INDEX_PATH, "r+");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.seek(slot * sizeof(ArchiveEntry)) &&
+              file.write((const uint8_t*)&_index[slot], sizeof(ArchiveEntry)) == sizeof(ArchiveEntry);
+    file.close();
+    return ok;
+}
+
+void ImageArchive::evict(uint16_t slot) {
+    char path[32];
+    pathFor(_index[slot].seq, path, sizeof(path));
+    _fs->remove(path);
+    
+    memset(&_index[slot], 0, sizeof(ArchiveEntry));
+    writeIndex(slot);
+    _count--;
+    _evictedCount++;
+}
+
+int32_t ImageArchive::oldestSlot() {
+    int32_t oldest = -1;
+    for (uint16_t i = 0; i < ARCHIVE_MAX_IMAGES; i++) {
+        if (_index[i].seq != 0 && (oldest < 0 || _index[i].seq < _index[oldest].seq)) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+uint64_t ImageArchive::freeBytes() {
+    #if ARCHIVE_STORAGE == ARCHIVE_STORAGE_SD
+    return SD_MMC.totalBytes() - SD_MMC.usedBytes();
+    #else
+    return SPIFFS.totalBytes() - SPIFFS.usedBytes();
+    #endif
+}
+
+void ImageArchive::pathFor(uint32_t seq, char* path, size_t size) {
+    snprintf(path, size, "%s/%08lx.jpg", ARCHIVE_DIR, (unsigned long)seq);
+}
+
+bool ImageArchive::find(uint16_t imageId, ArchiveEntry& entry) {
+    // Image IDs restart with the sensor, so the newest match wins
+    int32_t found = -1;
+    for (uint16_t i = 0; _index && i < ARCHIVE_MAX_IMAGES; i++) {
+        if (_index[i].seq != 0 && _index[i].imageId == imageId &&
+            (found < 0 || _index[i].seq > _index[found].seq)) {
+            found = i;
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    entry = _index[found];
+    return true;
+}
+
+bool ImageArchive::findSince(uint32_t timestamp, uint32_t afterSeq, ArchiveEntry& entry) {
+    int32_t found = -1;
+    for (uint16_t i = 0; _index && i < ARCHIVE_MAX_IMAGES; i++) {
+        if (_index[i].seq > afterSeq && _index[i].timestamp >= timestamp &&
+            (found < 0 || _index[i].seq < _index[found].seq)) {
+            found = i;
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    entry = _index[found];
+    return true;
+}
+
+uint8_t* ImageArchive::load(const ArchiveEntry& entry) {
+    char path[32];
+    pathFor(entry.seq, path, sizeof(path));
+    File file = _fs->open(path, FILE_READ);
+    if (!file) {
+        DEBUG_PRINTF("[ARCHIVE] Missing %s\n", path);
+        return nullptr;
+    }
+    
+    uint8_t* data = (uint8_t*)ps_malloc(entry.length);
+    if (data && file.read(data, entry.length) != entry.length) {
+        free(data);
+        data = nullptr;
+    }
+    file.close();
+    return data;
+}
+
+void ImageArchive::requestImage(uint16_t imageId) {
+    if (_pullCount == ARCHIVE_PULL_QUEUE) {
+        DEBUG_PRINTF("[ARCHIVE] Pull queue full, image %d not queued\n", imageId);
+        return;
+    }
+    _pullIds[_pullCount++] = imageId;
+}
+
+void ImageArchive::requestSince(uint32_t timestamp, uint8_t maxImages) {
+    // A new bulk pull replaces one still running
+    _bulkSince = timestamp;
+    _bulkAfterSeq = 0;
+    _bulkLeft = min(maxImages, (uint8_t)ARCHIVE_PULL_MAX);
+    DEBUG_PRINTF("[ARCHIVE] Bulk pull from %lu: up to %d images\n", timestamp, _bulkLeft);
+}
+
+bool ImageArchive::nextPull(ArchiveEntry& entry) {
+    // Single images first: someone is waiting on each of them
+    while (_pullCount > 0) {
+        uint16_t imageId = _pullIds[0];
+        _pullCount--;
+        memmove(_pullIds, _pullIds + 1, _pullCount * sizeof(uint16_t));
+        if (find(imageId, entry)) {
+            _pulledCount++;
+            return true;
+        }
+        DEBUG_PRINTF("[ARCHIVE] Pull for image %d: not archived\n", imageId);
+    }
+    
+    if (_bulkLeft > 0 && findSince(_bulkSince, _bulkAfterSeq, entry)) {
+        _bulkAfterSeq = entry.seq;
+        _bulkLeft--;
+        _pulledCount++;
+        return true;
+    }
+    _bulkLeft = 0;
+    return false;
+}
+
+bool ImageArchive::isIdle() {
+    return !_staged && _pullCount == 0 && _bulkLeft == 0;
+}
+
+uint16_t ImageArchive::count() {
+    return _count;
+}
+
+uint32_t ImageArchive::getStoredCount() {
+    return _storedCount;
+}
+
+uint32_t ImageArchive::getEvictedCount() {
+    return _evictedCount;
+}
+
+uint32_t ImageArchive::getPulledCount() {
+    return _pulledCount;
+}
@@ -0,0 +1,93 @@
+#ifndef IMAGE_ARCHIVE_H
+#define IMAGE_ARCHIVE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+
+// Index record of one archived image (also its layout in the index file)
+struct ArchiveEntry {
+    uint32_t seq;           // Archive order, 0 = free slot
+    uint32_t timestamp;     // Mesh time of the motion event
+    uint32_t length;
+    uint16_t imageId;       // Mesh image taken with it
+    uint16_t reserved;
+};
+
+// High-resolution frames kept on the sensor's own storage (microSD or the
+// flash SPIFFS partition) next to the small image that went over the mesh.
+// Each image is a plain JPEG file; a fixed-size index file, mirrored in
+// PSRAM, maps image IDs and mesh timestamps to them, and the oldest image
+// makes room for a new one. Captures are staged in PSRAM and written from
+// the loop, off the trigger path. The phone pulls images back by image
+// ID, or in bulk from a timestamp on.
+class ImageArchive {
+public:
+    ImageArchive();
+    ~ImageArchive();
+    
+    // Mount storage and load or create the index
+    bool begin();
+    bool isReady();
+    
+    // Keep a copy of a capture until flush() writes it out
+    bool stage(uint16_t imageId, uint32_t timestamp, const uint8_t* data, size_t length);
+    void flush();
+    
+    // Lookups: newest image for an ID, or the next one in archive order
+    // taken at or after a mesh time
+    bool find(uint16_t imageId, ArchiveEntry& entry);
+    bool findSince(uint32_t timestamp, uint32_t afterSeq, ArchiveEntry& entry);
+    
+    // Read an archived image into a new PSRAM buffer (caller frees)
+    uint8_t* load(const ArchiveEntry& entry);
+    
+    // Pulls requested over the mesh; nextPull hands out one at a time
+    void requestImage(uint16_t imageId);
+    void requestSince(uint32_t timestamp, uint8_t maxImages);
+    bool nextPull(ArchiveEntry& entry);
+    
+    // Nothing staged or waiting to be pulled
+    bool isIdle();
+    
+    // Statistics
+    uint16_t count();
+    uint32_t getStoredCount();
+    uint32_t getEvictedCount();
+    uint32_t getPulledCount();
+
+private:
+    bool write(uint16_t imageId, uint32_t timestamp, const uint8_t* data, size_t length);
+    bool writeIndex(uint16_t slot);
+    void evict(uint16_t slot);
+    int32_t oldestSlot();
+    uint64_t freeBytes();
+    void pathFor(uint32_t seq, char* path, size_t size);
+    
+    fs::FS* _fs;
+    ArchiveEntry* _index;       // ARCHIVE_MAX_IMAGES slots, in PSRAM
+    uint32_t _nextSeq;
+    uint16_t _count;
+    
+    // Capture waiting to be written
+    uint8_t* _staged;
+    size_t _stagedLength;
+    uint16_t _stagedId;
+    uint32_t _stagedTimestamp;
+    
+    // Pending pulls
+    uint16_t _pullIds[ARCHIVE_PULL_QUEUE];
+    uint8_t _pullCount;
+    uint32_t _bulkSince;
+    uint32_t _bulkAfterSeq;
+    uint8_t _bulkLeft;
+    
+    uint32_t _storedCount;
+    uint32_t _evictedCount;
+    uint32_t _pulledCount;
+};
+
+// Global instance
+extern ImageArchive imageArchive;
+
+#endif // IMAGE_ARCHIVE_H
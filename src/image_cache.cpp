@@ -0,0 +1,115 @@
+#include "image_cache.h"
+
+// Global instance
+ImageCache imageCache;
+
+ImageCache::ImageCache()
+    : _entries(nullptr)
+    , _storage(nullptr)
+    , _slots(0)
+    , _slotBytes(0)
+    , _fetchCount(0)
+    , _missCount(0)
+    , _evictedCount(0) {
+}
+
+ImageCache::~ImageCache() {
+    if (_storage) {
+        free(_storage);
+    }
+    if (_entries) {
+        free(_entries);
+    }
+}
+
+bool ImageCache::begin(uint8_t slots, size_t slotBytes) {
+    if (_entries) {
+        return true;
+    }
+    
+    if (!psramFound()) {
+        DEBUG_PRINTLN("[IMGCACHE] No PSRAM - full images sent immediately");
+        return false;
+    }
+    
+    _storage = (uint8_t*)ps_malloc(slots * slotBytes);
+    _entries = (CachedImage*)ps_malloc(slots * sizeof(CachedImage));
+    if (!_storage || !_entries) {
+        DEBUG_PRINTLN("[IMGCACHE] Failed to allocate image cache");
+        if (_storage) free(_storage);
+        if (_entries) free(_entries);
+        _storage = nullptr;
+        _entries = nullptr;
+        return false;
+    }
+    
+    memset(_entries, 0, slots * sizeof(CachedImage));
+    for (uint8_t i = 0; i < slots; i++) {
+        _entries[i].data = _storage + i * slotBytes;
+    }
+    _slots = slots;
+    _slotBytes = slotBytes;
+    
+    DEBUG_PRINTF("[IMGCACHE] Image cache ready: %d images x %u bytes\n", slots, slotBytes);
+    return true;
+}
+
+bool ImageCache::isReady() {
+    return _entries != nullptr;
+}
+
+bool ImageCache::store(uint16_t imageId, const uint8_t* data, size_t length, uint32_t timestamp,
+                       const ImageRegion& region) {
+    if (!_entries || length > _slotBytes) {
+        return false;
+    }
+    
+    // Free slot first, otherwise the oldest image
+    CachedImage* slot = nullptr;
+    for (uint8_t i = 0; i < _slots; i++) {
+        CachedImage& candidate = _entries[i];
+        if (!candidate.used) {
+            slot = &candidate;
+            break;
+        }
+        if (!slot || (int32_t)(candidate.storedAt - slot->storedAt) < 0) {
+            slot = &candidate;
+        }
+    }
+    if (slot->used) {
+        DEBUG_PRINTF("[IMGCACHE] Evicting image %d\n", slot->imageId);
+        _evictedCount++;
+    }
+    
+    memcpy(slot->data, data, length);
+    slot->length = length;
+    slot->imageId = imageId;
+    slot->timestamp = timestamp;
+    slot->storedAt = millis();
+    slot->region = region;
+    slot->used = true;
+    return true;
+}
+
+CachedImage* ImageCache::find(uint16_t imageId) {
+    for (uint8_t i = 0; _entries && i < _slots; i++) {
+        if (_entries[i].used && _entries[i].imageId == imageId) {
+            _fetchCount++;
+            return &_entries[i];
+        }
+    }
+    _missCount++;
+    return nullptr;
+}
+
+uint32_t ImageCache::getFetchCount() {
+    return _fetchCount;
+}
+
+uint32_t ImageCache::getMissCount() {
+    return _missCount;
+}
+
+uint32_t ImageCache::getEvictedCount() {
+    return _evictedCount;
+}
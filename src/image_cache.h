@@ -0,0 +1,56 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "message_protocol.h"
+
+// Full image held back while only its thumbnail went out
+struct CachedImage {
+    uint8_t* data;          // Fixed PSRAM region, IMG_CACHE_SLOT_BYTES long
+    size_t length;
+    uint16_t imageId;       // Thumbnail's image ID
+    uint32_t timestamp;     // Mesh time of the motion event
+    uint32_t storedAt;
+    ImageRegion region;     // Crop geometry of the full image
+    bool used;
+};
+
+// Bounded PSRAM store of full-resolution JPEGs awaiting a FETCH_IMAGE
+// command. The oldest image is evicted when a new one needs the room.
+class ImageCache {
+public:
+    ImageCache();
+    ~ImageCache();
+    
+    // Allocate the cache (PSRAM only)
+    bool begin(uint8_t slots, size_t slotBytes);
+    bool isReady();
+    
+    // Keep a copy of a full image
+    bool store(uint16_t imageId, const uint8_t* data, size_t length, uint32_t timestamp,
+               const ImageRegion& region);
+    
+    // Look up an image by its thumbnail's ID
+    CachedImage* find(uint16_t imageId);
+    
+    // Statistics
+    uint32_t getFetchCount();
+    uint32_t getMissCount();
+    uint32_t getEvictedCount();
+
+private:
+    CachedImage* _entries;
+    uint8_t* _storage;
+    uint8_t _slots;
+    size_t _slotBytes;
+    
+    uint32_t _fetchCount;
+    uint32_t _missCount;
+    uint32_t _evictedCount;
+};
+
+// Global instance
+extern ImageCache imageCache;
+
+#endif // IMAGE_CACHE_H
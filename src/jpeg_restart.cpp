@@ -0,0 +1,573 @@
+#include "jpeg_restart.h"
+#include <string.h>
+
+// Baseline allows two tables per class and this tree only sees 1-3 components
+static const uint8_t MAX_COMPONENTS = 3;
+static const uint8_t MAX_TABLES = 2;
+
+// Markers
+static const uint8_t SOI = 0xD8;
+static const uint8_t EOI = 0xD9;
+static const uint8_t SOS = 0xDA;
+static const uint8_t DHT = 0xC4;
+static const uint8_t DRI = 0xDD;
+static const uint8_t RST0 = 0xD0;
+
+// Canonical Huffman table, decode and encode side
+struct HuffTable {
+    bool present;
+    int32_t maxCode[17];        // Largest code of each length, -1 if none
+    int32_t valueOffset[17];    // Code of each length to index in values
+    uint8_t values[256];
+    uint16_t code[256];         // Encode side, by symbol
+    uint8_t size[256];          // 0 = symbol not in the table
+};
+
+struct JpegLayout {
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;
+    uint8_t ids[MAX_COMPONENTS];
+    uint8_t h[MAX_COMPONENTS];
+    uint8_t v[MAX_COMPONENTS];
+    uint8_t dcTable[MAX_COMPONENTS];
+    uint8_t acTable[MAX_COMPONENTS];
+    uint16_t restart;           // Existing restart interval, 0 if none
+    size_t driStart;            // Existing DRI segment (driLength 0 if none)
+    size_t driLength;
+    size_t sosStart;            // SOS marker
+    size_t dataStart;           // First byte of entropy-coded data
+    uint32_t mcus;
+};
+
+static HuffTable dcTables[MAX_TABLES];
+static HuffTable acTables[MAX_TABLES];
+static JpegLayout layout;
+
+static void buildTable(HuffTable& table, const uint8_t* counts, const uint8_t* values, uint16_t total) {
+    memset(table.size, 0, sizeof(table.size));
+    memcpy(table.values, values, total);
+    
+    int32_t code = 0;
+    uint16_t k = 0;
+    for (uint8_t length = 1; length <= 16; length++) {
+        table.valueOffset[length] = k - code;
+        for (uint8_t i = 0; i < counts[length - 1]; i++) {
+            table.code[values[k]] = code;
+            table.size[values[k]] = length;
+            k++;
+            code++;
+        }
+        table.maxCode[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table.present = true;
+}
+
+// Walk the headers up to the start of the scan
+static bool parseHeaders(const uint8_t* jpeg, size_t length) {
+    memset(&layout, 0, sizeof(layout));
+    dcTables[0].present = dcTables[1].present = false;
+    acTables[0].present = acTables[1].present = false;
+    
+    if (length < 4 || jpeg[0] != 0xFF || jpeg[1] != SOI) {
+        return false;
+    }
+    
+    size_t pos = 2;
+    while (pos + 4 <= length) {
+        if (jpeg[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = jpeg[pos + 1];
+        if (marker == 0xFF) {
+            pos++;  // Fill byte
+            continue;
+        }
+        uint16_t segment = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if (segment < 2 || pos + 2 + segment > length) {
+            return false;
+        }
+        const uint8_t* data = jpeg + pos + 4;
+        uint16_t dataLength = segment - 2;
+        
+        if (marker == 0xC0 || marker == 0xC1) {
+            // Baseline or extended sequential Huffman, 8-bit
+            if (dataLength < 6 || data[0] != 8) {
+                return false;
+            }
+            layout.height = (data[1] << 8) | data[2];
+            layout.width = (data[3] << 8) | data[4];
+            layout.components = data[5];
+            if (layout.width == 0 || layout.height == 0 || layout.components == 0 ||
+                layout.components > MAX_COMPONENTS || dataLength < 6 + 3 * layout.components) {
+                return false;
+            }
+            for (uint8_t c = 0; c < layout.components; c++) {
+                layout.ids[c] = data[6 + 3 * c];
+                layout.h[c] = data[7 + 3 * c] >> 4;
+                layout.v[c] = data[7 + 3 * c] & 0x0F;
+                if (layout.h[c] < 1 || layout.h[c] > 2 || layout.v[c] < 1 || layout.v[c] > 2) {
+                    return false;
+                }
+            }
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != DHT && marker != 0xC8 && marker != 0xCC) {
+            // Progressive, lossless and arithmetic coding are not handled
+            return false;
+        } else if (marker == DHT) {
+            uint16_t i = 0;
+            while (i + 17 <= dataLength) {
+                uint8_t tableClass = data[i] >> 4;
+                uint8_t tableId = data[i] & 0x0F;
+                if (tableClass > 1 || tableId >= MAX_TABLES) {
+                    return false;
+                }
+                uint16_t total = 0;
+                for (uint8_t n = 0; n < 16; n++) {
+                    total += data[i + 1 + n];
+                }
+                if (total > 256 || i + 17 + total > dataLength) {
+                    return false;
+                }
+                buildTable(tableClass ? acTables[tableId] : dcTables[tableId], data + i + 1, data + i + 17, total);
+                i += 17 + total;
+            }
+        } else if (marker == DRI) {
+            if (dataLength < 2) {
+                return false;
+            }
+            layout.restart = (data[0] << 8) | data[1];
+            layout.driStart = pos;
+            layout.driLength = 2 + segment;
+        } else if (marker == SOS) {
+            // A single interleaved scan holding every component
+            if (layout.components == 0 || dataLength < 1 + 2 * layout.components || data[0] != layout.components) {
+                return false;
+            }
+            for (uint8_t s = 0; s < layout.components; s++) {
+                if (data[1 + 2 * s] != layout.ids[s]) {
+                    return false;
+                }
+                layout.dcTable[s] = data[2 + 2 * s] >> 4;
+                layout.acTable[s] = data[2 + 2 * s] & 0x0F;
+                if (layout.dcTable[s] >= MAX_TABLES || layout.acTable[s] >= MAX_TABLES ||
+                    !dcTables[layout.dcTable[s]].present || !acTables[layout.acTable[s]].present) {
+                    return false;
+                }
+            }
+            
+            uint8_t hMax = 1;
+            uint8_t vMax = 1;
+            for (uint8_t c = 0; c < layout.components; c++) {
+                hMax = layout.h[c] > hMax ? layout.h[c] : hMax;
+                vMax = layout.v[c] > vMax ? layout.v[c] : vMax;
+            }
+            if (layout.components == 1) {
+                // A lone component is not interleaved: one block per MCU
+                layout.h[0] = layout.v[0] = hMax = vMax = 1;
+            }
+            uint32_t mcusX = (layout.width + 8 * hMax - 1) / (8 * hMax);
+            uint32_t mcusY = (layout.height + 8 * vMax - 1) / (8 * vMax);
+            layout.mcus = mcusX * mcusY;
+            layout.sosStart = pos;
+            layout.dataStart = pos + 2 + segment;
+            return true;
+        } else if (marker == SOI || marker == EOI || (marker >= RST0 && marker <= RST0 + 7)) {
+            return false;
+        }
+        pos += 2 + segment;
+    }
+    return false;
+}
+
+// Entropy-coded data reader; stops at the next marker and reads zeros past it
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t pos, size_t end)
+        : _data(data), _pos(pos), _end(end), _acc(0), _bits(0), _atMarker(false) {}
+    
+    uint32_t bits(uint8_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        fill();
+        _bits -= count;
+        return (_acc >> _bits) & ((1u << count) - 1);
+    }
+    
+    // Symbol from a table, -1 on a bad code
+    int16_t decode(const HuffTable& table) {
+        int32_t code = bits(1);
+        uint8_t length = 1;
+        while (code > table.maxCode[length]) {
+            if (++length > 16) {
+                return -1;
+            }
+            code = (code << 1) | bits(1);
+        }
+        return table.values[table.valueOffset[length] + code];
+    }
+    
+    // Drop the interval's padding bits and step over its restart marker
+    bool restart() {
+        _acc = 0;
+        _bits = 0;
+        while (_pos < _end && _data[_pos] == 0xFF && _pos + 1 < _end && _data[_pos + 1] == 0xFF) {
+            _pos++;
+        }
+        if (_pos + 1 >= _end || _data[_pos] != 0xFF || (_data[_pos + 1] & 0xF8) != RST0) {
+            return false;
+        }
+        _pos += 2;
+        _atMarker = false;
+        return true;
+    }
+
+private:
+    void fill() {
+        while (_bits <= 24) {
+            uint8_t byte = 0;
+            if (!_atMarker && _pos < _end) {
+                byte = _data[_pos];
+                if (byte == 0xFF) {
+                    if (_pos + 1 < _end && _data[_pos + 1] == 0x00) {
+                        _pos += 2;
+                    } else {
+                        _atMarker = true;
+                        byte = 0;
+                    }
+                } else {
+                    _pos++;
+                }
+            }
+            _acc = (_acc << 8) | byte;
+            _bits += 8;
+        }
+    }
+    
+    const uint8_t* _data;
+    size_t _pos;
+    size_t _end;
+    uint32_t _acc;
+    int8_t _bits;
+    bool _atMarker;
+};
+
+// Entropy-coded data writer with 0xFF byte stuffing
+class BitWriter {
+public:
+    BitWriter(uint8_t* out, size_t pos, size_t capacity)
+        : _out(out), _pos(pos), _capacity(capacity), _acc(0), _bits(0), _overflow(false) {}
+    
+    void put(uint32_t value, uint8_t count) {
+        if (count == 0) {
+            return;
+        }
+        _acc = (_acc << count) | (value & ((1u << count) - 1));
+        _bits += count;
+        while (_bits >= 8) {
+            _bits -= 8;
+            uint8_t byte = _acc >> _bits;
+            raw(byte);
+            if (byte == 0xFF) {
+                raw(0x00);
+            }
+        }
+        _acc &= (1u << _bits) - 1;
+    }
+    
+    bool putSymbol(const HuffTable& table, uint8_t symbol) {
+        if (table.size[symbol] == 0) {
+            return false;
+        }
+        put(table.code[symbol], table.size[symbol]);
+        return true;
+    }
+    
+    // Pad the last byte with ones, as an interval ends
+    void flush() {
+        if (_bits > 0) {
+            put(0xFF, 8 - _bits);
+        }
+    }
+    
+    void marker(uint8_t code) {
+        raw(0xFF);
+        raw(code);
+    }
+    
+    void copy(const uint8_t* data, size_t length) {
+        if (_pos + length > _capacity) {
+            _overflow = true;
+            return;
+        }
+        memcpy(_out + _pos, data, length);
+        _pos += length;
+    }
+    
+    size_t position() { return _pos; }
+    void advance(size_t bytes) { _pos += bytes; }
+    bool overflow() { return _overflow; }
+
+private:
+    void raw(uint8_t byte) {
+        if (_pos < _capacity) {
+            _out[_pos++] = byte;
+        } else {
+            _overflow = true;
+        }
+    }
+    
+    uint8_t* _out;
+    size_t _pos;
+    size_t _capacity;
+    uint32_t _acc;
+    int8_t _bits;
+    bool _overflow;
+};
+
+// DC difference or AC value as a magnitude category and its extra bits
+static uint8_t category(int32_t value) {
+    uint32_t magnitude = value < 0 ? -value : value;
+    uint8_t bits = 0;
+    while (magnitude) {
+        bits++;
+        magnitude >>= 1;
+    }
+    return bits;
+}
+
+static int32_t extend(uint32_t bits, uint8_t size) {
+    return (size && bits < (1u << (size - 1))) ? (int32_t)bits - (1 << size) + 1 : (int32_t)bits;
+}
+
+// Headers with the restart interval set to the one given
+static void writeHeaders(const uint8_t* jpeg, BitWriter& writer, uint16_t interval) {
+    if (layout.driLength) {
+        writer.copy(jpeg, layout.driStart);
+        writer.copy(jpeg + layout.driStart + layout.driLength,
+                    layout.sosStart - layout.driStart - layout.driLength);
+    } else {
+        writer.copy(jpeg, layout.sosStart);
+    }
+    uint8_t dri[6] = { 0xFF, DRI, 0x00, 0x04, (uint8_t)(interval >> 8), (uint8_t)interval };
+    writer.copy(dri, sizeof(dri));
+    writer.copy(jpeg + layout.sosStart, layout.dataStart - layout.sosStart);
+}
+
+// Interval i > 0 opens with RST((i - 1) mod 8)
+static uint8_t restartMarker(uint32_t interval) {
+    return RST0 + ((interval - 1) & 7);
+}
+
+size_t JpegRestart::rewrite(const uint8_t* jpeg, size_t length, uint8_t* out, size_t capacity,
+                            uint16_t interval, size_t chunkSize, size_t maxPad) {
+    if (interval == 0 || !parseHeaders(jpeg, length)) {
+        return 0;
+    }
+    
+    BitWriter writer(out, 0, capacity);
+    writeHeaders(jpeg, writer, interval);
+    
+    BitReader reader(jpeg, layout.dataStart, length);
+    int32_t inPredictor[MAX_COMPONENTS] = {0};
+    int32_t outPredictor[MAX_COMPONENTS] = {0};
+    size_t intervalStart = writer.position();
+    
+    for (uint32_t mcu = 0; mcu < layout.mcus; mcu++) {
+        if (mcu > 0 && layout.restart && mcu % layout.restart == 0) {
+            if (!reader.restart()) {
+                return 0;
+            }
+            memset(inPredictor, 0, sizeof(inPredictor));
+        }
+        if (mcu > 0 && mcu % interval == 0) {
+            intervalStart = writer.position();
+            writer.marker(restartMarker(mcu / interval));
+            memset(outPredictor, 0, sizeof(outPredictor));
+        }
+        
+        for (uint8_t c = 0; c < layout.components; c++) {
+            const HuffTable& dc = dcTables[layout.dcTable[c]];
+            const HuffTable& ac = acTables[layout.acTable[c]];
+            for (uint8_t block = 0; block < layout.h[c] * layout.v[c]; block++) {
+                // DC: recode against this interval's predictor
+                int16_t size = reader.decode(dc);
+                if (size < 0 || size > 11) {
+                    return 0;
+                }
+                inPredictor[c] += extend(reader.bits(size), size);
+                int32_t diff = inPredictor[c] - outPredictor[c];
+                outPredictor[c] = inPredictor[c];
+                uint8_t diffSize = category(diff);
+                if (!writer.putSymbol(dc, diffSize)) {
+                    return 0;
+                }
+                writer.put(diff < 0 ? diff - 1 : diff, diffSize);
+                
+                // AC: symbols and extra bits pass through unchanged
+                for (uint8_t k = 1; k < 64; k++) {
+                    int16_t symbol = reader.decode(ac);
+                    if (symbol < 0) {
+                        return 0;
+                    }
+                    writer.putSymbol(ac, symbol);
+                    uint8_t run = symbol >> 4;
+                    uint8_t bits = symbol & 0x0F;
+                    if (bits == 0) {
+                        if (run != 15) {
+                            break;  // End of block
+                        }
+                        k += 15;
+                    } else {
+                        k += run;
+                        writer.put(reader.bits(bits), bits);
+                    }
+                    if (k > 63) {
+                        return 0;
+                    }
+                }
+            }
+        }
+        
+        if ((mcu + 1) % interval == 0 || mcu + 1 == layout.mcus) {
+            writer.flush();
+            
+            // An interval straddling a chunk boundary moves onto it when the
+            // fill costs little, so one lost chunk spoils fewer intervals
+            size_t end = writer.position();
+            size_t boundary = (intervalStart / chunkSize + 1) * chunkSize;
+            size_t pad = boundary - intervalStart;
+            if (mcu >= interval && end > boundary && pad <= maxPad && end + pad <= capacity) {
+                memmove(out + intervalStart + pad, out + intervalStart, end - intervalStart);
+                memset(out + intervalStart, 0xFF, pad);
+                writer.advance(pad);
+            }
+        }
+    }
+    
+    writer.marker(EOI);
+    return writer.overflow() ? 0 : writer.position();
+}
+
+// Every byte of [start, end) arrived
+static bool receivedRange(const uint8_t* chunkMap, size_t chunkSize, size_t start, size_t end) {
+    for (size_t chunk = start / chunkSize; chunk * chunkSize < end; chunk++) {
+        if (!(chunkMap[chunk / 8] & (1 << (chunk % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An interval of flat mid-grey: every block DC 0 with no AC terms
+static bool writeGrey(BitWriter& writer, uint32_t interval, uint16_t restart) {
+    if (interval > 0) {
+        writer.marker(restartMarker(interval));
+    }
+    uint32_t mcus = layout.mcus - interval * restart;
+    mcus = mcus < restart ? mcus : restart;
+    for (uint32_t mcu = 0; mcu < mcus; mcu++) {
+        for (uint8_t c = 0; c < layout.components; c++) {
+            for (uint8_t block = 0; block < layout.h[c] * layout.v[c]; block++) {
+                if (!writer.putSymbol(dcTables[layout.dcTable[c]], 0) ||
+                    !writer.putSymbol(acTables[layout.acTable[c]], 0x00)) {
+                    return false;
+                }
+            }
+        }
+    }
+    writer.flush();
+    return true;
+}
+
+size_t JpegRestart::salvage(const uint8_t* jpeg, size_t length, const uint8_t* chunkMap, size_t chunkSize,
+                            uint8_t* out, size_t capacity, uint16_t& lostIntervals, uint16_t& totalIntervals) {
+    lostIntervals = 0;
+    totalIntervals = 0;
+    
+    // Headers must have arrived whole before they can even be parsed
+    size_t headerEnd = 0;
+    while (headerEnd < length && receivedRange(chunkMap, chunkSize, headerEnd, headerEnd + 1)) {
+        headerEnd += chunkSize;
+    }
+    if (!parseHeaders(jpeg, headerEnd < length ? headerEnd : length) || layout.restart == 0) {
+        return 0;
+    }
+    
+    uint16_t restart = layout.restart;
+    uint32_t intervals = (layout.mcus + restart - 1) / restart;
+    totalIntervals = intervals;
+    
+    BitWriter writer(out, 0, capacity);
+    writer.copy(jpeg, layout.dataStart);
+    
+    // Intervals are located by their markers. Across a loss the marker
+    // number only gives the index mod 8, so the bytes skipped pick the
+    // nearest candidate, at the image's average bytes per interval.
+    size_t averageBytes = (length - layout.dataStart) / intervals + 1;
+    uint32_t next = 0;          // Next interval to write
+    uint32_t index = 0;         // Interval starting at start
+    size_t start = layout.dataStart;
+    
+    for (size_t pos = layout.dataStart; pos + 1 < length && next < intervals; pos++) {
+        uint8_t code = jpeg[pos + 1];
+        if (jpeg[pos] != 0xFF || !((code & 0xF8) == RST0 || code == EOI) ||
+            !receivedRange(chunkMap, chunkSize, pos, pos + 2)) {
+            continue;
+        }
+        
+        // Data runs up to the marker, less any fill bytes before it
+        size_t end = pos;
+        while (end > start && jpeg[end - 1] == 0xFF) {
+            end--;
+        }
+        bool whole = receivedRange(chunkMap, chunkSize, start, pos);
+        if (whole && index >= next) {
+            while (next < index) {
+                if (!writeGrey(writer, next++, restart)) {
+                    return 0;
+                }
+                lostIntervals++;
+            }
+            if (index > 0) {
+                writer.marker(restartMarker(index));
+            }
+            writer.copy(jpeg + start, end - start);
+            next = index + 1;
+        }
+        if (code == EOI) {
+            break;
+        }
+        
+        // Index of the interval after this marker
+        uint32_t following = (code - RST0) + 1;
+        if (whole && ((index + 1 - following) & 7) == 0) {
+            following = index + 1;
+        } else {
+            uint32_t expected = index + (pos + 2 - start) / averageBytes;
+            while (following + 8 <= expected + 4) {
+                following += 8;
+            }
+            while (following <= index || following < next) {
+                following += 8;
+            }
+        }
+        if (following >= intervals) {
+            break;
+        }
+        index = following;
+        start = pos + 2;
+        pos++;
+    }
+    
+    while (next < intervals) {
+        if (!writeGrey(writer, next++, restart)) {
+            return 0;
+        }
+        lostIntervals++;
+    }
+    
+    writer.marker(EOI);
+    return writer.overflow() ? 0 : writer.position();
+}
@@ -0,0 +1,32 @@
+#ifndef JPEG_RESTART_H
+#define JPEG_RESTART_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Restart intervals for lossy image transfers. The sensor rewrites each
+// baseline JPEG so a restart marker follows every few MCUs, pushing a
+// marker onto the next chunk boundary with fill bytes when that is cheap.
+// The entropy data is decoded to Huffman symbols and coded again with the
+// image's own tables, so no pixel changes. An interval can then be
+// decoded on its own, and the gateway can rebuild an image that lost
+// chunks with the damaged intervals coded as flat grey.
+// No Arduino dependencies, so it builds and runs on a host as well; it
+// uses static tables, so it is not reentrant.
+class JpegRestart {
+public:
+    // Rewrite with a restart marker every interval MCUs (an existing
+    // interval is replaced). Returns the new length, 0 if the image is not
+    // baseline Huffman or does not fit capacity.
+    static size_t rewrite(const uint8_t* jpeg, size_t length, uint8_t* out, size_t capacity,
+                          uint16_t interval, size_t chunkSize, size_t maxPad);
+    
+    // Rebuild an image from the chunks marked in chunkMap (one bit per
+    // chunkSize bytes; the others may hold anything). Intervals not
+    // received whole are replaced with grey. Returns the new length, 0 if
+    // the headers were lost or the image has no restart interval.
+    static size_t salvage(const uint8_t* jpeg, size_t length, const uint8_t* chunkMap, size_t chunkSize,
+                          uint8_t* out, size_t capacity, uint16_t& lostIntervals, uint16_t& totalIntervals);
+};
+
+#endif // JPEG_RESTART_H
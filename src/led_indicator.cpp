@@ -6,14 +6,13 @@ LedIndicator ledIndicator;
 LedIndicator::LedIndicator()
     : _currentPattern(LedPattern::OFF)
     , _ledState(false)
-    , _lastUpdate(0)
     , _brightness(255)
+    , _patternStep(0)
     , _flashing(false)
-    , _flashCount(0)
     , _flashRemaining(0)
     , _flashOnTime(50)
-    , _flashOffTime(50)
-    , _flashStart(0) {
+    , _flashOffTime(50) {
+    TimerWheel::bind(_timer, onTimer, this);
 }
 
 void LedIndicator::begin() {
@@ -33,11 +32,13 @@ void LedIndicator::begin() {
 void LedIndicator::setPattern(LedPattern pattern) {
     if (_currentPattern != pattern) {
         _currentPattern = pattern;
-        _lastUpdate = millis();
         _ledState = false;
+        _patternStep = 0;
         
         // Cancel any ongoing flash sequence when pattern changes
         _flashing = false;
+        timerWheel.cancel(_timer);
+        step();
         
         DEBUG_PRINTF("[LED] Pattern set to %d\n", (int)pattern);
     }
@@ -47,29 +48,32 @@ LedPattern LedIndicator::getPattern() {
     return _currentPattern;
 }
 
-void LedIndicator::update() {
-    unsigned long currentTime = millis();
-    
+void LedIndicator::onTimer(void* context) {
+    static_cast<LedIndicator*>(context)->step();
+}
+
+void LedIndicator::step() {
     // Handle flash sequence first
     if (_flashing) {
-        unsigned long elapsed = currentTime - _flashStart;
-        int cycleDuration = _flashOnTime + _flashOffTime;
-        int cyclePosition = elapsed % cycleDuration;
-        
-        // Determine if LED should be on or off in current cycle
-        bool shouldBeOn = (cyclePosition < _flashOnTime);
-        setLedState(shouldBeOn);
+        if (!_ledState) {
+            setLedState(true);
+            timerWheel.arm(_timer, _flashOnTime);
+            return;
+        }
         
-        // Check if flash sequence is complete
-        int completedCycles = elapsed / cycleDuration;
-        if (completedCycles >= _flashCount) {
-            _flashing = false;
-            setPattern(LedPattern::OFF);
+        setLedState(false);
+        if (--_flashRemaining > 0) {
+            timerWheel.arm(_timer, _flashOffTime);
+            return;
         }
+        
+        // Flash sequence complete
+        _flashing = false;
+        setPattern(LedPattern::OFF);
         return;
     }
     
-    // Handle patterns
+    // Handle patterns; each re-arms the timer for its next edge
     switch (_currentPattern) {
         case LedPattern::OFF:
             setLedState(false);
@@ -80,54 +84,39 @@ void LedIndicator::update() {
             break;
             
         case LedPattern::BLINK_SLOW:
-            if (currentTime - _lastUpdate >= SLOW_BLINK_PERIOD / 2) {
-                _ledState = !_ledState;
-                setLedState(_ledState);
-                _lastUpdate = currentTime;
-            }
+            setLedState(!_ledState);
+            timerWheel.arm(_timer, SLOW_BLINK_PERIOD / 2);
             break;
             
         case LedPattern::BLINK_FAST:
-            if (currentTime - _lastUpdate >= FAST_BLINK_PERIOD / 2) {
-                _ledState = !_ledState;
-                setLedState(_ledState);
-                _lastUpdate = currentTime;
-            }
+            setLedState(!_ledState);
+            timerWheel.arm(_timer, FAST_BLINK_PERIOD / 2);
             break;
             
         case LedPattern::BLINK_MOTION:
-            if (currentTime - _lastUpdate >= MOTION_BLINK_PERIOD / 2) {
-                _ledState = !_ledState;
-                setLedState(_ledState);
-                _lastUpdate = currentTime;
-            }
+            setLedState(!_ledState);
+            timerWheel.arm(_timer, MOTION_BLINK_PERIOD / 2);
             break;
             
         case LedPattern::BLINK_TRANSMIT:
-            if (currentTime - _lastUpdate >= TRANSMIT_BLINK_PERIOD / 2) {
-                _ledState = !_ledState;
-                setLedState(_ledState);
-                _lastUpdate = currentTime;
-            }
+            setLedState(!_ledState);
+            timerWheel.arm(_timer, TRANSMIT_BLINK_PERIOD / 2);
             break;
             
         case LedPattern::BLINK_ERROR: {
             // SOS pattern: ... --- ...
             static const int SOS_PATTERN[] = {1,0,1,0,1,0,0,0, 1,1,1,0,1,1,1,0,1,1,1,0,0,0, 1,0,1,0,1,0,0,0,0,0};
             static const int SOS_LENGTH = sizeof(SOS_PATTERN) / sizeof(SOS_PATTERN[0]);
-            static int sosIndex = 0;
             
-            if (currentTime - _lastUpdate >= 150) {
-                setLedState(SOS_PATTERN[sosIndex] == 1);
-                sosIndex = (sosIndex + 1) % SOS_LENGTH;
-                _lastUpdate = currentTime;
-            }
+            setLedState(SOS_PATTERN[_patternStep] == 1);
+            _patternStep = (_patternStep + 1) % SOS_LENGTH;
+            timerWheel.arm(_timer, SOS_STEP);
             break;
         }
             
         case LedPattern::PULSE: {
             // Smooth breathing effect using sine wave
-            float phase = (float)(currentTime % PULSE_PERIOD) / PULSE_PERIOD;
+            float phase = (float)(millis() % PULSE_PERIOD) / PULSE_PERIOD;
             float brightness = (sin(phase * 2 * PI - PI/2) + 1) / 2;  // 0 to 1
             uint8_t pwmValue = (uint8_t)(brightness * _brightness);
             
@@ -135,6 +124,7 @@ void LedIndicator::update() {
                 pwmValue = 255 - pwmValue;
             }
             ledcWrite(0, pwmValue);
+            timerWheel.arm(_timer, PULSE_STEP);
             break;
         }
     }
@@ -142,11 +132,18 @@ void LedIndicator::update() {
 
 void LedIndicator::flash(int count, int onTime, int offTime) {
     _flashing = true;
-    _flashCount = count;
     _flashRemaining = count;
     _flashOnTime = onTime;
     _flashOffTime = offTime;
-    _flashStart = millis();
+    
+    // Start with the LED off so the first step turns it on
+    setLedState(false);
+    timerWheel.cancel(_timer);
+    if (count > 0) {
+        step();
+    } else {
+        _flashing = false;
+    }
     
     DEBUG_PRINTF("[LED] Flash sequence: %d times\n", count);
 }
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "timer_wheel.h"
 
 // LED patterns enumeration
 enum class LedPattern {
@@ -29,9 +30,6 @@ public:
     // Get current pattern
     LedPattern getPattern();
     
-    // Update LED state (call in loop)
-    void update();
-    
     // Quick flash for events (non-blocking)
     void flash(int count = 3, int onTime = 50, int offTime = 50);
     
@@ -46,18 +44,21 @@ public:
 private:
     void setLedState(bool state);
     
+    // Advance the flash sequence or pattern by one step (timer driven)
+    static void onTimer(void* context);
+    void step();
+    
     LedPattern _currentPattern;
     bool _ledState;
-    unsigned long _lastUpdate;
     uint8_t _brightness;
+    Timer _timer;
+    uint8_t _patternStep;
     
     // For flash sequence
     bool _flashing;
-    int _flashCount;
     int _flashRemaining;
     int _flashOnTime;
     int _flashOffTime;
-    unsigned long _flashStart;
     
     // Pattern timing
     static const int SLOW_BLINK_PERIOD = 1000;
@@ -65,6 +66,8 @@ private:
     static const int MOTION_BLINK_PERIOD = 100;
     static const int TRANSMIT_BLINK_PERIOD = 50;
     static const int PULSE_PERIOD = 2000;
+    static const int PULSE_STEP = 20;
+    static const int SOS_STEP = 150;
 };
 
 // Global instance
@@ -0,0 +1,84 @@
+#include "live_view.h"
+
+// Global instance
+LiveView liveView;
+
+LiveView::LiveView()
+    : _active(false)
+    , _frameDue(false)
+    , _intervalMs(LIVE_MIN_INTERVAL_MS)
+    , _framesSent(0)
+    , _framesFailed(0) {
+    TimerWheel::bind(_leaseTimer, onLeaseTimer, this);
+    TimerWheel::bind(_frameTimer, onFrameTimer, this);
+}
+
+void LiveView::start(uint16_t leaseMs) {
+    if (!_active) {
+        DEBUG_PRINTF("[LIVE] Live view started (lease %d ms)\n", leaseMs);
+        _active = true;
+        _frameDue = true;
+        _intervalMs = LIVE_MIN_INTERVAL_MS;
+    }
+    timerWheel.arm(_leaseTimer, leaseMs);
+}
+
+void LiveView::stop() {
+    if (!_active) {
+        return;
+    }
+    
+    timerWheel.cancel(_leaseTimer);
+    timerWheel.cancel(_frameTimer);
+    _active = false;
+    _frameDue = false;
+    DEBUG_PRINTF("[LIVE] Live view stopped: %lu frames sent, %lu failed\n",
+        _framesSent, _framesFailed);
+}
+
+bool LiveView::isActive() {
+    return _active;
+}
+
+bool LiveView::frameDue() {
+    return _active && _frameDue;
+}
+
+void LiveView::noteFrame(bool delivered) {
+    // Back off quickly when the mesh cannot keep up, recover gradually
+    if (delivered) {
+        _framesSent++;
+        _intervalMs = max((uint16_t)LIVE_MIN_INTERVAL_MS, (uint16_t)(_intervalMs * 3 / 4));
+    } else {
+        _framesFailed++;
+        _intervalMs = min((uint16_t)LIVE_MAX_INTERVAL_MS, (uint16_t)(_intervalMs * 2));
+    }
+    
+    // The next frame is captured only once this interval has passed
+    _frameDue = false;
+    if (_active) {
+        timerWheel.arm(_frameTimer, _intervalMs);
+    }
+}
+
+uint16_t LiveView::getIntervalMs() {
+    return _intervalMs;
+}
+
+uint32_t LiveView::getFramesSent() {
+    return _framesSent;
+}
+
+uint32_t LiveView::getFramesFailed() {
+    return _framesFailed;
+}
+
+void LiveView::onLeaseTimer(void* context) {
+    // The gateway stopped renewing: the phone is gone or lost interest
+    DEBUG_PRINTLN("[LIVE] Lease expired");
+    static_cast<LiveView*>(context)->stop();
+}
+
+void LiveView::onFrameTimer(void* context) {
+    static_cast<LiveView*>(context)->_frameDue = true;
+}
@@ -0,0 +1,49 @@
+#ifndef LIVE_VIEW_H
+#define LIVE_VIEW_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+// Sensor side of live view: a lease the gateway keeps renewing while the
+// phone watches, and the pacing of frames sent under it. Each frame is
+// captured only when the previous one has gone out, so nothing stale
+// ever waits behind a fresh frame; failed sends stretch the interval.
+class LiveView {
+public:
+    LiveView();
+    
+    // Start, or renew the lease of, a running live view
+    void start(uint16_t leaseMs);
+    void stop();
+    bool isActive();
+    
+    // Active and the pacing interval is up
+    bool frameDue();
+    
+    // Outcome of one frame: adapts the interval to what the mesh carries
+    void noteFrame(bool delivered);
+    
+    // Statistics
+    uint16_t getIntervalMs();
+    uint32_t getFramesSent();
+    uint32_t getFramesFailed();
+
+private:
+    static void onLeaseTimer(void* context);
+    static void onFrameTimer(void* context);
+    
+    Timer _leaseTimer;
+    Timer _frameTimer;      // Next frame is due (wakes the loop)
+    bool _active;
+    bool _frameDue;
+    uint16_t _intervalMs;
+    
+    uint32_t _framesSent;
+    uint32_t _framesFailed;
+};
+
+// Global instance
+extern LiveView liveView;
+
+#endif // LIVE_VIEW_H
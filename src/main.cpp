@@ -17,9 +17,23 @@
 #include "config.h"
 #include "pir_sensor.h"
 #include "camera.h"
+#include "duplicate_filter.h"
+#include "frame_queue.h"
+#include "frame_ring.h"
+#include "image_cache.h"
+#include "image_archive.h"
+#include "deep_sleep.h"
+#include "live_view.h"
+#include "timelapse.h"
 #include "led_indicator.h"
 #include "mesh_network.h"
+#include "mesh_clock.h"
 #include "message_protocol.h"
+#include "motion_verifier.h"
+#include "animal_classifier.h"
+#include "quality_control.h"
+#include "roi_crop.h"
+#include "timer_wheel.h"
 
 #if DEVICE_ROLE == ROLE_GATEWAY
 #include "ble_gateway.h"
@@ -29,39 +43,805 @@
 // Global State
 // ============================================================================
 
-static uint16_t imageCounter = 0;
-static bool motionPending = false;
-static uint32_t motionTimestamp = 0;
+// Kept across deep sleep so image IDs do not restart on each wake
+RTC_DATA_ATTR static uint16_t imageCounter = 0;  // Stays below IMAGE_ID_FULL
+
+// Motion events waiting for the capture stage
+struct MotionEvent {
+    uint32_t timestamp;     // Mesh time of the trigger
+    bool forced;            // Asked for from the phone, not sensed
+    uint32_t triggerMicros; // micros() of the PIR edge, for frame freshness
+};
+static MotionEvent motionEvents[MOTION_EVENT_QUEUE];
+static uint8_t motionHead = 0;
+static uint8_t motionCount = 0;
+static uint32_t motionDropped = 0;
+static bool eventForced = false;     // Event being captured skips veto and dedup
+static uint8_t eventConfidence = CONFIDENCE_UNKNOWN;  // Classifier score of its trigger frame
+
+// Mesh commands handed from the ESP-NOW receive task to the loop
+struct PendingCommand {
+    uint32_t receivedMicros; // Capture requests count their latency from here
+    uint8_t length;
+    uint8_t payload[16];    // Command type and its arguments
+};
+static_assert(sizeof(ArchivePullPayload) <= sizeof(PendingCommand::payload), "Largest command must fit the ring");
+static PendingCommand commands[MESH_COMMAND_QUEUE];
+static uint8_t commandHead = 0;
+static uint8_t commandCount = 0;
+static portMUX_TYPE commandLock = portMUX_INITIALIZER_UNLOCKED;
+
+static_assert(VERIFY_THUMB_WIDTH == CLASSIFIER_WIDTH && VERIFY_THUMB_HEIGHT == CLASSIFIER_HEIGHT,
+              "Classifier input must match the verification thumbnail");
+
+// Burst clip still being captured; frame n goes out as burstImageId + n
+static uint16_t burstImageId = 0;
+static uint8_t burstFrames = 0;      // Frames planned (0 = no burst running)
+static uint8_t burstCaptured = 0;
+static uint32_t burstTimestamp = 0;
+static unsigned long burstNextAt = 0;
 
 // ============================================================================
 // Callback Functions
 // ============================================================================
 
+/**
+ * Mesh time of an earlier micros() reading
+ */
+static uint32_t meshTimeAt(uint32_t atMicros) {
+    return meshClock.now() - (micros() - atMicros) / 1000;
+}
+
+/**
+ * Queue a motion event for the capture stage; if it is backed up, the
+ * oldest event gives way. The event is stamped with the time of the
+ * PIR edge, not the time the loop got to it.
+ */
+static void queueMotionEvent(bool forced, uint32_t triggerMicros) {
+    uint32_t timestamp = meshTimeAt(triggerMicros);
+    if (motionCount == MOTION_EVENT_QUEUE) {
+        motionHead = (motionHead + 1) % MOTION_EVENT_QUEUE;
+        motionCount--;
+        motionDropped++;
+        DEBUG_PRINTF("[MAIN] Motion queue full - dropped oldest event (%lu total)\n", motionDropped);
+    }
+    MotionEvent& event = motionEvents[(motionHead + motionCount) % MOTION_EVENT_QUEUE];
+    event.timestamp = timestamp;
+    event.forced = forced;
+    event.triggerMicros = triggerMicros;
+    motionCount++;
+    
+    DEBUG_PRINTF("[MAIN] Motion timestamp: %lu\n", timestamp);
+}
+
 /**
  * Called when PIR sensor detects motion
  */
 void onMotionDetected() {
     DEBUG_PRINTLN("[MAIN] ===== MOTION DETECTED via PIR sensor! =====");
     
+    // Start bringing the sensor out of standby before anything else
+    camera.wake();
+    
     // Flash LED to indicate motion
     ledIndicator.flash(3, 100, 100);
     
-    // Set flag for main loop to handle
-    motionPending = true;
-    motionTimestamp = millis();
+    queueMotionEvent(false, pirSensor.getLastTriggerMicros());
+}
+
+/**
+ * Called when the PIR output has gone quiet after a motion episode
+ */
+void onMotionEpisode(const MotionEpisode& episode) {
+    DEBUG_PRINTF("[MAIN] Motion episode %lu-%lu (mesh time), %d edges\n",
+        meshTimeAt(episode.startMicros), meshTimeAt(episode.endMicros), episode.edges);
+}
+
+/**
+ * Reserve consecutive image IDs
+ */
+static uint16_t reserveImageIds(uint8_t count) {
+    // The top bit marks fetched full images
+    if (imageCounter + count >= IMAGE_ID_FULL) {
+        imageCounter = 0;
+    }
+    uint16_t first = imageCounter + 1;
+    imageCounter += count;
+    return first;
+}
+
+/**
+ * Hand back IDs a request did not use, unless later ones were reserved since
+ */
+static void returnImageIds(uint16_t first, uint8_t count) {
+    if (imageCounter == first + count - 1) {
+        imageCounter = first - 1;
+    }
+}
+
+/**
+ * Take the oldest queued motion event
+ */
+static bool popMotionEvent(uint32_t& timestamp) {
+    if (motionCount == 0) {
+        return false;
+    }
+    timestamp = motionEvents[motionHead].timestamp;
+    eventForced = motionEvents[motionHead].forced;
+    // Scored again only if this event's frame is classified
+    eventConfidence = CONFIDENCE_UNKNOWN;
+    camera.markTrigger(motionEvents[motionHead].triggerMicros);
+    motionHead = (motionHead + 1) % MOTION_EVENT_QUEUE;
+    motionCount--;
+    return true;
+}
+
+/**
+ * Score the frame just verified; true if the classifier finds it empty
+ */
+static bool isEmptyFrame() {
+    const uint8_t* luma;
+    const uint8_t* change;
+    if (!CLASSIFY_ENABLED || !motionVerifier.getLastChange(luma, change)) {
+        return false;
+    }
+    
+    unsigned long start = micros();
+    eventConfidence = AnimalClassifier::score(luma, change);
+    DEBUG_PRINTF("[MAIN] Classifier score %d (%lu us)\n", eventConfidence, micros() - start);
+    
+    #if CLASSIFY_DROP_PCT > 0
+    if (eventConfidence < CLASSIFY_DROP_PCT && !eventForced) {
+        DEBUG_PRINTLN("[MAIN] No animal in the frame - dropped");
+        return true;
+    }
+    #endif
+    return false;
+}
+
+/**
+ * Classifier thinks the trigger frame shows an animal
+ */
+static bool isLikelyAnimal() {
+    return eventConfidence != CONFIDENCE_UNKNOWN && eventConfidence >= CLASSIFY_PRIORITY_PCT;
+}
+
+/**
+ * PIR trigger with nothing moving in the picture (wind, sun-warmed scene),
+ * or nothing the classifier takes for an animal
+ */
+static bool isFalseTrigger(const uint8_t* jpeg, size_t length) {
+    if (!VERIFY_ENABLED) {
+        return false;
+    }
+    if (!motionVerifier.verify(jpeg, length) && !eventForced) {
+        // Forced events send whatever the camera sees
+        DEBUG_PRINTF("[MAIN] Motion not confirmed by camera - vetoed (%lu so far)\n",
+            motionVerifier.getVetoCount());
+        return true;
+    }
+    return isEmptyFrame();
+}
+
+/**
+ * Frame looks like one sent recently; otherwise it is recorded as sent
+ */
+static bool isNearDuplicate(const uint8_t* jpeg, size_t length) {
+    if (!DEDUP_ENABLED || eventForced) {
+        return false;
+    }
+    
+    // Verification already hashed the trigger frame's thumbnail
+    uint64_t hash;
+    bool hashed = VERIFY_ENABLED ? motionVerifier.getLastHash(hash)
+                                 : motionVerifier.hashFrame(jpeg, length, hash);
+    if (!hashed) {
+        return false;
+    }
+    
+    if (duplicateFilter.isDuplicate(hash)) {
+        return true;
+    }
+    duplicateFilter.remember(hash);
+    return false;
+}
+
+/**
+ * Idle pre-trigger frames keep the background model current
+ */
+void onRingFrame(const FrameSlot& slot) {
+    if (VERIFY_ENABLED) {
+        motionVerifier.learn(slot.data, slot.length);
+    }
+}
+
+/**
+ * Cut an event's queued images down to where the camera saw change, with
+ * an optional low-quality full frame queued for context
+ */
+static void cropToMotion(QueuedImage** images, uint8_t count, uint32_t timestamp) {
+    uint16_t x, y, width, height;
+    if (!ROI_ENABLED || !motionVerifier.getChangedRegion(x, y, width, height)) {
+        return;
+    }
+    
+    // Context comes from the trigger frame (newest), before it is cropped
+    QueuedImage* trigger = images[count - 1];
+    if (ROI_CONTEXT_ENABLED && frameQueue.freeEntries() > 0) {
+        uint8_t* context = nullptr;
+        size_t contextLength = 0;
+        ImageRegion region;
+        if (roiCropper.encodeContext(trigger->data, trigger->length, &context, &contextLength, region)) {
+            frameQueue.push(context, contextLength, reserveImageIds(1), timestamp, region);
+            free(context);
+        }
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        roiCropper.cropInPlace(images[i]->data, images[i]->length, images[i]->capacity,
+                               x, y, width, height, images[i]->region);
+    }
+}
+
+/**
+ * Swap an event's queued images for small previews, keeping the full
+ * JPEGs on the sensor until the gateway asks for them
+ */
+static void holdFullImages(QueuedImage** images, uint8_t count) {
+    if (!THUMB_FIRST_ENABLED || !imageCache.isReady()) {
+        return;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        QueuedImage* image = images[i];
+        uint8_t* preview = nullptr;
+        size_t previewLength = 0;
+        if (!roiCropper.encodeReduced(image->data, image->length, THUMB_MAX_WIDTH, THUMB_QUALITY,
+                                      &preview, &previewLength)) {
+            continue;
+        }
+        
+        // Only worth it if the preview is smaller and the original is kept
+        if (previewLength < image->length &&
+            imageCache.store(image->imageId, image->data, image->length, image->timestamp, image->region)) {
+            DEBUG_PRINTF("[MAIN] Image %d: sending %u byte preview, holding %u bytes\n",
+                image->imageId, previewLength, image->length);
+            memcpy(image->data, preview, previewLength);
+            image->length = previewLength;
+            image->region.flags |= IMAGE_FLAG_THUMBNAIL;
+        }
+        free(preview);
+    }
+}
+
+/**
+ * Queue the full image behind a thumbnail the gateway asked for
+ */
+static void fetchFullImage(uint16_t imageId) {
+    CachedImage* cached = imageCache.find(imageId);
+    if (!cached) {
+        DEBUG_PRINTF("[MAIN] Fetch for image %d: no longer cached\n", imageId);
+        return;
+    }
+    
+    if (!frameQueue.push(cached->data, cached->length, imageId | IMAGE_ID_FULL,
+                         cached->timestamp, cached->region)) {
+        DEBUG_PRINTF("[MAIN] Fetch for image %d: frame queue full\n", imageId);
+        return;
+    }
+    DEBUG_PRINTF("[MAIN] Fetch for image %d: queued %u bytes\n", imageId, cached->length);
+}
+
+/**
+ * Hand a gateway command to the loop (called from the ESP-NOW receive task)
+ */
+static void queueCommand(const MeshMessage& msg) {
+    bool queued = false;
+    portENTER_CRITICAL(&commandLock);
+    if (commandCount < MESH_COMMAND_QUEUE) {
+        PendingCommand& pending = commands[(commandHead + commandCount) % MESH_COMMAND_QUEUE];
+        pending.receivedMicros = micros();
+        pending.length = min(msg.payloadLength, (uint8_t)sizeof(pending.payload));
+        memcpy(pending.payload, msg.payload, pending.length);
+        commandCount++;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&commandLock);
+    
+    if (!queued) {
+        DEBUG_PRINTF("[MAIN] Command queue full, command %d dropped\n", msg.payload[0]);
+        return;
+    }
+    timerWheel.wake();
+}
+
+/**
+ * Carry out gateway commands queued by the receive task
+ */
+static void serviceCommands() {
+    PendingCommand pending;
+    while (true) {
+        bool found = false;
+        portENTER_CRITICAL(&commandLock);
+        if (commandCount > 0) {
+            pending = commands[commandHead];
+            commandHead = (commandHead + 1) % MESH_COMMAND_QUEUE;
+            commandCount--;
+            found = true;
+        }
+        portEXIT_CRITICAL(&commandLock);
+        if (!found) {
+            return;
+        }
+        
+        CommandType command = static_cast<CommandType>(pending.payload[0]);
+        if (command == CommandType::FETCH_IMAGE && pending.length >= sizeof(FetchImagePayload)) {
+            fetchFullImage(pending.payload[1] | (pending.payload[2] << 8));
+        } else if (command == CommandType::CAPTURE_NOW) {
+            DEBUG_PRINTLN("[MAIN] Capture requested by gateway");
+            queueMotionEvent(true, pending.receivedMicros);
+        } else if (command == CommandType::LIVE_VIEW && pending.length >= sizeof(LiveViewPayload)) {
+            uint16_t leaseMs = pending.payload[1] | (pending.payload[2] << 8);
+            if (leaseMs > 0) {
+                liveView.start(leaseMs);
+            } else {
+                liveView.stop();
+            }
+        } else if (command == CommandType::ARCHIVE_PULL && pending.length >= sizeof(ArchivePullPayload)) {
+            const ArchivePullPayload* pull = (const ArchivePullPayload*)pending.payload;
+            if (pull->imageId != 0) {
+                imageArchive.requestImage(pull->imageId);
+            } else {
+                imageArchive.requestSince(pull->since, pull->maxImages);
+            }
+        }
+    }
+}
+
+/**
+ * Take the high-res archive frame for a motion image just sent. The copy
+ * is staged in PSRAM; the card write happens later from the loop.
+ */
+static void archiveHighRes(uint16_t imageId, uint32_t timestamp) {
+    // A held driver buffer is still being streamed
+    if (!imageArchive.isReady() || frameQueue.isCameraHeld()) {
+        return;
+    }
+    
+    if (camera.captureAt(ARCHIVE_FRAME_SIZE, ARCHIVE_QUALITY)) {
+        imageArchive.stage(imageId, timestamp, camera.getImageData(), camera.getImageLength());
+    }
+    camera.releaseFrame();
+}
+
+/**
+ * Start a burst clip from an accepted trigger frame
+ */
+static void startBurst(QueuedImage* trigger, uint32_t timestamp) {
+    burstImageId = trigger->imageId;
+    burstFrames = BURST_FRAMES;
+    burstCaptured = 1;
+    burstTimestamp = timestamp;
+    burstNextAt = millis() + BURST_INTERVAL_MS;
+    
+    trigger->clipFrame = 0;
+    trigger->clipFrames = BURST_FRAMES;
+    trigger->region.flags |= IMAGE_FLAG_CLIP;
+}
+
+/**
+ * Whether frames of a clip are still to be captured
+ */
+static bool burstPending(uint16_t clipId) {
+    return burstFrames > 0 && burstImageId == clipId && burstCaptured < burstFrames;
+}
+
+/**
+ * Capture the next burst frame once its interval is up. The clip ends
+ * early if the queue is full or the camera fails.
+ */
+static void captureBurstFrame() {
+    if (burstFrames == 0 || (long)(millis() - burstNextAt) < 0) {
+        return;
+    }
+    
+    QueuedImage* frame = frameQueue.captureFrame(burstImageId + burstCaptured, burstTimestamp);
+    if (!frame) {
+        DEBUG_PRINTF("[MAIN] Burst %d cut short at %d frames\n", burstImageId, burstCaptured);
+        burstFrames = 0;
+        return;
+    }
+    
+    frame->clipFrame = burstCaptured;
+    frame->clipFrames = burstFrames;
+    frame->region.flags |= IMAGE_FLAG_CLIP;
+    burstNextAt += BURST_INTERVAL_MS;
+    if (++burstCaptured >= burstFrames) {
+        burstFrames = 0;
+    }
+}
+
+/**
+ * Capture stage: turn queued motion events into queued images and alerts.
+ * Runs from the loop and while a transfer is blocked, so it never sends images.
+ */
+void captureMotion() {
+    captureBurstFrame();
+    
+    // Events during a burst wait for it to finish
+    uint32_t timestamp;
+    while (frameQueue.isReady() && burstFrames == 0 && popMotionEvent(timestamp)) {
+        bool hasImage = false;
+        uint16_t imageId = 0;
+        QueuedImage* queued[PRETRIGGER_MAX_FRAMES];
+        uint8_t queuedCount = 0;
+        bool archive = false;        // Single captures only: bursts and the ring keep the camera busy
+        
+        if (camera.isInitialized()) {
+            if (BURST_ENABLED) {
+                // Trigger frame now, the rest of the clip on the burst interval
+                QueuedImage* trigger = frameQueue.captureFrame(0, timestamp);
+                if (trigger && isFalseTrigger(trigger->data, trigger->length)) {
+                    frameQueue.dropNewest();
+                    continue;
+                }
+                if (trigger && isNearDuplicate(trigger->data, trigger->length)) {
+                    frameQueue.dropNewest();
+                    if (!DEDUP_ALERT_ONLY) {
+                        continue;
+                    }
+                } else if (trigger) {
+                    hasImage = true;
+                    imageId = reserveImageIds(BURST_FRAMES);
+                    trigger->imageId = imageId;
+                    startBurst(trigger, timestamp);
+                    if (isLikelyAnimal()) {
+                        trigger->region.flags |= IMAGE_FLAG_PRIORITY;
+                    }
+                }
+            } else if (frameRing.isRunning()) {
+                // Trigger frame plus the frames just before it, queued by reference
+                FrameSlot* frames[PRETRIGGER_MAX_FRAMES];
+                uint8_t room = frameQueue.freeEntries();
+                FrameSlot* trigger = frameRing.captureNow();
+                if (trigger && isFalseTrigger(trigger->data, trigger->length)) {
+                    continue;
+                }
+                if (trigger && isNearDuplicate(trigger->data, trigger->length)) {
+                    // Nothing new to show: alert only, or nothing at all
+                    if (!DEDUP_ALERT_ONLY) {
+                        continue;
+                    }
+                    room = 0;
+                }
+                uint8_t frameCount = frameRing.freeze(PRETRIGGER_WINDOW_MS, frames,
+                    room < PRETRIGGER_MAX_FRAMES ? room : PRETRIGGER_MAX_FRAMES);
+                if (frameCount > 0) {
+                    hasImage = true;
+                    imageId = reserveImageIds(frameCount);
+                }
+                for (uint8_t i = 0; i < frameCount; i++) {
+                    queued[queuedCount++] = frameQueue.pushRingFrame(frames[i], imageId + i, timestamp);
+                }
+            } else if (QueuedImage* captured = frameQueue.captureFrame(0, timestamp)) {
+                // Copied out of the driver buffer, which is already returned
+                if (isFalseTrigger(captured->data, captured->length)) {
+                    frameQueue.dropNewest();
+                    continue;
+                }
+                if (isNearDuplicate(captured->data, captured->length)) {
+                    frameQueue.dropNewest();
+                    if (!DEDUP_ALERT_ONLY) {
+                        continue;
+                    }
+                } else {
+                    queued[queuedCount++] = captured;
+                    hasImage = true;
+                    imageId = reserveImageIds(1);
+                    captured->imageId = imageId;
+                    archive = ARCHIVE_ENABLED;
+                }
+            }
+            
+            if (hasImage && burstFrames > 0) {
+                DEBUG_PRINTF("[MAIN] Burst %d started: %d frames every %d ms\n",
+                    imageId, BURST_FRAMES, BURST_INTERVAL_MS);
+            } else if (hasImage) {
+                cropToMotion(queued, queuedCount, timestamp);
+                holdFullImages(queued, queuedCount);
+                for (uint8_t i = 0; i < queuedCount && isLikelyAnimal(); i++) {
+                    queued[i]->region.flags |= IMAGE_FLAG_PRIORITY;
+                }
+            } else {
+                DEBUG_PRINTF("[MAIN] No image for motion event (%d images queued)\n", frameQueue.count());
+            }
+        }
+        
+        DEBUG_PRINTF("[MAIN] Sending motion alert: timestamp=%lu, imageId=%d, hasImage=%d\n",
+            timestamp, imageId, hasImage ? 1 : 0);
+        bool alertSent = meshNetwork.sendMotionAlert(timestamp, imageId, hasImage, eventConfidence);
+        DEBUG_PRINTF("[MAIN] Motion alert send result: %s\n", alertSent ? "SUCCESS" : "FAILED");
+        if (alertSent) {
+            deepSleep.noteAlertSent();
+        }
+        
+        // After the alert, so the high-res frame never delays it
+        if (archive) {
+            archiveHighRes(imageId, timestamp);
+        }
+    }
+}
+
+/**
+ * Wait for frame n of a clip to reach the head of the queue; later frames
+ * may still be on their way from the capture stage
+ */
+static QueuedImage* awaitClipFrame(uint16_t clipId, uint8_t frame) {
+    while (true) {
+        QueuedImage* image = frameQueue.peek();
+        if (image && image->clipFrames > 0 && image->imageId == clipId + frame) {
+            return image;
+        }
+        if (image || !burstPending(clipId)) {
+            return nullptr;
+        }
+        // Runs the capture stage, which queues the frame when it is due
+        meshNetwork.serviceFor(1);
+    }
+}
+
+/**
+ * Send a burst clip frame by frame as the capture stage queues it
+ */
+static void transmitClip(QueuedImage* first) {
+    uint16_t clipId = first->imageId - first->clipFrame;
+    uint8_t frames = first->clipFrames;
+    
+    // A clip whose start was lost is drained without sending
+    bool admitted = first->clipFrame == 0 &&
+        meshNetwork.beginClip(clipId, frames, first->length, &first->region);
+    if (!admitted && burstPending(clipId)) {
+        burstFrames = 0;
+    }
+    
+    uint8_t sent = 0;
+    for (uint8_t frame = first->clipFrame; frame < frames; frame++) {
+        QueuedImage* image = awaitClipFrame(clipId, frame);
+        if (!image) {
+            break;
+        }
+        
+        if (admitted) {
+            if (meshNetwork.sendClipFrame(image->data, image->length, frame, frame + 1 == frames)) {
+                qualityControl.noteTransfer(image->length, meshNetwork.getSendActiveMs());
+                sent++;
+            } else {
+                // Lost the gateway mid-clip: drain the remaining frames
+                meshNetwork.endClip();
+                admitted = false;
+            }
+        }
+        frameQueue.pop();
+    }
+    
+    if (admitted) {
+        meshNetwork.endClip();
+    }
+    DEBUG_PRINTF("[MAIN] Clip %d: %d of %d frames sent\n", clipId, sent, frames);
+}
+
+/**
+ * Transmit stage: drain the frame queue through the mesh
+ */
+void transmitImages() {
+    QueuedImage* image = frameQueue.peek();
+    if (!image) {
+        return;
+    }
+    
+    ledIndicator.setPattern(LedPattern::BLINK_TRANSMIT);
+    
+    while ((image = frameQueue.peek()) != nullptr) {
+        if (image->clipFrames > 0) {
+            transmitClip(image);
+            continue;
+        }
+        
+        DEBUG_PRINTF("[MAIN] Sending image %d (%u bytes, %d queued)\n",
+            image->imageId, image->length, frameQueue.count());
+        bool imageSent = meshNetwork.sendImage(image->data, image->length, image->imageId, &image->region);
+        if (imageSent) {
+            qualityControl.noteTransfer(image->length, meshNetwork.getSendActiveMs());
+        }
+        DEBUG_PRINTF("[MAIN] Image send result: %s\n", imageSent ? "SUCCESS" : "FAILED");
+        frameQueue.pop();
+    }
+    
+    ledIndicator.setPattern(LedPattern::BLINK_SLOW);
+}
+
+/**
+ * Send one live view frame when it is due. Frames are captured only when
+ * the previous one has gone out and motion images always go first, so
+ * a stale frame never waits behind a fresh one.
+ */
+static void serviceLiveView() {
+    if (!liveView.frameDue() || !camera.isInitialized() || frameQueue.count() > 0) {
+        return;
+    }
+    
+    // Reduced straight from the driver buffer, which goes back at once
+    uint8_t* frame = nullptr;
+    size_t frameLength = 0;
+    uint32_t capturedAt = meshClock.now();
+    bool encoded = camera.capture() &&
+        roiCropper.encodeReduced(camera.getImageData(), camera.getImageLength(),
+                                 LIVE_MAX_WIDTH, LIVE_QUALITY, &frame, &frameLength);
+    camera.releaseFrame();
+    if (!encoded) {
+        liveView.noteFrame(false);
+        return;
+    }
+    
+    ImageRegion region;
+    memset(&region, 0, sizeof(region));
+    region.flags = IMAGE_FLAG_LIVE;
+    bool sent = meshNetwork.sendImage(frame, frameLength, reserveImageIds(1), &region, capturedAt);
+    free(frame);
+    liveView.noteFrame(sent);
+}
+
+/**
+ * Send the held snapshots as one clip. The gateway admits it only in an
+ * off-peak window; otherwise the snapshots stay put until it said to
+ * ask again.
+ */
+static void transmitTimelapse() {
+    uint8_t frames = min(timelapse.count(), (uint8_t)CLIP_MAX_FRAMES);
+    
+    ImageRegion region;
+    memset(&region, 0, sizeof(region));
+    region.flags = IMAGE_FLAG_CLIP | IMAGE_FLAG_TIMELAPSE;
+    
+    // The IDs are held while the gateway is asked: motion captured during
+    // the wait reserves its own after them. A deferred batch gives them back.
+    uint16_t batchId = reserveImageIds(frames);
+    uint16_t deferredMs = 0;
+    if (!meshNetwork.beginClip(batchId, frames, timelapse.frame(0)->length, &region, &deferredMs)) {
+        returnImageIds(batchId, frames);
+        timelapse.deferSend(deferredMs > 0 ? deferredMs : TIMELAPSE_RETRY_MS);
+        return;
+    }
+    
+    ledIndicator.setPattern(LedPattern::BLINK_TRANSMIT);
+    uint8_t sent = 0;
+    while (sent < frames) {
+        const TimelapseFrame* frame = timelapse.frame(sent);
+        if (!meshNetwork.sendClipFrame(frame->data, frame->length, sent, sent + 1 == frames)) {
+            break;
+        }
+        sent++;
+    }
+    meshNetwork.endClip();
+    ledIndicator.setPattern(LedPattern::BLINK_SLOW);
     
-    DEBUG_PRINTF("[MAIN] Motion timestamp: %lu\n", motionTimestamp);
+    // Snapshots that did not make it go in the next batch
+    timelapse.release(sent);
+    if (sent < frames) {
+        timelapse.deferSend(TIMELAPSE_RETRY_MS);
+    }
+    DEBUG_PRINTF("[MAIN] Time-lapse batch %d: %d of %d snapshots sent\n", batchId, sent, frames);
+}
+
+/**
+ * Take a scheduled snapshot when one is due and send the held snapshots
+ * once there are enough. Runs from the loop only, so the store never
+ * changes under a batch being sent; motion images always go first.
+ */
+static void serviceTimelapse() {
+    if (!timelapse.isReady() || frameQueue.count() > 0) {
+        return;
+    }
+    
+    if (timelapse.captureDue() && camera.isInitialized()) {
+        uint32_t timestamp = meshClock.now();
+        if (camera.capture()) {
+            timelapse.store(camera.getImageData(), camera.getImageLength(), timestamp);
+        } else {
+            timelapse.store(nullptr, 0, timestamp);
+        }
+        camera.releaseFrame();
+    }
+    
+    if (timelapse.sendDue()) {
+        transmitTimelapse();
+    }
+}
+
+/**
+ * Write a staged archive frame and send one pulled image when the mesh
+ * has no motion images waiting. Pulled images go out as full images, like
+ * a fetched one.
+ */
+static void serviceArchive() {
+    if (!imageArchive.isReady()) {
+        return;
+    }
+    
+    imageArchive.flush();
+    
+    ArchiveEntry entry;
+    if (frameQueue.count() > 0 || !imageArchive.nextPull(entry)) {
+        return;
+    }
+    
+    if (entry.length > IMG_MAX_BYTES) {
+        DEBUG_PRINTF("[MAIN] Archived image %d too large to send (%lu bytes)\n", entry.imageId, entry.length);
+        return;
+    }
+    uint8_t* data = imageArchive.load(entry);
+    if (!data) {
+        return;
+    }
+    
+    ImageRegion region;
+    memset(&region, 0, sizeof(region));
+    bool sent = meshNetwork.sendImage(data, entry.length, entry.imageId | IMAGE_ID_FULL, &region);
+    free(data);
+    DEBUG_PRINTF("[MAIN] Archived image %d (%lu bytes) pull: %s\n",
+        entry.imageId, entry.length, sent ? "SENT" : "FAILED");
+}
+
+/**
+ * Deep sleep once nothing has been going on for DEEP_SLEEP_IDLE_MS: no
+ * motion episode, nothing waiting to be captured or sent, no live view
+ */
+static void serviceSleep() {
+    if (!DEEP_SLEEP_ENABLED) {
+        return;
+    }
+    
+    bool busy = commandCount > 0 || motionCount > 0 || burstFrames > 0 || pirSensor.isMotionDetected() ||
+                frameQueue.count() > 0 || liveView.isActive() ||
+                !imageArchive.isIdle() || !meshNetwork.isIdle();
+    if (busy) {
+        deepSleep.noteActivity();
+        return;
+    }
+    
+    if (deepSleep.isIdle()) {
+        camera.standby();
+        meshNetwork.saveState();
+        deepSleep.enter();
+    }
+}
+
+/**
+ * Keeps PIR handling and capture going while a transfer blocks the loop
+ */
+void servicePipeline() {
+    pirSensor.update();
+    serviceCommands();
+    captureMotion();
 }
 
 /**
  * Handle motion detection in main loop
  */
 void handleMotion() {
-    if (!motionPending) {
+    // Pipelined when the frame queue is available
+    if (frameQueue.isReady()) {
+        captureMotion();
+        transmitImages();
         return;
     }
     
-    motionPending = false;
+    // Without PSRAM the image is sent straight from the camera buffer,
+    // one event at a time
+    uint32_t motionTimestamp;
+    if (!popMotionEvent(motionTimestamp)) {
+        return;
+    }
     
     DEBUG_PRINTLN("[MAIN] ===== Processing motion event... =====");
     
@@ -76,9 +856,34 @@ void handleMotion() {
     DEBUG_PRINTF("[MAIN] Camera isInitialized(): %s\n", camera.isInitialized() ? "TRUE" : "FALSE");
     if (camera.isInitialized()) {
         DEBUG_PRINTLN("[MAIN] Attempting to capture image...");
-        if (camera.capture()) {
-            hasImage = true;
-            imageId = ++imageCounter;
+        hasImage = camera.capture();
+        
+        // Too large to send: tighten the encoder and recapture rather than drop
+        for (int attempt = 0; hasImage && QC_ENABLED && attempt < QC_RECAPTURE_MAX &&
+             camera.getImageLength() > IMG_MAX_BYTES; attempt++) {
+            camera.releaseFrame();
+            qualityControl.noteOversize();
+            hasImage = camera.capture();
+        }
+        if (hasImage) {
+            qualityControl.noteFrame(camera.getImageLength());
+            if (isFalseTrigger(camera.getImageData(), camera.getImageLength())) {
+                camera.releaseFrame();
+                ledIndicator.setPattern(LedPattern::BLINK_SLOW);
+                return;
+            }
+            if (isNearDuplicate(camera.getImageData(), camera.getImageLength())) {
+                camera.releaseFrame();
+                hasImage = false;
+                if (!DEDUP_ALERT_ONLY) {
+                    ledIndicator.setPattern(LedPattern::BLINK_SLOW);
+                    return;
+                }
+            }
+        }
+        
+        if (hasImage) {
+            imageId = reserveImageIds(1);
             
             DEBUG_PRINTLN("[MAIN] ===== IMAGE CAPTURED SUCCESSFULLY =====");
             DEBUG_PRINTF("[MAIN] Image size: %u bytes, ID: %d\n", 
@@ -101,17 +906,27 @@ void handleMotion() {
     // Sensor nodes send via mesh to gateway
     DEBUG_PRINTF("[MAIN] Sending motion alert: timestamp=%lu, imageId=%d, hasImage=%d\n",
         motionTimestamp, imageId, hasImage ? 1 : 0);
-    bool alertSent = meshNetwork.sendMotionAlert(motionTimestamp, imageId, hasImage);
+    bool alertSent = meshNetwork.sendMotionAlert(motionTimestamp, imageId, hasImage, eventConfidence);
     DEBUG_PRINTF("[MAIN] Motion alert send result: %s\n", alertSent ? "SUCCESS" : "FAILED");
+    if (alertSent) {
+        deepSleep.noteAlertSent();
+    }
     
     // Send image if captured
     if (hasImage && camera.isInitialized()) {
         DEBUG_PRINTLN("[MAIN] ===== Starting image send through mesh... =====");
+        ImageRegion priority;
+        memset(&priority, 0, sizeof(priority));
+        priority.flags = IMAGE_FLAG_PRIORITY;
         bool imageSent = meshNetwork.sendImage(
             camera.getImageData(),
             camera.getImageLength(),
-            imageId
+            imageId,
+            isLikelyAnimal() ? &priority : nullptr
         );
+        if (imageSent) {
+            qualityControl.noteTransfer(camera.getImageLength(), meshNetwork.getSendActiveMs());
+        }
         DEBUG_PRINTF("[MAIN] Image send result: %s\n", imageSent ? "SUCCESS" : "FAILED");
     } else {
         DEBUG_PRINTLN("[MAIN] Skipping image send (hasImage=false or camera not initialized)");
@@ -152,13 +967,15 @@ void onMeshMessage(const MeshMessage& msg) {
             uint8_t pathLength = 0;
             MessageProtocol::getPath(msg, path, &pathLength);
             
-            // Forward to phone via BLE with path information
+            // Forward to phone via BLE with path information (and the
+            // classifier score, from senders that have one)
             bleGateway.notifyMotionAlert(
                 msg.header.sourceId,
                 payload->timestamp,
                 payload->hasImage,
                 pathLength > 0 ? path : nullptr,
-                pathLength
+                pathLength,
+                msg.payloadLength >= sizeof(MotionAlertPayload) ? payload->confidence : CONFIDENCE_UNKNOWN
             );
             #endif
             break;
@@ -167,11 +984,17 @@ void onMeshMessage(const MeshMessage& msg) {
         case MessageType::IMAGE_START: {
             #if DEVICE_ROLE == ROLE_GATEWAY
             ImageStartPayload* payload = (ImageStartPayload*)msg.payload;
+            // Older senders stop before the crop geometry or the clip length
+            bool hasRegion = msg.payloadLength >= offsetof(ImageStartPayload, frameCount);
+            bool hasFrames = msg.payloadLength >= sizeof(ImageStartPayload);
             bleGateway.handleImageStart(
                 msg.header.sourceId,
                 payload->imageId,
                 payload->totalSize,
-                payload->totalChunks
+                payload->totalChunks,
+                hasRegion ? &payload->region : nullptr,
+                hasFrames ? payload->frameCount : 0,
+                payload->timestamp
             );
             #endif
             break;
@@ -196,7 +1019,18 @@ void onMeshMessage(const MeshMessage& msg) {
         case MessageType::IMAGE_END: {
             #if DEVICE_ROLE == ROLE_GATEWAY
             uint16_t imageId = msg.payload[0] | (msg.payload[1] << 8);
-            bleGateway.handleImageEnd(msg.header.sourceId, imageId);
+            bool clipFrame = msg.payloadLength >= sizeof(ImageEndPayload);
+            bleGateway.handleImageEnd(msg.header.sourceId, imageId,
+                clipFrame ? (const ImageEndPayload*)msg.payload : nullptr);
+            #endif
+            break;
+        }
+        
+        case MessageType::COMMAND: {
+            #if DEVICE_ROLE == ROLE_SENSOR
+            // Commands touch loop state (cache, queues, live view,
+            // archive): they are carried out from the loop
+            queueCommand(msg);
             #endif
             break;
         }
@@ -232,6 +1066,34 @@ void onNodeDiscovered(const MeshNode& node) {
 }
 
 #if DEVICE_ROLE == ROLE_GATEWAY
+// Node streaming live view to the phone (0 = none), and its lease renewal
+static uint16_t liveNode = 0;
+static Timer liveRenewTimer;
+
+/**
+ * Keep the live node's lease alive while the phone is watching
+ */
+static void onLiveRenewTimer(void* context) {
+    if (liveNode == 0 || !bleGateway.isConnected()) {
+        return;
+    }
+    meshNetwork.sendLiveView(liveNode, LIVE_LEASE_MS);
+    timerWheel.arm(liveRenewTimer, LIVE_RENEW_MS);
+}
+
+/**
+ * Stop the current live view, if any
+ */
+static void stopLiveView() {
+    if (liveNode == 0) {
+        return;
+    }
+    DEBUG_PRINTF("[MAIN] Stopping live view on node %d\n", liveNode);
+    timerWheel.cancel(liveRenewTimer);
+    meshNetwork.sendLiveView(liveNode, 0);
+    liveNode = 0;
+}
+
 /**
  * Called when BLE connection state changes
  */
@@ -256,9 +1118,26 @@ void onBleConnect(bool connected) {
             bleGateway.notifyStatus(node.nodeId, 100, node.rssi, totalNodes);
             delay(50);  // Small delay between notifications
         }
+    } else {
+        // Nobody is watching any more
+        stopLiveView();
     }
 }
 
+/**
+ * Called when the BLE gateway admits, tops up or defers an image transfer
+ */
+void onImageGrant(uint16_t nodeId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs) {
+    meshNetwork.sendImageGrant(nodeId, imageId, grantedChunks, retryAfterMs);
+}
+
+/**
+ * Called when the BLE gateway needs missing chunks resent (or reports done)
+ */
+void onImageRepair(uint16_t nodeId, uint16_t imageId, const uint16_t* chunks, uint8_t count) {
+    meshNetwork.sendImageNack(nodeId, imageId, chunks, count);
+}
+
 /**
  * Called when a command is received from the phone via BLE
  */
@@ -274,7 +1153,7 @@ void onBleCommand(uint8_t command, const uint8_t* data, size_t length) {
             if (length >= 2) {
                 uint16_t nodeId = data[0] | (data[1] << 8);
                 DEBUG_PRINTF("[MAIN] Force capture request for node %d\n", nodeId);
-                // TODO: Send capture command to node
+                meshNetwork.sendCommand(nodeId, CommandType::CAPTURE_NOW);
             }
             break;
             
@@ -298,6 +1177,51 @@ void onBleCommand(uint8_t command, const uint8_t* data, size_t length) {
             }
             break;
             
+        case 0x04:  // Fetch full image behind a thumbnail
+            if (length >= 4) {
+                uint16_t nodeId = data[0] | (data[1] << 8);
+                uint16_t imageId = data[2] | (data[3] << 8);
+                DEBUG_PRINTF("[MAIN] Full image request for node %d image %d\n", nodeId, imageId);
+                meshNetwork.sendImageFetch(nodeId, imageId);
+            }
+            break;
+            
+        case 0x05:  // Start live view on a node
+            if (length >= 2) {
+                uint16_t nodeId = data[0] | (data[1] << 8);
+                if (nodeId != liveNode) {
+                    stopLiveView();
+                }
+                DEBUG_PRINTF("[MAIN] Live view on node %d\n", nodeId);
+                liveNode = nodeId;
+                meshNetwork.sendLiveView(liveNode, LIVE_LEASE_MS);
+                timerWheel.arm(liveRenewTimer, LIVE_RENEW_MS);
+            }
+            break;
+            
+        case 0x06:  // Stop live view
+            stopLiveView();
+            break;
+            
+        case 0x07:  // Pull an archived high-res image
+            if (length >= 4) {
+                uint16_t nodeId = data[0] | (data[1] << 8);
+                uint16_t imageId = data[2] | (data[3] << 8);
+                DEBUG_PRINTF("[MAIN] Archive pull for node %d image %d\n", nodeId, imageId);
+                meshNetwork.sendArchivePull(nodeId, imageId, 0, 0);
+            }
+            break;
+            
+        case 0x08:  // Pull archived high-res images taken since a time
+            if (length >= 7) {
+                uint16_t nodeId = data[0] | (data[1] << 8);
+                uint32_t since = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t)data[5] << 24);
+                DEBUG_PRINTF("[MAIN] Archive pull for node %d: %d images since %lu\n", nodeId, data[6], since);
+                meshNetwork.sendArchivePull(nodeId, 0, since, data[6]);
+            }
+            break;
+            
+
         default:
             DEBUG_PRINTLN("[MAIN] Unknown BLE command");
             break;
@@ -309,10 +1233,35 @@ void onBleCommand(uint8_t command, const uint8_t* data, size_t length) {
 // Setup and Loop
 // ============================================================================
 
+#if DEVICE_ROLE == ROLE_SENSOR
+// Its own signal: the setup task's notification is the timer wheel's
+static SemaphoreHandle_t cameraDone = nullptr;
+static volatile bool cameraStarted = false;
+
+/**
+ * Camera init on the other core while setup brings up the PIR and radio
+ */
+static void cameraInitTask(void* param) {
+    cameraStarted = camera.begin();
+    xSemaphoreGive(cameraDone);
+    vTaskDelete(nullptr);
+}
+#endif
+
 void setup() {
-    // Initialize serial
+    // Timer wheel before anything arms a timer
+    timerWheel.begin();
+    
+    // A wake from deep sleep takes the fast path to the first capture
+    #if DEVICE_ROLE == ROLE_SENSOR
+    deepSleep.begin();
+    #endif
+    
+    // Initialize serial (nobody is watching after a wake from deep sleep)
     Serial.begin(SERIAL_BAUD);
-    delay(1000);
+    if (!deepSleep.wokeFromSleep()) {
+        delay(1000);
+    }
     
     DEBUG_PRINTLN("\n========================================");
     DEBUG_PRINTLN("  ESP32 Trail Camera Mesh Network");
@@ -325,15 +1274,18 @@ void setup() {
     ledIndicator.begin();
     ledIndicator.setPattern(LedPattern::BLINK_FAST);
     
-    // Initialize camera (sensor nodes only)
+    // Start the camera (sensor nodes only); it is the slowest step, so it
+    // runs on core 0 while the radio comes up here
     #if DEVICE_ROLE == ROLE_SENSOR
     DEBUG_PRINTLN("[MAIN] Initializing camera...");
-    if (!camera.begin()) {
-        DEBUG_PRINTLN("[MAIN] ===== WARNING: Camera init FAILED! Continuing without camera... =====");
-        // Continue without camera - device can still send motion alerts without images
-    } else {
-        DEBUG_PRINTLN("[MAIN] ===== Camera initialized SUCCESSFULLY =====");
-        DEBUG_PRINTF("[MAIN] Camera isInitialized(): %s\n", camera.isInitialized() ? "TRUE" : "FALSE");
+    unsigned long bootStart = millis();
+    cameraDone = xSemaphoreCreateBinary();
+    if (!cameraDone ||
+        xTaskCreatePinnedToCore(cameraInitTask, "camInit", 4096, nullptr, 1, nullptr, 0) != pdPASS) {
+        cameraStarted = camera.begin();
+        if (cameraDone) {
+            xSemaphoreGive(cameraDone);
+        }
     }
     #else
     DEBUG_PRINTLN("[MAIN] Gateway mode - skipping camera initialization");
@@ -344,6 +1296,7 @@ void setup() {
     DEBUG_PRINTLN("[MAIN] Initializing PIR sensor...");
     pirSensor.begin();
     pirSensor.setMotionCallback(onMotionDetected);
+    pirSensor.setEpisodeCallback(onMotionEpisode);
     #else
     DEBUG_PRINTLN("[MAIN] Gateway mode - skipping PIR sensor initialization");
     #endif
@@ -354,15 +1307,75 @@ void setup() {
         DEBUG_PRINTLN("[MAIN] Mesh init failed!");
         ledIndicator.setPattern(LedPattern::BLINK_ERROR);
         while (1) {
-            ledIndicator.update();
-            delay(10);
+            timerWheel.advance();
+            timerWheel.sleep();
         }
     }
+    
+    // Routes from before the sleep: the first alert needs no discovery
+    #if DEVICE_ROLE == ROLE_SENSOR
+    if (deepSleep.wokeFromSleep()) {
+        meshNetwork.restoreState();
+    }
+    #endif
+    
+    // Camera-dependent setup once its init task is done
+    #if DEVICE_ROLE == ROLE_SENSOR
+    if (cameraDone) {
+        xSemaphoreTake(cameraDone, portMAX_DELAY);
+        vSemaphoreDelete(cameraDone);
+        cameraDone = nullptr;
+    }
+    DEBUG_PRINTF("[MAIN] Camera and radio up in %lu ms\n", millis() - bootStart);
+    if (!cameraStarted) {
+        DEBUG_PRINTLN("[MAIN] ===== WARNING: Camera init FAILED! Continuing without camera... =====");
+        // Continue without camera - device can still send motion alerts without images
+    } else {
+        DEBUG_PRINTLN("[MAIN] ===== Camera initialized SUCCESSFULLY =====");
+        DEBUG_PRINTF("[MAIN] Camera isInitialized(): %s\n", camera.isInitialized() ? "TRUE" : "FALSE");
+        
+        qualityControl.begin();
+        
+        // Deep sleep ends the ring and the held snapshots, so neither runs
+        #if PRETRIGGER_ENABLED && !DEEP_SLEEP_ENABLED
+        if (frameRing.begin(PRETRIGGER_SLOTS, PRETRIGGER_SLOT_BYTES)) {
+            frameRing.setFrameCallback(onRingFrame);
+            frameRing.start(PRETRIGGER_INTERVAL_MS);
+        }
+        #endif
+        
+        // The pre-trigger ring captures continuously, so the camera stays hot
+        camera.setIdlePower(frameRing.isRunning() ? CameraPower::HOT
+                                                  : (CameraPower)CAMERA_POWER_MODE);
+        
+        frameQueue.begin(FRAME_QUEUE_DEPTH, FRAME_QUEUE_SLOT_BYTES);
+        
+        #if THUMB_FIRST_ENABLED
+        imageCache.begin(IMG_CACHE_SLOTS, IMG_CACHE_SLOT_BYTES);
+        #endif
+        
+        #if TIMELAPSE_ENABLED && !DEEP_SLEEP_ENABLED
+        timelapse.begin(TIMELAPSE_SLOTS, TIMELAPSE_SLOT_BYTES);
+        #endif
+        
+        #if ARCHIVE_ENABLED
+        imageArchive.begin();
+        #endif
+    }
+    #endif
+    
     meshNetwork.setMessageCallback(onMeshMessage);
     meshNetwork.setNodeDiscoveredCallback(onNodeDiscovered);
+    #if DEVICE_ROLE == ROLE_SENSOR
+    meshNetwork.setServiceCallback(servicePipeline);
+    #endif
     
     // Initialize BLE on gateway
     #if DEVICE_ROLE == ROLE_GATEWAY
+    // Image admission runs over the mesh even if BLE fails to start
+    bleGateway.setGrantCallback(onImageGrant);
+    bleGateway.setRepairCallback(onImageRepair);
+    
     DEBUG_PRINTLN("[MAIN] Initializing BLE gateway...");
     if (!bleGateway.begin()) {
         DEBUG_PRINTLN("[MAIN] BLE init failed!");
@@ -371,6 +1384,7 @@ void setup() {
         bleGateway.setConnectCallback(onBleConnect);
         bleGateway.setCommandCallback(onBleCommand);
     }
+    TimerWheel::bind(liveRenewTimer, onLiveRenewTimer, nullptr);
     #endif
     
     // Initialization complete
@@ -384,11 +1398,13 @@ void setup() {
 }
 
 void loop() {
+    // Fire due timers (heartbeats, retries, timeouts, LED patterns)
+    timerWheel.advance();
+    
     // Update all modules
     #if DEVICE_ROLE == ROLE_SENSOR
     pirSensor.update();  // Only update PIR on sensor nodes
     #endif
-    ledIndicator.update();
     meshNetwork.update();
     
     #if DEVICE_ROLE == ROLE_GATEWAY
@@ -397,10 +1413,15 @@ void loop() {
     
     // Handle pending motion events (only applicable to sensor nodes)
     #if DEVICE_ROLE == ROLE_SENSOR
+    serviceCommands();
     handleMotion();
+    serviceLiveView();
+    serviceTimelapse();
+    serviceArchive();
+    serviceSleep();
     #endif
     
-    // Small delay to prevent watchdog issues
-    delay(1);
+    // Sleep until the next timer is due or another task/ISR wakes us
+    timerWheel.sleep();
 }
 
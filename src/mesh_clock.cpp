@@ -0,0 +1,118 @@
+#include "mesh_clock.h"
+
+// Global instance
+MeshClock meshClock;
+
+MeshClock::MeshClock()
+    : _offset(0)
+    , _stratum(DEVICE_ROLE == ROLE_GATEWAY ? 0 : CLOCK_STRATUM_UNSYNCED)
+    , _referenceNode(0)
+    , _lastSync(0) {
+}
+
+uint32_t MeshClock::now() {
+    return millis() + _offset;
+}
+
+bool MeshClock::isSynced() {
+    expireSync();
+    return _stratum != CLOCK_STRATUM_UNSYNCED;
+}
+
+uint8_t MeshClock::getStratum() {
+    expireSync();
+    return _stratum;
+}
+
+int32_t MeshClock::getOffset() {
+    return _offset;
+}
+
+void MeshClock::resume(uint32_t meshTime) {
+    _offset = (int32_t)(meshTime - millis());
+}
+
+void MeshClock::onReference(uint16_t nodeId, uint32_t meshTime, uint8_t stratum, uint32_t localRxTime) {
+    // The gateway is the reference; it never follows anyone
+    if (DEVICE_ROLE == ROLE_GATEWAY || stratum == CLOCK_STRATUM_UNSYNCED) {
+        return;
+    }
+    
+    expireSync();
+    
+    // Follow our current reference, or switch to a better one
+    bool better = stratum + 1 < _stratum;
+    if (!better && nodeId != _referenceNode) {
+        return;
+    }
+    
+    int32_t offset = (int32_t)(meshTime - localRxTime);
+    int32_t error = offset - _offset;
+    
+    if (better || abs(error) > MESH_CLOCK_STEP_MS) {
+        // New reference or large error: step
+        _offset = offset;
+        DEBUG_PRINTF("[CLOCK] Synced to node %d (stratum %d), offset %ld ms\n",
+            nodeId, stratum + 1, (long)offset);
+    } else {
+        // Small error: slew half way to avoid jumping timestamps and slots
+        _offset += error / 2;
+    }
+    
+    _stratum = stratum + 1;
+    _referenceNode = nodeId;
+    _lastSync = millis();
+}
+
+bool MeshClock::inOwnSlot() {
+    // No shared time base: fall back to contention
+    if (!MESH_TDMA_ENABLED || !isSynced()) {
+        return true;
+    }
+    
+    uint32_t position = now() % (MESH_TDMA_SLOTS * MESH_TDMA_SLOT_MS);
+    uint32_t slotStart = (DEVICE_ID % MESH_TDMA_SLOTS) * MESH_TDMA_SLOT_MS;
+    
+    return position >= slotStart && position < slotStart + MESH_TDMA_SLOT_MS - MESH_TDMA_GUARD_MS;
+}
+
+uint32_t MeshClock::msUntilOwnSlot() {
+    if (inOwnSlot()) {
+        return 0;
+    }
+    
+    uint32_t frame = MESH_TDMA_SLOTS * MESH_TDMA_SLOT_MS;
+    uint32_t position = now() % frame;
+    uint32_t slotStart = (DEVICE_ID % MESH_TDMA_SLOTS) * MESH_TDMA_SLOT_MS;
+    
+    return (slotStart + frame - position) % frame;
+}
+
+bool MeshClock::inWindow(uint16_t periodMs, uint16_t offsetMs, uint16_t windowMs) {
+    if (periodMs == 0) {
+        return true;
+    }
+    
+    uint32_t position = (now() + periodMs - offsetMs % periodMs) % periodMs;
+    return position < windowMs;
+}
+
+uint32_t MeshClock::msUntilWindow(uint16_t periodMs, uint16_t offsetMs) {
+    if (periodMs == 0) {
+        return 0;
+    }
+    
+    uint32_t position = (now() + periodMs - offsetMs % periodMs) % periodMs;
+    return position == 0 ? 0 : periodMs - position;
+}
+
+void MeshClock::expireSync() {
+    if (DEVICE_ROLE == ROLE_GATEWAY || _stratum == CLOCK_STRATUM_UNSYNCED) {
+        return;
+    }
+    
+    if (millis() - _lastSync > MESH_CLOCK_SYNC_TIMEOUT_MS) {
+        DEBUG_PRINTLN("[CLOCK] Time reference lost");
+        _stratum = CLOCK_STRATUM_UNSYNCED;
+    }
+}
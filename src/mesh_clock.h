@@ -0,0 +1,51 @@
+#ifndef MESH_CLOCK_H
+#define MESH_CLOCK_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Stratum of a node with no time reference
+#define CLOCK_STRATUM_UNSYNCED 0xFF
+
+// Mesh-wide clock: the gateway's millis() is the reference (stratum 0),
+// each node syncs to the lowest-stratum neighbour it hears heartbeats from.
+class MeshClock {
+public:
+    MeshClock();
+    
+    // Mesh time in ms (local millis() on the gateway or when unsynced)
+    uint32_t now();
+    
+    // Sync state
+    bool isSynced();
+    uint8_t getStratum();
+    int32_t getOffset();
+    
+    // Carry on from a mesh time estimated across deep sleep; the clock
+    // stays unsynced until the next reference steps it
+    void resume(uint32_t meshTime);
+    
+    // Reference from a neighbour's heartbeat, received at localRxTime (millis)
+    void onReference(uint16_t nodeId, uint32_t meshTime, uint8_t stratum, uint32_t localRxTime);
+    
+    // TDMA slot schedule
+    bool inOwnSlot();
+    uint32_t msUntilOwnSlot();
+    
+    // Periodic windows on the mesh clock (relay wake schedules)
+    bool inWindow(uint16_t periodMs, uint16_t offsetMs, uint16_t windowMs);
+    uint32_t msUntilWindow(uint16_t periodMs, uint16_t offsetMs);
+
+private:
+    void expireSync();
+    
+    volatile int32_t _offset;
+    uint8_t _stratum;
+    uint16_t _referenceNode;
+    uint32_t _lastSync;
+};
+
+// Global instance
+extern MeshClock meshClock;
+
+#endif // MESH_CLOCK_H
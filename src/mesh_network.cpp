@@ -1,4 +1,5 @@
 #include "mesh_network.h"
+#include <new>
 
 // Static instance pointer for callbacks
 MeshNetwork* MeshNetwork::_instance = nullptr;
@@ -9,28 +10,102 @@ MeshNetwork meshNetwork;
 // Broadcast MAC address for ESP-NOW
 static const uint8_t BROADCAST_MAC[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
+// Guards the transmit queues (written from the ESP-NOW receive task)
+static portMUX_TYPE txQueueLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Routes kept in RTC memory across deep sleep
+struct RtcRoute {
+    uint16_t nodeId;
+    uint8_t macAddress[6];
+    int8_t rssi;
+    uint8_t hopCount;
+    bool isGateway;
+};
+
+#define MESH_RTC_MAGIC 0x4D524F55  // Marks the RTC routes as written
+
+RTC_DATA_ATTR static uint32_t rtcRoutesMagic = 0;
+RTC_DATA_ATTR static uint8_t rtcRouteCount = 0;
+RTC_DATA_ATTR static RtcRoute rtcRoutes[MESH_RTC_NODES];
+
+// Queue limits indexed by TrafficClass
+static const uint16_t TXQ_LIMITS[] = {
+    TXQ_CONTROL_LIMIT,
+    TXQ_ALERT_LIMIT,
+    TXQ_BULK_LIMIT,
+    TXQ_TELEMETRY_LIMIT
+};
+
 MeshNetwork::MeshNetwork()
     : _messageCallback(nullptr)
     , _nodeCallback(nullptr)
-    , _lastHeartbeat(0)
-    , _lastPrune(0)
+    , _serviceCallback(nullptr)
     , _messagesSent(0)
     , _messagesReceived(0)
     , _messagesRelayed(0)
     , _sendInProgress(false)
     , _lastSendSuccess(false)
+    , _sendStartUs(0)
+    , _lastAirtimeUs(0)
     , _imageTransferInProgress(false)
     , _currentImageId(0)
     , _currentChunk(0)
-    , _totalChunks(0) {
+    , _totalChunks(0)
+    , _chunkBase(0)
+    , _sendActiveUs(0)
+    , _clipFramesSent(0)
+    , _clipLastSent(false)
+    , _grantedChunks(0)
+    , _grantRetryAfterMs(0) {
     
     _instance = this;
     memset(_macAddress, 0, 6);
+    memset(_txQueues, 0, sizeof(_txQueues));
+    memset(_txStats, 0, sizeof(_txStats));
+    memset(_custodyAcks, 0, sizeof(_custodyAcks));
+    memset(_custodyMap, 0, sizeof(_custodyMap));
+    memset(&_repairRequest, 0, sizeof(_repairRequest));
+    _repairPending = false;
+    
+    TimerWheel::bind(_heartbeatTimer, onHeartbeatTimer, this);
+    TimerWheel::bind(_pruneTimer, onPruneTimer, this);
+    TimerWheel::bind(_custodyAckTimer, onCustodyAckTimer, this);
+    TimerWheel::bind(_custodyRetryTimer, onCustodyRetryTimer, this);
+    TimerWheel::bind(_slotTimer, onSlotTimer, this);
+    TimerWheel::bind(_pollTimer, onPollTimer, this);
+    TimerWheel::bind(_listenTimer, onListenTimer, this);
+    TimerWheel::bind(_wakeTimer, onWakeTimer, this);
+    TimerWheel::bind(_rendezvousTimer, onRendezvousTimer, this);
+    TimerWheel::bind(_burstTimer, onBurstTimer, this);
+    memset(_children, 0, sizeof(_children));
+    memset(_deferred, 0, sizeof(_deferred));
+    memset(_burstMac, 0, sizeof(_burstMac));
+    _burstUntil = 0;
+    _burstActive = false;
+    _radioOn = true;
+    _awakeUntil = 0;
+    for (auto& pending : _pending) {
+        memset(&pending.message, 0, sizeof(MeshMessage));
+        pending.retriesLeft = 0;
+        pending.waitingAck = false;
+        TimerWheel::bind(pending.retryTimer, onRetryTimer, &pending);
+    }
 }
 
 bool MeshNetwork::begin() {
     DEBUG_PRINTLN("[MESH] Initializing ESP-NOW mesh network...");
     
+    // Allocate transmit queues before any callback can fill them
+    if (!allocateTxQueues()) {
+        DEBUG_PRINTLN("[MESH] Failed to allocate transmit queues");
+        return false;
+    }
+    
+    // Relays keep forwarded chunks for custody resends and repairs
+    if (CUSTODY_ENABLED && !_chunkCache.begin(CUSTODY_CACHE_CHUNKS)) {
+        DEBUG_PRINTLN("[MESH] Custody cache unavailable, relaying without it");
+    }
+    
     // Set WiFi mode to station for ESP-NOW
     WiFi.mode(WIFI_STA);
     WiFi.disconnect();
@@ -64,31 +139,76 @@ bool MeshNetwork::begin() {
     
     // Send initial heartbeat
     sendHeartbeat();
+    timerWheel.arm(_heartbeatTimer, MESH_HEARTBEAT_INTERVAL_MS);
+    timerWheel.arm(_pruneTimer, MESH_ROUTE_TIMEOUT_MS / 2);
+    
+    // Sleepy nodes stay awake until they find a parent, then duty-cycle
+    if (MESH_SLEEPY_NODE) {
+        timerWheel.arm(_pollTimer, MESH_POLL_INTERVAL_MS);
+        timerWheel.arm(_listenTimer, MESH_POLL_LISTEN_MS);
+    }
+    
+    // Duty-cycled relays listen in their window (always, until the clock syncs)
+    if (MESH_WAKE_WINDOWS_ENABLED) {
+        timerWheel.arm(_wakeTimer, meshClock.msUntilWindow(MESH_WAKE_PERIOD_MS, MESH_WAKE_OFFSET_MS));
+        timerWheel.arm(_listenTimer, MESH_WAKE_WINDOW_MS);
+    }
     
     return true;
 }
 
 void MeshNetwork::update() {
-    unsigned long currentTime = millis();
-    
-    // Send periodic heartbeat
-    if (currentTime - _lastHeartbeat >= MESH_HEARTBEAT_INTERVAL_MS) {
-        sendHeartbeat();
-        _lastHeartbeat = currentTime;
+    // Heartbeats, pruning, retries and custody run from the timer wheel;
+    // here we only drain transmit queues in priority order
+    serviceTxQueues();
+}
+
+void MeshNetwork::onHeartbeatTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    mesh->sendHeartbeat();
+    timerWheel.arm(mesh->_heartbeatTimer, MESH_HEARTBEAT_INTERVAL_MS);
+}
+
+void MeshNetwork::onPruneTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    mesh->pruneRoutingTable();
+    timerWheel.arm(mesh->_pruneTimer, MESH_ROUTE_TIMEOUT_MS / 2);
+}
+
+void MeshNetwork::onCustodyAckTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    mesh->flushStaleCustodyAcks();
+    
+    // Partial ACKs opened since then are due later
+    for (auto& ack : mesh->_custodyAcks) {
+        if (ack.pending) {
+            timerWheel.arm(mesh->_custodyAckTimer, CUSTODY_ACK_DELAY_MS);
+            break;
+        }
     }
+}
+
+void MeshNetwork::onCustodyRetryTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    mesh->serviceCustodyRetries();
     
-    // Prune stale routes
-    if (currentTime - _lastPrune >= MESH_ROUTE_TIMEOUT_MS / 2) {
-        pruneRoutingTable();
-        _lastPrune = currentTime;
-    }
+    // Keep checking while forwarded chunks still wait for the next hop
+    portENTER_CRITICAL(&txQueueLock);
+    bool awaiting = mesh->_chunkCache.awaitingCustody();
+    portEXIT_CRITICAL(&txQueueLock);
     
-    // Process pending messages
-    processMessageQueue();
+    if (awaiting) {
+        timerWheel.arm(mesh->_custodyRetryTimer, CUSTODY_RETRY_MS);
+    }
+}
+
+void MeshNetwork::onSlotTimer(void* context) {
+    static_cast<MeshNetwork*>(context)->serviceTxQueues();
 }
 
 void MeshNetwork::onDataSent(const uint8_t* mac, esp_now_send_status_t status) {
     if (_instance) {
+        _instance->_lastAirtimeUs = micros() - _instance->_sendStartUs;
         _instance->_sendInProgress = false;
         _instance->_lastSendSuccess = (status == ESP_NOW_SEND_SUCCESS);
         
@@ -120,9 +240,16 @@ void MeshNetwork::handleReceivedMessage(const uint8_t* mac, const uint8_t* data,
         return;
     }
     
-    // Update routing table with sender info
-    // Note: RSSI would need to be obtained differently in newer ESP-IDF
-    updateRoutingTable(msg.header.sourceId, mac, -50, 1, false);
+    // Any traffic shows the sender is alive; only heartbeats set its route
+    noteNodeSeen(msg.header.sourceId, mac);
+    
+    // A sleepy child that just sent us something is listening for a moment
+    noteChildActivity(mac);
+    
+    // Duty-cycled: traffic arriving in our window may continue past it
+    if (MESH_WAKE_WINDOWS_ENABLED) {
+        _awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+    }
     
     // Process the message
     processMessage(msg, mac);
@@ -150,6 +277,19 @@ void MeshNetwork::processMessage(const MeshMessage& msg, const uint8_t* senderMa
             payload->role == ROLE_GATEWAY
         );
         
+        // Older firmware sends heartbeats without the clock fields and flags
+        if (msg.payloadLength >= sizeof(HeartbeatPayload)) {
+            meshClock.onReference(msg.header.sourceId, payload->meshTime, payload->syncStratum, millis());
+            
+            MeshNode* node = findNode(msg.header.sourceId);
+            if (node) {
+                node->isSleepy = (payload->flags & NODE_FLAG_SLEEPY) != 0;
+                node->wakePeriodMs = payload->wakePeriodMs;
+                node->wakeOffsetMs = payload->wakeOffsetMs;
+                node->wakeWindowMs = payload->wakeWindowMs;
+            }
+        }
+        
         // Notify callback
         if (_nodeCallback) {
             MeshNode* node = findNode(msg.header.sourceId);
@@ -168,7 +308,13 @@ void MeshNetwork::processMessage(const MeshMessage& msg, const uint8_t* senderMa
         );
         response.header.messageType = static_cast<uint8_t>(MessageType::DISCOVER_RESP);
         response.header.destId = msg.header.sourceId;
-        sendMessage(response);
+        enqueueMessage(response);
+        return;
+    }
+    
+    // Custody ACKs are hop-local: consume them, never relay
+    if (MessageProtocol::isCustodyAck(msg)) {
+        handleCustodyAck(msg);
         return;
     }
     
@@ -176,8 +322,26 @@ void MeshNetwork::processMessage(const MeshMessage& msg, const uint8_t* senderMa
     if (isForUs) {
         // Handle ACK
         if (type == MessageType::ACK) {
-            // Remove from pending queue (simplified - would need sequence matching)
             DEBUG_PRINTF("[MESH] Received ACK for seq %d\n", msg.header.sequenceNum);
+            acknowledgePending(msg.header.sequenceNum);
+            return;
+        }
+        
+        // Credit for our own image transfer
+        if (type == MessageType::IMAGE_GRANT) {
+            handleImageGrant(msg);
+            return;
+        }
+        
+        // Poll from a sleepy child, or our parent's answer to ours
+        if (type == MessageType::DATA_POLL) {
+            handleDataPoll(msg, senderMac);
+            return;
+        }
+        
+        // Repair request (or completion notice) for our own image
+        if (type == MessageType::NACK) {
+            handleImageNack(msg);
             return;
         }
         
@@ -186,27 +350,43 @@ void MeshNetwork::processMessage(const MeshMessage& msg, const uint8_t* senderMa
             _messageCallback(msg);
         }
         
-        // Send ACK for certain message types
+        // The gateway takes custody of every chunk it receives
+        if (CUSTODY_ENABLED && type == MessageType::IMAGE_CHUNK) {
+            noteCustody(senderMac, msg);
+        }
+        
+        // Send ACK for certain message types (IMAGE_START is answered by a grant)
         if (type == MessageType::MOTION_ALERT || 
-            type == MessageType::IMAGE_START ||
             type == MessageType::IMAGE_END) {
             MeshMessage ack = MessageProtocol::createAck(
                 DEVICE_ID, msg.header.sourceId, msg.header.sequenceNum
             );
-            sendMessage(ack);
+            enqueueMessage(ack);
         }
     }
     
-    // Relay if not for us and we're not the source
-    if (!isForUs && msg.header.sourceId != DEVICE_ID) {
+    // Relay if not for us and we're not the source (sleepy nodes never relay)
+    if (!isForUs && msg.header.sourceId != DEVICE_ID && !MESH_SLEEPY_NODE) {
         // Check if we should relay (message needs to reach gateway)
         if (msg.header.destId == GATEWAY_ID || msg.header.destId == BROADCAST_ID) {
-            relayMessage(msg);
+            relayMessage(msg, senderMac);
+        } else {
+            // Downstream unicast (grants, ACKs): forward if we have a route
+            // that doesn't lead straight back to the sender
+            MeshNode* dest = findNode(msg.header.destId);
+            if (dest && memcmp(dest->macAddress, senderMac, 6) != 0) {
+                // Serve what we can of a NACK from our cache, pass on the rest
+                MeshMessage forward = msg;
+                if (type == MessageType::NACK && CUSTODY_ENABLED && !serveRepairFromCache(forward)) {
+                    return;
+                }
+                relayMessage(forward, senderMac);
+            }
         }
     }
 }
 
-void MeshNetwork::relayMessage(const MeshMessage& msg) {
+void MeshNetwork::relayMessage(const MeshMessage& msg, const uint8_t* senderMac) {
     DEBUG_PRINTF("[MESH] Relaying message from %d to %d\n",
         msg.header.sourceId, msg.header.destId);
     
@@ -222,26 +402,35 @@ void MeshNetwork::relayMessage(const MeshMessage& msg) {
         }
     }
     
-    // Find next hop
-    MeshNode* nextHop = nullptr;
+    bool custody = CUSTODY_ENABLED &&
+        static_cast<MessageType>(relayMsg.header.messageType) == MessageType::IMAGE_CHUNK;
     
-    if (relayMsg.header.destId == GATEWAY_ID) {
-        nextHop = findGatewayRoute();
-    } else if (relayMsg.header.destId != BROADCAST_ID) {
-        nextHop = findNode(relayMsg.header.destId);
+    // A resend of a chunk we already hold only needs a fresh custody ACK
+    if (custody) {
+        portENTER_CRITICAL(&txQueueLock);
+        bool held = _chunkCache.find(relayMsg.header.sourceId,
+            ChunkCache::imageIdOf(relayMsg), relayMsg.header.chunkIndex) != nullptr;
+        portEXIT_CRITICAL(&txQueueLock);
+        
+        if (held) {
+            noteCustody(senderMac, relayMsg);
+            return;
+        }
     }
     
-    if (nextHop) {
-        // Send to specific node
-        addPeer(nextHop->macAddress);
-        
-        uint8_t buffer[250];
-        size_t len = MessageProtocol::serialize(relayMsg, buffer, sizeof(buffer));
-        
-        esp_now_send(nextHop->macAddress, buffer, len);
-    } else if (relayMsg.header.destId == BROADCAST_ID || relayMsg.header.destId == GATEWAY_ID) {
-        // Broadcast if no specific route
-        broadcast(relayMsg);
+    // Queue for transmission; sendMessage picks the next hop (or broadcasts)
+    if (!enqueueMessage(relayMsg)) {
+        DEBUG_PRINTF("[MESH] Relay queue full, dropped message from %d\n",
+            relayMsg.header.sourceId);
+        return;
+    }
+    
+    // Accepted: we now hold custody and answer for this chunk
+    if (custody) {
+        portENTER_CRITICAL(&txQueueLock);
+        _chunkCache.store(relayMsg);
+        portEXIT_CRITICAL(&txQueueLock);
+        noteCustody(senderMac, relayMsg);
     }
 }
 
@@ -255,6 +444,16 @@ bool MeshNetwork::sendMessage(const MeshMessage& msg) {
         dest = findNode(msg.header.destId);
     }
     
+    const uint8_t* targetMac = dest ? dest->macAddress : BROADCAST_MAC;
+    return transmitToMac(targetMac, msg);
+}
+
+bool MeshNetwork::transmitToMac(const uint8_t* targetMac, const MeshMessage& msg) {
+    // A sleeping child gets it when it next polls
+    if (holdForChild(targetMac, msg)) {
+        return true;
+    }
+    
     uint8_t buffer[250];
     size_t len = MessageProtocol::serialize(msg, buffer, sizeof(buffer));
     
@@ -263,14 +462,42 @@ bool MeshNetwork::sendMessage(const MeshMessage& msg) {
         return false;
     }
     
-    const uint8_t* targetMac = dest ? dest->macAddress : BROADCAST_MAC;
+    // Duty-cycled neighbour outside its window: hold non-urgent traffic
+    // for the window, wake-burst motion alerts through
+    MeshNode* node = findNodeByMac(targetMac);
+    if (node && !neighbourAwake(*node)) {
+        if (classifyMessage(msg) != TrafficClass::ALERT) {
+            return deferForWindow(targetMac, msg,
+                meshClock.msUntilWindow(node->wakePeriodMs, node->wakeOffsetMs), false);
+        }
+        return wakeBurst(*node, targetMac, msg, buffer, len);
+    }
+    
+    // Its window opened on its own: a burst still held for it is over
+    if (_burstActive && memcmp(targetMac, _burstMac, 6) == 0) {
+        _burstActive = false;
+    }
     
     // Ensure peer is added
     addPeer(targetMac);
     
+    bool sent = sendFrame(targetMac, buffer, len);
+    
+    // The MAC-layer ACK proves it is listening; keep talking for a moment
+    if (sent && node && node->wakePeriodMs > 0) {
+        node->awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+    }
+    
+    return sent;
+}
+
+bool MeshNetwork::sendFrame(const uint8_t* mac, const uint8_t* buffer, size_t len) {
+    radioOn();
+    
     // Send
     _sendInProgress = true;
-    esp_err_t result = esp_now_send(targetMac, buffer, len);
+    _sendStartUs = micros();
+    esp_err_t result = esp_now_send(mac, buffer, len);
     
     if (result != ESP_OK) {
         DEBUG_PRINTF("[MESH] esp_now_send error: %d\n", result);
@@ -295,34 +522,36 @@ bool MeshNetwork::broadcast(const MeshMessage& msg) {
         return false;
     }
     
-    _sendInProgress = true;
-    esp_err_t result = esp_now_send(BROADCAST_MAC, buffer, len);
-    
-    if (result != ESP_OK) {
-        _sendInProgress = false;
-        return false;
-    }
-    
-    // Wait for callback
-    unsigned long start = millis();
-    while (_sendInProgress && (millis() - start < 100)) {
-        delay(1);
+    // Duty-cycled neighbours only hear broadcasts in the shared window
+    if (dutyCycledNeighbours() && meshClock.isSynced() &&
+        !meshClock.inWindow(MESH_WAKE_PERIOD_MS, MESH_WAKE_OFFSET_MS, MESH_WAKE_WINDOW_MS) &&
+        classifyMessage(msg) != TrafficClass::ALERT) {
+        return deferForWindow(BROADCAST_MAC, msg,
+            meshClock.msUntilWindow(MESH_WAKE_PERIOD_MS, MESH_WAKE_OFFSET_MS), true);
     }
     
-    return _lastSendSuccess;
+    return sendFrame(BROADCAST_MAC, buffer, len);
 }
 
-bool MeshNetwork::sendImage(const uint8_t* imageData, size_t imageLength, uint16_t imageId) {
+bool MeshNetwork::sendImage(const uint8_t* imageData, size_t imageLength, uint16_t imageId, const ImageRegion* region,
+                            uint32_t capturedAt) {
     if (_imageTransferInProgress) {
         DEBUG_PRINTLN("[MESH] Image transfer already in progress");
         return false;
     }
     
+    // Restart intervals let the gateway use what arrives if chunks are lost
+    uint8_t* recoded = withRestartMarkers(imageData, imageLength);
+    if (recoded) {
+        imageData = recoded;
+    }
+    
     // Calculate chunks
     uint16_t totalChunks = (imageLength + IMG_CHUNK_SIZE - 1) / IMG_CHUNK_SIZE;
     
     if (totalChunks > IMG_MAX_CHUNKS) {
         DEBUG_PRINTLN("[MESH] Image too large");
+        free(recoded);
         return false;
     }
     
@@ -331,138 +560,736 @@ bool MeshNetwork::sendImage(const uint8_t* imageData, size_t imageLength, uint16
     
     _imageTransferInProgress = true;
     _currentImageId = imageId;
-    _currentChunk = 0;
-    _totalChunks = totalChunks;
+    _chunkBase = 0;
+    resetChunkState(totalChunks);
     
-    // Send IMAGE_START
+    // IMAGE_START is a request: hold the image until the gateway admits it
     MeshMessage startMsg = MessageProtocol::createImageStart(
-        DEVICE_ID, imageId, imageLength, totalChunks
+        DEVICE_ID, imageId, imageLength, totalChunks, region, 0, capturedAt
     );
-    if (!sendMessage(startMsg)) {
+    if (!requestImageGrant(startMsg)) {
+        DEBUG_PRINTLN("[MESH] No transfer grant from gateway");
         _imageTransferInProgress = false;
+        free(recoded);
         return false;
     }
     
-    // Send chunks
-    for (uint16_t i = 0; i < totalChunks; i++) {
-        size_t offset = i * IMG_CHUNK_SIZE;
-        size_t chunkSize = min((size_t)IMG_CHUNK_SIZE, imageLength - offset);
-        
-        MeshMessage chunkMsg = MessageProtocol::createImageChunk(
-            DEVICE_ID, imageId, i, imageData + offset, chunkSize
+    MeshMessage endMsg = MessageProtocol::createImageEnd(DEVICE_ID, imageId, totalChunks);
+    bool repaired = sendChunks(imageData, imageLength, imageId, startMsg, endMsg);
+    
+    _imageTransferInProgress = false;
+    free(recoded);
+    DEBUG_PRINTF("[MESH] Image transfer %s\n", repaired ? "complete" : "incomplete");
+    
+    return repaired;
+}
+
+bool MeshNetwork::beginClip(uint16_t imageId, uint8_t frameCount, size_t firstFrameLength, const ImageRegion* region,
+                            uint16_t* deferredMs) {
+    if (_imageTransferInProgress) {
+        DEBUG_PRINTLN("[MESH] Image transfer already in progress");
+        return false;
+    }
+    if (frameCount == 0 || frameCount > CLIP_MAX_FRAMES) {
+        return false;
+    }
+    
+    DEBUG_PRINTF("[MESH] Starting clip transfer: %d frames\n", frameCount);
+    
+    _imageTransferInProgress = true;
+    _currentImageId = imageId;
+    _chunkBase = 0;
+    _clipFramesSent = 0;
+    _clipLastSent = false;
+    resetChunkState(0);
+    
+    // The first frame's size stands in for the clip's in the admission request
+    uint16_t firstChunks = (firstFrameLength + IMG_CHUNK_SIZE - 1) / IMG_CHUNK_SIZE;
+    _clipStart = MessageProtocol::createImageStart(
+        DEVICE_ID, imageId, firstFrameLength, firstChunks, region, frameCount
+    );
+    if (!requestImageGrant(_clipStart, deferredMs)) {
+        DEBUG_PRINTLN("[MESH] No transfer grant from gateway");
+        _imageTransferInProgress = false;
+        return false;
+    }
+    return true;
+}
+
+bool MeshNetwork::sendClipFrame(const uint8_t* imageData, size_t imageLength, uint8_t frame, bool last) {
+    if (!_imageTransferInProgress || _clipLastSent || frame >= CLIP_MAX_FRAMES) {
+        return false;
+    }
+    
+    uint8_t* recoded = withRestartMarkers(imageData, imageLength);
+    if (recoded) {
+        imageData = recoded;
+    }
+    uint16_t totalChunks = (imageLength + IMG_CHUNK_SIZE - 1) / IMG_CHUNK_SIZE;
+    if (totalChunks > IMG_MAX_CHUNKS || totalChunks > CLIP_CHUNK_MASK + 1) {
+        free(recoded);
+        return false;
+    }
+    
+    DEBUG_PRINTF("[MESH] Clip frame %d: %u bytes, %u chunks\n", frame, imageLength, totalChunks);
+    
+    // Keep whatever credit the gateway already issued for this frame
+    uint16_t granted = _grantedChunks;
+    _chunkBase = (uint16_t)frame << CLIP_FRAME_SHIFT;
+    resetChunkState(totalChunks);
+    _grantedChunks = granted;
+    
+    MeshMessage endMsg = MessageProtocol::createClipFrameEnd(
+        DEVICE_ID, _currentImageId, totalChunks, frame | (last ? CLIP_FRAME_LAST : 0), imageLength
+    );
+    bool repaired = sendChunks(imageData, imageLength, _currentImageId, _clipStart, endMsg);
+    free(recoded);
+    
+    // The gateway grants the next frame once this one is forwarded
+    _grantedChunks = 0;
+    _clipFramesSent = frame + 1;
+    _clipLastSent = last;
+    
+    DEBUG_PRINTF("[MESH] Clip frame %d %s\n", frame, repaired ? "complete" : "incomplete");
+    return repaired;
+}
+
+void MeshNetwork::endClip() {
+    if (!_imageTransferInProgress) {
+        return;
+    }
+    
+    // Cut short: an empty final frame tells the gateway not to wait
+    if (!_clipLastSent) {
+        MeshMessage endMsg = MessageProtocol::createClipFrameEnd(
+            DEVICE_ID, _currentImageId, 0, _clipFramesSent | CLIP_FRAME_LAST, 0
         );
-        
-        // Send with retry
-        bool sent = false;
-        for (int retry = 0; retry < MSG_MAX_RETRIES && !sent; retry++) {
-            sent = sendMessage(chunkMsg);
-            if (!sent) {
-                delay(MSG_RETRY_DELAY_MS);
-            }
+        sendMessage(endMsg);
+    }
+    
+    _imageTransferInProgress = false;
+    _chunkBase = 0;
+    DEBUG_PRINTF("[MESH] Clip transfer done: %d frames\n", _clipFramesSent);
+}
+
+uint32_t MeshNetwork::getSendActiveMs() {
+    return _sendActiveUs / 1000;
+}
+
+void MeshNetwork::resetChunkState(uint16_t totalChunks) {
+    _currentChunk = 0;
+    _totalChunks = totalChunks;
+    _grantedChunks = 0;
+    _sendActiveUs = 0;
+    _repairPending = false;
+    portENTER_CRITICAL(&txQueueLock);
+    memset(_custodyMap, 0, sizeof(_custodyMap));
+    portEXIT_CRITICAL(&txQueueLock);
+}
+
+uint8_t* MeshNetwork::withRestartMarkers(const uint8_t* imageData, size_t& imageLength) {
+    #if JPEG_RESTART_ENABLED
+    // Markers, DC resets and chunk alignment add a few percent
+    size_t capacity = imageLength + imageLength / 4 + 1024;
+    uint8_t* recoded = (uint8_t*)ps_malloc(capacity);
+    if (!recoded) {
+        return nullptr;
+    }
+
+    unsigned long start = millis();
+    size_t length = JpegRestart::rewrite(imageData, imageLength, recoded, capacity,
+                                         JPEG_RESTART_MCUS, IMG_CHUNK_SIZE, JPEG_RESTART_MAX_PAD);
+    if (length == 0) {
+        // Not a JPEG this can recode: it goes out as it is
+        DEBUG_PRINTLN("[MESH] Image not recoded with restart markers");
+        free(recoded);
+        return nullptr;
+    }
+
+    DEBUG_PRINTF("[MESH] Restart markers added: %u -> %u bytes in %lu ms\n",
+        imageLength, length, millis() - start);
+    imageLength = length;
+    return recoded;
+    #else
+    return nullptr;
+    #endif
+}
+
+bool MeshNetwork::sendChunks(const uint8_t* imageData, size_t imageLength, uint16_t imageId,
+                             const MeshMessage& startMsg, const MeshMessage& endMsg) {
+    // Send chunks
+    for (uint16_t i = 0; i < _totalChunks; i++) {
+        // Stay within the credit the gateway has granted
+        if (i >= _grantedChunks && !waitForCredit(startMsg, i)) {
+            DEBUG_PRINTF("[MESH] Credit stalled at chunk %d\n", i);
+            return false;
         }
         
-        if (!sent) {
+        if (!sendImageChunk(imageData, imageLength, imageId, i)) {
             DEBUG_PRINTF("[MESH] Failed to send chunk %d\n", i);
-            _imageTransferInProgress = false;
             return false;
         }
         
         _currentChunk = i + 1;
         
+        // Let queued control traffic and alerts preempt the transfer,
+        // then give relayed transfers their share of the link
+        serviceTxQueues(TrafficClass::BULK);
+        serviceRelayShare();
+        
+        // Motion events keep being captured while the transfer runs
+        if (_serviceCallback) {
+            _serviceCallback();
+        }
+        
         // Small delay between chunks to avoid overwhelming receiver
+        unsigned long pacingStart = micros();
         delay(10);
+        _sendActiveUs += micros() - pacingStart;
+    }
+    
+    // Make sure the next hop took custody of every chunk
+    if (CUSTODY_ENABLED && !awaitCustody(imageData, imageLength, imageId)) {
+        DEBUG_PRINTLN("[MESH] Next hop did not take custody of all chunks");
     }
     
     // Send IMAGE_END
-    MeshMessage endMsg = MessageProtocol::createMessage(
-        DEVICE_ID, GATEWAY_ID, MessageType::IMAGE_END
-    );
-    uint8_t endPayload[4];
-    endPayload[0] = imageId & 0xFF;
-    endPayload[1] = (imageId >> 8) & 0xFF;
-    endPayload[2] = totalChunks & 0xFF;
-    endPayload[3] = (totalChunks >> 8) & 0xFF;
-    MessageProtocol::setPayload(endMsg, endPayload, 4);
     sendMessage(endMsg);
     
-    _imageTransferInProgress = false;
-    DEBUG_PRINTLN("[MESH] Image transfer complete");
-    
-    return true;
+    // Resend whatever the gateway still misses and no relay could supply
+    return serveImageRepairs(imageData, imageLength, imageId, endMsg);
 }
 
-bool MeshNetwork::sendMotionAlert(uint32_t timestamp, uint16_t imageId, bool hasImage) {
-    MeshMessage msg = MessageProtocol::createMotionAlert(
-        DEVICE_ID, timestamp, imageId, hasImage
+bool MeshNetwork::sendImageChunk(const uint8_t* imageData, size_t imageLength, uint16_t imageId, uint16_t chunkIndex) {
+    size_t offset = chunkIndex * IMG_CHUNK_SIZE;
+    size_t chunkSize = min((size_t)IMG_CHUNK_SIZE, imageLength - offset);
+    
+    MeshMessage chunkMsg = MessageProtocol::createImageChunk(
+        DEVICE_ID, imageId, _chunkBase | chunkIndex, imageData + offset, chunkSize
     );
-    return sendMessage(msg);
-}
-
-void MeshNetwork::sendHeartbeat() {
-    DEBUG_PRINTLN("[MESH] Sending heartbeat");
     
-    // Calculate hop count to gateway
-    uint8_t hopCount = 0;
-    MeshNode* gateway = findGatewayRoute();
-    if (gateway) {
-        hopCount = gateway->hopCount + 1;
+    // Our own chunks go out only in our TDMA slot, and only while the next
+    // hop is listening; keep the mesh serviced meanwhile
+    unsigned long waitStart = millis();
+    MeshNode* nextHop = findGatewayRoute();
+    while (!meshClock.inOwnSlot() || (nextHop && !neighbourAwake(*nextHop))) {
+        if (millis() - waitStart >= MESH_CHUNK_WAIT_MS) {
+            DEBUG_PRINTF("[MESH] Chunk %d: no slot with the next hop awake in %d ms\n",
+                chunkIndex, MESH_CHUNK_WAIT_MS);
+            return false;
+        }
+        serviceFor(1);
+        nextHop = findGatewayRoute();
     }
     
-    MeshMessage msg = MessageProtocol::createHeartbeat(
-        DEVICE_ID,
-        -50,  // RSSI placeholder
-        100,  // Battery placeholder (would need ADC reading)
-        hopCount
-    );
+    // Send with retry
+    unsigned long sendStart = micros();
+    bool sent = false;
+    for (int retry = 0; retry < MSG_MAX_RETRIES && !sent; retry++) {
+        sent = sendMessage(chunkMsg);
+        if (!sent) {
+            delay(MSG_RETRY_DELAY_MS);
+        }
+    }
+    _sendActiveUs += micros() - sendStart;
     
-    broadcast(msg);
+    return sent;
 }
 
-void MeshNetwork::updateRoutingTable(uint16_t nodeId, const uint8_t* mac, 
-    int8_t rssi, uint8_t hopCount, bool isGateway) {
-    
-    // Don't add ourselves
-    if (nodeId == DEVICE_ID) {
-        return;
+bool MeshNetwork::awaitCustody(const uint8_t* imageData, size_t imageLength, uint16_t imageId) {
+    for (int round = 0; round <= MSG_MAX_RETRIES; round++) {
+        // Give the next hop time to batch its ACK
+        unsigned long start = millis();
+        bool missing = true;
+        while (missing && millis() - start < CUSTODY_RETRY_MS) {
+            missing = false;
+            for (uint16_t i = 0; i < _totalChunks && !missing; i++) {
+                missing = !hasCustody(i);
+            }
+            if (missing) {
+                serviceFor(1);
+            }
+        }
+        
+        if (!missing) {
+            return true;
+        }
+        if (round == MSG_MAX_RETRIES) {
+            break;
+        }
+        
+        // Resend chunks the next hop never acknowledged
+        for (uint16_t i = 0; i < _totalChunks; i++) {
+            if (!hasCustody(i)) {
+                DEBUG_PRINTF("[MESH] Custody resend of chunk %d\n", i);
+                sendImageChunk(imageData, imageLength, imageId, i);
+            }
+        }
     }
     
-    // Find existing node
-    MeshNode* existing = findNode(nodeId);
-    
-    if (existing) {
-        // Update existing entry
-        memcpy(existing->macAddress, mac, 6);
-        existing->rssi = rssi;
-        existing->hopCount = hopCount;
-        existing->lastSeen = millis();
-        existing->isGateway = isGateway;
-        existing->isReachable = true;
-    } else {
-        // Add new node
-        if (_nodes.size() < MESH_MAX_NODES) {
-            MeshNode node;
-            node.nodeId = nodeId;
-            memcpy(node.macAddress, mac, 6);
-            node.rssi = rssi;
-            node.hopCount = hopCount;
-            node.lastSeen = millis();
-            node.isGateway = isGateway;
-            node.isReachable = true;
-            
-            _nodes.push_back(node);
-            
-            // Add as ESP-NOW peer
-            addPeer(mac);
-            
-            DEBUG_PRINTF("[MESH] New node discovered: %d (Gateway: %s)\n", 
-                nodeId, isGateway ? "YES" : "NO");
+    return false;
+}
+
+bool MeshNetwork::hasCustody(uint16_t chunk) {
+    portENTER_CRITICAL(&txQueueLock);
+    bool held = _custodyMap[chunk / 8] & (1 << (chunk % 8));
+    portEXIT_CRITICAL(&txQueueLock);
+    return held;
+}
+
+bool MeshNetwork::serveImageRepairs(const uint8_t* imageData, size_t imageLength, uint16_t imageId, const MeshMessage& endMsg) {
+    for (int round = 0; round < IMG_REPAIR_ROUNDS; round++) {
+        // The gateway answers IMAGE_END with a NACK and repeats it while
+        // repair stalls; an empty one means done. Waiting past its repeat
+        // interval rides out one lost NACK.
+        ImageNackPayload request;
+        bool answered = false;
+        unsigned long start = millis();
+        while (!answered && millis() - start < IMG_REPAIR_WAIT_MS) {
+            if (!_repairPending) {
+                serviceFor(1);
+                continue;
+            }
+            portENTER_CRITICAL(&txQueueLock);
+            request = _repairRequest;
+            _repairPending = false;
+            portEXIT_CRITICAL(&txQueueLock);
             
-            // Notify callback
-            if (_nodeCallback) {
-                _nodeCallback(node);
+            // A late NACK for an earlier image is no answer
+            answered = request.imageId == imageId;
+        }
+        
+        if (answered && request.count == 0) {
+            return true;
+        }
+        if (round + 1 == IMG_REPAIR_ROUNDS) {
+            break;
+        }
+        
+        if (answered) {
+            DEBUG_PRINTF("[MESH] Gateway missing %d chunks, resending\n", request.count);
+            for (uint8_t i = 0; i < request.count; i++) {
+                // Clip frames: only chunks of the frame being sent
+                uint16_t chunk = request.chunks[i] - _chunkBase;
+                if (request.chunks[i] >= _chunkBase && chunk < _totalChunks) {
+                    sendImageChunk(imageData, imageLength, imageId, chunk);
+                }
             }
+        } else {
+            // IMAGE_END or the NACK was lost: ask again
+            DEBUG_PRINTF("[MESH] No NACK for image %d, resending IMAGE_END\n", imageId);
         }
+        sendMessage(endMsg);
     }
+    
+    DEBUG_PRINTF("[MESH] Gateway never confirmed image %d\n", imageId);
+    return false;
+}
+
+bool MeshNetwork::sendImageNack(uint16_t destId, uint16_t imageId, const uint16_t* chunks, uint8_t count) {
+    MeshMessage msg = MessageProtocol::createImageNack(DEVICE_ID, destId, imageId, chunks, count);
+    return enqueueMessage(msg);
+}
+
+void MeshNetwork::handleImageNack(const MeshMessage& msg) {
+    if (msg.payloadLength < 3) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&txQueueLock);
+    memset(&_repairRequest, 0, sizeof(_repairRequest));
+    memcpy(&_repairRequest, msg.payload, min((size_t)msg.payloadLength, sizeof(_repairRequest)));
+    _repairRequest.count = min(_repairRequest.count, (uint8_t)IMG_NACK_MAX_CHUNKS);
+    _repairPending = true;
+    portEXIT_CRITICAL(&txQueueLock);
+}
+
+void MeshNetwork::noteCustody(const uint8_t* upstreamMac, const MeshMessage& chunk) {
+    uint16_t imageSource = chunk.header.sourceId;
+    uint16_t imageId = ChunkCache::imageIdOf(chunk);
+    uint16_t chunkIndex = chunk.header.chunkIndex;
+    CustodyAckState* slot = nullptr;
+    CustodyAckState* oldest = nullptr;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    for (uint8_t i = 0; i < CUSTODY_ACK_SLOTS; i++) {
+        CustodyAckState& ack = _custodyAcks[i];
+        if (ack.pending && ack.imageSource == imageSource && ack.imageId == imageId &&
+            memcmp(ack.mac, upstreamMac, 6) == 0) {
+            slot = &ack;
+            break;
+        }
+        if (!oldest || !ack.pending || (oldest->pending && ack.firstAt < oldest->firstAt)) {
+            oldest = &ack;
+        }
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    // Chunk outside the current bitmap: send what we have, start over
+    if (slot && (chunkIndex < slot->baseChunk || chunkIndex - slot->baseChunk >= 32)) {
+        flushCustodyAck(*slot);
+    }
+    if (!slot) {
+        slot = oldest;
+        if (slot->pending) {
+            flushCustodyAck(*slot);
+        }
+    }
+    
+    portENTER_CRITICAL(&txQueueLock);
+    if (!slot->pending) {
+        memcpy(slot->mac, upstreamMac, 6);
+        slot->imageSource = imageSource;
+        slot->imageId = imageId;
+        slot->baseChunk = chunkIndex;
+        slot->bitmap = 0;
+        slot->count = 0;
+        slot->firstAt = millis();
+        slot->pending = true;
+    }
+    slot->bitmap |= 1UL << (chunkIndex - slot->baseChunk);
+    slot->count++;
+    bool full = slot->count >= CUSTODY_ACK_BATCH;
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    if (full) {
+        flushCustodyAck(*slot);
+    } else if (!timerWheel.isArmed(_custodyAckTimer)) {
+        timerWheel.arm(_custodyAckTimer, CUSTODY_ACK_DELAY_MS);
+    }
+}
+
+void MeshNetwork::flushCustodyAck(CustodyAckState& ack) {
+    portENTER_CRITICAL(&txQueueLock);
+    if (!ack.pending) {
+        portEXIT_CRITICAL(&txQueueLock);
+        return;
+    }
+    CustodyAckState copy = ack;
+    ack.pending = false;
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    MeshMessage msg = MessageProtocol::createCustodyAck(
+        DEVICE_ID, copy.imageSource, copy.imageId, copy.baseChunk, copy.bitmap
+    );
+    enqueueMessage(msg, copy.mac);
+}
+
+void MeshNetwork::flushStaleCustodyAcks() {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < CUSTODY_ACK_SLOTS; i++) {
+        if (_custodyAcks[i].pending && now - _custodyAcks[i].firstAt >= CUSTODY_ACK_DELAY_MS) {
+            flushCustodyAck(_custodyAcks[i]);
+        }
+    }
+}
+
+void MeshNetwork::handleCustodyAck(const MeshMessage& msg) {
+    const CustodyAckPayload* ack = reinterpret_cast<const CustodyAckPayload*>(msg.payload);
+    uint16_t imageSource = msg.header.destId;
+    
+    // Our own image: mark the chunks the next hop has taken
+    if (imageSource == DEVICE_ID) {
+        portENTER_CRITICAL(&txQueueLock);
+        if (_imageTransferInProgress && ack->imageId == _currentImageId) {
+            for (uint8_t bit = 0; bit < 32; bit++) {
+                uint32_t chunk = (uint32_t)ack->baseChunk + bit - _chunkBase;
+                if ((ack->bitmap & (1UL << bit)) && ack->baseChunk + bit >= _chunkBase && chunk < _totalChunks) {
+                    _custodyMap[chunk / 8] |= 1 << (chunk % 8);
+                }
+            }
+        }
+        portEXIT_CRITICAL(&txQueueLock);
+        return;
+    }
+    
+    // A chunk we relayed: the next hop holds it now
+    portENTER_CRITICAL(&txQueueLock);
+    _chunkCache.acknowledge(imageSource, ack->imageId, ack->baseChunk, ack->bitmap);
+    portEXIT_CRITICAL(&txQueueLock);
+}
+
+void MeshNetwork::serviceCustodyRetries() {
+    uint32_t now = millis();
+    
+    for (uint16_t i = 0; i < _chunkCache.capacity(); i++) {
+        MeshMessage resend;
+        bool due = false;
+        
+        portENTER_CRITICAL(&txQueueLock);
+        CachedChunk* entry = _chunkCache.entry(i);
+        if (entry && entry->used && entry->awaitingCustody &&
+            now - entry->sentAt >= CUSTODY_RETRY_MS) {
+            // Out of retries: stop waiting but keep the chunk for NACK repairs
+            entry->awaitingCustody = false;
+            if (entry->retriesLeft > 0) {
+                entry->retriesLeft--;
+                resend = entry->message;
+                due = true;
+            }
+        }
+        portEXIT_CRITICAL(&txQueueLock);
+        
+        if (due) {
+            enqueueMessage(resend);
+        }
+    }
+}
+
+bool MeshNetwork::serveRepairFromCache(MeshMessage& nack) {
+    if (nack.payloadLength < 3) {
+        return true;
+    }
+    
+    ImageNackPayload request;
+    memset(&request, 0, sizeof(request));
+    memcpy(&request, nack.payload, min((size_t)nack.payloadLength, sizeof(request)));
+    request.count = min(request.count, (uint8_t)IMG_NACK_MAX_CHUNKS);
+    uint16_t imageSource = nack.header.destId;
+    
+    // Completion notice: the cached chunks of this image are no longer needed
+    if (request.count == 0) {
+        portENTER_CRITICAL(&txQueueLock);
+        _chunkCache.evictImage(imageSource, request.imageId);
+        portEXIT_CRITICAL(&txQueueLock);
+        return true;
+    }
+    
+    uint8_t remaining = 0;
+    for (uint8_t i = 0; i < request.count; i++) {
+        MeshMessage cached;
+        bool held = false;
+        
+        portENTER_CRITICAL(&txQueueLock);
+        CachedChunk* entry = _chunkCache.find(imageSource, request.imageId, request.chunks[i]);
+        if (entry) {
+            cached = entry->message;
+            held = true;
+        }
+        portEXIT_CRITICAL(&txQueueLock);
+        
+        if (held && enqueueMessage(cached)) {
+            DEBUG_PRINTF("[MESH] Repaired chunk %d of image %d from cache\n",
+                request.chunks[i], request.imageId);
+        } else {
+            request.chunks[remaining++] = request.chunks[i];
+        }
+    }
+    
+    if (remaining == 0) {
+        return false;
+    }
+    
+    // Forward only the chunks we could not supply
+    request.count = remaining;
+    MessageProtocol::setPayload(nack, &request, 3 + remaining * sizeof(uint16_t));
+    return true;
+}
+
+bool MeshNetwork::requestImageGrant(const MeshMessage& startMsg, uint16_t* deferredMs) {
+    unsigned long start = millis();
+    if (deferredMs) {
+        *deferredMs = 0;
+    }
+    
+    while (millis() - start < IMG_GRANT_WAIT_MS) {
+        _grantRetryAfterMs = 0;
+        sendMessage(startMsg);
+        
+        // Wait for a grant or a deferral
+        unsigned long sent = millis();
+        while (_grantedChunks == 0 && _grantRetryAfterMs == 0 &&
+               millis() - sent < IMG_GRANT_REQUEST_TIMEOUT_MS) {
+            serviceFor(1);
+        }
+        
+        if (_grantedChunks > 0) {
+            DEBUG_PRINTF("[MESH] Transfer granted: %d chunks\n", _grantedChunks);
+            return true;
+        }
+        
+        // Deferred: stay queued locally until the gateway expects capacity
+        if (_grantRetryAfterMs > 0 && deferredMs) {
+            DEBUG_PRINTF("[MESH] Transfer deferred for %d ms\n", _grantRetryAfterMs);
+            *deferredMs = _grantRetryAfterMs;
+            return false;
+        }
+        if (_grantRetryAfterMs > 0) {
+            DEBUG_PRINTF("[MESH] Transfer deferred for %d ms\n", _grantRetryAfterMs);
+            serviceFor(_grantRetryAfterMs);
+        }
+    }
+    
+    return false;
+}
+
+bool MeshNetwork::waitForCredit(const MeshMessage& startMsg, uint16_t chunkIndex) {
+    for (int attempt = 0; attempt < MSG_MAX_RETRIES; attempt++) {
+        unsigned long start = millis();
+        while (millis() - start < IMG_GRANT_REQUEST_TIMEOUT_MS) {
+            if (_grantedChunks > chunkIndex) {
+                return true;
+            }
+            serviceFor(1);
+        }
+        
+        // Top-up may have been lost; a repeated IMAGE_START returns the current grant
+        sendMessage(startMsg);
+    }
+    
+    return _grantedChunks > chunkIndex;
+}
+
+void MeshNetwork::serviceFor(uint32_t durationMs) {
+    // Keep heartbeats and queued traffic moving while a transfer is blocked
+    unsigned long start = millis();
+    do {
+        timerWheel.advance();
+        update();
+        if (_serviceCallback) {
+            _serviceCallback();
+        }
+        delay(1);
+    } while (millis() - start < durationMs);
+}
+
+void MeshNetwork::handleImageGrant(const MeshMessage& msg) {
+    if (msg.payloadLength < sizeof(ImageGrantPayload)) {
+        return;
+    }
+    
+    const ImageGrantPayload* grant = reinterpret_cast<const ImageGrantPayload*>(msg.payload);
+    if (!_imageTransferInProgress || grant->imageId != _currentImageId) {
+        DEBUG_PRINTF("[MESH] Ignoring grant for image %d\n", grant->imageId);
+        return;
+    }
+    
+    if (grant->grantedChunks == 0) {
+        _grantRetryAfterMs = max((uint16_t)1, grant->retryAfterMs);
+    } else if (grant->grantedChunks > _grantedChunks) {
+        _grantedChunks = grant->grantedChunks;
+    }
+}
+
+bool MeshNetwork::sendImageGrant(uint16_t destId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs) {
+    MeshMessage msg = MessageProtocol::createImageGrant(
+        DEVICE_ID, destId, imageId, grantedChunks, retryAfterMs
+    );
+    // Called from the receive path, so queue rather than block
+    return enqueueMessage(msg);
+}
+
+bool MeshNetwork::sendImageFetch(uint16_t destId, uint16_t imageId) {
+    MeshMessage msg = MessageProtocol::createImageFetch(DEVICE_ID, destId, imageId);
+    return enqueueMessage(msg);
+}
+
+bool MeshNetwork::sendCommand(uint16_t destId, CommandType command) {
+    MeshMessage msg = MessageProtocol::createCommand(DEVICE_ID, destId, command);
+    return enqueueMessage(msg);
+}
+
+bool MeshNetwork::sendLiveView(uint16_t destId, uint16_t leaseMs) {
+    MeshMessage msg = MessageProtocol::createLiveView(DEVICE_ID, destId, leaseMs);
+    return enqueueMessage(msg);
+}
+
+bool MeshNetwork::sendArchivePull(uint16_t destId, uint16_t imageId, uint32_t since, uint8_t maxImages) {
+    MeshMessage msg = MessageProtocol::createArchivePull(DEVICE_ID, destId, imageId, since, maxImages);
+    return enqueueMessage(msg);
+}
+
+bool MeshNetwork::sendMotionAlert(uint32_t timestamp, uint16_t imageId, bool hasImage, uint8_t confidence) {
+    MeshMessage msg = MessageProtocol::createMotionAlert(
+        DEVICE_ID, timestamp, imageId, hasImage, confidence
+    );
+    return sendMessage(msg);
+}
+
+void MeshNetwork::sendHeartbeat() {
+    DEBUG_PRINTLN("[MESH] Sending heartbeat");
+    
+    // Calculate hop count to gateway
+    uint8_t hopCount = 0;
+    MeshNode* gateway = findGatewayRoute();
+    if (gateway) {
+        hopCount = gateway->hopCount + 1;
+    }
+    
+    MeshMessage msg = MessageProtocol::createHeartbeat(
+        DEVICE_ID,
+        -50,  // RSSI placeholder
+        100,  // Battery placeholder (would need ADC reading)
+        hopCount
+    );
+    
+    // Heartbeats are telemetry; they yield to everything else
+    enqueueMessage(msg);
+}
+
+void MeshNetwork::updateRoutingTable(uint16_t nodeId, const uint8_t* mac, 
+    int8_t rssi, uint8_t hopCount, bool isGateway) {
+    
+    // Don't add ourselves
+    if (nodeId == DEVICE_ID) {
+        return;
+    }
+    
+    // Find existing node
+    MeshNode* existing = findNode(nodeId);
+    
+    if (existing) {
+        // Update existing entry
+        memcpy(existing->macAddress, mac, 6);
+        existing->rssi = rssi;
+        existing->hopCount = hopCount;
+        existing->lastSeen = millis();
+        existing->isGateway = isGateway;
+        existing->isReachable = true;
+    } else {
+        // Add new node
+        if (_nodes.size() < MESH_MAX_NODES) {
+            MeshNode node;
+            node.nodeId = nodeId;
+            memcpy(node.macAddress, mac, 6);
+            node.rssi = rssi;
+            node.hopCount = hopCount;
+            node.lastSeen = millis();
+            node.isGateway = isGateway;
+            node.isReachable = true;
+            node.isSleepy = false;
+            node.wakePeriodMs = 0;
+            node.wakeOffsetMs = 0;
+            node.wakeWindowMs = 0;
+            node.awakeUntil = 0;
+            
+            _nodes.push_back(node);
+            
+            // Add as ESP-NOW peer
+            addPeer(mac);
+            
+            DEBUG_PRINTF("[MESH] New node discovered: %d (Gateway: %s)\n", 
+                nodeId, isGateway ? "YES" : "NO");
+            
+            // Notify callback
+            if (_nodeCallback) {
+                _nodeCallback(node);
+            }
+        }
+    }
+}
+
+void MeshNetwork::noteNodeSeen(uint16_t nodeId, const uint8_t* mac) {
+    MeshNode* existing = findNode(nodeId);
+    if (existing) {
+        existing->lastSeen = millis();
+        existing->isReachable = true;
+        return;
+    }
+    
+    // Unknown until its first heartbeat: a direct neighbour for now
+    // Note: RSSI would need to be obtained differently in newer ESP-IDF
+    updateRoutingTable(nodeId, mac, -50, 1, false);
 }
 
 void MeshNetwork::pruneRoutingTable() {
@@ -477,6 +1304,8 @@ void MeshNetwork::pruneRoutingTable() {
             ++it;
         }
     }
+    
+    expireSleepyChildren();
 }
 
 MeshNode* MeshNetwork::findNode(uint16_t nodeId) {
@@ -502,7 +1331,7 @@ MeshNode* MeshNetwork::findGatewayRoute() {
     int8_t bestRssi = -128;
     
     for (auto& node : _nodes) {
-        if (node.isGateway && node.isReachable) {
+        if (node.isGateway && node.isReachable && !node.isSleepy) {
             if (node.rssi > bestRssi) {
                 bestRssi = node.rssi;
                 bestRoute = &node;
@@ -514,7 +1343,7 @@ MeshNode* MeshNetwork::findGatewayRoute() {
     if (!bestRoute) {
         uint8_t minHops = 255;
         for (auto& node : _nodes) {
-            if (node.isReachable && node.hopCount < minHops) {
+            if (node.isReachable && !node.isSleepy && node.hopCount < minHops) {
                 minHops = node.hopCount;
                 bestRoute = &node;
             }
@@ -552,19 +1381,284 @@ bool MeshNetwork::removePeer(const uint8_t* mac) {
     return esp_now_del_peer(mac) == ESP_OK;
 }
 
-void MeshNetwork::processMessageQueue() {
-    // Process retry queue (simplified implementation)
-    // A full implementation would handle ACK timeouts and retries
+bool MeshNetwork::queueMessage(const MeshMessage& msg, uint8_t retries) {
+    PendingMessage* slot = nullptr;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    for (auto& pending : _pending) {
+        if (!pending.waitingAck) {
+            pending.message = msg;
+            pending.retriesLeft = retries;
+            pending.waitingAck = true;
+            slot = &pending;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    if (!slot) {
+        DEBUG_PRINTLN("[MESH] Pending table full");
+        return false;
+    }
+    
+    enqueueMessage(msg);
+    timerWheel.arm(slot->retryTimer, MSG_RETRY_DELAY_MS);
+    return true;
+}
+
+void MeshNetwork::acknowledgePending(uint16_t sequence) {
+    for (auto& pending : _pending) {
+        if (pending.waitingAck && pending.message.header.sequenceNum == sequence) {
+            timerWheel.cancel(pending.retryTimer);
+            pending.waitingAck = false;
+            return;
+        }
+    }
+}
+
+void MeshNetwork::onRetryTimer(void* context) {
+    PendingMessage* pending = static_cast<PendingMessage*>(context);
+    if (!pending->waitingAck || !_instance) {
+        return;
+    }
+    
+    if (pending->retriesLeft == 0) {
+        DEBUG_PRINTF("[MESH] No ACK for seq %d, giving up\n", pending->message.header.sequenceNum);
+        pending->waitingAck = false;
+        return;
+    }
+    
+    pending->retriesLeft--;
+    _instance->enqueueMessage(pending->message);
+    timerWheel.arm(pending->retryTimer, MSG_RETRY_DELAY_MS);
+}
+
+bool MeshNetwork::allocateTxQueues() {
+    if (!_relayQueue.begin(TXQ_BULK_LIMIT, FAIRQ_PER_SOURCE_LIMIT, FAIRQ_QUANTUM_BYTES)) {
+        return false;
+    }
+    
+    for (uint8_t i = 0; i < static_cast<uint8_t>(TrafficClass::COUNT); i++) {
+        TxQueue& queue = _txQueues[i];
+        if (queue.frames || i == static_cast<uint8_t>(TrafficClass::BULK)) {
+            continue;
+        }
+        queue.frames = new (std::nothrow) QueuedFrame[TXQ_LIMITS[i]];
+        if (!queue.frames) {
+            return false;
+        }
+        queue.capacity = TXQ_LIMITS[i];
+        queue.head = 0;
+        queue.count = 0;
+    }
+    return true;
+}
+
+TrafficClass MeshNetwork::classifyMessage(const MeshMessage& msg) {
+    switch (static_cast<MessageType>(msg.header.messageType)) {
+        case MessageType::ACK:
+        case MessageType::NACK:
+        case MessageType::DISCOVER:
+        case MessageType::DISCOVER_RESP:
+        case MessageType::COMMAND:
+        case MessageType::IMAGE_GRANT:
+        case MessageType::DATA_POLL:
+            return TrafficClass::CONTROL;
+            
+        case MessageType::MOTION_ALERT:
+            return TrafficClass::ALERT;
+            
+        case MessageType::IMAGE_START:
+        case MessageType::IMAGE_CHUNK:
+        case MessageType::IMAGE_END:
+            return TrafficClass::BULK;
+            
+        default:
+            return TrafficClass::TELEMETRY;
+    }
+}
+
+bool MeshNetwork::enqueueMessage(const MeshMessage& msg, const uint8_t* nextHopMac) {
+    uint8_t cls = static_cast<uint8_t>(classifyMessage(msg));
+    TxQueue& queue = _txQueues[cls];
+    TrafficClassStats& stats = _txStats[cls];
+    bool accepted = false;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    if (cls == static_cast<uint8_t>(TrafficClass::BULK)) {
+        QueuedFrame frame;
+        frame.message = msg;
+        frame.enqueueTime = millis();
+        frame.hasNextHop = nextHopMac != nullptr;
+        if (nextHopMac) {
+            memcpy(frame.nextHopMac, nextHopMac, 6);
+        }
+        accepted = _relayQueue.enqueue(frame);
+        if (accepted) {
+            stats.depth = _relayQueue.size();
+        }
+    } else if (queue.frames && queue.count < queue.capacity) {
+        QueuedFrame& slot = queue.frames[(queue.head + queue.count) % queue.capacity];
+        slot.message = msg;
+        slot.enqueueTime = millis();
+        slot.hasNextHop = nextHopMac != nullptr;
+        if (nextHopMac) {
+            memcpy(slot.nextHopMac, nextHopMac, 6);
+        }
+        queue.count++;
+        stats.depth = queue.count;
+        accepted = true;
+    }
+    
+    if (accepted) {
+        stats.enqueued++;
+        if (stats.depth > stats.peakDepth) {
+            stats.peakDepth = stats.depth;
+        }
+    } else {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    // Queued from the ESP-NOW task: get the loop to send it
+    if (accepted) {
+        timerWheel.wake();
+    }
+    
+    return accepted;
+}
+
+bool MeshNetwork::popFrame(TrafficClass cls, QueuedFrame& frame) {
+    TxQueue& queue = _txQueues[static_cast<uint8_t>(cls)];
+    bool found = false;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    if (cls == TrafficClass::BULK) {
+        found = _relayQueue.dequeue(frame);
+        _txStats[static_cast<uint8_t>(cls)].depth = _relayQueue.size();
+    } else if (queue.count > 0) {
+        frame = queue.frames[queue.head];
+        queue.head = (queue.head + 1) % queue.capacity;
+        queue.count--;
+        _txStats[static_cast<uint8_t>(cls)].depth = queue.count;
+        found = true;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    return found;
+}
+
+bool MeshNetwork::requeueAtHead(const MeshMessage& msg, const uint8_t* nextHopMac) {
+    uint8_t cls = static_cast<uint8_t>(classifyMessage(msg));
+    TxQueue& queue = _txQueues[cls];
+    bool accepted = false;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    if (cls != static_cast<uint8_t>(TrafficClass::BULK) && queue.frames && queue.count < queue.capacity) {
+        queue.head = (queue.head + queue.capacity - 1) % queue.capacity;
+        QueuedFrame& slot = queue.frames[queue.head];
+        slot.message = msg;
+        slot.enqueueTime = millis();
+        slot.hasNextHop = true;
+        memcpy(slot.nextHopMac, nextHopMac, 6);
+        queue.count++;
+        _txStats[cls].depth = queue.count;
+        accepted = true;
+    } else {
+        _txStats[cls].dropped++;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    return accepted;
+}
+
+bool MeshNetwork::transmitNext(TrafficClass floor) {
+    // Highest-priority non-empty class strictly above the floor wins
+    for (uint8_t i = 0; i < static_cast<uint8_t>(floor); i++) {
+        // Bulk waits for our TDMA slot; lower classes may go meanwhile
+        if (i == static_cast<uint8_t>(TrafficClass::BULK) && !meshClock.inOwnSlot()) {
+            continue;
+        }
+        
+        // Alerts wait out a wake burst's gap; control traffic goes meanwhile
+        if (i == static_cast<uint8_t>(TrafficClass::ALERT) && timerWheel.isArmed(_burstTimer)) {
+            continue;
+        }
+        
+        QueuedFrame frame;
+        if (!popFrame(static_cast<TrafficClass>(i), frame)) {
+            continue;
+        }
+        
+        if (frame.message.header.sourceId == DEVICE_ID) {
+            MessageProtocol::stampClock(frame.message);
+        }
+        
+        uint32_t latency = millis() - frame.enqueueTime;
+        TrafficClassStats& stats = _txStats[i];
+        stats.sent++;
+        stats.totalLatencyMs += latency;
+        if (latency > stats.maxLatencyMs) {
+            stats.maxLatencyMs = latency;
+        }
+        
+        if (frame.hasNextHop) {
+            transmitToMac(frame.nextHopMac, frame.message);
+        } else if (frame.message.header.destId == BROADCAST_ID) {
+            broadcast(frame.message);
+        } else {
+            sendMessage(frame.message);
+        }
+        
+        if (i == static_cast<uint8_t>(TrafficClass::BULK)) {
+            portENTER_CRITICAL(&txQueueLock);
+            _relayQueue.chargeAirtime(frame.message.header.sourceId, _lastAirtimeUs);
+            
+            // Relayed chunk is on its way; expect custody from the next hop
+            if (CUSTODY_ENABLED &&
+                static_cast<MessageType>(frame.message.header.messageType) == MessageType::IMAGE_CHUNK) {
+                _chunkCache.markSent(_chunkCache.find(frame.message.header.sourceId,
+                    ChunkCache::imageIdOf(frame.message), frame.message.header.chunkIndex));
+            }
+            portEXIT_CRITICAL(&txQueueLock);
+            
+            if (CUSTODY_ENABLED && !timerWheel.isArmed(_custodyRetryTimer)) {
+                timerWheel.arm(_custodyRetryTimer, CUSTODY_RETRY_MS);
+            }
+        }
+        return true;
+    }
+    return false;
 }
 
-void MeshNetwork::queueMessage(const MeshMessage& msg, uint8_t retries) {
-    PendingMessage pending;
-    pending.message = msg;
-    pending.retriesLeft = retries;
-    pending.nextRetryTime = millis() + MSG_RETRY_DELAY_MS;
-    pending.waitingAck = true;
+void MeshNetwork::serviceTxQueues(TrafficClass floor) {
+    // Re-scan from the top after every frame so newly queued
+    // high-priority traffic overtakes anything lower
+    while (transmitNext(floor)) {
+    }
+    
+    // Bulk held back for our TDMA slot: come back when it opens
+    portENTER_CRITICAL(&txQueueLock);
+    bool bulkWaiting = _relayQueue.size() > 0;
+    portEXIT_CRITICAL(&txQueueLock);
     
-    _messageQueue.push(pending);
+    if (bulkWaiting && !timerWheel.isArmed(_slotTimer)) {
+        timerWheel.arm(_slotTimer, meshClock.msUntilOwnSlot());
+    }
+}
+
+void MeshNetwork::serviceRelayShare() {
+    // One frame per backlogged relay source, so our own transfer counts
+    // as just another flow on the link
+    portENTER_CRITICAL(&txQueueLock);
+    uint8_t flows = _relayQueue.activeFlows();
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    for (uint8_t i = 0; i < flows; i++) {
+        if (!transmitNext(TrafficClass::TELEMETRY)) {
+            break;
+        }
+    }
 }
 
 std::vector<MeshNode>& MeshNetwork::getNodes() {
@@ -579,10 +1673,86 @@ void MeshNetwork::setNodeDiscoveredCallback(NodeCallback callback) {
     _nodeCallback = callback;
 }
 
+void MeshNetwork::setServiceCallback(ServiceCallback callback) {
+    _serviceCallback = callback;
+}
+
 uint16_t MeshNetwork::getDeviceId() {
     return DEVICE_ID;
 }
 
+uint8_t MeshNetwork::getHopDepth() {
+    MeshNode* gateway = findGatewayRoute();
+    return gateway ? gateway->hopCount + 1 : 0;
+}
+
+bool MeshNetwork::isIdle() {
+    if (_imageTransferInProgress) {
+        return false;
+    }
+    
+    // The queues are written from the WiFi task; BULK frames, our own
+    // custody resends included, wait in the relay queue
+    portENTER_CRITICAL(&txQueueLock);
+    bool idle = _relayQueue.size() == 0;
+    for (auto& queue : _txQueues) {
+        idle = idle && queue.count == 0;
+    }
+    for (auto& pending : _pending) {
+        idle = idle && !pending.waitingAck;
+    }
+    for (auto& deferred : _deferred) {
+        idle = idle && !deferred.used;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    return idle;
+}
+
+void MeshNetwork::saveState() {
+    // The current gateway route first, so it survives if the table is full
+    MeshNode* route = findGatewayRoute();
+    rtcRouteCount = 0;
+    if (route) {
+        RtcRoute& saved = rtcRoutes[rtcRouteCount++];
+        saved.nodeId = route->nodeId;
+        memcpy(saved.macAddress, route->macAddress, 6);
+        saved.rssi = route->rssi;
+        saved.hopCount = route->hopCount;
+        saved.isGateway = route->isGateway;
+    }
+    for (auto& node : _nodes) {
+        if (rtcRouteCount == MESH_RTC_NODES) {
+            break;
+        }
+        if (&node == route || !node.isReachable || node.isSleepy) {
+            continue;
+        }
+        RtcRoute& saved = rtcRoutes[rtcRouteCount++];
+        saved.nodeId = node.nodeId;
+        memcpy(saved.macAddress, node.macAddress, 6);
+        saved.rssi = node.rssi;
+        saved.hopCount = node.hopCount;
+        saved.isGateway = node.isGateway;
+    }
+    rtcRoutesMagic = MESH_RTC_MAGIC;
+    DEBUG_PRINTF("[MESH] %d routes saved for deep sleep\n", rtcRouteCount);
+}
+
+bool MeshNetwork::restoreState() {
+    if (rtcRoutesMagic != MESH_RTC_MAGIC) {
+        return false;
+    }
+    
+    // Taken as just heard: they age out as usual if they stay silent
+    for (uint8_t i = 0; i < rtcRouteCount && i < MESH_RTC_NODES; i++) {
+        const RtcRoute& saved = rtcRoutes[i];
+        updateRoutingTable(saved.nodeId, saved.macAddress, saved.rssi, saved.hopCount, saved.isGateway);
+    }
+    DEBUG_PRINTF("[MESH] %d routes restored after deep sleep\n", rtcRouteCount);
+    return rtcRouteCount > 0;
+}
+
 void MeshNetwork::getMacAddress(uint8_t* mac) {
     memcpy(mac, _macAddress, 6);
 }
@@ -598,3 +1768,354 @@ uint32_t MeshNetwork::getMessagesReceived() {
 uint32_t MeshNetwork::getMessagesRelayed() {
     return _messagesRelayed;
 }
+
+TrafficClassStats MeshNetwork::getTrafficStats(TrafficClass cls) {
+    TrafficClassStats stats;
+    portENTER_CRITICAL(&txQueueLock);
+    stats = _txStats[static_cast<uint8_t>(cls)];
+    portEXIT_CRITICAL(&txQueueLock);
+    return stats;
+}
+
+bool MeshNetwork::getRelayFlowStats(uint16_t sourceId, FairFlowStats& stats) {
+    portENTER_CRITICAL(&txQueueLock);
+    bool found = _relayQueue.getFlowStats(sourceId, stats);
+    portEXIT_CRITICAL(&txQueueLock);
+    return found;
+}
+
+bool MeshNetwork::isRadioOn() {
+    return _radioOn;
+}
+
+MeshNetwork::SleepyChild* MeshNetwork::findSleepyChild(const uint8_t* mac) {
+    for (auto& child : _children) {
+        if (child.active && memcmp(child.mac, mac, 6) == 0) {
+            return &child;
+        }
+    }
+    return nullptr;
+}
+
+bool MeshNetwork::holdForChild(const uint8_t* mac, const MeshMessage& msg) {
+    bool held = false;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    SleepyChild* child = findSleepyChild(mac);
+    if (child && (int32_t)(millis() - child->awakeUntil) >= 0) {
+        // Bounded: the oldest held message makes room
+        if (child->count == MESH_CHILD_BUFFER) {
+            child->head = (child->head + 1) % MESH_CHILD_BUFFER;
+            child->count--;
+            child->dropped++;
+        }
+        child->held[(child->head + child->count) % MESH_CHILD_BUFFER] = msg;
+        child->count++;
+        held = true;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    if (held) {
+        DEBUG_PRINTF("[MESH] Holding message type %d for sleeping child %d\n",
+            msg.header.messageType, child->nodeId);
+    }
+    return held;
+}
+
+void MeshNetwork::noteChildActivity(const uint8_t* mac) {
+    portENTER_CRITICAL(&txQueueLock);
+    SleepyChild* child = findSleepyChild(mac);
+    if (child) {
+        child->awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+}
+
+void MeshNetwork::handleDataPoll(const MeshMessage& msg, const uint8_t* senderMac) {
+    if (msg.payloadLength < sizeof(DataPollPayload)) {
+        return;
+    }
+    const DataPollPayload* poll = reinterpret_cast<const DataPollPayload*>(msg.payload);
+    
+    // Child side: our parent has sent everything it held
+    if (poll->flags & POLL_FLAG_RESPONSE) {
+        updateRoutingTable(msg.header.sourceId, senderMac, -50, poll->hopCount,
+            (poll->flags & POLL_FLAG_GATEWAY) != 0);
+        meshClock.onReference(msg.header.sourceId, poll->meshTime, poll->syncStratum, millis());
+        
+        // Held messages arrived ahead of this; sleep once our own queue drains
+        _awakeUntil = millis();
+        timerWheel.arm(_listenTimer, 0);
+        return;
+    }
+    
+    // Parent side: register (or refresh) the child and release what we hold
+    MeshMessage held[MESH_CHILD_BUFFER];
+    uint8_t count = 0;
+    uint16_t nodeId = msg.header.sourceId;
+    bool registered = true;
+    
+    portENTER_CRITICAL(&txQueueLock);
+    SleepyChild* child = findSleepyChild(senderMac);
+    if (!child) {
+        for (auto& slot : _children) {
+            if (!slot.active) {
+                memset(&slot, 0, sizeof(SleepyChild));
+                slot.active = true;
+                slot.nodeId = nodeId;
+                memcpy(slot.mac, senderMac, 6);
+                child = &slot;
+                break;
+            }
+        }
+    }
+    if (child) {
+        child->lastPoll = millis();
+        child->awakeUntil = child->lastPoll + MESH_POLL_LISTEN_MS;
+        while (child->count > 0) {
+            held[count++] = child->held[child->head];
+            child->head = (child->head + 1) % MESH_CHILD_BUFFER;
+            child->count--;
+        }
+    } else {
+        registered = false;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    if (!registered) {
+        DEBUG_PRINTF("[MESH] No room for sleepy child %d\n", nodeId);
+        return;
+    }
+    
+    if (count > 0) {
+        DEBUG_PRINTF("[MESH] Releasing %d held messages to child %d\n", count, nodeId);
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        enqueueMessage(held[i], senderMac);
+    }
+    
+    uint8_t hopCount = 0;
+    MeshNode* gateway = findGatewayRoute();
+    if (DEVICE_ROLE != ROLE_GATEWAY && gateway) {
+        hopCount = gateway->hopCount + 1;
+    }
+    MeshMessage response = MessageProtocol::createDataPollResponse(DEVICE_ID, nodeId, count, hopCount);
+    enqueueMessage(response, senderMac);
+}
+
+void MeshNetwork::expireSleepyChildren() {
+    uint32_t now = millis();
+    
+    portENTER_CRITICAL(&txQueueLock);
+    for (auto& child : _children) {
+        if (child.active && now - child.lastPoll > MESH_CHILD_TIMEOUT_MS) {
+            child.active = false;
+            child.count = 0;
+        }
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+}
+
+void MeshNetwork::onPollTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    timerWheel.arm(mesh->_pollTimer, MESH_POLL_INTERVAL_MS);
+    
+    MeshNode* parent = mesh->findGatewayRoute();
+    if (!parent) {
+        return;
+    }
+    
+    MeshMessage poll = MessageProtocol::createDataPoll(DEVICE_ID, parent->nodeId, MESH_POLL_INTERVAL_MS);
+    mesh->enqueueMessage(poll, parent->macAddress);
+    mesh->_awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+    timerWheel.arm(mesh->_listenTimer, MESH_POLL_LISTEN_MS);
+}
+
+void MeshNetwork::onListenTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    
+    if (mesh->canSleep()) {
+        mesh->radioOff();
+    } else {
+        timerWheel.arm(mesh->_listenTimer, MESH_POLL_LISTEN_MS);
+    }
+}
+
+bool MeshNetwork::canSleep() {
+    if (!(MESH_SLEEPY_NODE || MESH_WAKE_WINDOWS_ENABLED) || _imageTransferInProgress || !findGatewayRoute()) {
+        return false;
+    }
+    if ((int32_t)(millis() - _awakeUntil) < 0) {
+        return false;
+    }
+    
+    // Relays keep listening until neighbours can find our window
+    if (MESH_WAKE_WINDOWS_ENABLED &&
+        (!meshClock.isSynced() ||
+         meshClock.inWindow(MESH_WAKE_PERIOD_MS, MESH_WAKE_OFFSET_MS, MESH_WAKE_WINDOW_MS))) {
+        return false;
+    }
+    
+    // Nothing of ours still waiting to go out
+    portENTER_CRITICAL(&txQueueLock);
+    bool idle = _relayQueue.size() == 0;
+    for (auto& queue : _txQueues) {
+        idle = idle && queue.count == 0;
+    }
+    portEXIT_CRITICAL(&txQueueLock);
+    
+    return idle;
+}
+
+void MeshNetwork::radioOn() {
+    if (MESH_SLEEPY_NODE || MESH_WAKE_WINDOWS_ENABLED) {
+        // Anything we send may be answered; listen a little after it
+        _awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+        if (!timerWheel.isArmed(_listenTimer)) {
+            timerWheel.arm(_listenTimer, MESH_POLL_LISTEN_MS);
+        }
+    }
+    
+    if (_radioOn) {
+        return;
+    }
+    
+    esp_wifi_start();
+    esp_wifi_set_channel(MESH_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    _radioOn = true;
+}
+
+void MeshNetwork::radioOff() {
+    if (!_radioOn) {
+        return;
+    }
+    
+    esp_wifi_stop();
+    _radioOn = false;
+}
+
+void MeshNetwork::onWakeTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    
+    // Our window opens: listen for its length, then the listen timer decides
+    mesh->radioOn();
+    mesh->_awakeUntil = millis() + MESH_WAKE_WINDOW_MS;
+    timerWheel.arm(mesh->_listenTimer, MESH_WAKE_WINDOW_MS);
+    
+    uint32_t next = meshClock.msUntilWindow(MESH_WAKE_PERIOD_MS, MESH_WAKE_OFFSET_MS);
+    timerWheel.arm(mesh->_wakeTimer, next > 0 ? next : MESH_WAKE_PERIOD_MS);
+}
+
+bool MeshNetwork::neighbourAwake(const MeshNode& node) {
+    // Always-on neighbours, and anyone while we lack a shared clock
+    if (node.wakePeriodMs == 0 || !meshClock.isSynced()) {
+        return true;
+    }
+    if ((int32_t)(millis() - node.awakeUntil) < 0) {
+        return true;
+    }
+    return meshClock.inWindow(node.wakePeriodMs, node.wakeOffsetMs, node.wakeWindowMs);
+}
+
+bool MeshNetwork::dutyCycledNeighbours() {
+    for (auto& node : _nodes) {
+        if (node.wakePeriodMs > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MeshNetwork::deferForWindow(const uint8_t* mac, const MeshMessage& msg, uint32_t delayMs, bool broadcast) {
+    DeferredFrame* slot = nullptr;
+    uint32_t earliest = delayMs;
+    uint32_t now = millis();
+    
+    for (auto& frame : _deferred) {
+        if (!frame.used) {
+            if (!slot) {
+                slot = &frame;
+            }
+        } else if ((int32_t)(frame.releaseAt - now) < (int32_t)earliest) {
+            earliest = max((int32_t)(frame.releaseAt - now), (int32_t)0);
+        }
+    }
+    
+    if (!slot) {
+        DEBUG_PRINTLN("[MESH] Wake window backlog full, dropping frame");
+        return false;
+    }
+    
+    slot->message = msg;
+    memcpy(slot->mac, mac, 6);
+    slot->releaseAt = now + delayMs;
+    slot->broadcast = broadcast;
+    slot->used = true;
+    
+    timerWheel.arm(_rendezvousTimer, earliest);
+    return true;
+}
+
+void MeshNetwork::onRendezvousTimer(void* context) {
+    MeshNetwork* mesh = static_cast<MeshNetwork*>(context);
+    uint32_t now = millis();
+    int32_t earliest = -1;
+    
+    // Release frames whose target window has opened; they go out in priority order
+    for (auto& frame : mesh->_deferred) {
+        if (!frame.used) {
+            continue;
+        }
+        int32_t remaining = (int32_t)(frame.releaseAt - now);
+        if (remaining <= 0) {
+            frame.used = false;
+            mesh->enqueueMessage(frame.message, frame.broadcast ? nullptr : frame.mac);
+        } else if (earliest < 0 || remaining < earliest) {
+            earliest = remaining;
+        }
+    }
+    
+    if (earliest >= 0) {
+        timerWheel.arm(mesh->_rendezvousTimer, earliest);
+    }
+}
+
+bool MeshNetwork::wakeBurst(MeshNode& node, const uint8_t* mac, const MeshMessage& msg, const uint8_t* buffer, size_t len) {
+    // Another alert sent mid-gap waits behind the one being repeated
+    if (timerWheel.isArmed(_burstTimer)) {
+        return enqueueMessage(msg, mac);
+    }
+    
+    if (!_burstActive || memcmp(_burstMac, mac, 6) != 0) {
+        DEBUG_PRINTF("[MESH] Wake burst to sleeping node %d\n", node.nodeId);
+        addPeer(mac);
+        memcpy(_burstMac, mac, 6);
+        _burstUntil = millis() + node.wakePeriodMs + MESH_WAKE_BURST_GAP_MS;
+        _burstActive = true;
+    }
+    
+    // The MAC-layer ACK shows its window caught one
+    if (sendFrame(mac, buffer, len)) {
+        node.awakeUntil = millis() + MESH_POLL_LISTEN_MS;
+        _burstActive = false;
+        return true;
+    }
+    if ((int32_t)(millis() - _burstUntil) >= 0) {
+        DEBUG_PRINTF("[MESH] Wake burst to node %d unanswered\n", node.nodeId);
+        _burstActive = false;
+        return false;
+    }
+    
+    // Repeat from the head of the alert queue once the gap is up, so the
+    // loop keeps serving other traffic in between
+    if (!requeueAtHead(msg, mac)) {
+        _burstActive = false;
+        return false;
+    }
+    timerWheel.arm(_burstTimer, MESH_WAKE_BURST_GAP_MS);
+    return true;
+}
+
+void MeshNetwork::onBurstTimer(void* context) {
+    static_cast<MeshNetwork*>(context)->serviceTxQueues();
+}
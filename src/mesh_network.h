@@ -6,9 +6,13 @@
 #include <esp_wifi.h>
 #include <WiFi.h>
 #include <vector>
-#include <queue>
 #include "config.h"
 #include "message_protocol.h"
+#include "fair_queue.h"
+#include "chunk_cache.h"
+#include "mesh_clock.h"
+#include "jpeg_restart.h"
+#include "timer_wheel.h"
 
 // Node information in routing table
 struct MeshNode {
@@ -19,19 +23,53 @@ struct MeshNode {
     uint32_t lastSeen;
     bool isGateway;
     bool isReachable;
+    bool isSleepy;          // Radio mostly off; reached through its parent's buffer
+    uint16_t wakePeriodMs;  // Duty-cycled relay: listen window schedule (0 = always on)
+    uint16_t wakeOffsetMs;
+    uint16_t wakeWindowMs;
+    uint32_t awakeUntil;    // Known to be listening until then (just answered us)
 };
 
 // Pending message for retry/relay
 struct PendingMessage {
     MeshMessage message;
     uint8_t retriesLeft;
-    uint32_t nextRetryTime;
+    Timer retryTimer;       // Fires when the ACK is overdue
     bool waitingAck;
 };
 
+// Transmit priority classes (lower value = higher priority)
+enum class TrafficClass : uint8_t {
+    CONTROL = 0,    // ACK/NACK, discovery, commands
+    ALERT,          // Motion alerts
+    BULK,           // Image transfer
+    TELEMETRY,      // Heartbeats and status
+    COUNT
+};
+
+// Bounded FIFO of frames for one traffic class
+struct TxQueue {
+    QueuedFrame* frames;
+    uint16_t capacity;
+    uint16_t head;
+    uint16_t count;
+};
+
+// Per-class queue statistics
+struct TrafficClassStats {
+    uint32_t enqueued;      // Frames accepted into the queue
+    uint32_t sent;          // Frames handed to ESP-NOW
+    uint32_t dropped;       // Frames rejected because the queue was full
+    uint32_t totalLatencyMs; // Sum of queueing delay over sent frames
+    uint32_t maxLatencyMs;  // Worst queueing delay seen
+    uint16_t depth;         // Current queue depth
+    uint16_t peakDepth;     // Highest queue depth seen
+};
+
 // Callback types
 typedef void (*MessageCallback)(const MeshMessage& msg);
 typedef void (*NodeCallback)(const MeshNode& node);
+typedef void (*ServiceCallback)(void);
 
 class MeshNetwork {
 public:
@@ -49,11 +87,52 @@ public:
     // Send message to all nodes (broadcast)
     bool broadcast(const MeshMessage& msg);
     
+    // Queue message for transmission in its traffic class (non-blocking).
+    // nextHopMac pins the frame to one neighbour instead of routing it.
+    bool enqueueMessage(const MeshMessage& msg, const uint8_t* nextHopMac = nullptr);
+    
+    // Map a message to its traffic class
+    static TrafficClass classifyMessage(const MeshMessage& msg);
+    
     // Send image in chunks
-    bool sendImage(const uint8_t* imageData, size_t imageLength, uint16_t imageId);
+    bool sendImage(const uint8_t* imageData, size_t imageLength, uint16_t imageId, const ImageRegion* region = nullptr,
+                   uint32_t capturedAt = 0);
+    
+    // Burst clip: one admission for up to frameCount frames (image IDs
+    // imageId..imageId+frameCount-1), each sent as soon as it is captured.
+    // With deferredMs the caller does not wait out a deferral: beginClip
+    // fails at once and reports when the gateway expects to have room.
+    bool beginClip(uint16_t imageId, uint8_t frameCount, size_t firstFrameLength, const ImageRegion* region = nullptr,
+                   uint16_t* deferredMs = nullptr);
+    bool sendClipFrame(const uint8_t* imageData, size_t imageLength, uint8_t frame, bool last);
+    void endClip();
+    
+    // Time the last image or clip frame spent sending its chunks, leaving
+    // out the grant, credit and slot waits (for throughput estimates)
+    uint32_t getSendActiveMs();
+    
+    // Keep heartbeats and queued traffic moving while the caller waits
+    void serviceFor(uint32_t durationMs);
+    
+    // Grant (or defer) an image transfer requested by a sensor (gateway side)
+    bool sendImageGrant(uint16_t destId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs);
+    
+    // Report missing chunks (count 0 = image complete) to a sensor (gateway side)
+    bool sendImageNack(uint16_t destId, uint16_t imageId, const uint16_t* chunks, uint8_t count);
+    
+    // Ask a sensor for the full image behind a thumbnail (gateway side)
+    bool sendImageFetch(uint16_t destId, uint16_t imageId);
+    
+    // Send an argument-less command, or start/renew/stop live view (gateway side)
+    bool sendCommand(uint16_t destId, CommandType command);
+    bool sendLiveView(uint16_t destId, uint16_t leaseMs);
+    
+    // Ask a sensor for archived high-res images: one by image ID, or up to
+    // maxImages taken since a mesh time when imageId is 0 (gateway side)
+    bool sendArchivePull(uint16_t destId, uint16_t imageId, uint32_t since, uint8_t maxImages);
     
     // Send motion alert
-    bool sendMotionAlert(uint32_t timestamp, uint16_t imageId, bool hasImage);
+    bool sendMotionAlert(uint32_t timestamp, uint16_t imageId, bool hasImage, uint8_t confidence = CONFIDENCE_UNKNOWN);
     
     // Send heartbeat
     void sendHeartbeat();
@@ -68,14 +147,34 @@ public:
     void setMessageCallback(MessageCallback callback);
     void setNodeDiscoveredCallback(NodeCallback callback);
     
+    // Called while a blocking transfer waits, so the application keeps
+    // handling its own events (must not start another transfer)
+    void setServiceCallback(ServiceCallback callback);
+    
     // Get local device info
     uint16_t getDeviceId();
     void getMacAddress(uint8_t* mac);
     
+    // Hops from this node to the gateway (0 = no route yet)
+    uint8_t getHopDepth();
+    
+    // Nothing queued, awaiting an ACK or mid-transfer (safe to deep sleep)
+    bool isIdle();
+    
+    // Keep the routing table in RTC memory across deep sleep; restore
+    // after begin() on a wake so the first alert needs no discovery
+    void saveState();
+    bool restoreState();
+    
     // Statistics
     uint32_t getMessagesSent();
     uint32_t getMessagesReceived();
     uint32_t getMessagesRelayed();
+    TrafficClassStats getTrafficStats(TrafficClass cls);
+    bool getRelayFlowStats(uint16_t sourceId, FairFlowStats& stats);
+    
+    // Sleepy node: radio state between polls
+    bool isRadioOn();
 
 private:
     // ESP-NOW callbacks (static for C callback)
@@ -85,10 +184,90 @@ private:
     // Internal message handling
     void handleReceivedMessage(const uint8_t* mac, const uint8_t* data, int len);
     void processMessage(const MeshMessage& msg, const uint8_t* senderMac);
-    void relayMessage(const MeshMessage& msg);
+    void relayMessage(const MeshMessage& msg, const uint8_t* senderMac);
+    bool transmitToMac(const uint8_t* mac, const MeshMessage& msg);
+    
+    // Image transfer admission (sensor side)
+    void handleImageGrant(const MeshMessage& msg);
+    bool requestImageGrant(const MeshMessage& startMsg, uint16_t* deferredMs = nullptr);
+    bool waitForCredit(const MeshMessage& startMsg, uint16_t chunkIndex);
+    void resetChunkState(uint16_t totalChunks);
+    uint8_t* withRestartMarkers(const uint8_t* imageData, size_t& imageLength);
+    bool sendChunks(const uint8_t* imageData, size_t imageLength, uint16_t imageId,
+                    const MeshMessage& startMsg, const MeshMessage& endMsg);
+    bool sendImageChunk(const uint8_t* imageData, size_t imageLength, uint16_t imageId, uint16_t chunkIndex);
+    
+    // Hop-by-hop custody and repair
+    struct CustodyAckState {
+        uint8_t mac[6];         // Upstream neighbour to acknowledge
+        uint16_t imageSource;
+        uint16_t imageId;
+        uint16_t baseChunk;
+        uint32_t bitmap;
+        uint8_t count;
+        uint32_t firstAt;
+        bool pending;
+    };
+    static const uint8_t CUSTODY_ACK_SLOTS = 4;
+    
+    // Parent side: downstream messages held for a sleepy child until it polls
+    struct SleepyChild {
+        uint16_t nodeId;
+        uint8_t mac[6];
+        uint32_t lastPoll;
+        uint32_t awakeUntil;    // Child is listening until then
+        MeshMessage held[MESH_CHILD_BUFFER];
+        uint8_t head;
+        uint8_t count;
+        uint16_t dropped;
+        bool active;
+    };
+    
+    SleepyChild* findSleepyChild(const uint8_t* mac);
+    bool holdForChild(const uint8_t* mac, const MeshMessage& msg);
+    void noteChildActivity(const uint8_t* mac);
+    void handleDataPoll(const MeshMessage& msg, const uint8_t* senderMac);
+    void expireSleepyChildren();
+    
+    // Child side: poll the parent, then turn the radio off
+    static void onPollTimer(void* context);
+    static void onListenTimer(void* context);
+    void radioOn();
+    void radioOff();
+    bool canSleep();
+    
+    // Wake windows: our own schedule, and traffic for sleeping neighbours
+    struct DeferredFrame {
+        MeshMessage message;
+        uint8_t mac[6];
+        uint32_t releaseAt;
+        bool broadcast;
+        bool used;
+    };
+    
+    static void onWakeTimer(void* context);
+    static void onRendezvousTimer(void* context);
+    static void onBurstTimer(void* context);
+    bool neighbourAwake(const MeshNode& node);
+    bool dutyCycledNeighbours();
+    bool deferForWindow(const uint8_t* mac, const MeshMessage& msg, uint32_t delayMs, bool broadcast);
+    bool wakeBurst(MeshNode& node, const uint8_t* mac, const MeshMessage& msg, const uint8_t* buffer, size_t len);
+    bool sendFrame(const uint8_t* mac, const uint8_t* buffer, size_t len);
+    
+    void noteCustody(const uint8_t* upstreamMac, const MeshMessage& chunk);
+    void flushCustodyAck(CustodyAckState& ack);
+    void flushStaleCustodyAcks();
+    void handleCustodyAck(const MeshMessage& msg);
+    void serviceCustodyRetries();
+    bool serveRepairFromCache(MeshMessage& nack);
+    void handleImageNack(const MeshMessage& msg);
+    bool awaitCustody(const uint8_t* imageData, size_t imageLength, uint16_t imageId);
+    bool hasCustody(uint16_t chunk);
+    bool serveImageRepairs(const uint8_t* imageData, size_t imageLength, uint16_t imageId, const MeshMessage& endMsg);
     
     // Routing
     void updateRoutingTable(uint16_t nodeId, const uint8_t* mac, int8_t rssi, uint8_t hopCount, bool isGateway);
+    void noteNodeSeen(uint16_t nodeId, const uint8_t* mac);
     void pruneRoutingTable();
     MeshNode* findNode(uint16_t nodeId);
     MeshNode* findNodeByMac(const uint8_t* mac);
@@ -97,24 +276,79 @@ private:
     bool addPeer(const uint8_t* mac);
     bool removePeer(const uint8_t* mac);
     
-    // Message queue
-    void processMessageQueue();
-    void queueMessage(const MeshMessage& msg, uint8_t retries);
+    // Messages awaiting an end-to-end ACK
+    bool queueMessage(const MeshMessage& msg, uint8_t retries);
+    void acknowledgePending(uint16_t sequence);
+    
+    // Timer callbacks (run from the loop via the timer wheel)
+    static void onHeartbeatTimer(void* context);
+    static void onPruneTimer(void* context);
+    static void onRetryTimer(void* context);
+    static void onCustodyAckTimer(void* context);
+    static void onCustodyRetryTimer(void* context);
+    static void onSlotTimer(void* context);
+    
+    // Priority transmit queues
+    bool allocateTxQueues();
+    bool popFrame(TrafficClass cls, QueuedFrame& frame);
+    bool requeueAtHead(const MeshMessage& msg, const uint8_t* nextHopMac);
+    bool transmitNext(TrafficClass floor);
+    void serviceTxQueues(TrafficClass floor = TrafficClass::COUNT);
+    void serviceRelayShare();
     
     // Static instance for callbacks
     static MeshNetwork* _instance;
     
-    // Node list and message queue
+    // Node list and messages awaiting ACKs
     std::vector<MeshNode> _nodes;
-    std::queue<PendingMessage> _messageQueue;
+    PendingMessage _pending[MSG_PENDING_MAX];
+    
+    // Transmit queues, one per traffic class (filled from the ESP-NOW task).
+    // Bulk traffic is held in the per-source fair queue instead.
+    TxQueue _txQueues[static_cast<uint8_t>(TrafficClass::COUNT)];
+    FairQueue _relayQueue;
+    
+    // Custody state: chunks we forwarded, pending upstream ACKs,
+    // and which of our own chunks the next hop has taken (the map is set
+    // from the WiFi task: access it under the mesh lock)
+    ChunkCache _chunkCache;
+    CustodyAckState _custodyAcks[CUSTODY_ACK_SLOTS];
+    uint8_t _custodyMap[(IMG_MAX_CHUNKS + 7) / 8];
+    
+    // Latest repair request for our own image
+    ImageNackPayload _repairRequest;
+    volatile bool _repairPending;
+    TrafficClassStats _txStats[static_cast<uint8_t>(TrafficClass::COUNT)];
     
     // Callbacks
     MessageCallback _messageCallback;
     NodeCallback _nodeCallback;
+    ServiceCallback _serviceCallback;
+    
+    // Timers
+    Timer _heartbeatTimer;
+    Timer _pruneTimer;
+    Timer _custodyAckTimer;     // Oldest partial custody ACK is due
+    Timer _custodyRetryTimer;   // Resend check for unacknowledged chunks
+    Timer _slotTimer;       // Start of our TDMA slot while bulk is waiting
+    Timer _pollTimer;       // Sleepy node: next poll of the parent
+    Timer _listenTimer;     // Sleepy node: radio off once traffic settles
     
-    // Timing
-    unsigned long _lastHeartbeat;
-    unsigned long _lastPrune;
+    // Sleepy children of this relay, and our own radio state if sleepy
+    SleepyChild _children[MESH_CHILD_MAX];
+    bool _radioOn;
+    volatile uint32_t _awakeUntil;
+    
+    // Frames waiting for a duty-cycled neighbour's next window
+    Timer _wakeTimer;       // Start of our own listen window
+    Timer _rendezvousTimer; // Earliest deferred frame is due
+    DeferredFrame _deferred[MESH_WAKE_DEFER_MAX];
+    
+    // Alert being repeated until a sleeping neighbour's window catches it
+    Timer _burstTimer;      // Next repeat is due (alerts wait meanwhile)
+    uint8_t _burstMac[6];
+    uint32_t _burstUntil;
+    bool _burstActive;
     
     // Statistics
     uint32_t _messagesSent;
@@ -124,6 +358,8 @@ private:
     // Send status
     volatile bool _sendInProgress;
     volatile bool _lastSendSuccess;
+    volatile uint32_t _sendStartUs;
+    volatile uint32_t _lastAirtimeUs;
     
     // Local device info
     uint8_t _macAddress[6];
@@ -133,6 +369,17 @@ private:
     uint16_t _currentImageId;
     uint16_t _currentChunk;
     uint16_t _totalChunks;
+    uint16_t _chunkBase;        // Clip frame bits of our chunk indices (0 for single images)
+    uint32_t _sendActiveUs;     // Chunk sending time of the current image
+    
+    // Burst clip being sent
+    MeshMessage _clipStart;
+    uint8_t _clipFramesSent;
+    bool _clipLastSent;
+    
+    // Credit granted by the gateway for the current image
+    volatile uint16_t _grantedChunks;
+    volatile uint16_t _grantRetryAfterMs;
 };
 
 // Global instance
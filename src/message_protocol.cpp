@@ -1,4 +1,5 @@
 #include "message_protocol.h"
+#include "mesh_clock.h"
 
 // Static member initialization
 uint16_t MessageProtocol::_sequenceCounter = 0;
@@ -146,7 +147,8 @@ bool MessageProtocol::deserialize(const uint8_t* buffer, size_t length, MeshMess
     return true;
 }
 
-MeshMessage MessageProtocol::createMotionAlert(uint16_t sourceId, uint32_t timestamp, uint16_t imageId, bool hasImage) {
+MeshMessage MessageProtocol::createMotionAlert(uint16_t sourceId, uint32_t timestamp, uint16_t imageId, bool hasImage,
+                                               uint8_t confidence) {
     MeshMessage msg = createMessage(sourceId, GATEWAY_ID, MessageType::MOTION_ALERT);
     
     MotionAlertPayload payload;
@@ -158,6 +160,7 @@ MeshMessage MessageProtocol::createMotionAlert(uint16_t sourceId, uint32_t times
     // Initialize path with source node as first entry
     payload.pathLength = 1;
     payload.path[0] = sourceId;
+    payload.confidence = confidence;
     
     setPayload(msg, &payload, sizeof(MotionAlertPayload));
     
@@ -174,26 +177,127 @@ MeshMessage MessageProtocol::createHeartbeat(uint16_t sourceId, int8_t rssi, uin
     payload.batteryLevel = battery;
     payload.hopCount = hopCount;
     payload.uptime = millis() / 1000;
+    payload.flags = MESH_SLEEPY_NODE ? NODE_FLAG_SLEEPY : 0;
+    payload.wakePeriodMs = MESH_WAKE_WINDOWS_ENABLED ? MESH_WAKE_PERIOD_MS : 0;
+    payload.wakeOffsetMs = MESH_WAKE_OFFSET_MS;
+    payload.wakeWindowMs = MESH_WAKE_WINDOW_MS;
     
     setPayload(msg, &payload, sizeof(HeartbeatPayload));
+    stampClock(msg);
     
     return msg;
 }
 
-MeshMessage MessageProtocol::createImageStart(uint16_t sourceId, uint16_t imageId, uint32_t size, uint16_t chunks) {
+MeshMessage MessageProtocol::createDataPoll(uint16_t sourceId, uint16_t destId, uint16_t intervalMs) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::DATA_POLL);
+    
+    DataPollPayload payload;
+    memset(&payload, 0, sizeof(DataPollPayload));
+    payload.intervalMs = intervalMs;
+    payload.syncStratum = CLOCK_STRATUM_UNSYNCED;
+    
+    setPayload(msg, &payload, sizeof(DataPollPayload));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createDataPollResponse(uint16_t sourceId, uint16_t destId, uint8_t delivered, uint8_t hopCount) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::DATA_POLL);
+    
+    DataPollPayload payload;
+    memset(&payload, 0, sizeof(DataPollPayload));
+    payload.flags = POLL_FLAG_RESPONSE | (DEVICE_ROLE == ROLE_GATEWAY ? POLL_FLAG_GATEWAY : 0);
+    payload.delivered = delivered;
+    payload.hopCount = hopCount;
+    
+    setPayload(msg, &payload, sizeof(DataPollPayload));
+    stampClock(msg);
+    
+    return msg;
+}
+
+void MessageProtocol::stampClock(MeshMessage& msg) {
+    // Refreshed right before transmit so queueing delay doesn't skew receivers
+    MessageType type = static_cast<MessageType>(msg.header.messageType);
+    
+    if (type == MessageType::HEARTBEAT && msg.payloadLength >= sizeof(HeartbeatPayload)) {
+        HeartbeatPayload* payload = reinterpret_cast<HeartbeatPayload*>(msg.payload);
+        payload->meshTime = meshClock.now();
+        payload->syncStratum = meshClock.getStratum();
+    } else if (type == MessageType::DATA_POLL && msg.payloadLength >= sizeof(DataPollPayload)) {
+        DataPollPayload* payload = reinterpret_cast<DataPollPayload*>(msg.payload);
+        if (!(payload->flags & POLL_FLAG_RESPONSE)) {
+            return;
+        }
+        payload->meshTime = meshClock.now();
+        payload->syncStratum = meshClock.getStratum();
+    } else {
+        return;
+    }
+    
+    msg.header.checksum = calculateChecksum(msg);
+}
+
+MeshMessage MessageProtocol::createImageStart(uint16_t sourceId, uint16_t imageId, uint32_t size, uint16_t chunks, const ImageRegion* region, uint8_t frameCount, uint32_t capturedAt) {
     MeshMessage msg = createMessage(sourceId, GATEWAY_ID, MessageType::IMAGE_START);
     
     ImageStartPayload payload;
     payload.imageId = imageId;
     payload.totalSize = size;
     payload.totalChunks = chunks;
-    payload.timestamp = millis();
+    payload.timestamp = capturedAt ? capturedAt : meshClock.now();
+    if (region) {
+        payload.region = *region;
+    } else {
+        memset(&payload.region, 0, sizeof(payload.region));
+    }
+    payload.frameCount = frameCount;
     
     setPayload(msg, &payload, sizeof(ImageStartPayload));
     
     return msg;
 }
 
+MeshMessage MessageProtocol::createImageEnd(uint16_t sourceId, uint16_t imageId, uint16_t chunks) {
+    MeshMessage msg = createMessage(sourceId, GATEWAY_ID, MessageType::IMAGE_END);
+    
+    // Single images stop before the clip frame fields
+    ImageEndPayload payload;
+    payload.imageId = imageId;
+    payload.totalChunks = chunks;
+    
+    setPayload(msg, &payload, offsetof(ImageEndPayload, frame));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createClipFrameEnd(uint16_t sourceId, uint16_t imageId, uint16_t chunks, uint8_t frame, uint32_t frameSize) {
+    MeshMessage msg = createMessage(sourceId, GATEWAY_ID, MessageType::IMAGE_END);
+    
+    ImageEndPayload payload;
+    payload.imageId = imageId;
+    payload.totalChunks = chunks;
+    payload.frame = frame;
+    payload.frameSize = frameSize;
+    
+    setPayload(msg, &payload, sizeof(ImageEndPayload));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createImageGrant(uint16_t sourceId, uint16_t destId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::IMAGE_GRANT);
+    
+    ImageGrantPayload payload;
+    payload.imageId = imageId;
+    payload.grantedChunks = grantedChunks;
+    payload.retryAfterMs = retryAfterMs;
+    
+    setPayload(msg, &payload, sizeof(ImageGrantPayload));
+    
+    return msg;
+}
+
 MeshMessage MessageProtocol::createImageChunk(uint16_t sourceId, uint16_t imageId, uint16_t chunkIndex, const uint8_t* data, uint8_t size) {
     MeshMessage msg = createMessage(sourceId, GATEWAY_ID, MessageType::IMAGE_CHUNK, 0, chunkIndex);
     
@@ -219,6 +323,91 @@ MeshMessage MessageProtocol::createAck(uint16_t sourceId, uint16_t destId, uint1
     return msg;
 }
 
+MeshMessage MessageProtocol::createCustodyAck(uint16_t sourceId, uint16_t imageSource, uint16_t imageId, uint16_t baseChunk, uint32_t bitmap) {
+    MeshMessage msg = createMessage(sourceId, imageSource, MessageType::ACK);
+    
+    CustodyAckPayload payload;
+    payload.kind = ACK_KIND_CUSTODY;
+    payload.imageId = imageId;
+    payload.baseChunk = baseChunk;
+    payload.bitmap = bitmap;
+    
+    setPayload(msg, &payload, sizeof(CustodyAckPayload));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createImageNack(uint16_t sourceId, uint16_t destId, uint16_t imageId, const uint16_t* chunks, uint8_t count) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::NACK);
+    
+    if (count > IMG_NACK_MAX_CHUNKS) {
+        count = IMG_NACK_MAX_CHUNKS;
+    }
+    
+    ImageNackPayload payload;
+    payload.imageId = imageId;
+    payload.count = count;
+    memcpy(payload.chunks, chunks, count * sizeof(uint16_t));
+    
+    // Only send the used part of the chunk list
+    setPayload(msg, &payload, 3 + count * sizeof(uint16_t));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createImageFetch(uint16_t sourceId, uint16_t destId, uint16_t imageId) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::COMMAND);
+    
+    FetchImagePayload payload;
+    payload.command = static_cast<uint8_t>(CommandType::FETCH_IMAGE);
+    payload.imageId = imageId;
+    
+    setPayload(msg, &payload, sizeof(FetchImagePayload));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createCommand(uint16_t sourceId, uint16_t destId, CommandType command) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::COMMAND);
+    
+    uint8_t payload = static_cast<uint8_t>(command);
+    setPayload(msg, &payload, 1);
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createLiveView(uint16_t sourceId, uint16_t destId, uint16_t leaseMs) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::COMMAND);
+    
+    LiveViewPayload payload;
+    payload.command = static_cast<uint8_t>(CommandType::LIVE_VIEW);
+    payload.leaseMs = leaseMs;
+    
+    setPayload(msg, &payload, sizeof(LiveViewPayload));
+    
+    return msg;
+}
+
+MeshMessage MessageProtocol::createArchivePull(uint16_t sourceId, uint16_t destId, uint16_t imageId, uint32_t since, uint8_t maxImages) {
+    MeshMessage msg = createMessage(sourceId, destId, MessageType::COMMAND);
+    
+    ArchivePullPayload payload;
+    payload.command = static_cast<uint8_t>(CommandType::ARCHIVE_PULL);
+    payload.imageId = imageId;
+    payload.since = since;
+    payload.maxImages = maxImages;
+    
+    setPayload(msg, &payload, sizeof(ArchivePullPayload));
+    
+    return msg;
+}
+
+bool MessageProtocol::isCustodyAck(const MeshMessage& msg) {
+    return static_cast<MessageType>(msg.header.messageType) == MessageType::ACK &&
+           msg.payloadLength >= sizeof(CustodyAckPayload) &&
+           msg.payload[0] == ACK_KIND_CUSTODY;
+}
+
 uint16_t MessageProtocol::getNextSequence() {
     return ++_sequenceCounter;
 }
@@ -230,7 +419,7 @@ bool MessageProtocol::appendToPath(MeshMessage& msg, uint16_t nodeId) {
     }
     
     // Check if payload is the right size
-    if (msg.payloadLength < sizeof(MotionAlertPayload)) {
+    if (msg.payloadLength < offsetof(MotionAlertPayload, confidence)) {
         // Old format without path - need to handle backward compatibility
         // For now, we'll only append if path tracking is already present
         return false;
@@ -261,7 +450,7 @@ bool MessageProtocol::getPath(const MeshMessage& msg, uint16_t* path, uint8_t* p
     }
     
     // Check if payload is the right size
-    if (msg.payloadLength < sizeof(MotionAlertPayload)) {
+    if (msg.payloadLength < offsetof(MotionAlertPayload, confidence)) {
         // Old format without path
         *pathLength = 0;
         return true;  // Return true but with empty path for backward compatibility
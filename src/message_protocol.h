@@ -11,8 +11,10 @@ enum class MessageType : uint8_t {
     IMAGE_START     = 0x10,  // Image transfer start
     IMAGE_CHUNK     = 0x11,  // Image data chunk
     IMAGE_END       = 0x12,  // Image transfer complete
+    IMAGE_GRANT     = 0x13,  // Gateway credit for an image transfer
     ACK             = 0x20,  // Acknowledgment
     NACK            = 0x21,  // Negative acknowledgment
+    DATA_POLL       = 0x22,  // Sleepy child asks its parent for held messages
     DISCOVER        = 0x30,  // Node discovery request
     DISCOVER_RESP   = 0x31,  // Node discovery response
     STATUS_REQUEST  = 0x40,  // Request node status
@@ -20,10 +22,28 @@ enum class MessageType : uint8_t {
     COMMAND         = 0x50,  // Command from gateway/phone
 };
 
+// COMMAND sub-types (first payload byte)
+enum class CommandType : uint8_t {
+    FETCH_IMAGE     = 0x01,  // Send the full image behind a thumbnail
+    CAPTURE_NOW     = 0x02,  // Handle as a motion event
+    LIVE_VIEW       = 0x03,  // Start/renew (lease > 0) or stop (lease 0) live view
+    ARCHIVE_PULL    = 0x04,  // Send archived high-res images
+};
+
 // Broadcast address for mesh
 #define BROADCAST_ID 0xFFFF
 #define GATEWAY_ID 0x0000
 
+// ACK payload kinds (an ACK without payload acknowledges header.sequenceNum)
+#define ACK_KIND_CUSTODY 0x01
+
+// Heartbeat node flags
+#define NODE_FLAG_SLEEPY 0x01  // Radio mostly off: never use as a relay
+
+// Data poll flags
+#define POLL_FLAG_RESPONSE 0x01  // Parent -> child: held messages were sent ahead
+#define POLL_FLAG_GATEWAY  0x02  // Responding parent is the gateway
+
 // Path tracking configuration
 #define MAX_PATH_LENGTH 8  // Maximum number of nodes in routing path
 
@@ -47,12 +67,48 @@ struct MeshMessage {
 
 // Motion alert payload
 struct MotionAlertPayload {
-    uint32_t timestamp;     // Time of detection
+    uint32_t timestamp;     // Time of detection (mesh clock)
     uint8_t  sensorId;      // Which sensor triggered
     uint16_t imageId;       // Associated image ID (if any)
     uint8_t  hasImage;      // Whether image is being sent
     uint8_t  pathLength;    // Number of nodes in routing path (0 = no path tracking)
     uint16_t path[MAX_PATH_LENGTH];  // Routing path: [sourceNode, relay1, relay2, ..., gateway]
+    uint8_t  confidence;    // Appended; classifier score 0-100 (CONFIDENCE_UNKNOWN = not scored)
+};
+
+// Motion alert confidence when the trigger was not classified
+#define CONFIDENCE_UNKNOWN 0xFF
+
+// Image region flags
+#define IMAGE_FLAG_CROP    0x01  // Image is a region of the full frame
+#define IMAGE_FLAG_CONTEXT 0x02  // Low-quality full frame sent alongside a crop
+#define IMAGE_FLAG_THUMBNAIL 0x04  // Reduced preview; the full image waits on the sensor
+#define IMAGE_FLAG_CLIP    0x08  // Frame of a burst clip
+#define IMAGE_FLAG_LIVE    0x10  // Live view frame
+#define IMAGE_FLAG_TIMELAPSE 0x20  // Batch of scheduled snapshots (sent as a clip)
+#define IMAGE_FLAG_PRIORITY 0x40  // Classifier thinks it shows an animal: forwarded first
+#define IMAGE_FLAG_PARTIAL 0x80  // Gateway gave up repairing: lost intervals are grey
+
+// Burst clips share one IMAGE_START; chunk indices carry the frame in
+// their top bits and each frame ends with its own IMAGE_END
+#define CLIP_FRAME_SHIFT 12
+#define CLIP_CHUNK_MASK  0x0FFF  // Chunks per frame stay below 4096
+#define CLIP_MAX_FRAMES  16
+#define CLIP_FRAME_LAST  0x80    // IMAGE_END frame byte: no frames follow
+
+// Image IDs stay below this bit; a fetched full image reuses its
+// thumbnail's ID with the bit set
+#define IMAGE_ID_FULL 0x8000
+
+// Where an image sits in the sensor's full frame (all zero = whole frame)
+struct ImageRegion {
+    uint8_t  flags;         // IMAGE_FLAG_*
+    uint16_t x;             // Crop origin in full-frame pixels
+    uint16_t y;
+    uint16_t width;         // Crop size in full-frame pixels
+    uint16_t height;
+    uint16_t frameWidth;    // Full frame size
+    uint16_t frameHeight;
 };
 
 // Image start payload
@@ -60,7 +116,60 @@ struct ImageStartPayload {
     uint16_t imageId;       // Unique image identifier
     uint32_t totalSize;     // Total image size in bytes
     uint16_t totalChunks;   // Number of chunks
-    uint32_t timestamp;     // Capture timestamp
+    uint32_t timestamp;     // Capture timestamp (mesh clock)
+    ImageRegion region;     // Appended; absent from older senders
+    uint8_t  frameCount;    // Appended; frames in a burst clip (0 = single image)
+};
+
+// Image end payload (frame fields appended for burst clip frames)
+struct ImageEndPayload {
+    uint16_t imageId;
+    uint16_t totalChunks;   // Chunks in the image (or in this clip frame)
+    uint8_t  frame;         // Clip frame index, CLIP_FRAME_LAST on the final one
+    uint32_t frameSize;     // Bytes in this clip frame
+};
+
+// Image grant payload (gateway -> sensor, answers IMAGE_START)
+struct ImageGrantPayload {
+    uint16_t imageId;       // Image the credit applies to
+    uint16_t grantedChunks; // Sender may send chunks [0, grantedChunks)
+    uint16_t retryAfterMs;  // When grantedChunks is 0: ask again after this delay
+};
+
+// Custody ACK payload (one hop, relay/gateway -> upstream neighbour).
+// header.destId carries the image's original source node.
+struct CustodyAckPayload {
+    uint8_t  kind;          // ACK_KIND_CUSTODY
+    uint16_t imageId;       // Image the chunks belong to
+    uint16_t baseChunk;     // First chunk covered by the bitmap
+    uint32_t bitmap;        // Bit n set = chunk baseChunk+n taken into custody
+};
+
+// Image NACK payload (gateway -> source, lists chunks still missing)
+struct ImageNackPayload {
+    uint16_t imageId;
+    uint8_t  count;         // Valid entries in chunks[]
+    uint16_t chunks[IMG_NACK_MAX_CHUNKS];
+};
+
+// Fetch payload (COMMAND, gateway -> sensor)
+struct FetchImagePayload {
+    uint8_t  command;       // CommandType::FETCH_IMAGE
+    uint16_t imageId;       // Thumbnail's image ID
+};
+
+// Live view payload (COMMAND, gateway -> sensor)
+struct LiveViewPayload {
+    uint8_t  command;       // CommandType::LIVE_VIEW
+    uint16_t leaseMs;       // Keep streaming this long unless renewed (0 = stop)
+};
+
+// Archive pull payload (COMMAND, gateway -> sensor)
+struct ArchivePullPayload {
+    uint8_t  command;       // CommandType::ARCHIVE_PULL
+    uint16_t imageId;       // Image to send (0 = all taken since the timestamp)
+    uint32_t since;         // Mesh time of the first image for a bulk pull
+    uint8_t  maxImages;     // Bulk pull limit
 };
 
 // Image chunk payload
@@ -79,6 +188,22 @@ struct HeartbeatPayload {
     uint8_t  batteryLevel;  // Battery percentage (0-100)
     uint8_t  hopCount;      // Hops to gateway
     uint32_t uptime;        // Seconds since boot
+    uint32_t meshTime;      // Sender's mesh clock at transmit (ms)
+    uint8_t  syncStratum;   // Sender's distance from the gateway clock (0xFF = unsynced)
+    uint8_t  flags;         // NODE_FLAG_*
+    uint16_t wakePeriodMs;  // Listen window period on the mesh clock (0 = always listening)
+    uint16_t wakeOffsetMs;  // Window start within the period
+    uint16_t wakeWindowMs;  // Window length
+};
+
+// Data poll payload (child -> parent request, parent -> child response)
+struct DataPollPayload {
+    uint8_t  flags;         // POLL_FLAG_*
+    uint16_t intervalMs;    // Child: time until its next poll
+    uint8_t  delivered;     // Parent: held messages sent ahead of this response
+    uint8_t  hopCount;      // Parent: hops to gateway (keeps the child's route fresh)
+    uint32_t meshTime;      // Parent: mesh clock at transmit
+    uint8_t  syncStratum;   // Parent: clock stratum
 };
 
 // Status response payload
@@ -124,11 +249,25 @@ public:
     static bool deserialize(const uint8_t* buffer, size_t length, MeshMessage& msg);
     
     // Create specific message types
-    static MeshMessage createMotionAlert(uint16_t sourceId, uint32_t timestamp, uint16_t imageId, bool hasImage);
+    static MeshMessage createMotionAlert(uint16_t sourceId, uint32_t timestamp, uint16_t imageId, bool hasImage,
+                                         uint8_t confidence = CONFIDENCE_UNKNOWN);
     static MeshMessage createHeartbeat(uint16_t sourceId, int8_t rssi, uint8_t battery, uint8_t hopCount);
-    static MeshMessage createImageStart(uint16_t sourceId, uint16_t imageId, uint32_t size, uint16_t chunks);
+    static MeshMessage createDataPoll(uint16_t sourceId, uint16_t destId, uint16_t intervalMs);
+    static MeshMessage createDataPollResponse(uint16_t sourceId, uint16_t destId, uint8_t delivered, uint8_t hopCount);
+    static void stampClock(MeshMessage& msg);
+    static MeshMessage createImageStart(uint16_t sourceId, uint16_t imageId, uint32_t size, uint16_t chunks, const ImageRegion* region = nullptr, uint8_t frameCount = 0, uint32_t capturedAt = 0);
+    static MeshMessage createImageEnd(uint16_t sourceId, uint16_t imageId, uint16_t chunks);
+    static MeshMessage createClipFrameEnd(uint16_t sourceId, uint16_t imageId, uint16_t chunks, uint8_t frame, uint32_t frameSize);
+    static MeshMessage createImageGrant(uint16_t sourceId, uint16_t destId, uint16_t imageId, uint16_t grantedChunks, uint16_t retryAfterMs);
     static MeshMessage createImageChunk(uint16_t sourceId, uint16_t imageId, uint16_t chunkIndex, const uint8_t* data, uint8_t size);
     static MeshMessage createAck(uint16_t sourceId, uint16_t destId, uint16_t sequence);
+    static MeshMessage createCustodyAck(uint16_t sourceId, uint16_t imageSource, uint16_t imageId, uint16_t baseChunk, uint32_t bitmap);
+    static MeshMessage createImageNack(uint16_t sourceId, uint16_t destId, uint16_t imageId, const uint16_t* chunks, uint8_t count);
+    static MeshMessage createImageFetch(uint16_t sourceId, uint16_t destId, uint16_t imageId);
+    static MeshMessage createCommand(uint16_t sourceId, uint16_t destId, CommandType command);
+    static MeshMessage createLiveView(uint16_t sourceId, uint16_t destId, uint16_t leaseMs);
+    static MeshMessage createArchivePull(uint16_t sourceId, uint16_t destId, uint16_t imageId, uint32_t since, uint8_t maxImages);
+    static bool isCustodyAck(const MeshMessage& msg);
     
     // Path tracking helpers for motion alerts
     static bool appendToPath(MeshMessage& msg, uint16_t nodeId);
@@ -0,0 +1,172 @@
+#include "motion_verifier.h"
+#include "frame_diff.h"
+#include "img_converters.h"
+
+// Global instance
+MotionVerifier motionVerifier;
+
+MotionVerifier::MotionVerifier()
+    : _decodeBuffer(nullptr)
+    , _decodeCapacity(0)
+    , _learnedFrames(0)
+    , _regionValid(false)
+    , _hashValid(false)
+    , _changeValid(false)
+    , _lastHash(0)
+    , _regionX0(0)
+    , _regionY0(0)
+    , _regionX1(0)
+    , _regionY1(0)
+    , _passCount(0)
+    , _vetoCount(0)
+    , _lastChanged(0) {
+    memset(_background, 0, sizeof(_background));
+    memset(_thumbnail, 0, sizeof(_thumbnail));
+    memset(_change, 0, sizeof(_change));
+}
+
+MotionVerifier::~MotionVerifier() {
+    if (_decodeBuffer) {
+        free(_decodeBuffer);
+    }
+}
+
+bool MotionVerifier::makeThumbnail(const uint8_t* jpeg, size_t length) {
+    // The thumbnail is about to change under the last change map
+    _changeValid = false;
+    
+    uint16_t width, height;
+    if (!FrameDiff::jpegDimensions(jpeg, length, width, height)) {
+        DEBUG_PRINTLN("[VERIFY] No JPEG frame header");
+        return false;
+    }
+    
+    // Decode at 1/8 scale: QVGA comes out 40x30, UXGA 200x150
+    uint16_t sw = (width + 7) / 8;
+    uint16_t sh = (height + 7) / 8;
+    size_t needed = (size_t)sw * sh * 2;
+    if (needed > _decodeCapacity) {
+        if (_decodeBuffer) {
+            free(_decodeBuffer);
+        }
+        _decodeBuffer = (uint8_t*)(psramFound() ? ps_malloc(needed) : malloc(needed));
+        _decodeCapacity = _decodeBuffer ? needed : 0;
+        if (!_decodeBuffer) {
+            DEBUG_PRINTLN("[VERIFY] Failed to allocate decode buffer");
+            return false;
+        }
+    }
+    
+    if (!jpg2rgb565(jpeg, length, _decodeBuffer, JPG_SCALE_8X)) {
+        DEBUG_PRINTLN("[VERIFY] JPEG decode failed");
+        return false;
+    }
+    
+    FrameDiff::rgb565ToLuma7(_decodeBuffer, sw, sh, (uint8_t*)_thumbnail,
+                             VERIFY_THUMB_WIDTH, VERIFY_THUMB_HEIGHT);
+    return true;
+}
+
+void MotionVerifier::foldThumbnail() {
+    if (_learnedFrames == 0) {
+        memcpy(_background, _thumbnail, sizeof(_background));
+    } else {
+        FrameDiff::blend(_background, _thumbnail, VERIFY_THUMB_WORDS);
+    }
+    if (_learnedFrames < 255) {
+        _learnedFrames++;
+    }
+}
+
+void MotionVerifier::learn(const uint8_t* jpeg, size_t length) {
+    if (makeThumbnail(jpeg, length)) {
+        foldThumbnail();
+    }
+}
+
+bool MotionVerifier::verify(const uint8_t* jpeg, size_t length) {
+    _hashValid = false;
+    if (!makeThumbnail(jpeg, length)) {
+        // Cannot judge the picture; let the trigger through
+        _passCount++;
+        return true;
+    }
+    
+    _lastHash = FrameDiff::dHash((const uint8_t*)_thumbnail, VERIFY_THUMB_WIDTH, VERIFY_THUMB_HEIGHT);
+    _hashValid = true;
+    
+    bool moved = true;
+    _regionValid = false;
+    if (isReady()) {
+        _lastChanged = FrameDiff::countChanged(_thumbnail, _background, VERIFY_THUMB_WORDS,
+                                               VERIFY_PIXEL_THRESHOLD);
+        moved = _lastChanged * 100 >= VERIFY_THUMB_PIXELS * VERIFY_MIN_CHANGED_PCT;
+        _regionValid = moved && FrameDiff::changedBounds(_thumbnail, _background,
+            VERIFY_THUMB_WIDTH, VERIFY_THUMB_HEIGHT, VERIFY_PIXEL_THRESHOLD,
+            _regionX0, _regionY0, _regionX1, _regionY1);
+        DEBUG_PRINTF("[VERIFY] %d of %d pixels changed - %s\n", _lastChanged,
+            VERIFY_THUMB_PIXELS, moved ? "motion" : "veto");
+        
+        // Kept for the classifier before the frame is folded in
+        for (size_t i = 0; i < VERIFY_THUMB_WORDS; i++) {
+            _change[i] = FrameDiff::absDiff4(_thumbnail[i], _background[i]);
+        }
+        _changeValid = true;
+    }
+    
+    // A lasting scene change (light, snow) is absorbed after a few triggers
+    foldThumbnail();
+    
+    if (moved) {
+        _passCount++;
+    } else {
+        _vetoCount++;
+    }
+    return moved;
+}
+
+bool MotionVerifier::getLastHash(uint64_t& hash) {
+    hash = _lastHash;
+    return _hashValid;
+}
+
+bool MotionVerifier::getLastChange(const uint8_t*& luma, const uint8_t*& change) {
+    luma = (const uint8_t*)_thumbnail;
+    change = (const uint8_t*)_change;
+    return _changeValid;
+}
+
+bool MotionVerifier::hashFrame(const uint8_t* jpeg, size_t length, uint64_t& hash) {
+    if (!makeThumbnail(jpeg, length)) {
+        return false;
+    }
+    hash = FrameDiff::dHash((const uint8_t*)_thumbnail, VERIFY_THUMB_WIDTH, VERIFY_THUMB_HEIGHT);
+    return true;
+}
+
+bool MotionVerifier::isReady() {
+    return _learnedFrames >= VERIFY_LEARN_FRAMES;
+}
+
+bool MotionVerifier::getChangedRegion(uint16_t& x, uint16_t& y, uint16_t& width, uint16_t& height) {
+    if (!_regionValid) {
+        return false;
+    }
+    x = _regionX0;
+    y = _regionY0;
+    width = _regionX1 - _regionX0;
+    height = _regionY1 - _regionY0;
+    return true;
+}
+
+uint32_t MotionVerifier::getPassCount() {
+    return _passCount;
+}
+
+uint32_t MotionVerifier::getVetoCount() {
+    return _vetoCount;
+}
+
+uint16_t MotionVerifier::getLastChanged() {
+    return _lastChanged;
+}
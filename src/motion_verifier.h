@@ -0,0 +1,75 @@
+#ifndef MOTION_VERIFIER_H
+#define MOTION_VERIFIER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define VERIFY_THUMB_PIXELS (VERIFY_THUMB_WIDTH * VERIFY_THUMB_HEIGHT)
+#define VERIFY_THUMB_WORDS (VERIFY_THUMB_PIXELS / 4)
+
+// Checks PIR triggers against the picture. Each JPEG is decoded at 1/8
+// scale and boxed down to a fixed luma thumbnail, so the background model
+// survives frame size changes; a trigger passes only if enough thumbnail
+// pixels differ from the background.
+class MotionVerifier {
+public:
+    MotionVerifier();
+    ~MotionVerifier();
+    
+    // Fold an idle frame into the background model
+    void learn(const uint8_t* jpeg, size_t length);
+    
+    // True if the frame shows motion (or there is no background yet);
+    // the frame is folded into the background either way
+    bool verify(const uint8_t* jpeg, size_t length);
+    
+    // Bounding box of change in the last passed frame, in thumbnail
+    // pixels (VERIFY_THUMB_WIDTH x VERIFY_THUMB_HEIGHT grid)
+    bool getChangedRegion(uint16_t& x, uint16_t& y, uint16_t& width, uint16_t& height);
+    
+    // Perceptual hash of the last verified frame's thumbnail
+    bool getLastHash(uint64_t& hash);
+    
+    // Last verified frame's thumbnail and its per-pixel change from the
+    // background (false until the background is ready)
+    bool getLastChange(const uint8_t*& luma, const uint8_t*& change);
+    
+    // Perceptual hash of any frame (leaves the background alone)
+    bool hashFrame(const uint8_t* jpeg, size_t length, uint64_t& hash);
+    
+    // Background model has enough frames to veto
+    bool isReady();
+    
+    // Statistics
+    uint32_t getPassCount();
+    uint32_t getVetoCount();
+    uint16_t getLastChanged();
+
+private:
+    bool makeThumbnail(const uint8_t* jpeg, size_t length);
+    void foldThumbnail();
+    
+    uint32_t _background[VERIFY_THUMB_WORDS];
+    uint32_t _thumbnail[VERIFY_THUMB_WORDS];
+    uint32_t _change[VERIFY_THUMB_WORDS];
+    uint8_t* _decodeBuffer;     // RGB565 at 1/8 scale
+    size_t _decodeCapacity;
+    uint8_t _learnedFrames;
+    bool _regionValid;
+    bool _hashValid;
+    bool _changeValid;
+    uint64_t _lastHash;
+    uint16_t _regionX0;
+    uint16_t _regionY0;
+    uint16_t _regionX1;
+    uint16_t _regionY1;
+    
+    uint32_t _passCount;
+    uint32_t _vetoCount;
+    uint16_t _lastChanged;
+};
+
+// Global instance
+extern MotionVerifier motionVerifier;
+
+#endif // MOTION_VERIFIER_H
@@ -1,80 +1,168 @@
 #include "pir_sensor.h"
 
+static_assert((PIR_EDGE_RING & (PIR_EDGE_RING - 1)) == 0 && PIR_EDGE_RING <= 128,
+              "PIR_EDGE_RING must be a power of two up to 128");
+
 // Static member initialization
-volatile bool PIRSensor::_motionFlag = false;
-volatile unsigned long PIRSensor::_lastInterruptTime = 0;
+DRAM_ATTR PIRSensor::Edge PIRSensor::_edges[PIR_EDGE_RING];
+volatile uint8_t PIRSensor::_edgeHead = 0;
+volatile uint8_t PIRSensor::_edgeTail = 0;
+volatile uint32_t PIRSensor::_overflowCount = 0;
 
 // Global instance
 PIRSensor pirSensor;
 
-PIRSensor::PIRSensor() 
+PIRSensor::PIRSensor()
     : _callback(nullptr)
+    , _episodeCallback(nullptr)
     , _lastMotionTime(0)
-    , _lastTriggerTime(0)
+    , _lastTriggerMicros(0)
+    , _cooldown(false)
     , _enabled(true)
-    , _motionState(false) {
+    , _inEpisode(false)
+    , _high(false)
+    , _seenOverflows(0)
+    , _episodeCount(0) {
+    memset(&_episode, 0, sizeof(_episode));
+    // The gap timer needs no callback: update() closes the episode
+    TimerWheel::bind(_gapTimer, nullptr, this);
 }
 
 void PIRSensor::begin() {
     // Configure PIR pin as input with internal pulldown
     pinMode(PIR_PIN, INPUT_PULLDOWN);
     
-    // Attach interrupt for rising edge (motion detected)
-    attachInterrupt(digitalPinToInterrupt(PIR_PIN), handleInterrupt, RISING);
+    // Already high (a PIR wake from deep sleep): its edge came before boot.
+    // The ISR is not attached yet, so this is the only producer.
+    if (digitalRead(PIR_PIN) == HIGH) {
+        _edges[_edgeHead & (PIR_EDGE_RING - 1)] = {0, true};
+        _edgeHead = _edgeHead + 1;
+    }
+    
+    // Both edges: rising starts or extends an episode, falling may end it
+    attachInterrupt(digitalPinToInterrupt(PIR_PIN), handleInterrupt, CHANGE);
     
     DEBUG_PRINTLN("[PIR] Sensor initialized on GPIO " + String(PIR_PIN));
 }
 
 void IRAM_ATTR PIRSensor::handleInterrupt() {
-    unsigned long currentTime = millis();
+    uint32_t now = micros();
+    uint8_t head = _edgeHead;
     
-    // Debounce check
-    if (currentTime - _lastInterruptTime > PIR_DEBOUNCE_MS) {
-        _motionFlag = true;
-        _lastInterruptTime = currentTime;
+    // Full: keep the older edges, update() resyncs from the pin level
+    if ((uint8_t)(head - _edgeTail) >= PIR_EDGE_RING) {
+        _overflowCount++;
+        return;
     }
+    
+    Edge& edge = _edges[head & (PIR_EDGE_RING - 1)];
+    edge.micros = now;
+    edge.rising = digitalRead(PIR_PIN) == HIGH;
+    // Publish the entry only once it is written
+    _edgeHead = head + 1;
+    
+    // The loop may be sleeping until its next timer
+    timerWheel.wakeFromISR();
 }
 
 void PIRSensor::setMotionCallback(MotionCallback callback) {
     _callback = callback;
 }
 
+void PIRSensor::setEpisodeCallback(EpisodeCallback callback) {
+    _episodeCallback = callback;
+}
+
 void PIRSensor::update() {
-    if (!_enabled) {
-        return;
+    // Level before the drain: an edge after it is already in the ring
+    bool level = digitalRead(PIR_PIN) == HIGH;
+    
+    while (_edgeTail != _edgeHead) {
+        Edge edge = _edges[_edgeTail & (PIR_EDGE_RING - 1)];
+        _edgeTail = _edgeTail + 1;
+        if (_enabled) {
+            onEdge(edge);
+        }
     }
     
-    // Check if motion was detected via interrupt
-    if (_motionFlag) {
-        _motionFlag = false;
-        
-        unsigned long currentTime = millis();
-        
-        // Check cooldown period
-        if (currentTime - _lastTriggerTime >= PIR_COOLDOWN_MS) {
-            _lastMotionTime = currentTime;
-            _lastTriggerTime = currentTime;
-            _motionState = true;
-            
-            DEBUG_PRINTLN("[PIR] Motion detected!");
-            
-            // Call the callback if set
-            if (_callback != nullptr) {
-                _callback();
-            }
-        } else {
-            DEBUG_PRINTLN("[PIR] Motion ignored (cooldown active)");
+    // Edges were dropped: trust the pin over the ring
+    if (_seenOverflows != _overflowCount) {
+        _seenOverflows = _overflowCount;
+        DEBUG_PRINTF("[PIR] Edge ring overflowed (%lu edges lost)\n", _seenOverflows);
+        if (_enabled && level != _high) {
+            Edge resync = {(uint32_t)micros(), level};
+            onEdge(resync);
         }
     }
     
-    // Reset motion state after a short period
-    if (_motionState && (millis() - _lastMotionTime > 1000)) {
-        _motionState = false;
+    // Low for the whole gap: the episode is over
+    if (_inEpisode && !_high && micros() - _episode.endMicros >= PIR_EPISODE_GAP_MS * 1000UL) {
+        endEpisode();
+    }
+}
+
+void PIRSensor::onEdge(const Edge& edge) {
+    _high = edge.rising;
+    
+    if (!edge.rising) {
+        if (_inEpisode) {
+            _episode.endMicros = edge.micros;
+            _episode.edges++;
+            timerWheel.arm(_gapTimer, PIR_EPISODE_GAP_MS);
+        }
+        return;
+    }
+    
+    // A rising edge within the gap continues the episode
+    if (_inEpisode && edge.micros - _episode.endMicros < PIR_EPISODE_GAP_MS * 1000UL) {
+        _episode.edges++;
+        timerWheel.cancel(_gapTimer);
+        return;
+    }
+    if (_inEpisode) {
+        endEpisode();
+    }
+    
+    _inEpisode = true;
+    _episode.startMicros = edge.micros;
+    _episode.endMicros = edge.micros;
+    _episode.edges = 1;
+    
+    // Cooldown runs on edge time, so a backlog drains as it happened
+    _episode.triggered = !_cooldown || edge.micros - _lastTriggerMicros >= PIR_COOLDOWN_MS * 1000UL;
+    if (!_episode.triggered) {
+        DEBUG_PRINTLN("[PIR] Motion ignored (cooldown active)");
+        return;
+    }
+    
+    _lastMotionTime = millis();
+    _lastTriggerMicros = edge.micros;
+    _cooldown = true;
+    
+    DEBUG_PRINTF("[PIR] Motion detected! (%lu us ago)\n", micros() - edge.micros);
+    
+    // Call the callback if set
+    if (_callback != nullptr) {
+        _callback();
+    }
+}
+
+void PIRSensor::endEpisode() {
+    _inEpisode = false;
+    _episodeCount++;
+    timerWheel.cancel(_gapTimer);
+    
+    DEBUG_PRINTF("[PIR] Episode over: %lu ms, %d edges%s\n",
+        (_episode.endMicros - _episode.startMicros) / 1000, _episode.edges,
+        _episode.triggered ? "" : " (in cooldown)");
+    
+    if (_episodeCallback != nullptr) {
+        _episodeCallback(_episode);
     }
 }
 
 bool PIRSensor::isMotionDetected() {
-    return _motionState;
+    return _inEpisode;
 }
 
 unsigned long PIRSensor::getTimeSinceLastMotion() {
@@ -85,7 +173,7 @@ unsigned long PIRSensor::getTimeSinceLastMotion() {
 }
 
 void PIRSensor::resetCooldown() {
-    _lastTriggerTime = 0;
+    _cooldown = false;
 }
 
 void PIRSensor::setEnabled(bool enabled) {
@@ -97,4 +185,14 @@ bool PIRSensor::isEnabled() {
     return _enabled;
 }
 
+uint32_t PIRSensor::getLastTriggerMicros() {
+    return _lastTriggerMicros;
+}
+
+uint32_t PIRSensor::getEpisodeCount() {
+    return _episodeCount;
+}
 
+uint32_t PIRSensor::getOverflowCount() {
+    return _overflowCount;
+}
@@ -3,10 +3,26 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "timer_wheel.h"
+
+// One stretch of PIR output activity: from the first rising edge until
+// the output has stayed low for PIR_EPISODE_GAP_MS
+struct MotionEpisode {
+    uint32_t startMicros;       // First rising edge, taken in the ISR
+    uint32_t endMicros;         // Last falling edge
+    uint16_t edges;             // Edges coalesced into the episode
+    bool triggered;             // Whether it fired the motion callback (not in cooldown)
+};
 
 // Callback function type for motion detection
 typedef void (*MotionCallback)(void);
 
+// Callback function type for a finished motion episode
+typedef void (*EpisodeCallback)(const MotionEpisode& episode);
+
+// The ISR only timestamps edges into a single-producer/single-consumer
+// ring; update() drains it from the loop and coalesces the edges into
+// episodes, so edges that arrive while the loop is blocked are kept.
 class PIRSensor {
 public:
     PIRSensor();
@@ -17,10 +33,13 @@ public:
     // Set callback function for motion detection
     void setMotionCallback(MotionCallback callback);
     
-    // Check for motion (call in loop for debounce handling)
+    // Set callback function for the end of an episode
+    void setEpisodeCallback(EpisodeCallback callback);
+    
+    // Drain the edge ring (call in loop)
     void update();
     
-    // Get current motion state
+    // Whether a motion episode is open
     bool isMotionDetected();
     
     // Get time since last motion
@@ -32,18 +51,43 @@ public:
     // Enable/disable the sensor
     void setEnabled(bool enabled);
     bool isEnabled();
+    
+    // micros() of the rising edge that started the last triggered episode
+    uint32_t getLastTriggerMicros();
+    
+    // Statistics
+    uint32_t getEpisodeCount();
+    uint32_t getOverflowCount();
 
 private:
+    struct Edge {
+        uint32_t micros;
+        bool rising;
+    };
+    
     static void IRAM_ATTR handleInterrupt();
+    void onEdge(const Edge& edge);
+    void endEpisode();
     
-    static volatile bool _motionFlag;
-    static volatile unsigned long _lastInterruptTime;
+    // Edge ring: the ISR only writes _edgeHead, update() only _edgeTail
+    static Edge _edges[PIR_EDGE_RING];
+    static volatile uint8_t _edgeHead;
+    static volatile uint8_t _edgeTail;
+    static volatile uint32_t _overflowCount;
     
     MotionCallback _callback;
+    EpisodeCallback _episodeCallback;
     unsigned long _lastMotionTime;
-    unsigned long _lastTriggerTime;
+    uint32_t _lastTriggerMicros;
+    bool _cooldown;             // Set until PIR_COOLDOWN_MS after a trigger
+    Timer _gapTimer;            // Wakes the loop to close an episode gone quiet
     bool _enabled;
-    bool _motionState;
+    
+    MotionEpisode _episode;
+    bool _inEpisode;
+    bool _high;                 // Output level after the last edge drained
+    uint32_t _seenOverflows;
+    uint32_t _episodeCount;
 };
 
 // Global instance
@@ -0,0 +1,173 @@
+#include "quality_control.h"
+#include "camera.h"
+#include "mesh_network.h"
+
+// Largest image the budget aims for: one PSRAM slot, unless large images
+// are asked for (sendImage itself takes up to IMG_MAX_BYTES)
+static const size_t MAX_IMAGE_BYTES = QC_LARGE_IMAGES ? IMG_MAX_BYTES : IMG_SLOT_BYTES;
+
+// Frame sizes the controller steps through, smallest first. Only the 4:3
+// sizes: the framesize_t values between them change the aspect ratio.
+static const framesize_t FRAME_SIZES[] = {
+    FRAMESIZE_QQVGA, FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_UXGA
+};
+static const int FRAME_SIZE_COUNT = sizeof(FRAME_SIZES) / sizeof(FRAME_SIZES[0]);
+
+// Index of the largest listed size not above the given one (0 if none)
+static int frameSizeIndex(framesize_t size) {
+    int index = 0;
+    while (index + 1 < FRAME_SIZE_COUNT && FRAME_SIZES[index + 1] <= size) {
+        index++;
+    }
+    return index;
+}
+
+// Global instance
+QualityController qualityControl;
+
+QualityController::QualityController()
+    : _maxFrameSize(CAMERA_FRAME_SIZE)
+    , _quality(CAMERA_JPEG_QUALITY)
+    , _averageSize(0)
+    , _throughput(0)
+    , _recaptureCount(0) {
+}
+
+void QualityController::begin() {
+    // The driver sized its buffers for the initial frame size; never go above it
+    _maxFrameSize = camera.getFrameSize();
+    _quality = camera.getJpegQuality();
+}
+
+bool QualityController::capture(uint8_t* dest, size_t capacity, size_t& length) {
+    if (capacity > MAX_IMAGE_BYTES) {
+        capacity = MAX_IMAGE_BYTES;
+    }
+    
+    for (int attempt = 0; attempt <= QC_RECAPTURE_MAX; attempt++) {
+        if (camera.captureTo(dest, capacity, length)) {
+            noteFrame(length);
+            return true;
+        }
+        if (length == 0 || !QC_ENABLED) {
+            // No frame at all, or nothing we may change
+            return false;
+        }
+        
+        noteOversize();
+        _recaptureCount++;
+    }
+    
+    return false;
+}
+
+size_t QualityController::getBudget() {
+    uint8_t hops = meshNetwork.getHopDepth();
+    if (hops == 0) {
+        hops = 1;
+    }
+    
+    // Each hop re-sends every chunk, so far nodes get lighter images
+    size_t budget = MAX_IMAGE_BYTES / hops;
+    
+    // And no heavier than the link has recently carried in the target time
+    if (_throughput > 0) {
+        size_t deliverable = (size_t)((uint64_t)_throughput * QC_TARGET_TRANSFER_MS / 1000);
+        if (deliverable < budget) {
+            budget = deliverable;
+        }
+    }
+    
+    if (budget < QC_MIN_BUDGET) {
+        budget = QC_MIN_BUDGET;
+    }
+    return budget;
+}
+
+void QualityController::noteFrame(size_t length) {
+    if (!QC_ENABLED || length == 0) {
+        return;
+    }
+    
+    // EWMA with 1/4 weight on the new frame
+    _averageSize = _averageSize == 0 ? length : (_averageSize * 3 + length) / 4;
+    
+    size_t budget = getBudget();
+    if (_averageSize > budget) {
+        tighten(QC_QUALITY_STEP);
+    } else if (_averageSize < budget * 6 / 10) {
+        // Wide hysteresis band: a frame size step roughly doubles the bytes
+        relax();
+    }
+}
+
+void QualityController::noteOversize() {
+    if (!QC_ENABLED) {
+        return;
+    }
+    DEBUG_PRINTLN("[QC] Frame too large to send - tightening");
+    tighten(QC_QUALITY_STEP * 2);
+}
+
+void QualityController::tighten(int step) {
+    if (_quality < QC_QUALITY_WORST) {
+        _quality = min(_quality + step, QC_QUALITY_WORST);
+        camera.setJpegQuality(_quality);
+        return;
+    }
+    
+    // A size off the list steps down onto it
+    framesize_t current = camera.getFrameSize();
+    int index = frameSizeIndex(current);
+    if (FRAME_SIZES[index] == current) {
+        index--;
+    }
+    if (index >= 0 && FRAME_SIZES[index] < current && FRAME_SIZES[index] >= QC_FRAME_SIZE_MIN) {
+        // Quality exhausted: drop a frame size and restart from mid quality
+        camera.setFrameSize(FRAME_SIZES[index]);
+        _quality = (CAMERA_JPEG_QUALITY + QC_QUALITY_WORST) / 2;
+        camera.setJpegQuality(_quality);
+        _averageSize = 0;
+    }
+}
+
+void QualityController::relax() {
+    if (_quality > CAMERA_JPEG_QUALITY) {
+        _quality = max(_quality - QC_QUALITY_STEP, CAMERA_JPEG_QUALITY);
+        camera.setJpegQuality(_quality);
+        return;
+    }
+    
+    framesize_t current = camera.getFrameSize();
+    int index = frameSizeIndex(current);
+    if (FRAME_SIZES[index] <= current) {
+        index++;
+    }
+    if (index < FRAME_SIZE_COUNT && FRAME_SIZES[index] <= _maxFrameSize) {
+        // Best quality at this size still fits easily: go up a size, coarser
+        camera.setFrameSize(FRAME_SIZES[index]);
+        _quality = (CAMERA_JPEG_QUALITY + QC_QUALITY_WORST) / 2;
+        camera.setJpegQuality(_quality);
+        _averageSize = 0;
+    }
+}
+
+void QualityController::noteTransfer(size_t bytes, uint32_t durationMs) {
+    if (durationMs == 0) {
+        return;
+    }
+    
+    uint32_t rate = (uint32_t)((uint64_t)bytes * 1000 / durationMs);
+    _throughput = _throughput == 0 ? rate : (_throughput * 3 + rate) / 4;
+    
+    DEBUG_PRINTF("[QC] Throughput %lu B/s, budget %u bytes (q=%d, size=%d)\n",
+        _throughput, getBudget(), _quality, camera.getFrameSize());
+}
+
+uint32_t QualityController::getThroughput() {
+    return _throughput;
+}
+
+uint32_t QualityController::getRecaptureCount() {
+    return _recaptureCount;
+}
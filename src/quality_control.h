@@ -0,0 +1,52 @@
+#ifndef QUALITY_CONTROL_H
+#define QUALITY_CONTROL_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "esp_camera.h"
+
+// Closed-loop JPEG quality / frame size controller. Holds a smoothed
+// frame size against a per-image byte budget derived from the node's hop
+// depth and the throughput recent transfers achieved, coarsening quality
+// first and frame size second (and the reverse when there is headroom).
+class QualityController {
+public:
+    QualityController();
+    
+    // Take the camera's configured settings as the ceiling
+    void begin();
+    
+    // Capture into a buffer, recapturing tighter if the frame is too large
+    bool capture(uint8_t* dest, size_t capacity, size_t& length);
+    
+    // Feed back a captured frame's size
+    void noteFrame(size_t length);
+    
+    // A frame was too large to send; tighten hard before the recapture
+    void noteOversize();
+    
+    // Feed back a completed transfer
+    void noteTransfer(size_t bytes, uint32_t durationMs);
+    
+    // Current per-image byte budget
+    size_t getBudget();
+    
+    // Statistics
+    uint32_t getThroughput();       // Bytes per second (0 = not measured yet)
+    uint32_t getRecaptureCount();
+
+private:
+    void tighten(int step);
+    void relax();
+    
+    framesize_t _maxFrameSize;
+    int _quality;
+    size_t _averageSize;            // Smoothed frame size (0 = restart)
+    uint32_t _throughput;
+    uint32_t _recaptureCount;
+};
+
+// Global instance
+extern QualityController qualityControl;
+
+#endif // QUALITY_CONTROL_H
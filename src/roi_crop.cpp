@@ -0,0 +1,176 @@
+#include "roi_crop.h"
+#include "frame_diff.h"
+#include "motion_verifier.h"
+#include "img_converters.h"
+
+// Global instance
+RoiCropper roiCropper;
+
+RoiCropper::RoiCropper()
+    : _rgb(nullptr)
+    , _rgbCapacity(0)
+    , _cropCount(0)
+    , _bytesSaved(0) {
+}
+
+RoiCropper::~RoiCropper() {
+    if (_rgb) {
+        free(_rgb);
+    }
+}
+
+bool RoiCropper::ensureBuffer(size_t bytes) {
+    if (bytes <= _rgbCapacity) {
+        return true;
+    }
+    
+    // Full-frame decodes only fit in PSRAM
+    if (!psramFound()) {
+        return false;
+    }
+    
+    if (_rgb) {
+        free(_rgb);
+    }
+    _rgb = (uint8_t*)ps_malloc(bytes);
+    _rgbCapacity = _rgb ? bytes : 0;
+    if (!_rgb) {
+        DEBUG_PRINTLN("[ROI] Failed to allocate decode buffer");
+    }
+    return _rgb != nullptr;
+}
+
+bool RoiCropper::cropInPlace(uint8_t* jpeg, size_t& length, size_t capacity,
+                             uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                             ImageRegion& region) {
+    // Most of the frame changed: the crop would save little
+    if ((uint32_t)width * height * 100 > (uint32_t)VERIFY_THUMB_PIXELS * ROI_MAX_AREA_PCT) {
+        return false;
+    }
+    
+    uint16_t frameWidth, frameHeight;
+    if (!FrameDiff::jpegDimensions(jpeg, length, frameWidth, frameHeight)) {
+        return false;
+    }
+    
+    // Decode at full size if it fits, otherwise at the smallest reduction that does
+    uint8_t scale = 1;
+    jpg_scale_t scaleMode = JPG_SCALE_NONE;
+    while ((size_t)(frameWidth / scale) * (frameHeight / scale) * 2 > ROI_DECODE_MAX_BYTES && scale < 8) {
+        scale *= 2;
+        scaleMode = (jpg_scale_t)(scaleMode + 1);
+    }
+    uint16_t dw = frameWidth / scale;
+    uint16_t dh = frameHeight / scale;
+    
+    if (!ensureBuffer((size_t)dw * dh * 2) || !jpg2rgb565(jpeg, length, _rgb, scaleMode)) {
+        return false;
+    }
+    
+    // Thumbnail box -> decoded pixels, padded, then aligned to 8-pixel MCUs
+    uint32_t cx0 = (uint32_t)x * dw / VERIFY_THUMB_WIDTH;
+    uint32_t cy0 = (uint32_t)y * dh / VERIFY_THUMB_HEIGHT;
+    uint32_t cx1 = ((uint32_t)(x + width) * dw + VERIFY_THUMB_WIDTH - 1) / VERIFY_THUMB_WIDTH;
+    uint32_t cy1 = ((uint32_t)(y + height) * dh + VERIFY_THUMB_HEIGHT - 1) / VERIFY_THUMB_HEIGHT;
+    uint32_t mx = (cx1 - cx0) * ROI_MARGIN_PCT / 100;
+    uint32_t my = (cy1 - cy0) * ROI_MARGIN_PCT / 100;
+    cx0 = cx0 > mx ? (cx0 - mx) & ~7u : 0;
+    cy0 = cy0 > my ? (cy0 - my) & ~7u : 0;
+    cx1 = min((cx1 + mx + 7) & ~7u, (uint32_t)dw);
+    cy1 = min((cy1 + my + 7) & ~7u, (uint32_t)dh);
+    uint16_t cw = cx1 - cx0;
+    uint16_t ch = cy1 - cy0;
+    
+    // Pack the region's rows to the front of the buffer (never overlaps forward)
+    for (uint16_t row = 0; row < ch; row++) {
+        memmove(_rgb + (size_t)row * cw * 2,
+                _rgb + ((size_t)(cy0 + row) * dw + cx0) * 2,
+                (size_t)cw * 2);
+    }
+    
+    uint8_t* encoded = nullptr;
+    size_t encodedLength = 0;
+    if (!fmt2jpg(_rgb, (size_t)cw * ch * 2, cw, ch, PIXFORMAT_RGB565, ROI_JPEG_QUALITY,
+                 &encoded, &encodedLength)) {
+        DEBUG_PRINTLN("[ROI] Crop encode failed");
+        return false;
+    }
+    
+    // Finer quality can outweigh the smaller area; keep whichever is smaller
+    bool worthwhile = encodedLength < length && encodedLength <= capacity;
+    if (worthwhile) {
+        DEBUG_PRINTF("[ROI] Cropped %ux%u+%u+%u of %ux%u: %u -> %u bytes\n",
+            cw * scale, ch * scale, cx0 * scale, cy0 * scale, frameWidth, frameHeight,
+            length, encodedLength);
+        
+        _bytesSaved += length - encodedLength;
+        _cropCount++;
+        
+        memcpy(jpeg, encoded, encodedLength);
+        length = encodedLength;
+        
+        region.flags = IMAGE_FLAG_CROP;
+        region.x = cx0 * scale;
+        region.y = cy0 * scale;
+        region.width = cw * scale;
+        region.height = ch * scale;
+        region.frameWidth = frameWidth;
+        region.frameHeight = frameHeight;
+    }
+    
+    free(encoded);
+    return worthwhile;
+}
+
+bool RoiCropper::encodeContext(const uint8_t* jpeg, size_t length, uint8_t** out, size_t* outLength,
+                               ImageRegion& region) {
+    uint16_t frameWidth, frameHeight;
+    if (!FrameDiff::jpegDimensions(jpeg, length, frameWidth, frameHeight)) {
+        return false;
+    }
+    
+    if (!encodeReduced(jpeg, length, frameWidth / 4, ROI_CONTEXT_QUALITY, out, outLength)) {
+        DEBUG_PRINTLN("[ROI] Context encode failed");
+        return false;
+    }
+    
+    region.flags = IMAGE_FLAG_CONTEXT;
+    region.x = 0;
+    region.y = 0;
+    region.width = frameWidth;
+    region.height = frameHeight;
+    region.frameWidth = frameWidth;
+    region.frameHeight = frameHeight;
+    return true;
+}
+
+bool RoiCropper::encodeReduced(const uint8_t* jpeg, size_t length, uint16_t maxWidth, uint8_t quality,
+                               uint8_t** out, size_t* outLength) {
+    uint16_t frameWidth, frameHeight;
+    if (!FrameDiff::jpegDimensions(jpeg, length, frameWidth, frameHeight)) {
+        return false;
+    }
+    
+    // The decoder only reduces by powers of two, up to 1/8
+    uint8_t scale = 2;
+    jpg_scale_t scaleMode = JPG_SCALE_2X;
+    while (frameWidth / scale > maxWidth && scale < 8) {
+        scale *= 2;
+        scaleMode = (jpg_scale_t)(scaleMode + 1);
+    }
+    uint16_t dw = frameWidth / scale;
+    uint16_t dh = frameHeight / scale;
+    
+    if (!ensureBuffer((size_t)dw * dh * 2) || !jpg2rgb565(jpeg, length, _rgb, scaleMode)) {
+        return false;
+    }
+    return fmt2jpg(_rgb, (size_t)dw * dh * 2, dw, dh, PIXFORMAT_RGB565, quality, out, outLength);
+}
+
+uint32_t RoiCropper::getCropCount() {
+    return _cropCount;
+}
+
+uint32_t RoiCropper::getBytesSaved() {
+    return _bytesSaved;
+}
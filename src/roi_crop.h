@@ -0,0 +1,49 @@
+#ifndef ROI_CROP_H
+#define ROI_CROP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "message_protocol.h"
+
+// Cuts a JPEG down to the region where motion was seen. The frame is
+// decoded to RGB565, the padded MCU-aligned region re-encoded at
+// ROI_JPEG_QUALITY, and the geometry reported for IMAGE_START.
+class RoiCropper {
+public:
+    RoiCropper();
+    ~RoiCropper();
+    
+    // Replace a JPEG with the crop of a thumbnail-grid region. Leaves the
+    // image untouched and returns false when cropping would not pay off.
+    bool cropInPlace(uint8_t* jpeg, size_t& length, size_t capacity,
+                     uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                     ImageRegion& region);
+    
+    // Encode a quarter-scale, low-quality copy of the full frame; the
+    // caller frees *out
+    bool encodeContext(const uint8_t* jpeg, size_t length, uint8_t** out, size_t* outLength,
+                       ImageRegion& region);
+    
+    // Re-encode a JPEG decoded down (1/2..1/8) to at most maxWidth; the
+    // caller frees *out
+    bool encodeReduced(const uint8_t* jpeg, size_t length, uint16_t maxWidth, uint8_t quality,
+                       uint8_t** out, size_t* outLength);
+    
+    // Statistics
+    uint32_t getCropCount();
+    uint32_t getBytesSaved();
+
+private:
+    bool ensureBuffer(size_t bytes);
+    
+    uint8_t* _rgb;              // RGB565 decode buffer
+    size_t _rgbCapacity;
+    
+    uint32_t _cropCount;
+    uint32_t _bytesSaved;
+};
+
+// Global instance
+extern RoiCropper roiCropper;
+
+#endif // ROI_CROP_H
@@ -0,0 +1,149 @@
+#include "timelapse.h"
+
+// Global instance
+Timelapse timelapse;
+
+Timelapse::Timelapse()
+    : _frames(nullptr)
+    , _storage(nullptr)
+    , _slots(0)
+    , _slotBytes(0)
+    , _head(0)
+    , _count(0)
+    , _captureDue(false)
+    , _sendDeferred(false)
+    , _capturedCount(0)
+    , _sentCount(0)
+    , _droppedCount(0) {
+    TimerWheel::bind(_captureTimer, onCaptureTimer, this);
+    TimerWheel::bind(_sendTimer, onSendTimer, this);
+}
+
+Timelapse::~Timelapse() {
+    if (_storage) {
+        free(_storage);
+    }
+    if (_frames) {
+        free(_frames);
+    }
+}
+
+bool Timelapse::begin(uint8_t slots, size_t slotBytes) {
+    if (_frames) {
+        return true;
+    }
+    
+    if (!psramFound()) {
+        DEBUG_PRINTLN("[TIMELAPSE] No PSRAM - time-lapse disabled");
+        return false;
+    }
+    
+    _storage = (uint8_t*)ps_malloc(slots * slotBytes);
+    _frames = (TimelapseFrame*)ps_malloc(slots * sizeof(TimelapseFrame));
+    if (!_storage || !_frames) {
+        DEBUG_PRINTLN("[TIMELAPSE] Failed to allocate snapshot store");
+        if (_storage) free(_storage);
+        if (_frames) free(_frames);
+        _storage = nullptr;
+        _frames = nullptr;
+        return false;
+    }
+    
+    memset(_frames, 0, slots * sizeof(TimelapseFrame));
+    for (uint8_t i = 0; i < slots; i++) {
+        _frames[i].data = _storage + i * slotBytes;
+    }
+    _slots = slots;
+    _slotBytes = slotBytes;
+    
+    // First snapshot right away, then on the schedule
+    _captureDue = true;
+    
+    DEBUG_PRINTF("[TIMELAPSE] Snapshot store ready: %d x %u bytes, every %lu s\n",
+        slots, slotBytes, (unsigned long)(TIMELAPSE_INTERVAL_MS / 1000));
+    return true;
+}
+
+bool Timelapse::isReady() {
+    return _frames != nullptr;
+}
+
+bool Timelapse::captureDue() {
+    return _frames && _captureDue;
+}
+
+void Timelapse::store(const uint8_t* data, size_t length, uint32_t timestamp) {
+    // The schedule moves on whether or not this snapshot is kept
+    _captureDue = false;
+    timerWheel.arm(_captureTimer, TIMELAPSE_INTERVAL_MS);
+    
+    if (!_frames || !data || length == 0 || length > _slotBytes) {
+        _droppedCount++;
+        return;
+    }
+    
+    // A full store gives up its oldest snapshot
+    if (_count == _slots) {
+        DEBUG_PRINTLN("[TIMELAPSE] Store full, dropping oldest snapshot");
+        _head = (_head + 1) % _slots;
+        _count--;
+        _droppedCount++;
+    }
+    
+    TimelapseFrame& frame = _frames[(_head + _count) % _slots];
+    memcpy(frame.data, data, length);
+    frame.length = length;
+    frame.timestamp = timestamp;
+    _count++;
+    _capturedCount++;
+    
+    DEBUG_PRINTF("[TIMELAPSE] Snapshot %u bytes, %d held\n", length, _count);
+}
+
+bool Timelapse::sendDue() {
+    return _count >= min((uint8_t)TIMELAPSE_BATCH_MIN, _slots) && !_sendDeferred;
+}
+
+void Timelapse::deferSend(uint32_t delayMs) {
+    DEBUG_PRINTF("[TIMELAPSE] Batch deferred for %lu ms\n", delayMs);
+    _sendDeferred = true;
+    timerWheel.arm(_sendTimer, delayMs);
+}
+
+uint8_t Timelapse::count() {
+    return _count;
+}
+
+const TimelapseFrame* Timelapse::frame(uint8_t index) {
+    if (index >= _count) {
+        return nullptr;
+    }
+    return &_frames[(_head + index) % _slots];
+}
+
+void Timelapse::release(uint8_t frames) {
+    frames = min(frames, _count);
+    _head = (_head + frames) % _slots;
+    _count -= frames;
+    _sentCount += frames;
+}
+
+uint32_t Timelapse::getCapturedCount() {
+    return _capturedCount;
+}
+
+uint32_t Timelapse::getSentCount() {
+    return _sentCount;
+}
+
+uint32_t Timelapse::getDroppedCount() {
+    return _droppedCount;
+}
+
+void Timelapse::onCaptureTimer(void* context) {
+    static_cast<Timelapse*>(context)->_captureDue = true;
+}
+
+void Timelapse::onSendTimer(void* context) {
+    static_cast<Timelapse*>(context)->_sendDeferred = false;
+}
@@ -0,0 +1,70 @@
+#ifndef TIMELAPSE_H
+#define TIMELAPSE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+// Scheduled snapshot held until the next batch goes out
+struct TimelapseFrame {
+    uint8_t* data;          // Fixed PSRAM region, TIMELAPSE_SLOT_BYTES long
+    size_t length;
+    uint32_t timestamp;     // Mesh time of the capture
+};
+
+// Sensor side of time-lapse: snapshots taken on a timer into a PSRAM
+// ring, oldest first, and sent together once enough have built up and
+// the gateway has a quiet window. When the gateway defers the batch the
+// snapshots stay here and the request is repeated when it said to.
+class Timelapse {
+public:
+    Timelapse();
+    ~Timelapse();
+    
+    // Allocate the store (PSRAM only) and start the capture schedule
+    bool begin(uint8_t slots, size_t slotBytes);
+    bool isReady();
+    
+    // Snapshot schedule
+    bool captureDue();
+    void store(const uint8_t* data, size_t length, uint32_t timestamp);
+    
+    // Batch ready and not deferred by the gateway
+    bool sendDue();
+    void deferSend(uint32_t delayMs);
+    
+    // Held snapshots, oldest first
+    uint8_t count();
+    const TimelapseFrame* frame(uint8_t index);
+    void release(uint8_t frames);
+    
+    // Statistics
+    uint32_t getCapturedCount();
+    uint32_t getSentCount();
+    uint32_t getDroppedCount();
+
+private:
+    static void onCaptureTimer(void* context);
+    static void onSendTimer(void* context);
+    
+    TimelapseFrame* _frames;
+    uint8_t* _storage;
+    uint8_t _slots;
+    size_t _slotBytes;
+    uint8_t _head;
+    uint8_t _count;
+    
+    Timer _captureTimer;    // Next snapshot is due (wakes the loop)
+    Timer _sendTimer;       // Deferral from the gateway has run out
+    bool _captureDue;
+    bool _sendDeferred;
+    
+    uint32_t _capturedCount;
+    uint32_t _sentCount;
+    uint32_t _droppedCount;
+};
+
+// Global instance
+extern Timelapse timelapse;
+
+#endif // TIMELAPSE_H
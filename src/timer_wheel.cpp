@@ -0,0 +1,195 @@
+#include "timer_wheel.h"
+
+// Global instance
+TimerWheel timerWheel;
+
+// Timers are armed from the ESP-NOW and BLE tasks as well as the loop
+static portMUX_TYPE wheelLock = portMUX_INITIALIZER_UNLOCKED;
+
+TimerWheel::TimerWheel()
+    : _currentTick(0)
+    , _armedCount(0)
+    , _loopTask(nullptr) {
+    memset(_slots, 0, sizeof(_slots));
+    memset(_occupied, 0, sizeof(_occupied));
+}
+
+void TimerWheel::begin() {
+    _loopTask = xTaskGetCurrentTaskHandle();
+    _currentTick = millis() / TIMER_WHEEL_TICK_MS;
+}
+
+void TimerWheel::bind(Timer& timer, TimerCallback callback, void* context) {
+    memset(&timer, 0, sizeof(Timer));
+    timer.callback = callback;
+    timer.context = context;
+}
+
+void TimerWheel::arm(Timer& timer, uint32_t delayMs) {
+    portENTER_CRITICAL(&wheelLock);
+    if (timer.armed) {
+        unlink(timer);
+    }
+    // Round up so a timer never fires early
+    timer.tick = (millis() + delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    link(timer);
+    portEXIT_CRITICAL(&wheelLock);
+    
+    // A deadline earlier than the one the loop sleeps towards
+    wake();
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    portENTER_CRITICAL(&wheelLock);
+    if (timer.armed) {
+        unlink(timer);
+    }
+    portEXIT_CRITICAL(&wheelLock);
+}
+
+bool TimerWheel::isArmed(const Timer& timer) {
+    return timer.armed;
+}
+
+void TimerWheel::advance() {
+    uint32_t nowTick = millis() / TIMER_WHEEL_TICK_MS;
+    
+    // The cursor moves only here, but arm() reads it from other tasks
+    portENTER_CRITICAL(&wheelLock);
+    // After a long stall one rotation covers every bucket
+    if (nowTick - _currentTick > TIMER_WHEEL_SLOTS) {
+        _currentTick = nowTick - TIMER_WHEEL_SLOTS;
+    }
+    uint32_t tick = _currentTick;
+    portEXIT_CRITICAL(&wheelLock);
+    
+    for (; (int32_t)(nowTick - tick) >= 0; tick++) {
+        uint32_t slot = tick & SLOT_MASK;
+        
+        // Timers re-armed from a callback land in later buckets
+        portENTER_CRITICAL(&wheelLock);
+        _currentTick = tick + 1;
+        portEXIT_CRITICAL(&wheelLock);
+        
+        // Pop one due timer at a time so callbacks can arm/cancel freely
+        while (true) {
+            Timer* due = nullptr;
+            
+            portENTER_CRITICAL(&wheelLock);
+            for (Timer* timer = _slots[slot]; timer; timer = timer->next) {
+                if ((int32_t)(timer->tick - tick) <= 0) {
+                    unlink(*timer);
+                    due = timer;
+                    break;
+                }
+            }
+            portEXIT_CRITICAL(&wheelLock);
+            
+            if (!due) {
+                break;
+            }
+            if (due->callback) {
+                due->callback(due->context);
+            }
+        }
+    }
+}
+
+uint32_t TimerWheel::msUntilNext() {
+    uint32_t limit = min((uint32_t)TIMER_WHEEL_MAX_SLEEP_MS, (uint32_t)TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS);
+    uint32_t start = _currentTick & SLOT_MASK;
+    uint32_t result = limit;
+    
+    // First occupied bucket ahead of the cursor; it may hold a timer from a
+    // later rotation, which only costs one early wakeup
+    portENTER_CRITICAL(&wheelLock);
+    for (uint32_t distance = 0; distance < TIMER_WHEEL_SLOTS; ) {
+        uint32_t slot = (start + distance) & SLOT_MASK;
+        uint32_t bits = _occupied[slot / 32] >> (slot % 32);
+        
+        if (bits == 0) {
+            // Skip the rest of this bitmap word
+            distance += 32 - (slot % 32);
+            continue;
+        }
+        
+        distance += __builtin_ctz(bits);
+        if (distance < TIMER_WHEEL_SLOTS) {
+            uint32_t dueTick = _currentTick + distance;
+            uint32_t now = millis();
+            uint32_t due = dueTick * TIMER_WHEEL_TICK_MS;
+            result = (int32_t)(due - now) > 0 ? min(due - now, limit) : 0;
+        }
+        break;
+    }
+    portEXIT_CRITICAL(&wheelLock);
+    
+    return result;
+}
+
+void TimerWheel::sleep() {
+    uint32_t waitMs = msUntilNext();
+    if (waitMs > 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    }
+}
+
+void TimerWheel::wake() {
+    // The loop arming its own timers is already awake
+    if (_loopTask && xTaskGetCurrentTaskHandle() != _loopTask) {
+        xTaskNotifyGive(_loopTask);
+    }
+}
+
+void IRAM_ATTR TimerWheel::wakeFromISR() {
+    if (_loopTask) {
+        BaseType_t higherPriorityWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(_loopTask, &higherPriorityWoken);
+        if (higherPriorityWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+uint16_t TimerWheel::armedCount() {
+    return _armedCount;
+}
+
+void TimerWheel::link(Timer& timer) {
+    // Deadlines already past go in the cursor's bucket so the next advance fires them
+    if ((int32_t)(timer.tick - _currentTick) < 0) {
+        timer.tick = _currentTick;
+    }
+    uint32_t slot = timer.tick & SLOT_MASK;
+    
+    timer.prev = nullptr;
+    timer.next = _slots[slot];
+    if (timer.next) {
+        timer.next->prev = &timer;
+    }
+    _slots[slot] = &timer;
+    _occupied[slot / 32] |= 1UL << (slot % 32);
+    timer.armed = true;
+    _armedCount++;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    uint32_t slot = timer.tick & SLOT_MASK;
+    
+    if (timer.prev) {
+        timer.prev->next = timer.next;
+    } else {
+        _slots[slot] = timer.next;
+    }
+    if (timer.next) {
+        timer.next->prev = timer.prev;
+    }
+    if (!_slots[slot]) {
+        _occupied[slot / 32] &= ~(1UL << (slot % 32));
+    }
+    
+    timer.next = nullptr;
+    timer.prev = nullptr;
+    timer.armed = false;
+    _armedCount--;
+}
@@ -0,0 +1,75 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Timer expiry callback; runs in the loop task
+typedef void (*TimerCallback)(void* context);
+
+// Intrusive timer node; owners embed one per timeout they need.
+// Bind once, then arm/cancel as often as needed.
+struct Timer {
+    Timer* next;
+    Timer* prev;
+    uint32_t tick;          // Wheel tick at which it fires
+    TimerCallback callback;
+    void* context;
+    bool armed;
+};
+
+// Hashed timing wheel: timers are bucketed by deadline tick, so arm and
+// cancel are O(1) and expiry only visits the buckets that have come due.
+// Deadlines beyond one rotation stay in their bucket until their turn.
+class TimerWheel {
+public:
+    TimerWheel();
+    
+    // Remember the loop task so other tasks and ISRs can wake it
+    void begin();
+    
+    // Set a timer's callback (does not arm it)
+    static void bind(Timer& timer, TimerCallback callback, void* context);
+    
+    // Arm (or re-arm) a timer to fire delayMs from now
+    void arm(Timer& timer, uint32_t delayMs);
+    
+    // Disarm a timer; safe if it is not armed
+    void cancel(Timer& timer);
+    
+    bool isArmed(const Timer& timer);
+    
+    // Fire every timer whose deadline has passed (call from the loop)
+    void advance();
+    
+    // Upper bound on the time until the next timer is due
+    uint32_t msUntilNext();
+    
+    // Block the loop until the next deadline or a wake()
+    void sleep();
+    
+    // Wake the loop early: new work arrived from another task or an ISR
+    void wake();
+    void IRAM_ATTR wakeFromISR();
+    
+    // Number of armed timers
+    uint16_t armedCount();
+
+private:
+    void link(Timer& timer);
+    void unlink(Timer& timer);
+    
+    static const uint32_t SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+    static const uint32_t BITMAP_WORDS = (TIMER_WHEEL_SLOTS + 31) / 32;
+    
+    Timer* _slots[TIMER_WHEEL_SLOTS];
+    uint32_t _occupied[BITMAP_WORDS];   // Bit per non-empty slot
+    uint32_t _currentTick;              // Next tick to expire
+    uint16_t _armedCount;
+    TaskHandle_t _loopTask;
+};
+
+// Global instance
+extern TimerWheel timerWheel;
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,65 @@
+// Host benchmark: one AnimalClassifier score and its layers on a
+// verifier-sized thumbnail. Host timings only show where the time goes;
+// the ESP32 cost comes from the verifier's own log.
+
+#include "animal_classifier.h"
+#include "host_test.h"
+
+static const size_t PIXELS = CLASSIFIER_WIDTH * CLASSIFIER_HEIGHT;
+static const int ROUNDS = 20000;
+
+static uint8_t luma[PIXELS];
+static uint8_t change[PIXELS];
+static int8_t planes[8 * PIXELS];
+static int8_t layerOut[8 * PIXELS / 4];
+static int8_t weights[8 * 8 * 9];
+static int32_t bias[8];
+static uint8_t shift[8];
+
+template <typename Kernel>
+static void run(const char* name, Kernel kernel) {
+    double start = nowSeconds();
+    for (int i = 0; i < ROUNDS; i++) {
+        // The inputs do not change: keep the compiler from hoisting the work
+        asm volatile("" ::: "memory");
+        hostSink += kernel();
+    }
+    double us = (nowSeconds() - start) * 1e6 / ROUNDS;
+    printf("  %-24s %8.2f us/call\n", name, us);
+}
+
+int main() {
+    for (size_t i = 0; i < PIXELS; i++) {
+        luma[i] = randomLuma();
+        change[i] = randomNext() % 8;
+    }
+    for (size_t i = 0; i < sizeof(planes); i++) {
+        planes[i] = randomLuma();
+    }
+    for (size_t i = 0; i < sizeof(weights); i++) {
+        weights[i] = (int8_t)(randomNext() % 5) - 2;
+    }
+    for (uint8_t c = 0; c < 8; c++) {
+        bias[c] = -64;
+        shift[c] = 3;
+    }
+    
+    printf("[animal_classifier] %dx%d thumbnail, %d rounds\n", CLASSIFIER_WIDTH, CLASSIFIER_HEIGHT, ROUNDS);
+    run("score", [] { return (uint32_t)AnimalClassifier::score(luma, change); });
+    run("conv3x3s2 2->8 32x24", [] {
+        AnimalClassifier::conv3x3s2(planes, 2, CLASSIFIER_WIDTH, CLASSIFIER_HEIGHT,
+                                    weights, bias, shift, 8, layerOut);
+        return (uint32_t)layerOut[0];
+    });
+    run("conv3x3s2 8->8 16x12", [] {
+        AnimalClassifier::conv3x3s2(planes, 8, CLASSIFIER_WIDTH / 2, CLASSIFIER_HEIGHT / 2,
+                                    weights, bias, shift, 8, layerOut);
+        return (uint32_t)layerOut[0];
+    });
+    run("globalMax 8x8x6", [] {
+        int8_t pooled[8];
+        AnimalClassifier::globalMax(planes, 8, 48, pooled);
+        return (uint32_t)pooled[7];
+    });
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef FRAME_DIFF_REFERENCE_H
+#define FRAME_DIFF_REFERENCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Plain per-pixel versions of the FrameDiff kernels, one byte at a time.
+// Pixels are bytes in memory order, which is lane order on a
+// little-endian host as on the ESP32.
+namespace reference {
+
+inline uint32_t countChanged(const uint8_t* a, const uint8_t* b, size_t pixels, uint8_t threshold) {
+    uint32_t changed = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        if (abs(a[i] - b[i]) > threshold) {
+            changed++;
+        }
+    }
+    return changed;
+}
+
+inline uint32_t sumAbsDiff(const uint8_t* a, const uint8_t* b, size_t pixels) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        sum += abs(a[i] - b[i]);
+    }
+    return sum;
+}
+
+inline void blend(uint8_t* background, const uint8_t* frame, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t half = (background[i] + frame[i]) / 2;
+        background[i] = (background[i] + half) / 2;
+    }
+}
+
+inline bool changedBounds(const uint8_t* a, const uint8_t* b, uint16_t width, uint16_t height,
+                          uint8_t threshold, uint16_t& x0, uint16_t& y0, uint16_t& x1, uint16_t& y1) {
+    bool found = false;
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            if (abs(a[i] - b[i]) <= threshold) {
+                continue;
+            }
+            if (!found) {
+                x0 = x1 = x;
+                y0 = y1 = y;
+                found = true;
+            }
+            if (x < x0) x0 = x;
+            if (x > x1) x1 = x;
+            if (y < y0) y0 = y;
+            if (y > y1) y1 = y;
+        }
+    }
+    if (found) {
+        x1++;
+        y1++;
+    }
+    return found;
+}
+
+} // namespace reference
+
+#endif // FRAME_DIFF_REFERENCE_H
@@ -0,0 +1,66 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Minimal checks for the host tests: failures are printed and counted,
+// and the test exits non-zero if any failed.
+static int hostFailures = 0;
+static int hostChecks = 0;
+
+#define CHECK(condition) \
+    do { \
+        hostChecks++; \
+        if (!(condition)) { \
+            hostFailures++; \
+            if (hostFailures <= 20) { \
+                printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            } \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        hostChecks++; \
+        unsigned long long _a = (unsigned long long)(actual); \
+        unsigned long long _e = (unsigned long long)(expected); \
+        if (_a != _e) { \
+            hostFailures++; \
+            if (hostFailures <= 20) { \
+                printf("%s:%d: %s == 0x%llx, expected 0x%llx\n", __FILE__, __LINE__, #actual, _a, _e); \
+            } \
+        } \
+    } while (0)
+
+static inline int reportResults(const char* name) {
+    printf("[%s] %d checks, %d failed\n", name, hostChecks, hostFailures);
+    return hostFailures == 0 ? 0 : 1;
+}
+
+// xorshift32: the same inputs on every run
+static uint32_t hostRandomState = 0x2545F491u;
+
+static inline uint32_t randomNext() {
+    hostRandomState ^= hostRandomState << 13;
+    hostRandomState ^= hostRandomState >> 17;
+    hostRandomState ^= hostRandomState << 5;
+    return hostRandomState;
+}
+
+static inline uint8_t randomLuma() {
+    return randomNext() & 0x7F;
+}
+
+// Monotonic time for the benchmarks
+static inline double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Defeats dead-code elimination of benchmarked results
+static volatile uint32_t hostSink;
+
+#endif // HOST_TEST_H
@@ -0,0 +1,203 @@
+// Host test: AnimalClassifier's kernels against plain references, and
+// golden scores for fixed scenes so a change to the weights or kernels
+// that moves any score is caught. Regenerate the golden values (and say
+// why in the commit) when the weights are replaced.
+
+#include "animal_classifier.h"
+#include "host_test.h"
+#include <string.h>
+
+static const size_t PIXELS = CLASSIFIER_WIDTH * CLASSIFIER_HEIGHT;
+
+// Zero-pads the input, then a 3x3 stride-2 convolution with ReLU and requantisation
+static void referenceConv(const int8_t* in, uint8_t inCh, uint16_t w, uint16_t h,
+                          const int8_t* weights, const int32_t* bias, const uint8_t* shift,
+                          uint8_t outCh, int8_t* out) {
+    const uint16_t pw = w + 2;
+    const uint16_t ph = h + 2;
+    static int32_t padded[16 * 36 * 28];
+    memset(padded, 0, sizeof(padded));
+    for (uint8_t c = 0; c < inCh; c++) {
+        for (uint16_t y = 0; y < h; y++) {
+            for (uint16_t x = 0; x < w; x++) {
+                padded[(c * ph + y + 1) * pw + x + 1] = in[(c * h + y) * w + x];
+            }
+        }
+    }
+    
+    const uint16_t ow = (w + 1) / 2;
+    const uint16_t oh = (h + 1) / 2;
+    for (uint8_t oc = 0; oc < outCh; oc++) {
+        for (uint16_t oy = 0; oy < oh; oy++) {
+            for (uint16_t ox = 0; ox < ow; ox++) {
+                int32_t acc = bias[oc];
+                for (uint8_t ic = 0; ic < inCh; ic++) {
+                    for (int ky = 0; ky < 3; ky++) {
+                        for (int kx = 0; kx < 3; kx++) {
+                            acc += weights[((oc * inCh + ic) * 3 + ky) * 3 + kx] *
+                                   padded[(ic * ph + oy * 2 + ky) * pw + ox * 2 + kx];
+                        }
+                    }
+                }
+                int32_t value = acc > 0 ? acc >> shift[oc] : 0;
+                out[(oc * oh + oy) * ow + ox] = value > 127 ? 127 : value;
+            }
+        }
+    }
+}
+
+static void testConv() {
+    // Odd sizes leave a half-covered last row and column
+    const uint16_t sizes[][2] = { { 1, 1 }, { 5, 3 }, { 7, 7 }, { 16, 12 }, { 32, 24 }, { 33, 25 } };
+    const uint8_t channels[][2] = { { 1, 1 }, { 2, 8 }, { 8, 8 }, { 3, 5 } };
+    static int8_t in[8 * 33 * 25];
+    static int8_t out[8 * 17 * 13 + 1];
+    static int8_t expected[8 * 17 * 13];
+    
+    for (const auto& size : sizes) {
+        for (const auto& ch : channels) {
+            uint16_t w = size[0], h = size[1];
+            uint8_t inCh = ch[0], outCh = ch[1];
+            for (size_t i = 0; i < (size_t)inCh * w * h; i++) {
+                in[i] = randomLuma();
+            }
+            int8_t weights[8 * 8 * 9];
+            int32_t bias[8];
+            uint8_t shift[8];
+            for (size_t i = 0; i < (size_t)outCh * inCh * 9; i++) {
+                weights[i] = (int8_t)(randomNext() % 9) - 4;
+            }
+            for (uint8_t c = 0; c < outCh; c++) {
+                bias[c] = (int32_t)(randomNext() % 512) - 256;
+                shift[c] = randomNext() % 5;
+            }
+            
+            size_t outBytes = (size_t)outCh * ((w + 1) / 2) * ((h + 1) / 2);
+            memset(out, 0x55, sizeof(out));
+            AnimalClassifier::conv3x3s2(in, inCh, w, h, weights, bias, shift, outCh, out);
+            referenceConv(in, inCh, w, h, weights, bias, shift, outCh, expected);
+            CHECK(memcmp(out, expected, outBytes) == 0);
+            // Nothing written past the output map
+            CHECK_EQ(out[outBytes], 0x55);
+        }
+    }
+}
+
+static void testGlobalMax() {
+    int8_t in[3 * 7] = {
+        -5, -3, -9, -1, -7, -2, -8,      // all negative
+        0, 12, 3, 127, 5, 127, 1,        // repeated peak
+        4, 3, 2, 1, 0, -1, 9,            // peak in the last pixel
+    };
+    int8_t out[3];
+    AnimalClassifier::globalMax(in, 3, 7, out);
+    CHECK_EQ(out[0], -1);
+    CHECK_EQ(out[1], 127);
+    CHECK_EQ(out[2], 9);
+}
+
+static void testSigmoid() {
+    CHECK_EQ(AnimalClassifier::sigmoidPercent(-100000), 0);
+    CHECK_EQ(AnimalClassifier::sigmoidPercent(0), 50);
+    CHECK_EQ(AnimalClassifier::sigmoidPercent(16), 73);
+    CHECK_EQ(AnimalClassifier::sigmoidPercent(-16), 27);
+    CHECK_EQ(AnimalClassifier::sigmoidPercent(100000), 100);
+    
+    // Monotonic through the table and its interpolation
+    uint8_t previous = 0;
+    for (int32_t logit = -160; logit <= 160; logit++) {
+        uint8_t percent = AnimalClassifier::sigmoidPercent(logit);
+        CHECK(percent >= previous);
+        CHECK(percent <= 100);
+        previous = percent;
+    }
+}
+
+// Fixed scenes: a luma thumbnail and its change from the background
+struct Scene {
+    const char* name;
+    uint8_t golden;
+    uint8_t luma[PIXELS];
+    uint8_t change[PIXELS];
+};
+
+static void fillBlock(uint8_t* plane, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint8_t value) {
+    for (uint16_t y = y0; y < y1; y++) {
+        for (uint16_t x = x0; x < x1; x++) {
+            plane[y * CLASSIFIER_WIDTH + x] = value;
+        }
+    }
+}
+
+static void buildScenes(Scene* scenes) {
+    // Flat grey, nothing changed
+    memset(scenes[0].luma, 64, PIXELS);
+    memset(scenes[0].change, 0, PIXELS);
+    
+    // Light level shift: every pixel changed a little
+    memset(scenes[1].luma, 80, PIXELS);
+    memset(scenes[1].change, 12, PIXELS);
+    
+    // Sensor noise on a textured scene
+    for (size_t i = 0; i < PIXELS; i++) {
+        scenes[2].luma[i] = (i * 37) & 0x7F;
+        scenes[2].change[i] = (i * 7919 >> 3) % 4;
+    }
+    
+    // A dark body against a bright background, where it changed
+    memset(scenes[3].luma, 96, PIXELS);
+    memset(scenes[3].change, 1, PIXELS);
+    fillBlock(scenes[3].luma, 12, 8, 20, 15, 24);
+    fillBlock(scenes[3].change, 12, 8, 20, 15, 72);
+    
+    // A branch swaying: a thin strip of weak change, no luma edge
+    memset(scenes[4].luma, 50, PIXELS);
+    memset(scenes[4].change, 0, PIXELS);
+    fillBlock(scenes[4].change, 0, 11, 32, 12, 20);
+    
+    // Two bodies at the frame edges
+    memset(scenes[5].luma, 100, PIXELS);
+    memset(scenes[5].change, 0, PIXELS);
+    fillBlock(scenes[5].luma, 0, 0, 6, 5, 10);
+    fillBlock(scenes[5].change, 0, 0, 6, 5, 90);
+    fillBlock(scenes[5].luma, 27, 19, 32, 24, 10);
+    fillBlock(scenes[5].change, 27, 19, 32, 24, 90);
+    
+    // A small body far away: lands mid-scale, so any drift shows
+    memset(scenes[6].luma, 70, PIXELS);
+    memset(scenes[6].change, 0, PIXELS);
+    fillBlock(scenes[6].luma, 5, 16, 9, 20, 20);
+    fillBlock(scenes[6].change, 5, 16, 9, 20, 90);
+}
+
+static Scene scenes[] = {
+    { "flat",           2, {}, {} },
+    { "light shift",    2, {}, {} },
+    { "noise",          2, {}, {} },
+    { "body",           100, {}, {} },
+    { "swaying branch", 5, {}, {} },
+    { "two bodies",     100, {}, {} },
+    { "small body",     33, {}, {} },
+};
+
+static void testGolden() {
+    buildScenes(scenes);
+    for (const Scene& scene : scenes) {
+        uint8_t score = AnimalClassifier::score(scene.luma, scene.change);
+        if (score != scene.golden) {
+            printf("  scene '%s': score %d, golden %d\n", scene.name, score, scene.golden);
+        }
+        CHECK_EQ(score, scene.golden);
+        
+        // Same input, same score: no state leaks between calls
+        CHECK_EQ(AnimalClassifier::score(scene.luma, scene.change), score);
+    }
+}
+
+int main() {
+    testConv();
+    testGlobalMax();
+    testSigmoid();
+    testGolden();
+    return reportResults("animal_classifier");
+}
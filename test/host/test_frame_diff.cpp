@@ -0,0 +1,192 @@
+// Host test: FrameDiff's SWAR kernels against per-pixel references, over
+// every 7-bit lane pair, odd thumbnail widths and word counts that end
+// mid-row.
+
+#include "frame_diff.h"
+#include "frame_diff_reference.h"
+#include "host_test.h"
+#include <string.h>
+
+static const uint16_t WIDTHS[] = { 4, 5, 7, 9, 13, 31, 32, 33 };
+static const uint8_t THRESHOLDS[] = { 0, 1, 7, 16, 63, 126 };
+
+// Lane i of a word is byte i in memory
+static uint32_t lanes(uint8_t l0, uint8_t l1, uint8_t l2, uint8_t l3) {
+    uint8_t bytes[4] = { l0, l1, l2, l3 };
+    uint32_t word;
+    memcpy(&word, bytes, 4);
+    return word;
+}
+
+static void testLaneKernels() {
+    // Every 7-bit pair in lane 0, with random neighbours to catch carries
+    for (int a = 0; a < 128; a++) {
+        for (int b = 0; b < 128; b++) {
+            uint8_t n[6];
+            for (uint8_t& v : n) {
+                v = randomLuma();
+            }
+            uint32_t wa = lanes(a, n[0], n[1], n[2]);
+            uint32_t wb = lanes(b, n[3], n[4], n[5]);
+            
+            uint32_t diff = FrameDiff::absDiff4(wa, wb);
+            uint32_t expected = lanes(abs(a - b), abs(n[0] - n[3]), abs(n[1] - n[4]), abs(n[2] - n[5]));
+            CHECK_EQ(diff, expected);
+            
+            uint32_t average = FrameDiff::average4(wa, wb);
+            expected = lanes((a + b) / 2, (n[0] + n[3]) / 2, (n[1] + n[4]) / 2, (n[2] + n[5]) / 2);
+            CHECK_EQ(average, expected);
+        }
+    }
+    
+    for (int v = 0; v < 128; v++) {
+        for (int threshold = 0; threshold <= 126; threshold++) {
+            uint32_t word = lanes(v, 127 - v, v / 2, 127);
+            uint32_t expected = (v > threshold) + (127 - v > threshold) + (v / 2 > threshold) + (127 > threshold);
+            CHECK_EQ(FrameDiff::countAbove4(word, threshold), expected);
+        }
+    }
+}
+
+static void testFrameKernels() {
+    for (uint16_t width : WIDTHS) {
+        for (uint16_t height = 1; height <= 9; height++) {
+            size_t pixels = (size_t)width * height;
+            if (pixels % 4 != 0) {
+                continue;
+            }
+            size_t words = pixels / 4;
+            
+            // One spare word past the end must never be read into results or written
+            uint32_t a[words + 1];
+            uint32_t b[words + 1];
+            uint8_t* pa = (uint8_t*)a;
+            uint8_t* pb = (uint8_t*)b;
+            for (size_t i = 0; i < pixels + 4; i++) {
+                pa[i] = randomLuma();
+                // Mostly small changes, a few large ones
+                pb[i] = (randomNext() % 8 == 0) ? randomLuma() : (uint8_t)((pa[i] + randomNext() % 5) & 0x7F);
+            }
+            
+            for (uint8_t threshold : THRESHOLDS) {
+                CHECK_EQ(FrameDiff::countChanged(a, b, words, threshold),
+                         reference::countChanged(pa, pb, pixels, threshold));
+                
+                uint16_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+                uint16_t rx0 = 0, ry0 = 0, rx1 = 0, ry1 = 0;
+                bool found = FrameDiff::changedBounds(a, b, width, height, threshold, x0, y0, x1, y1);
+                bool expected = reference::changedBounds(pa, pb, width, height, threshold, rx0, ry0, rx1, ry1);
+                CHECK_EQ(found, expected);
+                if (found && expected) {
+                    CHECK_EQ(x0, rx0);
+                    CHECK_EQ(y0, ry0);
+                    CHECK_EQ(x1, rx1);
+                    CHECK_EQ(y1, ry1);
+                }
+            }
+            
+            CHECK_EQ(FrameDiff::sumAbsDiff(a, b, words), reference::sumAbsDiff(pa, pb, pixels));
+            
+            uint8_t expected[pixels + 4];
+            memcpy(expected, pa, pixels + 4);
+            reference::blend(expected, pb, pixels);
+            FrameDiff::blend(a, b, words);
+            CHECK(memcmp(pa, expected, pixels + 4) == 0);
+        }
+    }
+}
+
+static void testChangedBoundsEdges() {
+    // Single changed pixels at the corners of an odd-width frame
+    const uint16_t width = 13;
+    const uint16_t height = 4;
+    uint32_t a[width * height / 4];
+    uint32_t b[width * height / 4];
+    const uint16_t corners[][2] = { { 0, 0 }, { 12, 0 }, { 0, 3 }, { 12, 3 }, { 3, 1 } };
+    for (const auto& corner : corners) {
+        memset(a, 0x20, sizeof(a));
+        memset(b, 0x20, sizeof(b));
+        ((uint8_t*)b)[corner[1] * width + corner[0]] = 0x7F;
+        
+        uint16_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        CHECK(FrameDiff::changedBounds(a, b, width, height, 16, x0, y0, x1, y1));
+        CHECK_EQ(x0, corner[0]);
+        CHECK_EQ(y0, corner[1]);
+        CHECK_EQ(x1, corner[0] + 1);
+        CHECK_EQ(y1, corner[1] + 1);
+    }
+    
+    memset(b, 0x20, sizeof(b));
+    uint16_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    CHECK(!FrameDiff::changedBounds(a, b, width, height, 0, x0, y0, x1, y1));
+}
+
+static void testLumaAndHash() {
+    // Odd source sizes, shrinking and stretching
+    const uint16_t sizes[][4] = { { 33, 25, 32, 24 }, { 7, 5, 32, 24 }, { 320, 240, 32, 24 }, { 31, 17, 9, 8 } };
+    for (const auto& size : sizes) {
+        uint16_t sw = size[0], sh = size[1], dw = size[2], dh = size[3];
+        uint8_t rgb[(size_t)sw * sh * 2];
+        for (size_t i = 0; i < sizeof(rgb); i++) {
+            rgb[i] = randomNext();
+        }
+        uint8_t luma[(size_t)dw * dh];
+        FrameDiff::rgb565ToLuma7(rgb, sw, sh, luma, dw, dh);
+        for (uint8_t value : luma) {
+            CHECK(value < 128);
+        }
+    }
+    
+    // White and black land at the ends of the 7-bit range (565 white is
+    // 248/252/248, so 125 rather than 127)
+    uint8_t flat[8 * 6 * 2];
+    uint8_t luma[4 * 3];
+    memset(flat, 0xFF, sizeof(flat));
+    FrameDiff::rgb565ToLuma7(flat, 8, 6, luma, 4, 3);
+    CHECK_EQ(luma[0], 125);
+    CHECK_EQ(luma[11], 125);
+    memset(flat, 0x00, sizeof(flat));
+    FrameDiff::rgb565ToLuma7(flat, 8, 6, luma, 4, 3);
+    CHECK_EQ(luma[0], 0);
+    
+    // A left-to-right fall in brightness sets every hash bit; a rise clears them
+    const uint16_t width = 27;
+    const uint16_t height = 11;
+    uint8_t ramp[width * height];
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            ramp[y * width + x] = 127 - x * 4;
+        }
+    }
+    CHECK_EQ(FrameDiff::dHash(ramp, width, height), ~0ULL);
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            ramp[y * width + x] = x * 4;
+        }
+    }
+    CHECK_EQ(FrameDiff::dHash(ramp, width, height), 0ULL);
+    CHECK_EQ(FrameDiff::hammingDistance(0x0F0F, 0x00FF), 8);
+}
+
+static void testJpegDimensions() {
+    // SOI, an APP0 segment, then SOF0 for 320x240
+    const uint8_t jpeg[] = {
+        0xFF, 0xD8,
+        0xFF, 0xE0, 0x00, 0x04, 0x00, 0x00,
+        0xFF, 0xC0, 0x00, 0x11, 0x08, 0x00, 0xF0, 0x01, 0x40, 0x03, 0x01, 0x22, 0x00,
+    };
+    uint16_t width = 0, height = 0;
+    CHECK(FrameDiff::jpegDimensions(jpeg, sizeof(jpeg), width, height));
+    CHECK_EQ(width, 320);
+    CHECK_EQ(height, 240);
+    CHECK(!FrameDiff::jpegDimensions(jpeg, 10, width, height));
+}
+
+int main() {
+    testLaneKernels();
+    testFrameKernels();
+    testChangedBoundsEdges();
+    testLumaAndHash();
+    testJpegDimensions();
+    return reportResults("frame_diff");
+}
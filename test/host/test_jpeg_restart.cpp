@@ -0,0 +1,353 @@
+// Host test: JpegRestart against libjpeg. Rewritten images must decode to
+// the same pixels as the originals, with every marker the rewrite moved
+// sitting on a chunk boundary; salvaged images must decode, keep every
+// interval that arrived whole and turn the others flat grey.
+
+#include "jpeg_restart.h"
+#include "host_test.h"
+#include <jpeglib.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+// As config.h sets them for the mesh
+static const size_t CHUNK = 190;
+static const uint16_t INTERVAL = 4;
+static const size_t MAX_PAD = 16;
+
+static const size_t JPEG_CAPACITY = 64 * 1024;
+static const size_t MAX_PIXELS = 160 * 120;
+
+static uint8_t original[JPEG_CAPACITY];
+static size_t originalLength;
+static uint8_t rewritten[JPEG_CAPACITY];
+static size_t rewrittenLength;
+static uint8_t received[JPEG_CAPACITY];
+static uint8_t salvaged[JPEG_CAPACITY];
+static uint8_t expectedPixels[MAX_PIXELS * 3];
+static uint8_t pixels[MAX_PIXELS * 3];
+
+struct Format {
+    const char* name;
+    int components;
+    int h;
+    int v;
+};
+
+static const Format FORMATS[] = {
+    { "4:4:4", 3, 1, 1 },
+    { "4:2:2", 3, 2, 1 },
+    { "4:2:0", 3, 2, 2 },
+    { "grey",  1, 1, 1 },
+};
+
+static const uint16_t SIZES[][2] = { { 160, 120 }, { 75, 43 } };
+
+// Restart interval of the original: none, and one the rewrite replaces
+static const int RESTARTS[] = { 0, 5 };
+
+// Gradients, edges and noise, so every interval codes differently
+static void encode(const Format& format, uint16_t width, uint16_t height, int restart, bool progressive) {
+    static uint8_t source[MAX_PIXELS * 3];
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            uint8_t* p = source + (y * width + x) * format.components;
+            bool edge = ((x / 13) + (y / 9)) & 1;
+            for (int c = 0; c < format.components; c++) {
+                p[c] = (x * (c + 1) + y * (3 - c) + (edge ? 90 : 0) + randomNext() % 24) & 0xFF;
+            }
+        }
+    }
+    
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char* buffer = nullptr;
+    unsigned long length = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &length);
+    
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = format.components;
+    cinfo.in_color_space = format.components == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    cinfo.comp_info[0].h_samp_factor = format.h;
+    cinfo.comp_info[0].v_samp_factor = format.v;
+    cinfo.restart_interval = restart;
+    if (progressive) {
+        jpeg_simple_progression(&cinfo);
+    }
+    
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = source + cinfo.next_scanline * width * format.components;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    
+    originalLength = length <= JPEG_CAPACITY ? length : 0;
+    memcpy(original, buffer, originalLength);
+    free(buffer);
+}
+
+struct DecodeErrors {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void onDecodeError(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<DecodeErrors*>(cinfo->err)->jump, 1);
+}
+
+// Decode without fancy upsampling so each MCU's pixels depend on its own
+// blocks only. False on an error or any corrupt-data warning.
+static bool decode(const uint8_t* jpeg, size_t length, uint8_t* out, uint16_t width, uint16_t height) {
+    jpeg_decompress_struct cinfo;
+    DecodeErrors errors;
+    cinfo.err = jpeg_std_error(&errors.manager);
+    errors.manager.error_exit = onDecodeError;
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg, length);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.dct_method = JDCT_ISLOW;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+    bool sized = cinfo.output_width == width && cinfo.output_height == height;
+    while (sized && cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = out + cinfo.output_scanline * width * cinfo.output_components;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    if (sized) {
+        jpeg_finish_decompress(&cinfo);
+    }
+    bool clean = sized && errors.manager.num_warnings == 0;
+    jpeg_destroy_decompress(&cinfo);
+    return clean;
+}
+
+// Entropy-coded data start: just past the SOS segment
+static size_t scanStart(const uint8_t* jpeg, size_t length) {
+    for (size_t pos = 2; pos + 3 < length; ) {
+        size_t segment = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if (jpeg[pos + 1] == 0xDA) {
+            return pos + 2 + segment;
+        }
+        pos += 2 + segment;
+    }
+    return 0;
+}
+
+// Positions of the RSTn and EOI markers in the scan; fill bytes before a
+// marker are not part of it. Returns the marker count.
+static size_t findMarkers(const uint8_t* jpeg, size_t length, size_t* markers, size_t capacity) {
+    size_t count = 0;
+    for (size_t pos = scanStart(jpeg, length); pos + 1 < length && count < capacity; pos++) {
+        uint8_t code = jpeg[pos + 1];
+        if (jpeg[pos] == 0xFF && ((code & 0xF8) == 0xD0 || code == 0xD9)) {
+            markers[count++] = pos;
+            pos++;
+        }
+    }
+    return count;
+}
+
+static uint32_t mcuCount(const Format& format, uint16_t width, uint16_t height) {
+    return ((width + 8 * format.h - 1) / (8 * format.h)) * ((height + 8 * format.v - 1) / (8 * format.v));
+}
+
+static void testRewrite(const Format& format, uint16_t width, uint16_t height) {
+    size_t pixelBytes = (size_t)width * height * format.components;
+    CHECK(decode(original, originalLength, expectedPixels, width, height));
+    
+    rewrittenLength = JpegRestart::rewrite(original, originalLength, rewritten, sizeof(rewritten),
+                                           INTERVAL, CHUNK, MAX_PAD);
+    CHECK(rewrittenLength > 0);
+    if (rewrittenLength == 0) {
+        return;
+    }
+    
+    // Same pixels as before
+    memset(pixels, 0, pixelBytes);
+    CHECK(decode(rewritten, rewrittenLength, pixels, width, height));
+    CHECK(memcmp(pixels, expectedPixels, pixelBytes) == 0);
+    
+    // RST0..RST7 in turn between the intervals, then EOI
+    static size_t markers[4096];
+    size_t count = findMarkers(rewritten, rewrittenLength, markers, 4096);
+    uint32_t intervals = (mcuCount(format, width, height) + INTERVAL - 1) / INTERVAL;
+    CHECK_EQ(count, intervals);
+    for (size_t i = 0; i + 1 < count; i++) {
+        CHECK_EQ(rewritten[markers[i] + 1], 0xD0 + (i & 7));
+    }
+    CHECK_EQ(markers[count - 1], rewrittenLength - 2);
+    
+    // A marker with fill before it sits on a chunk boundary, within the
+    // fill allowed; one without had no boundary it could cheaply reach
+    static size_t fill[4096];
+    for (size_t i = 0; i < count; i++) {
+        fill[i] = 0;
+        while (rewritten[markers[i] - fill[i] - 1] == 0xFF) {
+            fill[i]++;
+        }
+    }
+    CHECK_EQ(fill[count - 1], 0);
+    for (size_t i = 0; i + 1 < count; i++) {
+        size_t boundary = (markers[i] / CHUNK + 1) * CHUNK;
+        size_t end = markers[i + 1] - fill[i + 1];
+        if (fill[i] > 0) {
+            CHECK_EQ(markers[i] % CHUNK, 0);
+            CHECK(fill[i] <= MAX_PAD);
+        } else {
+            // The interval ends before the next boundary, or the fill cost too much
+            CHECK(end <= boundary || boundary - markers[i] > MAX_PAD);
+        }
+    }
+    
+    // Too small an output buffer
+    CHECK_EQ(JpegRestart::rewrite(original, originalLength, salvaged, rewrittenLength - 1,
+                                  INTERVAL, CHUNK, MAX_PAD), 0);
+}
+
+// Drop the chunks in lost[], salvage, and check every interval: kept ones
+// decode as in the rewritten image, the others flat grey
+static void checkSalvage(const Format& format, uint16_t width, uint16_t height,
+                         const size_t* lost, size_t lostCount) {
+    size_t chunks = (rewrittenLength + CHUNK - 1) / CHUNK;
+    uint8_t chunkMap[JPEG_CAPACITY / CHUNK / 8 + 1];
+    memset(chunkMap, 0xFF, sizeof(chunkMap));
+    memcpy(received, rewritten, rewrittenLength);
+    for (size_t i = 0; i < lostCount; i++) {
+        chunkMap[lost[i] / 8] &= ~(1 << (lost[i] % 8));
+        for (size_t b = lost[i] * CHUNK; b < (lost[i] + 1) * CHUNK && b < rewrittenLength; b++) {
+            received[b] = randomNext();
+        }
+    }
+    
+    // An interval survives if its bytes and both markers delimiting it arrived
+    static size_t markers[4096];
+    size_t count = findMarkers(rewritten, rewrittenLength, markers, 4096);
+    static bool intervalLost[4096];
+    uint16_t expectedLost = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i == 0 ? scanStart(rewritten, rewrittenLength) : markers[i - 1];
+        intervalLost[i] = false;
+        for (size_t chunk = start / CHUNK; chunk * CHUNK < markers[i] + 2 && chunk < chunks; chunk++) {
+            if (!(chunkMap[chunk / 8] & (1 << (chunk % 8)))) {
+                intervalLost[i] = true;
+            }
+        }
+        expectedLost += intervalLost[i];
+    }
+    
+    uint16_t lostIntervals = 0;
+    uint16_t totalIntervals = 0;
+    size_t length = JpegRestart::salvage(received, rewrittenLength, chunkMap, CHUNK,
+                                         salvaged, sizeof(salvaged), lostIntervals, totalIntervals);
+    CHECK(length > 0);
+    CHECK_EQ(totalIntervals, count);
+    CHECK_EQ(lostIntervals, expectedLost);
+    if (length == 0) {
+        return;
+    }
+    
+    CHECK(decode(salvaged, length, pixels, width, height));
+    uint16_t mcuWidth = 8 * format.h;
+    uint16_t mcuHeight = 8 * format.v;
+    uint32_t mcusX = (width + mcuWidth - 1) / mcuWidth;
+    uint32_t mcus = mcuCount(format, width, height);
+    int mismatched = 0;
+    for (uint32_t mcu = 0; mcu < mcus; mcu++) {
+        bool grey = intervalLost[mcu / INTERVAL];
+        for (uint16_t y = (mcu / mcusX) * mcuHeight; y < ((mcu / mcusX) + 1) * mcuHeight && y < height; y++) {
+            for (uint16_t x = (mcu % mcusX) * mcuWidth; x < ((mcu % mcusX) + 1) * mcuWidth && x < width; x++) {
+                for (int c = 0; c < format.components; c++) {
+                    size_t at = (y * width + x) * format.components + c;
+                    mismatched += pixels[at] != (grey ? 128 : expectedPixels[at]);
+                }
+            }
+        }
+    }
+    CHECK_EQ(mismatched, 0);
+}
+
+static void testSalvage(const Format& format, uint16_t width, uint16_t height) {
+    if (rewrittenLength == 0) {
+        return;
+    }
+    size_t chunks = (rewrittenLength + CHUNK - 1) / CHUNK;
+    size_t firstData = scanStart(rewritten, rewrittenLength) / CHUNK + 1;
+    
+    // Everything arrived
+    checkSalvage(format, width, height, nullptr, 0);
+    
+    // One chunk, two adjacent ones, the last (EOI) and the first after the headers
+    size_t middle[] = { chunks / 2 };
+    checkSalvage(format, width, height, middle, 1);
+    if (chunks > firstData + 3) {
+        size_t pair[] = { chunks / 2, chunks / 2 + 1 };
+        checkSalvage(format, width, height, pair, 2);
+        size_t scattered[] = { firstData, chunks / 3, chunks - 2 };
+        checkSalvage(format, width, height, scattered, 3);
+    }
+    size_t last[] = { chunks - 1 };
+    checkSalvage(format, width, height, last, 1);
+    
+    // Headers lost: nothing to rebuild from
+    uint8_t chunkMap[JPEG_CAPACITY / CHUNK / 8 + 1];
+    memset(chunkMap, 0xFF, sizeof(chunkMap));
+    chunkMap[0] &= ~1;
+    uint16_t lostIntervals = 1;
+    uint16_t totalIntervals = 1;
+    CHECK_EQ(JpegRestart::salvage(rewritten, rewrittenLength, chunkMap, CHUNK,
+                                  salvaged, sizeof(salvaged), lostIntervals, totalIntervals), 0);
+    CHECK_EQ(lostIntervals, 0);
+    CHECK_EQ(totalIntervals, 0);
+}
+
+static void testUnsupported() {
+    size_t length = 0;
+    uint16_t lostIntervals, totalIntervals;
+    uint8_t chunkMap[JPEG_CAPACITY / CHUNK / 8 + 1];
+    memset(chunkMap, 0xFF, sizeof(chunkMap));
+    
+    // Progressive
+    encode(FORMATS[2], 64, 48, 0, true);
+    CHECK(originalLength > 0);
+    length = JpegRestart::rewrite(original, originalLength, rewritten, sizeof(rewritten), INTERVAL, CHUNK, MAX_PAD);
+    CHECK_EQ(length, 0);
+    
+    // No restart interval to salvage by
+    encode(FORMATS[2], 64, 48, 0, false);
+    CHECK_EQ(JpegRestart::salvage(original, originalLength, chunkMap, CHUNK,
+                                  salvaged, sizeof(salvaged), lostIntervals, totalIntervals), 0);
+    
+    // Not a JPEG
+    uint8_t garbage[512];
+    for (uint8_t& byte : garbage) {
+        byte = randomNext();
+    }
+    CHECK_EQ(JpegRestart::rewrite(garbage, sizeof(garbage), rewritten, sizeof(rewritten), INTERVAL, CHUNK, MAX_PAD), 0);
+}
+
+int main() {
+    for (const Format& format : FORMATS) {
+        for (const auto& size : SIZES) {
+            for (int restart : RESTARTS) {
+                encode(format, size[0], size[1], restart, false);
+                CHECK(originalLength > 0);
+                testRewrite(format, size[0], size[1]);
+                testSalvage(format, size[0], size[1]);
+            }
+        }
+    }
+    testUnsupported();
+    return reportResults("jpeg_restart");
+}